@@ -0,0 +1,81 @@
+/*
+nifly
+C++ NIF library for the Gamebryo/NetImmerse File Format
+See the included GPLv3 LICENSE file
+*/
+
+// Example: converts all NIF files of a directory tree between Skyrim LE and SE using NifBatch.
+// Usage: NifBatchOptimize <input dir> <output dir> [le|se] [threads]
+
+#include <NifBatch.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+
+using namespace nifly;
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cerr << "Usage: " << argv[0] << " <input dir> <output dir> [le|se] [threads]" << std::endl;
+		return 1;
+	}
+
+	const std::filesystem::path inputDir = argv[1];
+	const std::filesystem::path outputDir = argv[2];
+	const bool toLE = argc > 3 && std::string(argv[3]) == "le";
+
+	std::vector<std::filesystem::path> files;
+	for (auto& entry : std::filesystem::recursive_directory_iterator(inputDir)) {
+		std::string ext = entry.path().extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+			return static_cast<char>(std::tolower(c));
+		});
+		if (entry.is_regular_file() && ext == ".nif")
+			files.push_back(entry.path());
+	}
+
+	std::sort(files.begin(), files.end());
+
+	NifBatchOptions options;
+	if (argc > 4)
+		options.numThreads = static_cast<uint32_t>(std::stoul(argv[4]));
+
+	options.outputFunc = [&](const std::filesystem::path& fileName) {
+		std::filesystem::path outFileName = outputDir / std::filesystem::relative(fileName, inputDir);
+		std::filesystem::create_directories(outFileName.parent_path());
+		return outFileName;
+	};
+
+	auto processFunc = [toLE](NifFile& nif, const std::filesystem::path&) {
+		OptOptions optOptions;
+		optOptions.targetVersion = toLE ? NiVersion::getSK() : NiVersion::getSSE();
+
+		OptResult result = nif.OptimizeFor(optOptions);
+		return result.versionMismatch ? 1 : 0;
+	};
+
+	auto resultFunc = [](const NifBatchResult& result) {
+		switch (result.status) {
+			case NBS_OK: break;
+			case NBS_LOAD_FAILED:
+				std::cerr << result.fileName.string() << ": load failed (" << result.error << ")" << std::endl;
+				break;
+			case NBS_PROCESS_FAILED:
+				std::cerr << result.fileName.string() << ": version not supported" << std::endl;
+				break;
+			case NBS_SAVE_FAILED:
+				std::cerr << result.fileName.string() << ": save failed (" << result.error << ")" << std::endl;
+				break;
+			case NBS_EXCEPTION:
+				std::cerr << result.fileName.string() << ": " << result.message << std::endl;
+				break;
+		}
+	};
+
+	NifBatch batch(options);
+	const size_t numFailed = batch.Run(files, processFunc, resultFunc);
+
+	std::cout << files.size() - numFailed << " of " << files.size() << " files converted" << std::endl;
+	return numFailed == 0 ? 0 : 2;
+}
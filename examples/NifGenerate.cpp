@@ -0,0 +1,110 @@
+/*
+nifly
+C++ NIF library for the Gamebryo/NetImmerse File Format
+See the included GPLv3 LICENSE file
+*/
+
+// Example: generates a synthetic NIF file using NifGenerator.
+// Usage: NifGenerate <output file> [options]
+//   --version <ob|fo3|sk|sse|fo4|fo76>   File version (default: sse)
+//   --nodes <count>                     Nodes below the root node
+//   --depth <count>                     Length of the node chains below the root node
+//   --shapes <count>                    Shapes
+//   --verts <count>                     Vertices per shape
+//   --bones <count>                     Bones per shape (0 = unskinned)
+//   --controllers <count>               Nodes with a transform controller
+//   --blocks <count>                    Minimum block count
+//   --collision                         Adds collision to the nodes with shapes
+
+#include <NifGenerator.hpp>
+
+#include <iostream>
+
+using namespace nifly;
+
+static bool ParseVersion(const std::string& name, NiVersion& version) {
+	if (name == "ob")
+		version = NiVersion::getOB();
+	else if (name == "fo3")
+		version = NiVersion::getFO3();
+	else if (name == "sk")
+		version = NiVersion::getSK();
+	else if (name == "sse")
+		version = NiVersion::getSSE();
+	else if (name == "fo4")
+		version = NiVersion::getFO4();
+	else if (name == "fo76")
+		version = NiVersion::getFO76();
+	else
+		return false;
+
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0]
+				  << " <output file> [--version <ob|fo3|sk|sse|fo4|fo76>] [--nodes <count>] [--depth <count>]"
+					 " [--shapes <count>] [--verts <count>] [--bones <count>] [--controllers <count>]"
+					 " [--blocks <count>] [--collision]"
+				  << std::endl;
+		return 1;
+	}
+
+	const std::filesystem::path outFileName = argv[1];
+
+	NifGeneratorOptions options;
+	for (int i = 2; i < argc; i++) {
+		const std::string arg = argv[i];
+		if (arg == "--collision") {
+			options.collision = true;
+			continue;
+		}
+
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+
+		const std::string value = argv[++i];
+		if (arg == "--version") {
+			if (!ParseVersion(value, options.version)) {
+				std::cerr << "Unknown version " << value << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--nodes")
+			options.nodeCount = static_cast<uint32_t>(std::stoul(value));
+		else if (arg == "--depth")
+			options.nodeDepth = static_cast<uint32_t>(std::stoul(value));
+		else if (arg == "--shapes")
+			options.shapeCount = static_cast<uint32_t>(std::stoul(value));
+		else if (arg == "--verts")
+			options.vertsPerShape = static_cast<uint16_t>(std::min<unsigned long>(std::stoul(value), 0xFFFF));
+		else if (arg == "--bones")
+			options.bonesPerSkin = static_cast<uint16_t>(std::min<unsigned long>(std::stoul(value), 0xFFFF));
+		else if (arg == "--controllers")
+			options.controllerCount = static_cast<uint32_t>(std::stoul(value));
+		else if (arg == "--blocks")
+			options.blockCount = static_cast<uint32_t>(std::stoul(value));
+		else {
+			std::cerr << "Unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	NifFile nif;
+	NifGenerator generator(options);
+	if (generator.Generate(nif)) {
+		std::cerr << "Invalid generator options" << std::endl;
+		return 1;
+	}
+
+	if (nif.Save(outFileName)) {
+		std::cerr << "Failed to save " << outFileName.string() << std::endl;
+		return 2;
+	}
+
+	std::cout << outFileName.string() << ": " << nif.GetHeader().GetNumBlocks() << " blocks" << std::endl;
+	return 0;
+}
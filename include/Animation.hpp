@@ -24,7 +24,9 @@ public:
 	static constexpr const char* BlockName = "NiKeyframeData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 CLONEABLECLASSDEF(NiTransformData, NiKeyframeData) {
@@ -41,7 +43,9 @@ public:
 	static constexpr const char* BlockName = "NiPosData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiBoolData, NiObject) {
@@ -51,7 +55,9 @@ public:
 	static constexpr const char* BlockName = "NiBoolData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiFloatData, NiObject) {
@@ -61,7 +67,9 @@ public:
 	static constexpr const char* BlockName = "NiFloatData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiBSplineData, NiObject) {
@@ -72,7 +80,9 @@ public:
 	static constexpr const char* BlockName = "NiBSplineData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiBSplineBasisData, NiObject) {
@@ -82,7 +92,8 @@ public:
 	static constexpr const char* BlockName = "NiBSplineBasisData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(NiInterpolator, NiObject) {};
@@ -94,9 +105,9 @@ public:
 	NiBlockRef<NiBSplineData> splineDataRef;
 	NiBlockRef<NiBSplineBasisData> basisDataRef;
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 CLONEABLECLASSDEF(NiBSplineFloatInterpolator, NiBSplineInterpolator) {};
@@ -111,7 +122,8 @@ public:
 	static constexpr const char* BlockName = "NiBSplineCompFloatInterpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiBSplinePoint3Interpolator, NiBSplineInterpolator) {
@@ -119,7 +131,8 @@ public:
 	Vector3 value = NiVec3Min;
 	uint32_t handle = NiUShortMax;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiBSplineCompPoint3Interpolator, NiBSplinePoint3Interpolator) {
@@ -130,7 +143,8 @@ public:
 	static constexpr const char* BlockName = "NiBSplineCompPoint3Interpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiBSplineTransformInterpolator, NiBSplineInterpolator) {
@@ -146,7 +160,8 @@ public:
 	static constexpr const char* BlockName = "NiBSplineTransformInterpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiBSplineCompTransformInterpolator, NiBSplineTransformInterpolator) {
@@ -161,7 +176,8 @@ public:
 	static constexpr const char* BlockName = "NiBSplineCompTransformInterpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 enum InterpBlendFlags : uint8_t { INTERP_BLEND_NONE = 0x00, INTERP_BLEND_MANAGER_CONTROLLED = 0x01 };
@@ -174,7 +190,8 @@ public:
 	uint8_t priority = 0;
 	float easeSpinner = 0.0f;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiBlendInterpolator, NiInterpolator) {
@@ -193,7 +210,9 @@ public:
 	float highEaseSpinner = NiFloatMin;
 	std::vector<InterpBlendItem> interpItems;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiBlendBoolInterpolator, NiBlendInterpolator) {
@@ -203,7 +222,8 @@ public:
 	static constexpr const char* BlockName = "NiBlendBoolInterpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiBlendFloatInterpolator, NiBlendInterpolator) {
@@ -213,7 +233,8 @@ public:
 	static constexpr const char* BlockName = "NiBlendFloatInterpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiBlendPoint3Interpolator, NiBlendInterpolator) {
@@ -223,7 +244,8 @@ public:
 	static constexpr const char* BlockName = "NiBlendPoint3Interpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiBlendTransformInterpolator, NiBlendInterpolator) {
@@ -242,9 +264,9 @@ public:
 	static constexpr const char* BlockName = "NiBoolInterpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 CLONEABLECLASSDEF(NiBoolTimelineInterpolator, NiBoolInterpolator) {
@@ -261,9 +283,9 @@ public:
 	static constexpr const char* BlockName = "NiFloatInterpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiTransformInterpolator, NiKeyBasedInterpolator) {
@@ -276,9 +298,9 @@ public:
 	static constexpr const char* BlockName = "NiTransformInterpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 CLONEABLECLASSDEF(BSRotAccumTransfInterpolator, NiTransformInterpolator) {
@@ -295,9 +317,9 @@ public:
 	static constexpr const char* BlockName = "NiPoint3Interpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 enum PathFlags : uint16_t {
@@ -326,9 +348,9 @@ public:
 	static constexpr const char* BlockName = "NiPathInterpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 enum LookAtFlags : uint16_t {
@@ -355,11 +377,12 @@ public:
 	static constexpr const char* BlockName = "NiLookAtInterpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 struct BSTreadTransformData {
@@ -373,13 +396,16 @@ struct BSTreadTransform {
 	BSTreadTransformData transform1;
 	BSTreadTransformData transform2;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		name.Sync(stream);
 		stream.Sync(transform1);
 		stream.Sync(transform2);
 	}
 
-	void GetStringRefs(std::vector<NiStringRef*>& refs) { refs.emplace_back(&name); }
+	size_t GetHeapSize() const { return HeapSize(name); }
+
+	void ForEachStringRef(const NiStringRefVisitor& visitor) { visitor(name); }
 };
 
 STREAMABLECLASSDEF(BSTreadTransfInterpolator, NiInterpolator) {
@@ -390,10 +416,11 @@ public:
 	static constexpr const char* BlockName = "BSTreadTransfInterpolator";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 class NiObjectNET;
@@ -408,10 +435,10 @@ public:
 	float stopTime = NiFloatMin;
 	NiBlockPtr<NiObjectNET> targetRef;
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiLookAtController, NiTimeController) {
@@ -422,8 +449,9 @@ public:
 	static constexpr const char* BlockName = "NiLookAtController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiPathController, NiTimeController) {
@@ -439,9 +467,9 @@ public:
 	static constexpr const char* BlockName = "NiPathController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 CLONEABLECLASSDEF(NiPSysResetOnLoopCtlr, NiTimeController) {
@@ -460,7 +488,9 @@ public:
 	static constexpr const char* BlockName = "NiUVData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiUVController, NiTimeController) {
@@ -471,9 +501,9 @@ public:
 	static constexpr const char* BlockName = "NiUVController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(BSFrustumFOVController, NiTimeController) {
@@ -483,9 +513,9 @@ public:
 	static constexpr const char* BlockName = "BSFrustumFOVController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(BSLagBoneController, NiTimeController) {
@@ -497,7 +527,8 @@ public:
 	static constexpr const char* BlockName = "BSLagBoneController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 class BSShaderProperty;
@@ -532,9 +563,9 @@ public:
 	static constexpr const char* BlockName = "BSProceduralLightningController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiBoneLODController, NiTimeController) {
@@ -546,8 +577,10 @@ public:
 	static constexpr const char* BlockName = "NiBoneLODController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 CLONEABLECLASSDEF(NiBSBoneLODController, NiBoneLODController) {
@@ -560,14 +593,17 @@ struct Morph {
 	NiStringRef frameName;
 	std::vector<Vector3> vectors;
 
-	void Sync(NiStreamReversible& stream, uint32_t numVerts) {
+	template<typename Stream>
+	void Sync(Stream& stream, uint32_t numVerts) {
 		frameName.Sync(stream);
 		vectors.resize(numVerts);
 		for (uint32_t i = 0; i < numVerts; i++)
 			stream.Sync(vectors[i]);
 	}
 
-	void GetStringRefs(std::vector<NiStringRef*>& refs) { refs.emplace_back(&frameName); }
+	size_t GetHeapSize() const { return HeapSize(frameName) + HeapSize(vectors); }
+
+	void ForEachStringRef(const NiStringRefVisitor& visitor) { visitor(frameName); }
 };
 
 STREAMABLECLASSDEF(NiMorphData, NiObject) {
@@ -582,8 +618,11 @@ public:
 	static constexpr const char* BlockName = "NiMorphData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
+	void notifyVerticesReorder(const std::vector<uint16_t>& vertMap) override;
 
 	std::vector<Morph> GetMorphs() const;
 	void SetMorphs(const uint32_t numVerts, const std::vector<Morph>& m);
@@ -596,13 +635,13 @@ public:
 	NiBlockRef<NiInterpolator> interpRef;
 	float weight = 0.0f;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		interpRef.Sync(stream);
 		stream.Sync(weight);
 	}
 
-	void GetChildRefs(std::set<NiRef*>& refs) { refs.insert(&interpRef); }
-	void GetChildIndices(std::vector<uint32_t>& indices) { indices.push_back(interpRef.index); }
+	void ForEachChildRef(const NiRefVisitor& visitor) { visitor(interpRef); }
 };
 
 enum GeomMorpherFlags : uint16_t { GM_UPDATE_NORMALS_DISABLED, GM_UPDATE_NORMALS_ENABLED };
@@ -617,18 +656,19 @@ public:
 	static constexpr const char* BlockName = "NiGeomMorpherController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiSingleInterpController, NiInterpController) {
 public:
 	NiBlockRef<NiInterpController> interpolatorRef;
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiRollController, NiSingleInterpController) {
@@ -638,9 +678,9 @@ public:
 	static constexpr const char* BlockName = "NiRollController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 enum TargetColor : uint16_t { TC_AMBIENT, TC_DIFFUSE, TC_SPECULAR, TC_SELF_ILLUM };
@@ -649,7 +689,8 @@ STREAMABLECLASSDEF(NiPoint3InterpController, NiSingleInterpController) {
 public:
 	TargetColor targetColor = TC_AMBIENT;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(NiMaterialColorController, NiPoint3InterpController) {
@@ -673,8 +714,10 @@ public:
 	static constexpr const char* BlockName = "NiFloatExtraDataController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiVisData, NiObject) {
@@ -684,7 +727,9 @@ public:
 	static constexpr const char* BlockName = "NiVisData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 class NiBoolInterpController : public NiSingleInterpController {};
@@ -728,9 +773,10 @@ public:
 	static constexpr const char* BlockName = "NiFlipController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 enum TexTransformType : uint32_t { TT_TRANSLATE_U, TT_TRANSLATE_V, TT_ROTATE, TT_SCALE_U, TT_SCALE_V };
@@ -744,7 +790,8 @@ public:
 	static constexpr const char* BlockName = "NiTextureTransformController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(NiLightDimmerController, NiFloatInterpController) {
@@ -808,7 +855,8 @@ public:
 	static constexpr const char* BlockName = "BSLightingShaderPropertyColorController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSLightingShaderPropertyFloatController, NiFloatInterpController) {
@@ -818,7 +866,8 @@ public:
 	static constexpr const char* BlockName = "BSLightingShaderPropertyFloatController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSLightingShaderPropertyUShortController, NiFloatInterpController) {
@@ -828,7 +877,8 @@ public:
 	static constexpr const char* BlockName = "BSLightingShaderPropertyUShortController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSEffectShaderPropertyColorController, NiFloatInterpController) {
@@ -838,7 +888,8 @@ public:
 	static constexpr const char* BlockName = "BSEffectShaderPropertyColorController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSEffectShaderPropertyFloatController, NiFloatInterpController) {
@@ -848,7 +899,8 @@ public:
 	static constexpr const char* BlockName = "BSEffectShaderPropertyFloatController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 class NiAVObject;
@@ -860,16 +912,20 @@ public:
 	static constexpr const char* BlockName = "NiMultiTargetTransformController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiPSysModifierCtlr, NiSingleInterpController) {
 public:
 	NiStringRef modifierName;
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 CLONEABLECLASSDEF(NiPSysModifierBoolCtlr, NiPSysModifierCtlr) {};
@@ -997,9 +1053,9 @@ public:
 	static constexpr const char* BlockName = "NiPSysEmitterCtlr";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 class BSMasterParticleSystem;
@@ -1012,8 +1068,9 @@ public:
 	static constexpr const char* BlockName = "BSPSysMultiTargetEmitterCtlr";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiStringPalette, NiObject) {
@@ -1024,7 +1081,9 @@ public:
 	static constexpr const char* BlockName = "NiStringPalette";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 class ControllerLink {
@@ -1039,7 +1098,8 @@ public:
 	NiStringRef ctrlID;
 	NiStringRef interpID;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		interpolatorRef.Sync(stream);
 		controllerRef.Sync(stream);
 		stream.Sync(priority);
@@ -1051,22 +1111,22 @@ public:
 		interpID.Sync(stream);
 	}
 
-	void GetStringRefs(std::vector<NiStringRef*>& refs) {
-		refs.emplace_back(&nodeName);
-		refs.emplace_back(&propType);
-		refs.emplace_back(&ctrlType);
-		refs.emplace_back(&ctrlID);
-		refs.emplace_back(&interpID);
+	size_t GetHeapSize() const {
+		return HeapSize(nodeName) + HeapSize(propType) + HeapSize(ctrlType) + HeapSize(ctrlID)
+			   + HeapSize(interpID);
 	}
 
-	void GetChildRefs(std::set<NiRef*>& refs) {
-		refs.insert(&interpolatorRef);
-		refs.insert(&controllerRef);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) {
+		visitor(nodeName);
+		visitor(propType);
+		visitor(ctrlType);
+		visitor(ctrlID);
+		visitor(interpID);
 	}
 
-	void GetChildIndices(std::vector<uint32_t>& indices) {
-		indices.push_back(interpolatorRef.index);
-		indices.push_back(controllerRef.index);
+	void ForEachChildRef(const NiRefVisitor& visitor) {
+		visitor(interpolatorRef);
+		visitor(controllerRef);
 	}
 };
 
@@ -1080,10 +1140,11 @@ public:
 	static constexpr const char* BlockName = "NiSequence";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 enum CycleType : uint32_t { CYCLE_LOOP, CYCLE_REVERSE, CYCLE_CLAMP };
@@ -1101,7 +1162,8 @@ public:
 	static constexpr const char* BlockName = "BSAnimNote";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSAnimNotes, NiObject) {
@@ -1111,9 +1173,10 @@ public:
 	static constexpr const char* BlockName = "BSAnimNotes";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 class NiControllerManager;
@@ -1135,11 +1198,12 @@ public:
 	static constexpr const char* BlockName = "NiControllerSequence";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 class NiDefaultAVObjectPalette;
@@ -1153,8 +1217,9 @@ public:
 	static constexpr const char* BlockName = "NiControllerManager";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 } // namespace nifly
@@ -18,6 +18,7 @@ See the included GPLv3 LICENSE file
 #include <set>
 #include <streambuf>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -144,6 +145,8 @@ public:
 	uint32_t NDS() const { return nds; }
 	void SetNDS(const uint32_t ndsVer) { nds = ndsVer; }
 
+	size_t GetHeapSize() const;
+
 	// Check if file is for a Bethesda title
 	bool IsBethesda() const { return (file == V20_2_0_7 && user >= 11) || IsOB(); }
 
@@ -221,27 +224,41 @@ public:
 	}
 };
 
+// Writes to an output stream, or only counts the written bytes without a stream
 class NiOStream : public NiStreamBase {
 private:
 	std::ostream* stream = nullptr;
 	std::streamsize blockSize = 0;
+	std::streamsize totalSize = 0;
 
 public:
 	NiOStream(std::ostream* s, NiVersion v)
 		: NiStreamBase(std::move(v))
 		, stream(s) {}
 
+	// Counting only
+	NiOStream(NiVersion v)
+		: NiStreamBase(std::move(v)) {}
+
 	void write(const char* ptr, std::streamsize count) {
-		stream->write(ptr, count);
+		if (stream)
+			stream->write(ptr, count);
 		blockSize += count;
+		totalSize += count;
 	}
 
 	void writeline(const char* ptr, std::streamsize count) {
-		stream->write(ptr, count);
-		stream->write("\n", 1);
+		if (stream) {
+			stream->write(ptr, count);
+			stream->write("\n", 1);
+		}
 		blockSize += count + 1;
+		totalSize += count + 1;
 	}
-	std::streampos tellp() { return stream->tellp(); }
+	std::streampos tellp() { return stream ? stream->tellp() : std::streampos(totalSize); }
+
+	// Bytes written since the stream was created
+	std::streamsize GetTotalSize() const { return totalSize; }
 
 	// Be careful with sizes of structs and classes
 	template<typename T>
@@ -321,6 +338,109 @@ private:
 	Mode mode;
 };
 
+// Stream types of the Sync functions that are used by Get and Put.
+// They have the interface of NiStreamReversible, but their mode is known at compile time,
+// so that mode checks in Sync functions are resolved when they are instantiated.
+class NiStreamReader {
+public:
+	using Mode = NiStreamReversible::Mode;
+
+	explicit NiStreamReader(NiIStream& is)
+		: istream(is) {}
+
+	static constexpr Mode GetMode() { return Mode::Reading; }
+
+	template<typename T>
+	void Sync(T& t) {
+		istream.read(reinterpret_cast<char*>(&t), sizeof(T));
+	}
+
+	NiVersion& GetVersion() { return istream.GetVersion(); }
+	const NiVersion& GetVersion() const { return istream.GetVersion(); }
+
+	void Sync(char* ptr, std::streamsize count) { istream.read(ptr, count); }
+	void SyncLine(char* ptr, std::streamsize count) { istream.getline(ptr, count); }
+
+	void SyncHalf(float& fl) {
+		half_float::half halfData;
+		istream.read(reinterpret_cast<char*>(&halfData), 2);
+		fl = halfData;
+	}
+
+	static constexpr NiOStream* asWrite() { return nullptr; }
+	NiIStream* asRead() { return &istream; }
+
+private:
+	NiIStream& istream;
+};
+
+class NiStreamWriter {
+public:
+	using Mode = NiStreamReversible::Mode;
+
+	explicit NiStreamWriter(NiOStream& os)
+		: ostream(os) {}
+
+	static constexpr Mode GetMode() { return Mode::Writing; }
+
+	template<typename T>
+	void Sync(T& t) {
+		ostream.write(reinterpret_cast<char*>(&t), sizeof(T));
+	}
+
+	NiVersion& GetVersion() { return ostream.GetVersion(); }
+	const NiVersion& GetVersion() const { return ostream.GetVersion(); }
+
+	void Sync(char* ptr, std::streamsize count) { ostream.write(ptr, count); }
+	void SyncLine(char* ptr, std::streamsize count) { ostream.writeline(ptr, count); }
+
+	void SyncHalf(float& fl) {
+		half_float::half halfData(fl);
+		ostream.write(reinterpret_cast<char*>(&halfData), 2);
+	}
+
+	NiOStream* asWrite() { return &ostream; }
+	static constexpr NiIStream* asRead() { return nullptr; }
+
+private:
+	NiOStream& ostream;
+};
+
+// Sync functions are templates over the stream type. Those defined in source files are instantiated
+// with this after their definition, NiStreamReversible is kept for compatibility.
+#define NIFLY_SYNC_INSTANTIATE(CLASS) \
+	template void CLASS::Sync(NiStreamReader& stream); \
+	template void CLASS::Sync(NiStreamWriter& stream); \
+	template void CLASS::Sync(NiStreamReversible& stream);
+
+// Heap memory owned by a member, see NiObject::GetHeapSize.
+// Containers count their capacity, including the heap memory of their elements.
+template<typename T>
+concept HasGetHeapSize = requires(const T& t) {
+	t.GetHeapSize();
+};
+
+inline size_t HeapSize(const std::string& str) {
+	// Short strings are stored in the object itself
+	static const size_t localCapacity = std::string().capacity();
+	return str.capacity() > localCapacity ? str.capacity() + 1 : 0;
+}
+
+template<HasGetHeapSize T>
+size_t HeapSize(const T& t) {
+	return t.GetHeapSize();
+}
+
+template<typename T>
+size_t HeapSize(const std::vector<T>& vec) {
+	size_t size = vec.capacity() * sizeof(T);
+	if constexpr (requires(const T& e) { HeapSize(e); }) {
+		for (auto& e : vec)
+			size += HeapSize(e);
+	}
+	return size;
+}
+
 template<typename Derived, typename Base>
 class NiCloneable : public Base {
 public:
@@ -330,6 +450,8 @@ public:
 		return static_cast<Derived*>(this->Clone_impl());
 	}
 
+	size_t GetObjectSize() const override { return sizeof(Derived); }
+
 private:
 	virtual NiCloneable* Clone_impl() const override { return new Derived(asDer()); }
 
@@ -347,15 +469,17 @@ public:
 		return static_cast<Derived*>(this->Clone_impl());
 	}
 
+	size_t GetObjectSize() const override { return sizeof(Derived); }
+
 	void Get(NiIStream& stream) override {
 		Base::Get(stream);
-		NiStreamReversible s(&stream, nullptr, NiStreamReversible::Mode::Reading);
+		NiStreamReader s(stream);
 		asDer().Sync(s);
 	}
 
 	void Put(NiOStream& stream) override {
 		Base::Put(stream);
-		NiStreamReversible s(nullptr, &stream, NiStreamReversible::Mode::Writing);
+		NiStreamWriter s(stream);
 		asDer().Sync(s);
 	}
 
@@ -382,6 +506,7 @@ public:
 	const std::string& get() const { return str; }
 
 	size_t length() const { return str.length(); }
+	size_t GetHeapSize() const { return HeapSize(str); }
 
 	void SetNullOutput(const bool wantNullOutput = true) { nullOutput = wantNullOutput; }
 	void clear() { str.clear(); }
@@ -389,7 +514,8 @@ public:
 	void Read(NiIStream& stream, const int szSize);
 	void Write(NiOStream& stream, const int szSize);
 
-	void Sync(NiStreamReversible& stream, const int szSize) {
+	template<typename Stream>
+	void Sync(Stream& stream, const int szSize) {
 		if (auto istream = stream.asRead())
 			Read(*istream, szSize);
 		else if (auto ostream = stream.asWrite())
@@ -416,6 +542,7 @@ public:
 	const std::string& get() const { return str; }
 
 	size_t length() const { return str.length(); }
+	size_t GetHeapSize() const { return HeapSize(str); }
 
 	uint32_t GetIndex() const { return index; }
 	void SetIndex(const uint32_t id) { index = id; }
@@ -428,7 +555,8 @@ public:
 	void Read(NiIStream& stream);
 	void Write(NiOStream& stream);
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		if (auto istream = stream.asRead())
 			Read(*istream);
 		else if (auto ostream = stream.asWrite())
@@ -463,6 +591,33 @@ public:
 
 using NiPtr = NiRef;
 
+// Non-owning reference to a callable, which is only valid during the call it's passed to.
+// Used instead of std::function where a callback is called often and must not allocate.
+template<typename Signature>
+class NiFunctionRef;
+
+template<typename Ret, typename... Args>
+class NiFunctionRef<Ret(Args...)> {
+private:
+	void* callable = nullptr;
+	Ret (*invoke)(void*, Args...) = nullptr;
+
+public:
+	template<typename Fn>
+	requires(!std::is_same_v<std::decay_t<Fn>, NiFunctionRef>)
+	NiFunctionRef(Fn&& fn)
+		: callable(const_cast<void*>(static_cast<const void*>(std::addressof(fn))))
+		, invoke([](void* c, Args... args) -> Ret {
+			return (*static_cast<std::remove_reference_t<Fn>*>(c))(std::forward<Args>(args)...);
+		}) {}
+
+	Ret operator()(Args... args) const { return invoke(callable, std::forward<Args>(args)...); }
+};
+
+// Callbacks of NiObject::ForEachChildRef, ForEachPtr and ForEachStringRef
+using NiRefVisitor = NiFunctionRef<void(NiRef&)>;
+using NiStringRefVisitor = NiFunctionRef<void(NiStringRef&)>;
+
 // Helper to reduce duplication
 template<typename ValueType, typename SizeType>
 class NiVectorBase {
@@ -504,6 +659,8 @@ public:
 	ValueType* data() { return vec.data(); }
 	const ValueType* data() const { return vec.data(); }
 
+	size_t GetHeapSize() const { return HeapSize(vec); }
+
 	iterator erase(SizeType i) { return vec.erase(vec.begin() + i); }
 
 	// for SWIG, to avoid duplicating std_vector.i to handle iteration
@@ -522,13 +679,15 @@ public:
 	NiVector(const SizeType size)
 		: Base(size) {}
 
-	SizeType Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	SizeType Sync(Stream& stream) {
 		SizeType sz = SyncSize(stream);
 		SyncData(stream, sz);
 		return sz;
 	}
 
-	SizeType SyncSize(NiStreamReversible& stream) {
+	template<typename Stream>
+	SizeType SyncSize(Stream& stream) {
 		SizeType sz = 0;
 
 		if (stream.GetMode() == NiStreamReversible::Mode::Writing) {
@@ -543,14 +702,16 @@ public:
 	}
 
 
-	void SyncData(NiStreamReversible& stream, const SizeType size) {
+	template<typename Stream>
+	void SyncData(Stream& stream, const SizeType size) {
 		Base::resize(size);
 
 		for (auto& e : *this)
 			stream.Sync(e);
 	}
 
-	void SyncByteArray(NiStreamReversible& stream) {
+	template<typename Stream>
+	void SyncByteArray(Stream& stream) {
 		SizeType sz = SyncSize(stream);
 		Base::resize(sz);
 
@@ -560,21 +721,17 @@ public:
 };
 
 // these concepts are needed because otherwise SWIG wrapper uses functions that are not present e.g. in NiStringRef
-template<typename T, typename U>
-concept HasGetStringRefs = requires(T t, U u) {
-	t.GetStringRefs(u);
-};
-template<typename T, typename U>
-concept HasGetChildRefs = requires(T t, U u) {
-	t.GetChildRefs(u);
+template<typename T>
+concept HasForEachStringRef = requires(T t, const NiStringRefVisitor& visitor) {
+	t.ForEachStringRef(visitor);
 };
-template<typename T, typename U>
-concept HasGetChildIndices = requires(T t, U u) {
-	t.GetChildIndices(u);
+template<typename T>
+concept HasForEachChildRef = requires(T t, const NiRefVisitor& visitor) {
+	t.ForEachChildRef(visitor);
 };
-template<typename T, typename U>
-concept HasGetPtrs = requires(T t, U u) {
-	t.GetPtrs(u);
+template<typename T>
+concept HasForEachPtr = requires(T t, const NiRefVisitor& visitor) {
+	t.ForEachPtr(visitor);
 };
 
 template<typename ValueType, typename SizeType = uint32_t>
@@ -588,13 +745,15 @@ public:
 	NiSyncVector(const SizeType size)
 		: Base(size) {}
 
-	SizeType Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	SizeType Sync(Stream& stream) {
 		SizeType sz = SyncSize(stream);
 		SyncData(stream, sz);
 		return sz;
 	}
 
-	SizeType SyncSize(NiStreamReversible& stream) {
+	template<typename Stream>
+	SizeType SyncSize(Stream& stream) {
 		SizeType sz = 0;
 
 		if (stream.GetMode() == NiStreamReversible::Mode::Writing) {
@@ -608,7 +767,8 @@ public:
 		return sz;
 	}
 
-	void SyncData(NiStreamReversible& stream, const SizeType size) {
+	template<typename Stream>
+	void SyncData(Stream& stream, const SizeType size) {
 		Base::resize(size);
 
 		for (auto& e : *this)
@@ -616,35 +776,27 @@ public:
 	}
 
     // the above concepts are used here to avoid SWIG wrapper using functions that are not present e.g. in NiStringRef
-	void GetStringRefs(std::vector<NiStringRef*>& refs) {
-		if constexpr (HasGetStringRefs<ValueType, std::vector<NiStringRef*>>)
-		{
-			for (auto& e : *this)
-				e.GetStringRefs(refs);
-		}
-	}
-
-	void GetChildRefs(std::set<NiRef*>& refs) {
-		if constexpr (HasGetChildRefs<ValueType, std::set<NiRef*>>)
+	void ForEachStringRef(const NiStringRefVisitor& visitor) {
+		if constexpr (HasForEachStringRef<ValueType>)
 		{
 			for (auto& e : *this)
-				e.GetChildRefs(refs);
+				e.ForEachStringRef(visitor);
 		}
 	}
 
-	void GetChildIndices(std::vector<uint32_t>& indices) {
-		if constexpr (HasGetChildIndices<ValueType, std::vector<uint32_t>>)
+	void ForEachChildRef(const NiRefVisitor& visitor) {
+		if constexpr (HasForEachChildRef<ValueType>)
 		{
 			for (auto& e : *this)
-				e.GetChildIndices(indices);
+				e.ForEachChildRef(visitor);
 		}
 	}
 
-	void GetPtrs(std::set<NiPtr*>& ptrs) {
-		if constexpr (HasGetPtrs<ValueType, std::set<NiPtr*>>)
+	void ForEachPtr(const NiRefVisitor& visitor) {
+		if constexpr (HasForEachPtr<ValueType>)
 		{
 			for (auto& e : *this)
-				e.GetPtrs(ptrs);
+				e.ForEachPtr(visitor);
 		}
 	}
 };
@@ -681,7 +833,8 @@ public:
 			e.Write(stream, stringSize);
 	}
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		if (auto istream = stream.asRead())
 			Read(*istream);
 		else if (auto ostream = stream.asWrite())
@@ -722,7 +875,8 @@ public:
 			e.Write(stream);
 	}
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		if (auto istream = stream.asRead())
 			Read(*istream);
 		else if (auto ostream = stream.asWrite())
@@ -738,7 +892,8 @@ public:
 	NiBlockRef() {}
 	NiBlockRef(const uint32_t id) { NiRef::index = id; }
 
-	void Sync(NiStreamReversible& stream) { stream.Sync(base::index); }
+	template<typename Stream>
+	void Sync(Stream& stream) { stream.Sync(base::index); }
 };
 
 template<typename T>
@@ -756,7 +911,6 @@ public:
 
 	void SetKeepEmptyRefs(const bool keep = true) { keepEmptyRefs = keep; }
 
-	virtual void Sync(NiStreamReversible& stream) = 0;
 
 	virtual void AddBlockRef(const uint32_t id) = 0;
 	virtual uint32_t GetBlockRef(const uint32_t id) const = 0;
@@ -764,6 +918,7 @@ public:
 	virtual void RemoveBlockRef(const uint32_t id) = 0;
 	virtual void GetIndices(std::vector<uint32_t>& indices) = 0;
 	virtual void GetIndexPtrs(std::set<NiRef*>& indices) = 0;
+	virtual void ForEachRef(const NiRefVisitor& visitor) = 0;
 	virtual void SetIndices(const std::vector<uint32_t>& indices) = 0;
 };
 
@@ -801,6 +956,8 @@ public:
 		return refs;
 	}
 
+	size_t GetHeapSize() const { return HeapSize(refs); }
+
 	void Clear() {
 		refs.clear();
 		arraySize = 0;
@@ -812,7 +969,8 @@ public:
 		refs.resize(arraySize);
 	}
 
-	void Sync(NiStreamReversible& stream) override {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		if (stream.GetMode() == NiStreamReversible::Mode::Writing)
 			CleanInvalidRefs();
 
@@ -857,6 +1015,11 @@ public:
 			indices.insert(&r);
 	}
 
+	void ForEachRef(const NiRefVisitor& visitor) override {
+		for (auto& r : refs)
+			visitor(r);
+	}
+
 	void SetIndices(const std::vector<uint32_t>& indices) override {
 		arraySize = static_cast<uint32_t>(indices.size());
 		refs.resize(arraySize);
@@ -877,7 +1040,8 @@ protected:
 	using base::refs;
 public:
 	using base::arraySize;
-	void Sync(NiStreamReversible& stream) override {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		if (stream.GetMode() == NiStreamReversible::Mode::Writing)
 			base::CleanInvalidRefs();
 
@@ -904,6 +1068,8 @@ public:
 	virtual const char* GetBlockName() { return BlockName; }
 
 	virtual void notifyVerticesDelete(const std::vector<uint16_t>&) {}
+	// Vertices were renumbered, vertMap[oldIndex] is the new index of each vertex
+	virtual void notifyVerticesReorder(const std::vector<uint16_t>&) {}
 
 	virtual void Get(NiIStream& stream) {
 		if (stream.GetVersion().File() >= V10_0_0_0 && stream.GetVersion().File() < V10_1_0_114)
@@ -915,15 +1081,44 @@ public:
 			stream.write(reinterpret_cast<const char*>(&groupID), 4);
 	}
 
-	virtual void GetStringRefs(std::vector<NiStringRef*>&) {}
-	virtual void GetChildRefs(std::set<NiRef*>&) {}
+	// Call the visitor for each reference of the block, in the order they are stored in the file.
+	// These don't allocate, the functions returning containers below are based on them.
+	virtual void ForEachStringRef(const NiStringRefVisitor&) {}
+	virtual void ForEachChildRef(const NiRefVisitor&) {}
+	virtual void ForEachPtr(const NiRefVisitor&) {}
+
+	// Child references followed by pointers
+	void ForEachRef(const NiRefVisitor& visitor) {
+		ForEachChildRef(visitor);
+		ForEachPtr(visitor);
+	}
+
+	void GetStringRefs(std::vector<NiStringRef*>& refs) {
+		ForEachStringRef([&](NiStringRef& ref) { refs.push_back(&ref); });
+	}
+
+	void GetChildRefs(std::set<NiRef*>& refs) {
+		ForEachChildRef([&](NiRef& ref) { refs.insert(&ref); });
+	}
+
 	std::set<NiRef*> CopyChildRefs() {
 		std::set<NiRef*> refs;
 		GetChildRefs(refs);
 		return refs;
 	}
-	virtual void GetChildIndices(std::vector<uint32_t>&) {}
-	virtual void GetPtrs(std::set<NiPtr*>&) {}
+
+	void GetChildIndices(std::vector<uint32_t>& indices) {
+		ForEachChildRef([&](NiRef& ref) { indices.push_back(ref.index); });
+	}
+
+	void GetPtrs(std::set<NiPtr*>& ptrs) {
+		ForEachPtr([&](NiRef& ref) { ptrs.insert(&ref); });
+	}
+
+	// Heap memory owned by the block (containers and strings), without the object itself
+	virtual size_t GetHeapSize() const { return 0; }
+	// Size of the block object itself
+	virtual size_t GetObjectSize() const { return sizeof(NiObject); }
 
 	NiObject* Clone() const {
 		return static_cast<NiObject*>(this->Clone_impl());
@@ -971,9 +1166,20 @@ private:
 	std::vector<uint8_t> embedData;
 
 	// Foreign reference to the blocks list in NifFile.
-	std::vector<std::unique_ptr<NiObject>>* blocks = nullptr;
+	// Blocks can be shared with other files, see NifFile::CopyFrom.
+	std::vector<std::shared_ptr<NiObject>>* blocks = nullptr;
+
+	// Shared blocks replaced by UnshareBlock and their copies, so the shared pointers can still be resolved
+	std::unordered_map<const NiObject*, std::pair<std::weak_ptr<NiObject>, std::weak_ptr<NiObject>>>
+		unsharedBlocks;
+
+	// Index of each block for GetBlockID, rebuilt on first use after blocks were deleted or reordered
+	mutable std::unordered_map<const NiObject*, uint32_t> blockIds;
+	mutable uint32_t blockIdsRevision = 0;
+	mutable bool hasBlockIds = false;
 
 	uint32_t numBlocks = 0;
+	uint32_t blockListRevision = 0;
 	uint16_t numBlockTypes = 0;
 	std::vector<NiString> blockTypes;
 	std::vector<uint16_t> blockTypeIndices;
@@ -986,10 +1192,21 @@ private:
 	uint32_t numGroups = 0;
 	std::vector<uint32_t> groupSizes;
 
+	bool IsBlockIdsCurrent() const { return hasBlockIds && blockIdsRevision == blockListRevision; }
+	void BuildBlockIds() const;
+	// Keeps a current block index current after the block at "blockId" was added or replaced
+	void UpdateBlockId(const bool wasCurrent, const NiObject* oldBlock, const uint32_t blockId);
+
 public:
 	static constexpr const char* BlockName = "NiHeader";
 	const char* GetBlockName() override { return BlockName; }
 
+	NiHeader() = default;
+	NiHeader(const NiHeader&) = default;
+	NiHeader(NiHeader&&) = default;
+	NiHeader& operator=(const NiHeader&) = default;
+	NiHeader& operator=(NiHeader&&) = default;
+
 	void Clear();
 
 	bool IsValid() const { return valid; }
@@ -1007,11 +1224,33 @@ public:
 	// Sets export info string (automatically split into three members after 256 characters each)
 	void SetExportInfo(const std::string& exportInfo);
 
-	// Sets pointer to all blocks in the file
-	void SetBlockReference(std::vector<std::unique_ptr<NiObject>>* blockRef) { blocks = blockRef; }
+	// Sets pointer to all blocks in the file.
+	// Takes a list of shared_ptr since blocks can be shared (see NifFile::CopyFrom), lists of unique_ptr
+	// used before have to be converted.
+	void SetBlockReference(std::vector<std::shared_ptr<NiObject>>* blockRef) {
+		blocks = blockRef;
+		unsharedBlocks.clear();
+		hasBlockIds = false;
+	}
 
 	uint32_t GetNumBlocks() const { return numBlocks; }
 
+	// Changes whenever blocks are added, deleted, replaced or reordered.
+	// Changes to the references within blocks are not counted.
+	uint32_t GetBlockListRevision() const { return blockListRevision; }
+
+	// Returns true if the block is shared with another file (see NifFile::CopyFrom)
+	bool IsBlockShared(const uint32_t blockId) const {
+		return blockId < numBlocks && (*blocks)[blockId].use_count() > 1;
+	}
+
+	// Replaces a shared block with a copy owned by this file only and returns it (or the block if it
+	// isn't shared). Pointers to the shared block still refer to the block of the other files afterwards,
+	// GetBlockID resolves them to the copy.
+	NiObject* UnshareBlock(const uint32_t blockId);
+
+	// GetBlock and the other accessors return shared blocks as they are, so they must not be modified.
+	// Use GetBlockForWrite (or UnshareBlock) to get a block that can be modified.
 	NiObject* GetBlockById(const uint32_t blockId) {
 		if (blockId < numBlocks)
 			return (*blocks)[blockId].get();
@@ -1082,8 +1321,43 @@ public:
 		return nullptr;
 	}
 
-	// Returns the index of a block in the file (or NIF_NPOS)
-	uint32_t GetBlockID(NiObject* block) const;
+	// Like GetBlock, but copies the block first if it's shared with other files (see UnshareBlock)
+	template<class T>
+	T* GetBlockForWrite(const uint32_t blockId) {
+		auto block = GetBlock<T>(blockId);
+		if (block && IsBlockShared(blockId))
+			block = static_cast<T*>(UnshareBlock(blockId));
+
+		return block;
+	}
+
+	template<class T>
+	T* GetBlockForWrite(const NiBlockRef<T>& blockRef) {
+		return GetBlockForWrite<T>(blockRef.index);
+	}
+
+	template<class T>
+	T* GetBlockForWrite(const NiBlockRef<T>* blockRef) {
+		if (blockRef)
+			return GetBlockForWrite<T>(blockRef->index);
+		return nullptr;
+	}
+
+	template<class T>
+	T* GetBlockForWrite(const NiRef& blockRef) {
+		return GetBlockForWrite<T>(blockRef.index);
+	}
+
+	template<class T>
+	T* GetBlockForWrite(const NiRef* blockRef) {
+		if (blockRef)
+			return GetBlockForWrite<T>(blockRef->index);
+		return nullptr;
+	}
+
+	// Returns the index of a block in the file (or NIF_NPOS).
+	// Shared blocks that were replaced by UnshareBlock return the index of their copy.
+	uint32_t GetBlockID(const NiObject* block) const;
 
 	// Deletes a block and notifies all other blocks
 	void DeleteBlock(const uint32_t blockId);
@@ -1096,6 +1370,8 @@ public:
 
 	// Adds a new block to the file. Pointer is moved to the file.
 	uint32_t AddBlock(NiObject* newBlock);
+	// Adds a new block to the file, which can still be shared with other files (see UnshareBlock).
+	uint32_t AddBlock(std::shared_ptr<NiObject> newBlock);
 
 	// Replaces an existing block in the file. Pointer is moved to the file.
 	// This is not the same as deleting and adding a new block.
@@ -1103,6 +1379,10 @@ public:
 
 	void SetBlockOrder(std::vector<uint32_t>& newOrder);
 
+	// Removes all blocks marked in "removedBlocks" at once and updates the references of all other blocks.
+	// References to removed blocks are cleared. Removed entries may already be moved out of the list.
+	void RemoveBlocks(const std::vector<bool>& removedBlocks);
+
 	bool IsBlockReferenced(const uint32_t blockId, bool includePtrs = true);
 	int GetBlockRefCount(const uint32_t blockId, bool includePtrs = true);
 
@@ -1116,8 +1396,8 @@ public:
 
 		for (uint32_t i = 0; i < numBlocks; i++) {
 			if (i != rootId) {
-				// Only check blocks of provided template type
-				auto block = GetBlock<T>(i);
+				// Only check blocks of provided template type (without copying shared blocks)
+				auto block = dynamic_cast<T*>((*blocks)[i].get());
 				if (block && !IsBlockReferenced(i)) {
 					DeleteBlock(i);
 
@@ -1166,6 +1446,8 @@ public:
 
 	static void BlockDeleted(NiObject* o, const uint32_t blockId);
 
+	size_t GetHeapSize() const override;
+
 	void Get(NiIStream& stream) override;
 	void Put(NiOStream& stream) override;
 };
@@ -1178,7 +1460,10 @@ public:
 	NiUnknown(NiIStream& stream, const uint32_t size);
 	NiUnknown(const uint32_t size);
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+
+	size_t GetHeapSize() const override;
 };
 
 } // namespace nifly
@@ -16,8 +16,10 @@ STREAMABLECLASSDEF(NiExtraData, NiObject) {
 public:
 	NiStringRef name;
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiBinaryExtraData, NiExtraData) {
@@ -27,7 +29,9 @@ public:
 	static constexpr const char* BlockName = "NiBinaryExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiFloatExtraData, NiExtraData) {
@@ -37,7 +41,8 @@ public:
 	static constexpr const char* BlockName = "NiFloatExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiFloatsExtraData, NiExtraData) {
@@ -47,7 +52,9 @@ public:
 	static constexpr const char* BlockName = "NiFloatsExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiStringExtraData, NiExtraData) {
@@ -57,8 +64,10 @@ public:
 	static constexpr const char* BlockName = "NiStringExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 	std::vector<NiStringRef*> GetStringRefList();};
 
 STREAMABLECLASSDEF(NiStringsExtraData, NiExtraData) {
@@ -68,7 +77,9 @@ public:
 	static constexpr const char* BlockName = "NiStringsExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiBooleanExtraData, NiExtraData) {
@@ -78,7 +89,8 @@ public:
 	static constexpr const char* BlockName = "NiBooleanExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiIntegerExtraData, NiExtraData) {
@@ -88,7 +100,8 @@ public:
 	static constexpr const char* BlockName = "NiIntegerExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiIntegersExtraData, NiExtraData) {
@@ -98,7 +111,9 @@ public:
 	static constexpr const char* BlockName = "NiIntegersExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiVectorExtraData, NiExtraData) {
@@ -108,7 +123,8 @@ public:
 	static constexpr const char* BlockName = "NiVectorExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiColorExtraData, NiExtraData) {
@@ -118,7 +134,8 @@ public:
 	static constexpr const char* BlockName = "NiColorExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(BSXFlags, NiIntegerExtraData) {
@@ -134,7 +151,9 @@ public:
 	static constexpr const char* BlockName = "BSWArray";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSPositionData, NiExtraData) {
@@ -144,7 +163,9 @@ public:
 	static constexpr const char* BlockName = "BSPositionData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSEyeCenterExtraData, NiExtraData) {
@@ -154,7 +175,9 @@ public:
 	static constexpr const char* BlockName = "BSEyeCenterExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 struct BSPackedGeomObject {
@@ -184,7 +207,9 @@ struct BSPackedGeomData {
 	std::vector<BSVertexData> vertData;
 	std::vector<Triangle> triangles;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const { return HeapSize(combined) + HeapSize(vertData) + HeapSize(triangles); }
 
 	void SetVertices(const bool enable);
 	bool HasVertices() const { return vertexDesc.HasFlag(VF_VERTEX); }
@@ -229,7 +254,9 @@ public:
 	static constexpr const char* BlockName = "BSPackedCombinedSharedGeomDataExtra";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSInvMarker, NiExtraData) {
@@ -242,7 +269,8 @@ public:
 	static constexpr const char* BlockName = "BSInvMarker";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 class FurniturePosition {
@@ -257,7 +285,8 @@ public:
 	uint16_t animationType = 0; // User Version >= 12
 	uint16_t entryPoints = 0;	// User Version >= 12
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSFurnitureMarker, NiExtraData) {
@@ -267,7 +296,9 @@ public:
 	static constexpr const char* BlockName = "BSFurnitureMarker";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 CLONEABLECLASSDEF(BSFurnitureMarkerNode, BSFurnitureMarker) {
@@ -281,7 +312,9 @@ public:
 	NiVector<Vector3, uint16_t> points;
 	NiVector<Vector3, uint16_t> normals;
 
-	void Sync(NiStreamReversible&);
+	template<typename Stream>
+	void Sync(Stream&);
+	size_t GetHeapSize() const { return HeapSize(points) + HeapSize(normals); }
 };
 
 STREAMABLECLASSDEF(BSDecalPlacementVectorExtraData, NiFloatExtraData) {
@@ -291,7 +324,9 @@ public:
 	static constexpr const char* BlockName = "BSDecalPlacementVectorExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSBehaviorGraphExtraData, NiExtraData) {
@@ -302,8 +337,10 @@ public:
 	static constexpr const char* BlockName = "BSBehaviorGraphExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSBound, NiExtraData) {
@@ -314,7 +351,8 @@ public:
 	static constexpr const char* BlockName = "BSBound";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 class BoneLOD {
@@ -322,8 +360,10 @@ public:
 	uint32_t distance = 0;
 	NiStringRef boneName;
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const { return HeapSize(boneName); }
+	void ForEachStringRef(const NiStringRefVisitor& visitor);
 };
 
 STREAMABLECLASSDEF(BSBoneLODExtraData, NiExtraData) {
@@ -333,8 +373,10 @@ public:
 	static constexpr const char* BlockName = "BSBoneLODExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiTextKeyExtraData, NiExtraData) {
@@ -344,8 +386,10 @@ public:
 	static constexpr const char* BlockName = "NiTextKeyExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSDistantObjectLargeRefExtraData, NiExtraData) {
@@ -355,7 +399,8 @@ public:
 	static constexpr const char* BlockName = "BSDistantObjectLargeRefExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 class BSConnectPoint {
@@ -366,7 +411,9 @@ public:
 	Vector3 translation;
 	float scale = 1.0f;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const { return HeapSize(root) + HeapSize(variableName); }
 };
 
 STREAMABLECLASSDEF(BSConnectPointParents, NiExtraData) {
@@ -376,7 +423,9 @@ public:
 	static constexpr const char* BlockName = "BSConnectPoint::Parents";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSConnectPointChildren, NiExtraData) {
@@ -387,7 +436,9 @@ public:
 	static constexpr const char* BlockName = "BSConnectPoint::Children";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 CLONEABLECLASSDEF(BSExtraData, NiObject) {};
@@ -402,7 +453,9 @@ public:
 	static constexpr const char* BlockName = "BSClothExtraData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 
 	bool ToHKX(const std::string& fileName);
 	bool FromHKX(const std::string& fileName);
@@ -24,7 +24,8 @@ struct AdditionalDataInfo {
 	uint32_t channelOffset = 0;
 	uint8_t unkByte1 = 2;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(dataType);
 		stream.Sync(numChannelBytesPerElement);
 		stream.Sync(numChannelBytes);
@@ -46,7 +47,8 @@ struct AdditionalDataBlock {
 	std::vector<uint32_t> dataSizes;
 	std::vector<std::vector<uint8_t>> data;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(hasData);
 
 		if (hasData) {
@@ -70,6 +72,8 @@ struct AdditionalDataBlock {
 			}
 		}
 	}
+
+	size_t GetHeapSize() const { return HeapSize(blockOffsets) + HeapSize(dataSizes) + HeapSize(data); }
 };
 
 CLONEABLECLASSDEF(AdditionalGeomData, NiObject) {};
@@ -83,7 +87,9 @@ public:
 	static constexpr const char* BlockName = "NiAdditionalGeometryData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 struct BSPackedAdditionalDataBlock {
@@ -100,7 +106,8 @@ struct BSPackedAdditionalDataBlock {
 	uint32_t unkInt1 = 0;
 	uint32_t numTotalBytesPerElement = 0;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(hasData);
 
 		if (hasData) {
@@ -124,6 +131,8 @@ struct BSPackedAdditionalDataBlock {
 		stream.Sync(unkInt1);
 		stream.Sync(numTotalBytesPerElement);
 	}
+
+	size_t GetHeapSize() const { return HeapSize(blockOffsets) + HeapSize(atomSizes) + HeapSize(data); }
 };
 
 STREAMABLECLASSDEF(BSPackedAdditionalGeometryData, AdditionalGeomData) {
@@ -135,7 +144,9 @@ public:
 	static constexpr const char* BlockName = "BSPackedAdditionalGeometryData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 enum ConsistencyType : uint16_t { CT_MUTABLE = 0x0000, CT_STATIC = 0x4000, CT_VOLATILE = 0x8000 };
@@ -150,6 +161,10 @@ protected:
 	bool hasVertexColors = false;
 	BoundingSphere bounds;
 
+	uint32_t vertexGeneration = 1; // Not in file
+	uint32_t boundsGeneration = 0; // Not in file
+	uint64_t boundsVertexHash = 0; // Not in file, hash of the vertex positions at the last UpdateBounds call
+
 public:
 	std::vector<Vector3> vertices;
 	std::vector<Vector3> normals;
@@ -168,11 +183,13 @@ public:
 	ConsistencyType consistencyFlags = CT_MUTABLE;
 	NiBlockRef<AdditionalGeomData> additionalDataRef;
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 
 	void notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) override;
+	void notifyVerticesReorder(const std::vector<uint16_t>& vertMap) override;
 
 	uint16_t GetNumVertices() const;
 	void SetVertices(const bool enable);
@@ -199,6 +216,15 @@ public:
 	BoundingSphere GetBounds() const { return bounds; }
 	void UpdateBounds();
 
+	// Increments the vertex generation, call after modifying vertex positions directly
+	void MarkVerticesChanged() { ++vertexGeneration; }
+	uint32_t GetVertexGeneration() const { return vertexGeneration; }
+	// Vertices were marked as changed since the last UpdateBounds call
+	bool IsBoundsDirty() const;
+	// Hashes the vertex positions to also detect direct writes since the last UpdateBounds call
+	// and marks the vertices as changed if there were any. Returns true if the bounds are dirty.
+	bool CheckVerticesChanged();
+
 	virtual void Create(NiVersion& version,
 						const std::vector<Vector3>* verts,
 						const std::vector<Triangle>* tris,
@@ -261,6 +287,10 @@ public:
 	virtual BoundingSphere GetBounds() const;
 	virtual void UpdateBounds();
 
+	virtual void MarkVerticesChanged();
+	virtual uint32_t GetVertexGeneration() const;
+	virtual bool IsBoundsDirty() const;
+
 	int GetBoneID(const NiHeader& hdr, const std::string& boneName) const;
 };
 
@@ -277,6 +307,39 @@ protected:
 	uint32_t numTriangles = 0;
 	uint16_t numVertices = 0;
 
+	uint32_t vertexGeneration = 1; // Not in file
+	uint32_t boundsGeneration = 0; // Not in file
+
+	enum RawCache {
+		RAW_VERTICES,
+		RAW_NORMALS,
+		RAW_TANGENTS,
+		RAW_BITANGENTS,
+		RAW_UVS,
+		RAW_COLORS,
+		RAW_EYEDATA,
+		RAW_COUNT
+	};
+
+	uint32_t vertexDataGeneration = 1;				// Not in file
+	std::array<uint32_t, RAW_COUNT> rawGenerations{}; // vertData generation each raw copy was filled from
+
+	bool IsRawCacheValid(RawCache cache, size_t rawSize) const {
+		return rawGenerations[cache] == vertexDataGeneration && rawSize == numVertices;
+	}
+
+	void MarkVertexDataChanged() { ++vertexDataGeneration; }
+
+	std::vector<Vector3> rawVertices;	// cached copy refreshed by UpdateRawVertices function
+	std::vector<Vector3> rawNormals;	// cached copy refreshed by UpdateRawNormals function
+	std::vector<Vector3> rawTangents;	// cached copy refreshed by UpdateRawTangents function
+	std::vector<Vector3> rawBitangents; // cached copy refreshed by UpdateRawBitangents function
+	std::vector<Vector2> rawUvs;		// cached copy refreshed by UpdateRawUvs function
+	std::vector<Color4> rawColors;		// cached copy refreshed by UpdateRawColors function
+	std::vector<float> rawEyeData;		// cached copy refreshed by UpdateRawEyeData function
+
+	std::vector<BSVertexData> vertData;
+
 public:
 	VertexDesc vertexDesc;
 
@@ -288,17 +351,8 @@ public:
 	std::vector<Vector3> particleNorms;
 	std::vector<Triangle> particleTris;
 
-	std::vector<Vector3> rawVertices;	// temporary copy filled by UpdateRawVertices function
-	std::vector<Vector3> rawNormals;	// temporary copy filled by UpdateRawNormals function
-	std::vector<Vector3> rawTangents;	// temporary copy filled by UpdateRawTangents function
-	std::vector<Vector3> rawBitangents; // temporary copy filled by UpdateRawBitangents function
-	std::vector<Vector2> rawUvs;		// temporary copy filled by UpdateRawUvs function
-	std::vector<Color4> rawColors;		// temporary copy filled by UpdateRawColors function
-	std::vector<float> rawEyeData;		// temporary copy filled by UpdateRawEyeData function
-
 	std::vector<uint32_t> deletedTris; // temporary storage for BSSubIndexTriShape
 
-	std::vector<BSVertexData> vertData;
 	std::vector<Triangle> triangles;
 
 	BSTriShape();
@@ -306,10 +360,12 @@ public:
 	static constexpr const char* BlockName = "BSTriShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 	void notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) override;
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	void notifyVerticesReorder(const std::vector<uint16_t>& vertMap) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 
 	bool HasSkinInstance() const override { return !skinInstanceRef.IsEmpty(); }
 	NiBlockRef<NiBoneContainer>* SkinInstanceRef() override { return &skinInstanceRef; }
@@ -326,13 +382,23 @@ public:
 	const NiBlockRef<NiAlphaProperty>* AlphaPropertyRef() const override { return &alphaPropertyRef; }
 	void SetAlphaPropertyRef(const uint32_t alphaId) override { alphaPropertyRef.index = alphaId; }
 
-	std::vector<Vector3>& UpdateRawVertices();
-	std::vector<Vector3>& UpdateRawNormals();
-	std::vector<Vector3>& UpdateRawTangents();
-	std::vector<Vector3>& UpdateRawBitangents();
-	std::vector<Vector2>& UpdateRawUvs();
-	std::vector<Color4>& UpdateRawColors();
-	std::vector<float>& UpdateRawEyeData();
+	const std::vector<BSVertexData>& GetVertexData() const { return vertData; }
+
+	// Returns the vertex data for modification and marks the vertices and raw copies as changed.
+	// The reference must not be kept for writes after raw copies or bounds were updated again.
+	std::vector<BSVertexData>& GetVertexDataForWrite() {
+		MarkVerticesChanged();
+		return vertData;
+	}
+
+	// Raw copies of the vertex data, only rebuilt if it changed since they were last filled
+	const std::vector<Vector3>& UpdateRawVertices();
+	const std::vector<Vector3>& UpdateRawNormals();
+	const std::vector<Vector3>& UpdateRawTangents();
+	const std::vector<Vector3>& UpdateRawBitangents();
+	const std::vector<Vector2>& UpdateRawUvs();
+	const std::vector<Color4>& UpdateRawColors();
+	const std::vector<float>& UpdateRawEyeData();
 
 	uint16_t GetNumVertices() const override;
 	void SetVertices(const bool enable) override;
@@ -342,7 +408,7 @@ public:
 	bool HasUVs() const override { return vertexDesc.HasFlag(VF_UV); }
 
 	void SetSecondUVs(const bool enable);
-	bool HasSecondUVs() { return vertexDesc.HasFlag(VF_UV_2); }
+	bool HasSecondUVs() const { return vertexDesc.HasFlag(VF_UV_2); }
 
 	void SetNormals(const bool enable) override;
 	bool HasNormals() const override { return vertexDesc.HasFlag(VF_NORMAL); }
@@ -370,6 +436,15 @@ public:
 	void SetBounds(const BoundingSphere& newBounds) override { bounds = newBounds; }
 	BoundingSphere GetBounds() const override { return bounds; }
 	void UpdateBounds() override;
+	// Bounds that UpdateBounds would assign, without changing the shape
+	BoundingSphere CalcBounds() const;
+
+	void MarkVerticesChanged() override {
+		++vertexGeneration;
+		++vertexDataGeneration;
+	}
+	uint32_t GetVertexGeneration() const override { return vertexGeneration; }
+	bool IsBoundsDirty() const override;
 
 	void SetVertexData(const std::vector<BSVertexData>& bsVertData);
 
@@ -379,6 +454,8 @@ public:
 					   std::unordered_set<uint32_t>* lockedIndices = nullptr);
 	void CalcTangentSpace();
 	int CalcDataSizes(NiVersion& version);
+	// Vertex description or data sizes differ from what CalcDataSizes would assign
+	bool IsDataSizeDirty(const NiVersion& version) const;
 
 	void SetTangentData(const std::vector<Vector3>& in);
 	void SetBitangentData(const std::vector<Vector3>& in);
@@ -430,7 +507,8 @@ public:
 	uint32_t index = 0;
 	uint32_t numTris = 0;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSSubIndexTriShape, BSTriShape) {
@@ -450,6 +528,8 @@ public:
 		uint32_t parentArrayIndex = 0xFFFFFFFF;
 		uint32_t numSubSegments = 0;
 		std::vector<BSSITSSubSegment> subSegments;
+
+		size_t GetHeapSize() const { return HeapSize(subSegments); }
 	};
 
 	class BSSITSSubSegmentDataRecord {
@@ -458,6 +538,8 @@ public:
 		uint32_t material = 0xFFFFFFFF;
 		uint32_t numData = 0;
 		std::vector<float> extraData;
+
+		size_t GetHeapSize() const { return HeapSize(extraData); }
 	};
 
 	class BSSITSSubSegmentData {
@@ -467,6 +549,10 @@ public:
 		std::vector<uint32_t> arrayIndices;
 		std::vector<BSSITSSubSegmentDataRecord> dataRecords;
 		NiString ssfFile;
+
+		size_t GetHeapSize() const {
+			return HeapSize(arrayIndices) + HeapSize(dataRecords) + HeapSize(ssfFile);
+		}
 	};
 
 	class BSSITSSegmentation {
@@ -476,6 +562,8 @@ public:
 		uint32_t numTotalSegments = 0;
 		std::vector<BSSITSSegment> segments;
 		BSSITSSubSegmentData subSegmentData;
+
+		size_t GetHeapSize() const { return HeapSize(segments) + HeapSize(subSegmentData); }
 	};
 
 protected:
@@ -490,7 +578,9 @@ public:
 	static constexpr const char* BlockName = "BSSubIndexTriShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 	void notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) override;
 
 	std::vector<BSGeometrySegmentData> GetSegments() const;
@@ -516,7 +606,8 @@ public:
 	static constexpr const char* BlockName = "BSMeshLODTriShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 	void notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) override;
 };
 
@@ -530,9 +621,14 @@ public:
 	static constexpr const char* BlockName = "BSDynamicTriShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 	void notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) override;
+	void notifyVerticesReorder(const std::vector<uint16_t>& vertMap) override;
 	void CalcDynamicData();
+	// Dynamic data or eye data differ from what CalcDynamicData would assign
+	bool IsDynamicDataDirty() const;
 
 	void Create(NiVersion& version,
 				const std::vector<Vector3>* verts,
@@ -561,10 +657,11 @@ public:
 	NiStringRef shaderName;
 	uint32_t implementation = 0;
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 
 	bool IsSkinned() const override;
 
@@ -596,7 +693,8 @@ protected:
 	uint16_t numTriangles = 0;
 
 public:
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 
 	void Create(NiVersion& version,
 				const std::vector<Vector3>* verts,
@@ -608,6 +706,8 @@ public:
 struct MatchGroup {
 	uint16_t count = 0;
 	std::vector<uint16_t> matches;
+
+	size_t GetHeapSize() const { return HeapSize(matches); }
 };
 
 STREAMABLECLASSDEF(NiTriShapeData, NiTriBasedGeomData) {
@@ -623,13 +723,16 @@ public:
 	static constexpr const char* BlockName = "NiTriShapeData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 	void Create(NiVersion& version,
 				const std::vector<Vector3>* verts,
 				const std::vector<Triangle>* tris,
 				const std::vector<Vector2>* uvs,
 				const std::vector<Vector3>* norms) override;
 	void notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) override;
+	void notifyVerticesReorder(const std::vector<uint16_t>& vertMap) override;
 
 	std::vector<MatchGroup> GetMatchGroups() const;
 	void SetMatchGroups(const std::vector<MatchGroup>& mg);
@@ -660,7 +763,9 @@ public:
 	bool hasPoints = true;
 	std::vector<std::vector<uint16_t>> points;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const { return HeapSize(stripLengths) + HeapSize(points); }
 };
 
 STREAMABLECLASSDEF(NiTriStripsData, NiTriBasedGeomData) {
@@ -670,8 +775,11 @@ public:
 	static constexpr const char* BlockName = "NiTriStripsData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 	void notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) override;
+	void notifyVerticesReorder(const std::vector<uint16_t>& vertMap) override;
 
 	uint32_t GetNumTriangles() const override;
 	bool GetTriangles(std::vector<Triangle>& tris) const override;
@@ -703,7 +811,9 @@ public:
 	static constexpr const char* BlockName = "NiLinesData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 	void notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) override;
 };
 
@@ -743,7 +853,9 @@ public:
 	static constexpr const char* BlockName = "NiScreenElementsData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 	void notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) override;
 };
 
@@ -774,7 +886,8 @@ public:
 	NiGeometryData* GetGeomData() const override;
 	void SetGeomData(NiGeometryData* geomDataPtr) override;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSSegmentedTriShape, NiTriShape) {
@@ -786,7 +899,9 @@ public:
 	static constexpr const char* BlockName = "BSSegmentedTriShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 
 	std::vector<BSGeometrySegmentData> GetSegments() const;
 	void SetSegments(const std::vector<BSGeometrySegmentData>& sd);
@@ -14,12 +14,15 @@ public:
 	float time = 0.0f;
 	NiStringRef value;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(time);
 		value.Sync(stream);
 	}
 
-	void GetStringRefs(std::vector<NiStringRef*>& refs) { refs.emplace_back(&value); }
+	size_t GetHeapSize() const { return HeapSize(value); }
+
+	void ForEachStringRef(const NiStringRefVisitor& visitor) { visitor(value); }
 };
 
 enum NiKeyType : uint32_t { NO_INTERP, LINEAR_KEY, QUADRATIC_KEY, TBC_KEY, XYZ_ROTATION_KEY, CONST_KEY };
@@ -41,7 +44,8 @@ public:
 	T backward{};
 	TBC tbc;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(time);
 		stream.Sync(value);
 
@@ -64,7 +68,8 @@ private:
 	std::vector<NiAnimationKey<T>> keys;
 
 public:
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(numKeys);
 		keys.resize(numKeys);
 
@@ -103,5 +108,7 @@ public:
 		keys.clear();
 		numKeys = 0;
 	}
+
+	size_t GetHeapSize() const { return HeapSize(keys); }
 };
 } // namespace nifly
@@ -0,0 +1,72 @@
+/*
+nifly
+C++ NIF library for the Gamebryo/NetImmerse File Format
+See the included GPLv3 LICENSE file
+*/
+
+#pragma once
+
+#include "NifFile.hpp"
+
+#include <functional>
+
+namespace nifly {
+// Status of a file processed by NifBatch
+enum NifBatchStatus {
+	NBS_OK,				// Loaded, processed and saved (if requested) without errors
+	NBS_LOAD_FAILED,	// NifFile::Load failed, error holds its return value
+	NBS_PROCESS_FAILED, // Process function returned non-zero, error holds its return value
+	NBS_SAVE_FAILED,	// NifFile::Save failed, error holds its return value
+	NBS_EXCEPTION,		// An exception was thrown, message holds its description
+};
+
+// Result of a single file processed by NifBatch
+struct NifBatchResult {
+	size_t index = 0;				   // Index of the file in the input list
+	std::filesystem::path fileName;	   // Input file
+	std::filesystem::path outFileName; // Output file (empty if not saved)
+	NifBatchStatus status = NBS_OK;	   // Outcome of processing the file
+	int error = 0;					   // Return value of the failed step
+	std::string message;			   // Exception description
+};
+
+// Loaded file is passed to this function. Return 0 to continue with saving, other values are reported as errors.
+using NifBatchProcessFunc = std::function<int(NifFile& nif, const std::filesystem::path& fileName)>;
+
+// Returns the output file for an input file. An empty path skips saving the file.
+using NifBatchOutputFunc = std::function<std::filesystem::path(const std::filesystem::path& fileName)>;
+
+// Receives the result of each file in input order, always on the thread that called NifBatch::Run.
+// Must not throw, since the worker threads are still running while results are reported.
+using NifBatchResultFunc = std::function<void(const NifBatchResult& result)>;
+
+// NifBatch options
+struct NifBatchOptions {
+	uint32_t numThreads = 0;	   // Number of worker threads (0 = hardware concurrency)
+	uint32_t maxInFlight = 0;	   // Files started ahead of the oldest unreported file (0 = 4 * threads)
+	NifLoadOptions loadOptions;	   // Stats sink is filled per worker and merged before Run returns
+	NifSaveOptions saveOptions;	   // Stats sink is filled per worker and merged before Run returns
+	NifBatchOutputFunc outputFunc; // Output file of each input file (not set = files aren't saved)
+};
+
+// Runs Load -> process function -> Save over a list of files on a pool of worker threads.
+// Each worker reuses its NifFile between files. Results are reported in input order, and
+// the number of files in flight is bounded, so memory use doesn't depend on the list size.
+class NifBatch {
+	NifBatchOptions options;
+
+public:
+	NifBatch() = default;
+	NifBatch(const NifBatchOptions& batchOptions)
+		: options(batchOptions) {}
+
+	const NifBatchOptions& GetOptions() const { return options; }
+	void SetOptions(const NifBatchOptions& batchOptions) { options = batchOptions; }
+
+	// Processes all files and returns the number of files that failed.
+	// 'processFunc' is called concurrently from multiple threads and must not share unprotected state.
+	size_t Run(const std::vector<std::filesystem::path>& files,
+			   const NifBatchProcessFunc& processFunc,
+			   const NifBatchResultFunc& resultFunc = nullptr) const;
+};
+} // namespace nifly
@@ -10,6 +10,8 @@ See the included GPLv3 LICENSE file
 #include "Geometry.hpp"
 #include "Nodes.hpp"
 
+#include <future>
+
 #if __has_include(<filesystem>)
 
 #include <filesystem>
@@ -26,10 +28,11 @@ namespace std::filesystem {
 namespace nifly {
 // OptimizeFor function options
 struct OptOptions {
-	NiVersion targetVersion;	// NiVersion target for the optimization process
-	bool headParts = false;		// Use mesh formats required for head parts (use ONLY for head parts!)
-	bool removeParallax = true; // Remove parallax shader flags and texture paths
-	bool calcBounds = true;		// Recalculate bounding spheres for unskinned meshes
+	NiVersion targetVersion;		  // NiVersion target for the optimization process
+	bool headParts = false;			  // Use mesh formats required for head parts (use ONLY for head parts!)
+	bool removeParallax = true;		  // Remove parallax shader flags and texture paths
+	bool calcBounds = true;			  // Recalculate bounding spheres for unskinned meshes
+	bool optimizeVertexCache = false; // Reorder triangles and vertices of all shapes for vertex cache locality
 };
 
 // OptimizeFor function result
@@ -43,32 +46,162 @@ struct OptResult {
 	std::vector<std::string> shapesParallaxRemoved; // Names of shapes that had their parallax settings
 };
 
+// UpdateSkinPartitions strategy for splitting partitions that exceed the bone limit
+enum SkinPartitionStrategy {
+	SPS_SEQUENTIAL,		 // Start a new partition at the first triangle that doesn't fit (in triangle order)
+	SPS_BONE_SIMILARITY, // Group triangles with similar bones to minimize the partition count
+};
+
+// UpdateSkinPartitions function options
+struct SkinPartitionOptions {
+	SkinPartitionStrategy strategy = SPS_SEQUENTIAL; // Strategy for splitting partitions with too many bones
+};
+
+// UpdateSkinPartitions function result
+struct SkinPartitionResult {
+	uint32_t numPartitions = 0;		 // Number of partitions after the update
+	uint32_t numAddedPartitions = 0; // Number of partitions that were added to stay within the bone limit
+	uint16_t maxBonesPerPartition = 0; // Bone limit per partition of the file version
+	uint16_t maxBones = 0;			 // Highest bone count of all partitions
+	uint32_t totalBones = 0;		 // Sum of the bone counts of all partitions
+};
+
 // Sort function for bone weights with indices
 struct BoneWeightsSort {
 	bool operator()(const SkinWeight& lhs, const SkinWeight& rhs) { return rhs.weight < lhs.weight; }
 };
 
+// Wall time and run count of a load or save phase
+struct NifStatsPhase {
+	uint64_t count = 0; // Number of times the phase ran
+	uint64_t ns = 0;	// Total wall time in nanoseconds
+};
+
+// Block decoding counters of a single block type
+struct NifStatsBlockType {
+	uint64_t count = 0; // Number of decoded blocks
+	uint64_t bytes = 0; // Bytes read from the stream
+	uint64_t ns = 0;	// Total wall time in nanoseconds
+};
+
+// Stats sink for NifFile::Load and NifFile::Save (see NifLoadOptions and NifSaveOptions).
+// Values add up over all calls using the same sink until Reset is called.
+// Not synchronized, use one sink per thread and merge them with Add.
+struct NifStats {
+	NifStatsPhase load;				// Whole NifFile::Load call
+	NifStatsPhase readHeader;		// Header parse
+	NifStatsPhase readBlocks;		// Block decode of all blocks
+	NifStatsPhase prepareData;		// NifFile::PrepareData, including texture path cleanup
+	NifStatsPhase trimTexturePaths; // NifFile::TrimTexturePaths
+	NifStatsPhase save;				// Whole NifFile::Save call
+	NifStatsPhase finalizeData;		// NifFile::FinalizeData
+	NifStatsPhase optimize;			// NifFile::Optimize
+	NifStatsPhase sortBlocks;		// NifFile::PrettySortBlocks
+	NifStatsPhase writeHeader;		// Header write
+	NifStatsPhase writeBlocks;		// Block write of all blocks
+	NifStatsPhase writeBlockSizes;	// Block size array update
+	uint64_t headerBytesRead = 0;	// Bytes of all parsed headers
+	uint64_t blocksRead = 0;		// Number of all decoded blocks
+	uint64_t bytesRead = 0;			// Bytes parsed from all loaded files (without footer)
+	uint64_t blocksWritten = 0;		// Number of all written blocks
+	uint64_t bytesWritten = 0;		// Bytes of all saved files
+
+	// Block decoding per block type
+	std::map<std::string, NifStatsBlockType> blockTypes;
+
+	void Reset() { *this = NifStats(); }
+	void Add(const NifStats& other);
+};
+
+// Memory owned by the blocks of a single block type
+struct NifMemoryBlockType {
+	uint64_t count = 0;		  // Number of blocks
+	uint64_t objectBytes = 0; // Size of the block objects
+	uint64_t heapBytes = 0;	  // Heap memory owned by the blocks
+};
+
+// Memory footprint of a file, see NifFile::GetMemoryUsage.
+// Heap memory counts the capacity of containers, but not the allocator overhead.
+struct NifMemoryUsage {
+	uint64_t fileBytes = 0;	  // NifFile object and its block list
+	uint64_t headerBytes = 0; // Heap memory owned by the header (strings, block types and sizes)
+	uint64_t objectBytes = 0; // Size of all block objects
+	uint64_t heapBytes = 0;	  // Heap memory owned by all blocks
+
+	// Memory per block type
+	std::map<std::string, NifMemoryBlockType> blockTypes;
+
+	uint64_t GetTotal() const { return fileBytes + headerBytes + objectBytes + heapBytes; }
+};
+
+// Blocks that differ between two files, see NifFile::Diff
+struct NifDiff {
+	std::vector<std::pair<uint32_t, uint32_t>> changed; // Block IDs in this and the other file
+	std::vector<uint32_t> removed;						// Block IDs in this file without a match
+	std::vector<uint32_t> added;						// Block IDs in the other file without a match
+
+	bool IsEmpty() const { return changed.empty() && removed.empty() && added.empty(); }
+};
+
 // NifFile load options
 struct NifLoadOptions {
-	bool isTerrain = false; // Load as terrain file. Affects texture path cleanup and shape names.
+	bool isTerrain = false;	   // Load as terrain file. Affects texture path cleanup and shape names.
+	NifStats* stats = nullptr; // Receives timing and counters of the load phases (not set = no overhead)
 };
 
 // NifFile save options
 struct NifSaveOptions {
-	bool optimize = true;	// Update bounds and delete unreferenced blocks (see NifFile::Optimize)
-	bool sortBlocks = true; // Sorts all blocks in a logical order (see NifFile::PrettySortBlocks)
+	bool optimize = true;	   // Update bounds and delete unreferenced blocks (see NifFile::Optimize)
+	bool sortBlocks = true;	   // Sorts all blocks in a logical order (see NifFile::PrettySortBlocks)
+	NifStats* stats = nullptr; // Receives timing and counters of the save phases (not set = no overhead)
+};
+
+// Size of a file when saved, see NifFile::CalcSerializedSize
+struct NifSerializedSize {
+	uint64_t headerBytes = 0;		  // Header including block types, block sizes and strings
+	std::vector<uint64_t> blockBytes; // Size of each block
+	uint64_t footerBytes = 0;		  // Root references after the blocks
+
+	uint64_t GetTotal() const {
+		uint64_t total = headerBytes + footerBytes;
+		for (auto& bytes : blockBytes)
+			total += bytes;
+		return total;
+	}
 };
 
 class NifFile {
 private:
 	NiHeader hdr;
-	std::vector<std::unique_ptr<NiObject>> blocks;
+	std::vector<std::shared_ptr<NiObject>> blocks;
 	bool isValid = false;
 	bool hasUnknown = false;
 	bool isTerrain = false;
 	bool preserveTexturePaths = false;
 	static constexpr const char* DefaultRootNodeName = "Scene Root";
 
+	// Parent node ID of each block (see GetParentNodeID).
+	// Built on demand and rebuilt once the block list of the header changed.
+	mutable std::vector<uint32_t> parentIndex;
+	mutable uint32_t parentIndexRevision = 0;
+	mutable bool hasParentIndex = false;
+
+	bool IsParentIndexCurrent() const {
+		return hasParentIndex && parentIndexRevision == hdr.GetBlockListRevision()
+			   && parentIndex.size() == blocks.size();
+	}
+	void BuildParentIndex() const;
+
+	// Records the new parent of a block if the index is current
+	void SetParentNodeID(const uint32_t blockID, const uint32_t parentID);
+	// Moves the index entries to the new block IDs after blocks were deleted or reordered
+	void RemapParentIndex(const std::vector<uint32_t>& newIndices);
+
+	// Finalizes, optimizes and sorts the blocks before writing them (see Save)
+	void PrepareSave(const NifSaveOptions& options);
+	void WriteFile(std::ostream& file, NifStats* stats);
+	NifSerializedSize CountSerializedSize();
+
 public:
 	NifFile() = default;
 
@@ -93,9 +226,29 @@ public:
 		return *this;
 	}
 
+	NifFile(NifFile&& other) noexcept { MoveFrom(other); }
+
+	NifFile& operator=(NifFile&& other) noexcept {
+		MoveFrom(other);
+		return *this;
+	}
+
 	NiHeader& GetHeader() { return hdr; }
 	const NiHeader& GetHeader() const { return hdr; }
-	void CopyFrom(const NifFile& other);
+
+	// Copies the header and all blocks of another file.
+	// With "copyOnWrite", both files share the blocks instead and a block is only copied once either
+	// file modifies it. The functions of this class do that on their own, blocks that are modified
+	// directly have to be retrieved with GetBlockForWrite first. Pointers to a shared block keep
+	// referring to the unmodified block after it was copied, functions taking block pointers accept them.
+	// Geometry blocks of NiGeometryData based shapes are always copied, as they're linked by pointer.
+	// Getters like GetVertsForShape fill caches of shared shapes, so files sharing blocks must not be
+	// used from different threads at the same time.
+	void CopyFrom(const NifFile& other, const bool copyOnWrite = false);
+
+	// Takes over the header and all blocks of another file without copying them.
+	// The other file is cleared afterwards, block pointers stay valid.
+	void MoveFrom(NifFile& other);
 
 	int Load(const std::filesystem::path& fileName, const NifLoadOptions& options = NifLoadOptions());
 	int Load(const std::string& fileName, const NifLoadOptions& options = NifLoadOptions());
@@ -104,7 +257,26 @@ public:
 	int Save(const std::string& fileName, const NifSaveOptions& options = NifSaveOptions());
 	int Save(std::ostream& file, const NifSaveOptions& options = NifSaveOptions());
 
-	// Update geometry bounds and delete unreferenced blocks
+	// Saves into a buffer that is resized to the exact file size once, before writing.
+	int Save(std::vector<uint8_t>& data, const NifSaveOptions& options = NifSaveOptions());
+
+	// Returns the exact size of the file and each block when saved with the options, without writing it.
+	// Blocks are finalized, optimized and sorted like in Save, so a following Save writes the same size.
+	// FO76 files can't be saved, their size is 0.
+	NifSerializedSize CalcSerializedSize(const NifSaveOptions& options = NifSaveOptions());
+
+	// Loads or saves the file on background threads, the future receives the return value of Load or Save.
+	// Files are read and written on I/O threads, blocks are decoded and encoded on other threads,
+	// so concurrent requests keep both busy. A single request reads the whole file before decoding it
+	// (and encodes it before writing), so it doesn't finish faster than Load or Save.
+	// The file must not be accessed until the future is ready.
+	// Stats sinks in the options must stay valid until then and must not be shared between requests.
+	std::future<int> LoadAsync(const std::filesystem::path& fileName,
+							   const NifLoadOptions& options = NifLoadOptions());
+	std::future<int> SaveAsync(const std::filesystem::path& fileName,
+							   const NifSaveOptions& options = NifSaveOptions());
+
+	// Update bounds of modified shapes and delete unreferenced blocks
 	void Optimize();
 
 	// Optimizes/converts the file using OptOptions and returns OptResult.
@@ -113,14 +285,37 @@ public:
 
 	// Fills string refs, links NiGeometryData pointers, cleans up texture paths and removes invalid triangles.
 	// For skinned BSTriShape blocks, copies mesh data from skin partitions to shape.
-	// Already automatically called by NifFile::Load.
-	void PrepareData();
+	// Already automatically called by NifFile::Load, which passes its stats sink (optional).
+	void PrepareData(NifStats* stats = nullptr);
 
 	// Calculates data sizes required for saving.
 	// For skinned BSTriShape blocks, copies mesh data back from shape to skin partitions
 	// Already automatically called by NifFile::Save.
 	void FinalizeData();
 
+	// Returns the memory owned by the file and its blocks, broken down by block type.
+	// Use NiObject::GetObjectSize and NiObject::GetHeapSize for single blocks.
+	// Blocks shared with other files (see CopyFrom) are counted in each file.
+	NifMemoryUsage GetMemoryUsage() const;
+
+	// Returns a content hash of the block that is stable across runs and platforms.
+	// Strings are hashed by their contents, so the order of the header strings doesn't matter.
+	// By default, references are hashed by their block IDs.
+	// With "ignoreBlockOrder", the hashes of referenced blocks are used instead of their IDs,
+	// and the order of the child nodes and shapes of a node is ignored (see PrettySortBlocks).
+	// All other reference lists, e.g. the bones of a skin instance, are hashed in order.
+	uint64_t GetBlockHash(const uint32_t blockId, const bool ignoreBlockOrder = false) const;
+
+	// Returns a content hash of the file version and all blocks, see GetBlockHash.
+	// Files with the same hash can be treated as unchanged, e.g. to skip exporting them again.
+	uint64_t GetFileHash(const bool ignoreBlockOrder = false) const;
+
+	// Compares the blocks of this file with the blocks of another file.
+	// By default, blocks are compared by block ID.
+	// With "ignoreBlockOrder", blocks are matched by the block types and names on their path
+	// from the root node instead, and reported as changed if their own data or references differ.
+	NifDiff Diff(const NifFile& other, const bool ignoreBlockOrder = false) const;
+
 	// Indicates that the file was fully loaded or otherwise initialized
 	bool IsValid() const { return isValid; }
 
@@ -160,7 +355,7 @@ public:
 	void LinkGeomData();
 
 	// Removes triangles with vertex indices that don't exist
-	void RemoveInvalidTris() const;
+	void RemoveInvalidTris();
 
 	// Returns vertex limit depending on the file version
 	// All versions: 65535 (uint16_t)
@@ -185,10 +380,30 @@ public:
 	void SetShapeOrder(const std::vector<std::string>& order);
 
 	struct SortState {
-		std::set<uint32_t> visitedIndices;
+		std::vector<bool> visitedIndices;
 		std::vector<uint32_t> newIndices;
 		uint32_t newIndex = 0;
 		std::vector<uint32_t> rootShapeOrder;
+		std::vector<bool> addedChildren; // Used by SortGraph, cleared after each node
+
+		// Starts with the current order
+		explicit SortState(const uint32_t numBlocks)
+			: visitedIndices(numBlocks)
+			, newIndices(numBlocks)
+			, addedChildren(numBlocks) {
+			for (uint32_t i = 0; i < numBlocks; i++)
+				newIndices[i] = i;
+		}
+
+		bool IsVisited(const uint32_t index) const { return visitedIndices[index]; }
+
+		// Assigns the next new index if the block doesn't have one yet
+		void Visit(const uint32_t index) {
+			if (!visitedIndices[index]) {
+				newIndices[index] = newIndex++;
+				visitedIndices[index] = true;
+			}
+		}
 	};
 
 	void SetSortIndices(const NiRef& ref, SortState& sortState);
@@ -236,6 +451,14 @@ public:
 	// Counts the amount of deleted blocks in "deletionCount" if passed.
 	bool DeleteUnreferencedNodes(int* deletionCount = nullptr);
 
+	// Merges identical properties, texture sets, key based interpolators and animation data blocks.
+	// Blocks are compared by their serialized data with references to already merged blocks normalized.
+	// References are redirected to the first block of each group, the other blocks are deleted.
+	// Merged blocks are used by multiple parents afterwards, so modifying one affects all of them.
+	// Does nothing when there are unknown block types to prevent data loss.
+	// Returns the amount of deleted blocks (or 0).
+	uint32_t DeduplicateBlocks();
+
 	// Find a block of the given type by its name.
 	// Block type needs a "name" member (like blocks based on NiObjectNET).
 	// Returns block in the correct type or nullptr.
@@ -245,8 +468,25 @@ public:
 	// Returns index of a block in the blocks array or NIF_NPOS
 	uint32_t GetBlockID(NiObject* block) const;
 
+	// Returns the block for modification, copying it first if it's shared with other files (see CopyFrom).
+	// Blocks that aren't part of the file are returned as they are.
+	template<class T>
+	T* GetBlockForWrite(T* block) {
+		const uint32_t blockId = GetBlockID(block);
+		if (blockId == NIF_NPOS)
+			return block;
+
+		return static_cast<T*>(hdr.UnshareBlock(blockId));
+	}
+
 	// Returns first direct parent NiNode of a block (or nullptr)
 	NiNode* GetParentNode(NiObject* block) const;
+	// Returns the block ID of the first direct parent NiNode of a block (or NIF_NPOS)
+	uint32_t GetParentNodeID(const uint32_t blockID) const;
+
+	// Parent lookups use an index that is kept up to date by the functions of this class.
+	// Child refs of nodes that are changed directly aren't detected, call this afterwards.
+	void InvalidateParentIndex() { hasParentIndex = false; }
 
 	// Moves block from its current parent NiNode to a new parent
 	void SetParentNode(NiObject* block, NiNode* parent);
@@ -303,6 +543,14 @@ public:
 	// Source block can be located in a different file (see "srcNif" parameter).
 	uint32_t CloneNamedNode(const std::string& nodeName, NifFile* srcNif = nullptr);
 
+	// Moves "root" and all blocks below it (child references) from another file without copying them
+	// and attaches it to "destParent" (or the root node). Returns the new index of "root" (or NIF_NPOS).
+	// Blocks that are also referenced from outside of the subtree stay in "srcNif" and are shared instead
+	// (see CopyFrom). Pointers to nodes outside of the subtree (like bones) are resolved by name,
+	// missing nodes are added to the root node. Strings are added to the header.
+	// "srcNif" is compacted in a single pass, references to "root" are cleared there.
+	uint32_t TransplantSubtree(NifFile& srcNif, NiAVObject* root, NiNode* destParent = nullptr);
+
 	// Creates a new unskinned shape for the current file version with vertex/triangle data and returns it.
 	// Adds default shader and texture set as well.
 	// Parameters for texture coordinates (UVs) and normals are optional (pass nullptr).
@@ -319,7 +567,7 @@ public:
 	std::vector<NiShape*> GetShapes() const;
 
 	// Renames a shape (same as setting the "name" member)
-	static bool RenameShape(NiShape* shape, const std::string& newName);
+	bool RenameShape(NiShape* shape, const std::string& newName);
 
 	// Renames shapes with duplicate names by appending a suffix "_<count>"
 	bool RenameDuplicateShapes();
@@ -453,10 +701,10 @@ public:
 	void SetShapeVertWeights(const std::string& shapeName,
 							 const uint16_t vertIndex,
 							 std::vector<uint8_t>& boneids,
-							 std::vector<float>& weights) const;
+							 std::vector<float>& weights);
 
 	// Clears all bone weights and bone indices on the shape. Not implemented for NiTriShape.
-	void ClearShapeVertWeights(const std::string& shapeName) const;
+	void ClearShapeVertWeights(const std::string& shapeName);
 
 	// Gets the segmentation info and a list of the segments each triangle is assigned to.
 	// A triangle can only be assigned to one segment at the same time.
@@ -465,9 +713,7 @@ public:
 
 	// Sets the segmentation info and a list of the segments each triangle is assigned to.
 	// A triangle can only be assigned to one segment at the same time.
-	static void SetShapeSegments(NiShape* shape,
-								 const NifSegmentationInfo& inf,
-								 const std::vector<int>& triParts);
+	void SetShapeSegments(NiShape* shape, const NifSegmentationInfo& inf, const std::vector<int>& triParts);
 
 	// Gets the partition info and a list of the partitions each triangle is assigned to.
 	// A triangle can only be assigned to one partition at the same time.
@@ -492,7 +738,12 @@ public:
 	void DeletePartitions(NiShape* shape, std::vector<uint32_t>& partInds);
 
 	// Reorder triangles of the shape to the order of triangle indices in the list
-	static bool ReorderTriangles(NiShape* shape, const std::vector<uint32_t>& triangleIndices);
+	bool ReorderTriangles(NiShape* shape, const std::vector<uint32_t>& triangleIndices);
+
+	// Reorders triangles for post-transform vertex cache locality and then renumbers vertices in fetch order.
+	// Triangles stay within their skin partition, segment and LOD level. Skin, partition, LOCKEDNORM and
+	// morph data of the shape are updated to match. Returns false if the shape can't be reordered.
+	bool OptimizeVertexCache(NiShape* shape);
 
 	// Gets pointer to vertex positions of the shape (can be nullptr or empty)
 	const std::vector<Vector3>* GetVertsForShape(NiShape* shape);
@@ -536,7 +787,7 @@ public:
 	// Sets vertex bitangents of the shape. Size needs to match the current vertex count.
 	void SetBitangentsForShape(NiShape* shape, const std::vector<Vector3>& bitangents);
 	// Sets vertex eye data of the shape. Size needs to match the current vertex count.
-	static void SetEyeDataForShape(NiShape* shape, const std::vector<float>& eyeData);
+	void SetEyeDataForShape(NiShape* shape, const std::vector<float>& eyeData);
 
 	// Gets binary extra data that contains tangent and bitangent data (used in OB).
 	// Returns nullptr if no matching extra data was found.
@@ -588,14 +839,28 @@ public:
 					 const Vector3& offset,
 					 std::unordered_map<uint16_t, float>* mask = nullptr);
 
+	// Moves the shape by the specified offset, scaled by a weight per vertex (0 = unchanged, 1 = full offset).
+	// The weight count needs to match the vertex count.
+	void OffsetShape(NiShape* shape, const Vector3& offset, const std::vector<float>& weights);
+
 	// Scales the entire shape from the scene root by the specified factors. Respects the specified masking map.
 	void ScaleShape(NiShape* shape, const Vector3& scale, std::unordered_map<uint16_t, float>* mask = nullptr);
 
+	// Scales the shape from the scene root, blended by a weight per vertex (0 = not scaled, 1 = fully scaled).
+	// Like the unmasked version, all vertices are moved by the negated root translation.
+	// The weight count needs to match the vertex count.
+	void ScaleShape(NiShape* shape, const Vector3& scale, const std::vector<float>& weights);
+
 	// Rotates the entire shape from the scene root by the specified angles in degrees. Respects the specified masking map.
 	void RotateShape(NiShape* shape,
 					 const Vector3& angle,
 					 std::unordered_map<uint16_t, float>* mask = nullptr);
 
+	// Rotates the shape from the scene root, blended by a weight per vertex (0 = none, 1 = fully rotated).
+	// Like the unmasked version, all vertices are moved by the negated root translation.
+	// The weight count needs to match the vertex count.
+	void RotateShape(NiShape* shape, const Vector3& angle, const std::vector<float>& weights);
+
 	// Returns alpha property of the shape (or nullptr)
 	NiAlphaProperty* GetAlphaProperty(NiShape* shape) const;
 
@@ -636,6 +901,22 @@ public:
 				   std::unordered_map<uint16_t, Vector3>& outDiffData,
 				   float scale = 1.0f);
 
+	// Same as above, but returns the differences in the more compact sparse format sorted by vertex index.
+	int CalcShapeDiff(NiShape* shape,
+					  const std::vector<Vector3>* targetData,
+					  SparseDiffData& outDiffData,
+					  float scale = 1.0f);
+	int CalcUVDiff(NiShape* shape,
+				   const std::vector<Vector2>* targetData,
+				   SparseDiffData& outDiffData,
+				   float scale = 1.0f);
+
+	// Adds the differences multiplied by the weight to the vertex positions of the shape.
+	void ApplyShapeDiff(NiShape* shape, const SparseDiffData& diffData, const float weight = 1.0f);
+
+	// Adds the differences multiplied by the weight to the texture coordinates (UVs) of the shape.
+	void ApplyUVDiff(NiShape* shape, const SparseDiffData& diffData, const float weight = 1.0f);
+
 	// Create all blocks and flags required for skinning, if they don't already exist
 	// Blocks: BSDismemberSkinInstance, NiSkinData, NiSkinPartition, BSSkin::Instance, BSSkin::BoneData
 	void CreateSkinning(NiShape* shape);
@@ -647,6 +928,7 @@ public:
 	// but updates the weighting values and vertex/triangle maps.
 	// If required by limits, inserts additional partitions with matching slots.
 	void UpdateSkinPartitions(NiShape* shape);
+	SkinPartitionResult UpdateSkinPartitions(NiShape* shape, const SkinPartitionOptions& options);
 
 	// Update bone set partition flags. Called automatically in some functions that edit partitions.
 	void UpdatePartitionFlags(NiShape* shape);
@@ -0,0 +1,42 @@
+/*
+nifly
+C++ NIF library for the Gamebryo/NetImmerse File Format
+See the included GPLv3 LICENSE file
+*/
+
+#pragma once
+
+#include "NifFile.hpp"
+
+namespace nifly {
+// NifGenerator options
+struct NifGeneratorOptions {
+	NiVersion version = NiVersion::getSSE(); // Version of the generated file
+	uint32_t nodeCount = 0;					 // NiNode blocks below the root node
+	uint32_t nodeDepth = 1;					 // Nodes are added in chains of this length below the root
+	uint32_t shapeCount = 1;				 // Shapes, distributed over the deepest node of each chain
+	uint16_t vertsPerShape = 256;			 // Vertices of each shape, laid out as a triangulated grid
+	uint16_t bonesPerSkin = 0;				 // Bones of each shape (0 = unskinned), nodes are used as bones
+	uint32_t controllerCount = 0;			 // Nodes with a transform controller (at most one per node)
+	bool collision = false;					 // Box collision on each node with shapes (up to Skyrim SE)
+	uint32_t blockCount = 0;				 // Minimum block count, padded with extra data on the nodes
+};
+
+// Generates synthetic files of arbitrary size for scaling tests and benchmarks.
+// Output only depends on the options, so the same options always generate the same file.
+class NifGenerator {
+	NifGeneratorOptions options;
+
+public:
+	NifGenerator() = default;
+	NifGenerator(const NifGeneratorOptions& generatorOptions)
+		: options(generatorOptions) {}
+
+	const NifGeneratorOptions& GetOptions() const { return options; }
+	void SetOptions(const NifGeneratorOptions& generatorOptions) { options = generatorOptions; }
+
+	// Replaces the contents of the file with a generated scene.
+	// Returns 0 on success, 1 if the options are invalid (e.g. too few vertices for a triangle).
+	int Generate(NifFile& nif) const;
+};
+} // namespace nifly
@@ -0,0 +1,68 @@
+/*
+nifly
+C++ NIF library for the Gamebryo/NetImmerse File Format
+See the included GPLv3 LICENSE file
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+// Scoped trace events, enabled with the NIFLY_ENABLE_TRACING CMake option.
+// Each thread records into its own fixed-size ring buffer without locking, so the oldest events
+// of a thread are overwritten once its buffer is full. Without the option, the macros compile to nothing.
+//
+// Usage:
+//   NIFLY_TRACE_SCOPE("NifFile::Load"); // Records an event lasting until the end of the scope
+//   nifly::trace::WriteChromeTrace(file); // Open in chrome://tracing or ui.perfetto.dev
+
+namespace nifly {
+namespace trace {
+// Events recorded per thread before the oldest ones are overwritten
+constexpr uint32_t ThreadBufferSize = 16384;
+
+// Returns true if the library was built with NIFLY_ENABLE_TRACING
+bool IsEnabled();
+
+// Writes the recorded events of all threads in the Chrome trace event JSON format.
+// Can be called while other threads are recording. Writes an empty trace if tracing is disabled.
+void WriteChromeTrace(std::ostream& out);
+
+// Discards the recorded events of all threads.
+// Must not be called while other threads are recording.
+void Clear();
+
+#ifdef NIFLY_ENABLE_TRACING
+// Monotonic time in nanoseconds since the first call
+uint64_t Now();
+
+// Records a complete event. "name" must stay valid until the events are written or cleared.
+void Record(const char* name, uint64_t startNs, uint64_t endNs);
+
+// Records an event for the lifetime of the object
+class Scope {
+	const char* name;
+	uint64_t startNs;
+
+public:
+	Scope(const char* eventName)
+		: name(eventName)
+		, startNs(Now()) {}
+
+	~Scope() { Record(name, startNs, Now()); }
+
+	Scope(const Scope&) = delete;
+	Scope& operator=(const Scope&) = delete;
+};
+#endif
+} // namespace trace
+} // namespace nifly
+
+#ifdef NIFLY_ENABLE_TRACING
+#define NIFLY_TRACE_CONCAT_INNER(a, b) a##b
+#define NIFLY_TRACE_CONCAT(a, b) NIFLY_TRACE_CONCAT_INNER(a, b)
+#define NIFLY_TRACE_SCOPE(name) ::nifly::trace::Scope NIFLY_TRACE_CONCAT(niflyTraceScope, __LINE__)(name)
+#else
+#define NIFLY_TRACE_SCOPE(name)
+#endif
@@ -94,6 +94,20 @@ void InsertVectorIndices(VectorType& v, const std::vector<IndexType>& indices) {
 	}
 }
 
+// Moves each element v[i] to v[map[i]].  'map' must be a permutation of the indices of v,
+// otherwise v is left unchanged.
+template<typename VectorType, typename IndexType>
+void ApplyIndexPermutation(VectorType& v, const std::vector<IndexType>& map) {
+	if (v.size() != map.size())
+		return;
+
+	VectorType permuted(v.size());
+	for (size_t i = 0; i < map.size(); ++i)
+		permuted[map[i]] = std::move(v[i]);
+
+	v = std::move(permuted);
+}
+
 // 'indices' must be in sorted ascending order beforehand.
 template<typename IndexType1, typename IndexType2>
 std::vector<int> GenerateIndexCollapseMap(const std::vector<IndexType1>& indices, const IndexType2 mapSize) {
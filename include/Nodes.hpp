@@ -18,10 +18,11 @@ public:
 	static constexpr const char* BlockName = "NiNode";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 
 	NiBlockRefArray<NiAVObject>& GetChildren();
 	NiBlockRefArray<NiDynamicEffect>& GetEffects();
@@ -47,7 +48,8 @@ public:
 	static constexpr const char* BlockName = "BSValueNode";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(BSLeafAnimNode, NiNode) {
@@ -64,10 +66,11 @@ public:
 	static constexpr const char* BlockName = "BSTreeNode";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSOrderedNode, NiNode) {
@@ -78,7 +81,8 @@ public:
 	static constexpr const char* BlockName = "BSOrderedNode";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(BSMultiBoundData, NiObject) {};
@@ -92,7 +96,8 @@ public:
 	static constexpr const char* BlockName = "BSMultiBoundOBB";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSMultiBoundAABB, BSMultiBoundData) {
@@ -103,7 +108,8 @@ public:
 	static constexpr const char* BlockName = "BSMultiBoundAABB";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSMultiBoundSphere, BSMultiBoundData) {
@@ -114,7 +120,8 @@ public:
 	static constexpr const char* BlockName = "BSMultiBoundSphere";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSMultiBound, NiObject) {
@@ -124,10 +131,10 @@ public:
 	static constexpr const char* BlockName = "BSMultiBound";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 enum BSCPCullingType : uint32_t {
@@ -146,10 +153,10 @@ public:
 	static constexpr const char* BlockName = "BSMultiBoundNode";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(BSRangeNode, NiNode) {
@@ -161,7 +168,8 @@ public:
 	static constexpr const char* BlockName = "BSRangeNode";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(BSDebrisNode, BSRangeNode) {
@@ -199,7 +207,8 @@ public:
 	static constexpr const char* BlockName = "NiBillboardNode";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 enum NiSwitchFlags : uint16_t { UPDATE_ONLY_ACTIVE_CHILD, UPDATE_CONTROLLERS };
@@ -212,7 +221,8 @@ public:
 	static constexpr const char* BlockName = "NiSwitchNode";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 struct LODRange {
@@ -230,7 +240,9 @@ public:
 	static constexpr const char* BlockName = "NiRangeLODData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiScreenLODData, NiLODData) {
@@ -244,7 +256,9 @@ public:
 	static constexpr const char* BlockName = "NiScreenLODData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiLODNode, NiSwitchNode) {
@@ -254,10 +268,10 @@ public:
 	static constexpr const char* BlockName = "NiLODNode";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 CLONEABLECLASSDEF(NiBone, NiNode) {
@@ -275,6 +289,7 @@ public:
 	static constexpr const char* BlockName = "NiSortAdjustNode";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 } // namespace nifly
@@ -1025,6 +1025,63 @@ public:
 	}
 };
 
+// Applies the affine transformation of 'mat' to 'count' points that are 'stride' bytes apart.
+// With 'weights', each point only moves by weights[i] towards its transformed position.
+void TransformPoints(Vector3* points,
+					 size_t count,
+					 size_t stride,
+					 const Matrix4& mat,
+					 const float* weights = nullptr);
+
+// Applies 'uv * scale + offset' to 'count' texture coordinates that are 'stride' bytes apart.
+void TransformTexCoords(Vector2* uvs, size_t count, size_t stride, const Vector2& scale, const Vector2& offset);
+
+// Sparse per-vertex difference data (e.g. morph offsets), sorted by ascending vertex index.
+// Coordinates are stored in separate arrays. Texture coordinate differences use x (U) and y (V) only.
+struct SparseDiffData {
+	std::vector<uint16_t> indices;
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+
+	size_t size() const { return indices.size(); }
+	bool empty() const { return indices.empty(); }
+
+	void clear() {
+		indices.clear();
+		x.clear();
+		y.clear();
+		z.clear();
+	}
+
+	Vector3 GetDiff(const size_t i) const { return Vector3(x[i], y[i], z[i]); }
+
+	// Appends a difference. The index needs to be greater than all existing ones.
+	void AddDiff(const uint16_t index, const Vector3& diff) {
+		indices.push_back(index);
+		x.push_back(diff.x);
+		y.push_back(diff.y);
+		z.push_back(diff.z);
+	}
+
+	// Stores '(target * targetScale - source) * diffScale' for all points where it isn't nearly zero
+	void Calc(const Vector3* source,
+			  const Vector3* target,
+			  size_t count,
+			  float targetScale = 1.0f,
+			  float diffScale = 1.0f);
+	void Calc(const Vector2* source,
+			  const Vector2* target,
+			  size_t count,
+			  float targetScale = 1.0f,
+			  float diffScale = 1.0f);
+
+	// Adds the differences multiplied by 'weight' to 'count' points that are 'stride' bytes apart.
+	// Indices out of range are ignored.
+	void ApplyTo(Vector3* points, size_t count, size_t stride, float weight = 1.0f) const;
+	void ApplyTo(Vector2* uvs, size_t count, size_t stride, float weight = 1.0f) const;
+};
+
 
 struct BoundingSphere {
 	Vector3 center;
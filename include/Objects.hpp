@@ -21,10 +21,11 @@ public:
 	NiBlockRef<NiTimeController> controllerRef;
 	NiBlockRefArray<NiExtraData> extraDataRefs;
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 	void SetControllerRef(const int controllerId) { controllerRef.index = controllerId; }
 };
 
@@ -42,9 +43,10 @@ public:
 	NiBlockRefArray<NiProperty> propertyRefs;
 	NiBlockRef<NiCollisionObject> collisionRef;
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 
 	const MatTransform& GetTransformToParent() const { return transform; }
 	void SetTransformToParent(const MatTransform& t) { transform = t; }
@@ -55,12 +57,15 @@ public:
 	NiString name;
 	NiBlockPtr<NiAVObject> objectRef;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		name.Sync(stream, 4);
 		objectRef.Sync(stream);
 	}
 
-	void GetPtrs(std::set<NiPtr*>& ptrs) { ptrs.insert(&objectRef); }
+	size_t GetHeapSize() const { return HeapSize(name); }
+
+	void ForEachPtr(const NiRefVisitor& visitor) { visitor(objectRef); }
 };
 
 CLONEABLECLASSDEF(NiAVObjectPalette, NiObject) {};
@@ -73,8 +78,10 @@ public:
 	static constexpr const char* BlockName = "NiDefaultAVObjectPalette";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiCamera, NiAVObject) {
@@ -100,9 +107,9 @@ public:
 	static constexpr const char* BlockName = "NiCamera";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 CLONEABLECLASSDEF(NiSequenceStreamHelper, NiObjectNET) {
@@ -119,7 +126,9 @@ public:
 	static constexpr const char* BlockName = "NiPalette";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 enum PixelFormat : uint32_t {
@@ -194,9 +203,10 @@ public:
 	NiVector<MipMapInfo> mipmaps;
 	uint32_t bytesPerPixel = 0;
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 enum PlatformID : uint32_t { PLAT_ANY, PLAT_XENON, PLAT_PS3, PLAT_DX9, PLAT_WII, PLAT_D3D10 };
@@ -213,7 +223,9 @@ public:
 	static constexpr const char* BlockName = "NiPersistentSrcTextureRendererData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiPixelData, TextureRenderData) {
@@ -226,7 +238,9 @@ public:
 	static constexpr const char* BlockName = "NiPixelData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 enum PixelLayout : uint32_t {
@@ -275,10 +289,11 @@ public:
 	static constexpr const char* BlockName = "NiSourceTexture";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 CLONEABLECLASSDEF(NiSourceCubeMap, NiSourceTexture) {
@@ -318,8 +333,10 @@ public:
 	bool switchState = false;
 	NiBlockPtrArray<NiNode> affectedNodes;
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiTextureEffect, NiDynamicEffect) {
@@ -337,9 +354,9 @@ public:
 	static constexpr const char* BlockName = "NiTextureEffect";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiLight, NiDynamicEffect) {
@@ -349,7 +366,8 @@ public:
 	Color3 diffuseColor;
 	Color3 specularColor;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(NiAmbientLight, NiLight) {
@@ -373,7 +391,8 @@ public:
 	static constexpr const char* BlockName = "NiPointLight";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiSpotLight, NiPointLight) {
@@ -385,6 +404,7 @@ public:
 	static constexpr const char* BlockName = "NiSpotLight";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 } // namespace nifly
@@ -58,7 +58,9 @@ public:
 	static constexpr const char* BlockName = "NiParticlesData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 CLONEABLECLASSDEF(NiAutoNormalParticlesData, NiParticlesData) {
@@ -80,9 +82,9 @@ public:
 	static constexpr const char* BlockName = "NiParticleMeshesData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiPSysData, NiRotatingParticlesData) {
@@ -93,7 +95,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiMeshPSysData, NiPSysData) {
@@ -107,9 +110,10 @@ public:
 	static constexpr const char* BlockName = "NiMeshPSysData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSStripPSysData, NiPSysData) {
@@ -122,7 +126,8 @@ public:
 	static constexpr const char* BlockName = "BSStripPSysData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysEmitterCtlrData, NiObject) {
@@ -133,7 +138,9 @@ public:
 	static constexpr const char* BlockName = "NiPSysEmitterCtlrData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 class NiParticleSystem;
@@ -145,9 +152,11 @@ public:
 	NiBlockPtr<NiParticleSystem> targetRef;
 	bool isActive = false;
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSPSysStripUpdateModifier, NiPSysModifier) {
@@ -157,7 +166,8 @@ public:
 	static constexpr const char* BlockName = "BSPSysStripUpdateModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysSpawnModifier, NiPSysModifier) {
@@ -174,7 +184,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysSpawnModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysAgeDeathModifier, NiPSysModifier) {
@@ -185,9 +196,9 @@ public:
 	static constexpr const char* BlockName = "NiPSysAgeDeathModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(BSPSysLODModifier, NiPSysModifier) {
@@ -200,7 +211,8 @@ public:
 	static constexpr const char* BlockName = "BSPSysLODModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSPSysSimpleColorModifier, NiPSysModifier) {
@@ -219,7 +231,8 @@ public:
 	static constexpr const char* BlockName = "BSPSysSimpleColorModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysRotationModifier, NiPSysModifier) {
@@ -237,7 +250,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysRotationModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSPSysScaleModifier, NiPSysModifier) {
@@ -247,7 +261,9 @@ public:
 	static constexpr const char* BlockName = "BSPSysScaleModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 enum ForceType : uint32_t { FORCE_PLANAR, FORCE_SPHERICAL, FORCE_UNKNOWN };
@@ -266,8 +282,9 @@ public:
 	static constexpr const char* BlockName = "NiPSysGravityModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 CLONEABLECLASSDEF(NiPSysPositionModifier, NiPSysModifier) {
@@ -283,7 +300,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysBoundUpdateModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysDragModifier, NiPSysModifier) {
@@ -297,8 +315,9 @@ public:
 	static constexpr const char* BlockName = "NiPSysDragModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(BSPSysInheritVelocityModifier, NiPSysModifier) {
@@ -311,8 +330,9 @@ public:
 	static constexpr const char* BlockName = "BSPSysInheritVelocityModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(BSPSysSubTexModifier, NiPSysModifier) {
@@ -328,7 +348,8 @@ public:
 	static constexpr const char* BlockName = "BSPSysSubTexModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 enum DecayType : uint32_t { DECAY_NONE, DECAY_LINEAR, DECAY_EXPONENTIAL };
@@ -347,8 +368,9 @@ public:
 	static constexpr const char* BlockName = "NiPSysBombModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiColorData, NiObject) {
@@ -358,7 +380,9 @@ public:
 	static constexpr const char* BlockName = "NiColorData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiPSysColorModifier, NiPSysModifier) {
@@ -368,9 +392,9 @@ public:
 	static constexpr const char* BlockName = "NiPSysColorModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiPSysGrowFadeModifier, NiPSysModifier) {
@@ -384,7 +408,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysGrowFadeModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysMeshUpdateModifier, NiPSysModifier) {
@@ -394,9 +419,10 @@ public:
 	static constexpr const char* BlockName = "NiPSysMeshUpdateModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiPSysFieldModifier, NiPSysModifier) {
@@ -407,9 +433,9 @@ public:
 	bool useMaxDistance = false;
 	float maxDistance = 0.0f;
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiPSysVortexFieldModifier, NiPSysFieldModifier) {
@@ -419,7 +445,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysVortexFieldModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysGravityFieldModifier, NiPSysFieldModifier) {
@@ -429,7 +456,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysGravityFieldModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysDragFieldModifier, NiPSysFieldModifier) {
@@ -440,7 +468,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysDragFieldModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysTurbulenceFieldModifier, NiPSysFieldModifier) {
@@ -450,7 +479,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysTurbulenceFieldModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysAirFieldModifier, NiPSysFieldModifier) {
@@ -466,7 +496,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysAirFieldModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysRadialFieldModifier, NiPSysFieldModifier) {
@@ -476,7 +507,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysRadialFieldModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSWindModifier, NiPSysModifier) {
@@ -486,7 +518,8 @@ public:
 	static constexpr const char* BlockName = "BSWindModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSPSysRecycleBoundModifier, NiPSysModifier) {
@@ -498,8 +531,9 @@ public:
 	static constexpr const char* BlockName = "BSPSysRecycleBoundModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(BSPSysHavokUpdateModifier, NiPSysModifier) {
@@ -510,9 +544,10 @@ public:
 	static constexpr const char* BlockName = "BSPSysHavokUpdateModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSParentVelocityModifier, NiPSysModifier) {
@@ -522,7 +557,8 @@ public:
 	static constexpr const char* BlockName = "BSParentVelocityModifier";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSMasterParticleSystem, NiNode) {
@@ -533,10 +569,11 @@ public:
 	static constexpr const char* BlockName = "BSMasterParticleSystem";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiParticleSystem, NiAVObject) {
@@ -577,10 +614,11 @@ public:
 	static constexpr const char* BlockName = "NiParticleSystem";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 CLONEABLECLASSDEF(NiMeshParticleSystem, NiParticleSystem) {
@@ -607,10 +645,10 @@ public:
 	NiBlockRef<NiPSysCollider> nextColliderRef;
 	NiBlockPtr<NiNode> colliderNodeRef;
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiPSysSphericalCollider, NiPSysCollider) {
@@ -620,7 +658,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysSphericalCollider";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysPlanarCollider, NiPSysCollider) {
@@ -633,7 +672,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysPlanarCollider";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysColliderManager, NiPSysModifier) {
@@ -643,9 +683,9 @@ public:
 	static constexpr const char* BlockName = "NiPSysColliderManager";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiPSysEmitter, NiPSysModifier) {
@@ -662,15 +702,17 @@ public:
 	float lifeSpan = 0.0f;
 	float lifeSpanVariation = 0.0f;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysVolumeEmitter, NiPSysEmitter) {
 public:
 	NiBlockPtr<NiNode> emitterNodeRef;
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(NiPSysSphereEmitter, NiPSysVolumeEmitter) {
@@ -680,7 +722,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysSphereEmitter";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysCylinderEmitter, NiPSysVolumeEmitter) {
@@ -691,7 +734,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysCylinderEmitter";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiPSysBoxEmitter, NiPSysVolumeEmitter) {
@@ -703,7 +747,8 @@ public:
 	static constexpr const char* BlockName = "NiPSysBoxEmitter";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(BSPSysArrayEmitter, NiPSysVolumeEmitter) {
@@ -732,7 +777,9 @@ public:
 	static constexpr const char* BlockName = "NiPSysMeshEmitter";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 } // namespace nifly
@@ -55,7 +55,8 @@ public:
 	static constexpr const char* BlockName = "NiShadeProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiSpecularProperty, NiProperty) {
@@ -65,7 +66,8 @@ public:
 	static constexpr const char* BlockName = "NiSpecularProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 struct TexTransform {
@@ -89,7 +91,8 @@ public:
 	bool hasTexTransform = false;
 	TexTransform transform;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		const NiFileVersion fileVersion = stream.GetVersion().File();
 
 		if (fileVersion >= NiFileVersion::V3_3_0_13)
@@ -120,8 +123,7 @@ public:
 		}
 	}
 
-	void GetChildRefs(std::set<NiRef*>& refs) { refs.insert(&sourceRef); }
-	void GetChildIndices(std::vector<uint32_t>& indices) { indices.push_back(sourceRef.index); }
+	void ForEachChildRef(const NiRefVisitor& visitor) { visitor(sourceRef); }
 };
 
 class ShaderTexDesc {
@@ -130,7 +132,8 @@ public:
 	TexDesc data;
 	uint32_t mapIndex = 0;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(isUsed);
 
 		if (isUsed) {
@@ -139,8 +142,7 @@ public:
 		}
 	}
 
-	void GetChildRefs(std::set<NiRef*>& refs) { data.GetChildRefs(refs); }
-	void GetChildIndices(std::vector<uint32_t>& indices) { data.GetChildIndices(indices); }
+	void ForEachChildRef(const NiRefVisitor& visitor) { data.ForEachChildRef(visitor); }
 };
 
 STREAMABLECLASSDEF(NiTexturingProperty, NiProperty) {
@@ -194,9 +196,10 @@ public:
 	static constexpr const char* BlockName = "NiTexturingProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(NiVertexColorProperty, NiProperty) {
@@ -208,7 +211,8 @@ public:
 	static constexpr const char* BlockName = "NiVertexColorProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiDitherProperty, NiProperty) {
@@ -218,7 +222,8 @@ public:
 	static constexpr const char* BlockName = "NiDitherProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiFogProperty, NiProperty) {
@@ -230,7 +235,8 @@ public:
 	static constexpr const char* BlockName = "NiFogProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiWireframeProperty, NiProperty) {
@@ -240,7 +246,8 @@ public:
 	static constexpr const char* BlockName = "NiWireframeProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(NiZBufferProperty, NiProperty) {
@@ -250,7 +257,8 @@ public:
 	static constexpr const char* BlockName = "NiZBufferProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSShaderTextureSet, NiObject) {
@@ -263,7 +271,9 @@ public:
 	static constexpr const char* BlockName = "BSShaderTextureSet";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 CLONEABLECLASSDEF(NiShader, NiProperty) {
@@ -335,7 +345,9 @@ public:
 	Vector2 uvOffset;
 	Vector2 uvScale = Vector2(1.0f, 1.0f);
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 
 	uint32_t GetShaderType() const override;
 	void SetShaderType(const uint32_t type) override;
@@ -394,7 +406,9 @@ public:
 	static constexpr const char* BlockName = "TallGrassShaderProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 CLONEABLECLASSDEF(VolumetricFogShaderProperty, BSShaderProperty) {
@@ -407,7 +421,9 @@ class BSTextureArray {
 public:
 	NiStringVector<> textureArray;
 
-	void Sync(NiStreamReversible& stream) { textureArray.Sync(stream); }
+	template<typename Stream>
+	void Sync(Stream& stream) { textureArray.Sync(stream); }
+	size_t GetHeapSize() const { return HeapSize(textureArray); }
 };
 
 STREAMABLECLASSDEF(BSLightingShaderProperty, BSShaderProperty) {
@@ -482,10 +498,11 @@ public:
 	static constexpr const char* BlockName = "BSLightingShaderProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 
 	bool HasTextureSet() const override { return !textureSetRef.IsEmpty(); }
 	NiBlockRef<BSShaderTextureSet>* TextureSetRef() override { return &textureSetRef; }
@@ -552,7 +569,9 @@ public:
 	static constexpr const char* BlockName = "BSEffectShaderProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 
 	float GetEnvironmentMapScale() const override;
 	Color4 GetEmissiveColor() const override;
@@ -568,7 +587,8 @@ public:
 	static constexpr const char* BlockName = "BSWaterShaderProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(BSSkyShaderProperty, BSShaderProperty) {
@@ -579,14 +599,17 @@ public:
 	static constexpr const char* BlockName = "BSSkyShaderProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSShaderLightingProperty, BSShaderProperty) {
 public:
 	uint32_t textureClampMode = 3; // User Version <= 11
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 enum SkyObjectType : uint32_t {
@@ -606,7 +629,9 @@ public:
 	static constexpr const char* BlockName = "SkyShaderProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(TileShaderProperty, BSShaderLightingProperty) {
@@ -616,7 +641,9 @@ public:
 	static constexpr const char* BlockName = "TileShaderProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(BSShaderNoLightingProperty, BSShaderLightingProperty) {
@@ -630,7 +657,9 @@ public:
 	static constexpr const char* BlockName = "BSShaderNoLightingProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 
 	bool IsSkinned() const override;
 	void SetSkinned(const bool enable) override;
@@ -649,9 +678,9 @@ public:
 	static constexpr const char* BlockName = "BSShaderPPLightingProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 
 	bool HasTextureSet() const override { return !textureSetRef.IsEmpty(); }
 	NiBlockRef<BSShaderTextureSet>* TextureSetRef() override { return &textureSetRef; }
@@ -676,7 +705,8 @@ public:
 	static constexpr const char* BlockName = "NiAlphaProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 
@@ -696,7 +726,8 @@ public:
 	static constexpr const char* BlockName = "NiMaterialProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 
 	bool IsEmissive() const override;
 	bool HasSpecular() const override;
@@ -744,6 +775,7 @@ public:
 	static constexpr const char* BlockName = "NiStencilProperty";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 } // namespace nifly
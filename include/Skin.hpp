@@ -44,6 +44,8 @@ public:
 		BoundingSphere bounds;
 		uint16_t numVertices = 0;
 		std::vector<SkinWeight> vertexWeights;
+
+		size_t GetHeapSize() const { return HeapSize(vertexWeights); }
 	};
 
 	// skinTransform transforms from the global CS to the skin CS.
@@ -56,8 +58,11 @@ public:
 	static constexpr const char* BlockName = "NiSkinData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 	void notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) override;
+	void notifyVerticesReorder(const std::vector<uint16_t>& vertMap) override;
 };
 
 STREAMABLECLASSDEF(NiSkinPartition, NiObject) {
@@ -87,6 +92,13 @@ public:
 		// triParts, triParts should be cleared.
 		std::vector<Triangle> trueTriangles; // User Version >= 12, User Version 2 == 100
 
+		size_t GetHeapSize() const {
+			size_t size = HeapSize(bones) + HeapSize(vertexMap) + HeapSize(vertexWeights);
+			size += HeapSize(stripLengths) + HeapSize(strips);
+			size += HeapSize(triangles) + HeapSize(boneIndices) + HeapSize(trueTriangles);
+			return size;
+		}
+
 		bool ConvertStripsToTriangles();
 		void GenerateTrueTrianglesFromMappedTriangles();
 		void GenerateMappedTrianglesFromTrueTrianglesAndVertexMap();
@@ -128,8 +140,11 @@ public:
 	static constexpr const char* BlockName = "NiSkinPartition";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 	void notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) override;
+	void notifyVerticesReorder(const std::vector<uint16_t>& vertMap) override;
 	// DeletePartitions: partInds must be in sorted ascending order
 	void DeletePartitions(const std::vector<uint32_t>& partInds);
 	uint32_t RemoveEmptyPartitions(std::vector<uint32_t>& outDeletedIndices);
@@ -166,6 +181,8 @@ class NiNode;
 CLONEABLECLASSDEF(NiBoneContainer, NiObject) {
 public:
 	NiBlockPtrArray<NiNode> boneRefs;
+
+	size_t GetHeapSize() const override { return NiObject::GetHeapSize() + HeapSize(boneRefs); }
 };
 
 STREAMABLECLASSDEF(NiSkinInstance, NiBoneContainer) {
@@ -177,10 +194,10 @@ public:
 	static constexpr const char* BlockName = "NiSkinInstance";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
-	void GetPtrs(std::set<NiRef*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 
@@ -198,7 +215,9 @@ public:
 	static constexpr const char* BlockName = "BSDismemberSkinInstance";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 
 	// DeletePartitions: partInds must be in sorted ascending order.
 	void DeletePartitions(const std::vector<uint32_t>& partInds);
@@ -224,7 +243,9 @@ public:
 	static constexpr const char* BlockName = "BSSkin::BoneData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 class NiAVObject;
@@ -238,9 +259,10 @@ public:
 	static constexpr const char* BlockName = "BSSkin::Instance";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
-	void GetPtrs(std::set<NiRef*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 } // namespace nifly
@@ -88,7 +88,11 @@ public:
 	VertexFlags GetFlags() const { return VertexFlags((desc & DESC_MASK_OFFSET) >> 44); }
 	void SetFlags(VertexFlags flags) { desc |= Convert(flags) | (desc & DESC_MASK_FLAGS); }
 
-	void Sync(NiStreamReversible& stream) { stream.Sync(desc); }
+	bool operator==(const VertexDesc& other) const { return desc == other.desc; }
+	bool operator!=(const VertexDesc& other) const { return !operator==(other); }
+
+	template<typename Stream>
+	void Sync(Stream& stream) { stream.Sync(desc); }
 
 private:
 	uint64_t Convert(VertexFlags flag) { return static_cast<uint64_t>(flag) << 44; }
@@ -109,6 +113,15 @@ struct BSVertexData {
 		weightBones = rhs.weightBones;
 		eyeData = rhs.eyeData;
 	}
+
+	bool operator==(const BSVertexData& rhs) const {
+		return vert == rhs.vert && bitangentX == rhs.bitangentX && uv.u == rhs.uv.u && uv.v == rhs.uv.v
+			   && normal == rhs.normal && bitangentY == rhs.bitangentY && tangent == rhs.tangent
+			   && bitangentZ == rhs.bitangentZ && colorData == rhs.colorData && weights == rhs.weights
+			   && weightBones == rhs.weightBones && eyeData == rhs.eyeData;
+	}
+	bool operator!=(const BSVertexData& rhs) const { return !operator==(rhs); }
+
 	// Single- or half-precision depending on IsFullPrecision() being true
 	Vector3 vert;
 	float bitangentX = 0.0f; // Maybe the dot product of the vert normal and the z-axis?
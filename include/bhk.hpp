@@ -39,7 +39,8 @@ struct bhkPositionConstraintMotor : bhkLimitedForceConstraintMotor {
 	float proportionalRecoveryVelocity = 2.0f;
 	float constantRecoveryVelocity = 1.0f;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(minForce);
 		stream.Sync(maxForce);
 		stream.Sync(tau);
@@ -55,7 +56,8 @@ struct bhkVelocityConstraintMotor : bhkLimitedForceConstraintMotor {
 	float velocityTarget = 0.0f;
 	bool useVelocityTargetFromConstraintTargets = 0.0f;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(minForce);
 		stream.Sync(maxForce);
 		stream.Sync(tau);
@@ -69,7 +71,8 @@ struct bhkSpringDamperConstraintMotor : bhkLimitedForceConstraintMotor {
 	float springConstant = 0.0f;
 	float springDamping = 0.0f;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(minForce);
 		stream.Sync(maxForce);
 		stream.Sync(springConstant);
@@ -84,7 +87,8 @@ struct MotorDesc {
 	bhkVelocityConstraintMotor motorVelocity;
 	bhkSpringDamperConstraintMotor motorSpringDamper;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(motorType);
 
 		switch (motorType) {
@@ -106,7 +110,8 @@ struct HingeDesc {
 	Vector4 axleInB2;
 	Vector4 pivotB;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		if (stream.GetVersion().File() <= NiFileVersion::V20_0_0_5) {
 			stream.Sync(pivotA);
 			stream.Sync(axleInA1);
@@ -141,7 +146,8 @@ struct LimitedHingeDesc {
 	float maxFriction = 0.0f;
 	MotorDesc motorDesc;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		if (stream.GetVersion().Stream() <= 16) {
 			stream.Sync(pivotA);
 			stream.Sync(axleA);
@@ -188,7 +194,8 @@ struct RagdollDesc {
 	float maxFriction = 0.0f;
 	MotorDesc motorDesc;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		if (stream.GetVersion().Stream() <= 16) {
 			stream.Sync(pivotA);
 			stream.Sync(planeA);
@@ -245,7 +252,8 @@ struct PrismaticDesc {
 	float friction = 0.0f;
 	MotorDesc motorDesc;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		if (stream.GetVersion().File() <= NiFileVersion::V20_0_0_5) {
 			stream.Sync(pivotA);
 			stream.Sync(rotationA);
@@ -298,7 +306,8 @@ public:
 	HavokMaterial material = 0;
 	uint16_t weldingInfo = 0;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(triangle1);
 		stream.Sync(triangle2);
 		stream.Sync(triangle3);
@@ -324,7 +333,8 @@ public:
 	NiVector<uint16_t> strips;
 	NiVector<uint16_t> weldingInfo;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(translation);
 		stream.Sync(matIndex);
 		stream.Sync(reference);
@@ -335,6 +345,10 @@ public:
 		strips.Sync(stream);
 		weldingInfo.Sync(stream);
 	}
+
+	size_t GetHeapSize() const {
+		return HeapSize(verts) + HeapSize(indices) + HeapSize(strips) + HeapSize(weldingInfo);
+	}
 };
 
 class NiAVObject;
@@ -346,8 +360,9 @@ public:
 	static constexpr const char* BlockName = "NiCollisionObject";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 enum PropagationMode : uint32_t {
@@ -417,19 +432,24 @@ public:
 		
 	BoundingVolume& operator=(const BoundingVolume& other);
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const;
 };
 
 struct UnionBV {
 	uint32_t numBV = 0;
 	std::vector<BoundingVolume> boundingVolumes;
 
-	void Sync(NiStreamReversible& stream) {
+	template<typename Stream>
+	void Sync(Stream& stream) {
 		stream.Sync(numBV);
 		boundingVolumes.resize(numBV);
 		for (uint32_t i = 0; i < numBV; i++)
 			boundingVolumes[i].Sync(stream);
 	}
+
+	size_t GetHeapSize() const { return HeapSize(boundingVolumes); }
 };
 
 STREAMABLECLASSDEF(NiCollisionData, NiCollisionObject) {
@@ -442,7 +462,9 @@ public:
 	static constexpr const char* BlockName = "NiCollisionData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkNiCollisionObject, NiCollisionObject) {
@@ -453,9 +475,9 @@ public:
 	static constexpr const char* BlockName = "bhkNiCollisionObject";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 CLONEABLECLASSDEF(bhkCollisionObject, bhkNiCollisionObject) {
@@ -471,7 +493,8 @@ public:
 	static constexpr const char* BlockName = "bhkNPCollisionObject";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(bhkPCollisionObject, bhkNiCollisionObject) {
@@ -494,7 +517,8 @@ public:
 	static constexpr const char* BlockName = "bhkBlendCollisionObject";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(bhkPhysicsSystem, BSExtraData) {
@@ -506,7 +530,9 @@ public:
 	static constexpr const char* BlockName = "bhkPhysicsSystem";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkRagdollSystem, BSExtraData) {
@@ -518,7 +544,9 @@ public:
 	static constexpr const char* BlockName = "bhkRagdollSystem";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkBlendController, NiTimeController) {
@@ -528,7 +556,8 @@ public:
 	static constexpr const char* BlockName = "bhkBlendController";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(bhkRefObject, NiObject) {};
@@ -546,7 +575,8 @@ protected:
 	HavokMaterial material = 0;
 
 public:
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 
 	HavokMaterial GetMaterial() const override { return material; }
 	void SetMaterial(HavokMaterial mat) override { material = mat; }
@@ -563,7 +593,8 @@ public:
 	static constexpr const char* BlockName = "bhkPlaneShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(bhkSphereRepShape, bhkShape) {
@@ -571,7 +602,8 @@ protected:
 	HavokMaterial material = 0;
 
 public:
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 
 	HavokMaterial GetMaterial() const override { return material; }
 	void SetMaterial(HavokMaterial mat) override { material = mat; }
@@ -581,7 +613,8 @@ STREAMABLECLASSDEF(bhkConvexShape, bhkSphereRepShape) {
 public:
 	float radius = 0.0f;
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(bhkMultiSphereShape, bhkSphereRepShape) {
@@ -592,7 +625,9 @@ public:
 	static constexpr const char* BlockName = "bhkMultiSphereShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkConvexListShape, bhkShape) {
@@ -609,9 +644,10 @@ public:
 	static constexpr const char* BlockName = "bhkConvexListShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkConvexVerticesShape, bhkConvexShape) {
@@ -625,7 +661,9 @@ public:
 	static constexpr const char* BlockName = "bhkConvexVerticesShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkBoxShape, bhkConvexShape) {
@@ -639,7 +677,8 @@ public:
 	static constexpr const char* BlockName = "bhkBoxShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(bhkSphereShape, bhkConvexShape) {
@@ -661,9 +700,9 @@ public:
 	static constexpr const char* BlockName = "bhkTransformShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 CLONEABLECLASSDEF(bhkConvexTransformShape, bhkTransformShape) {
@@ -685,7 +724,8 @@ public:
 	static constexpr const char* BlockName = "bhkCapsuleShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(bhkBvTreeShape, bhkShape) {};
@@ -704,9 +744,10 @@ public:
 	static constexpr const char* BlockName = "bhkMoppBvTreeShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 class NiTriStripsData;
@@ -731,9 +772,10 @@ public:
 	static constexpr const char* BlockName = "bhkNiTriStripsShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 
 	HavokMaterial GetMaterial() const override { return material; }
 	void SetMaterial(HavokMaterial mat) override { material = mat; }
@@ -754,9 +796,10 @@ public:
 	static constexpr const char* BlockName = "bhkListShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 
 	HavokMaterial GetMaterial() const override { return material; }
 	void SetMaterial(HavokMaterial mat) override { material = mat; }
@@ -794,7 +837,9 @@ public:
 	static constexpr const char* BlockName = "hkPackedNiTriStripsData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkPackedNiTriStripsShape, bhkShapeCollection) {
@@ -815,9 +860,10 @@ public:
 	static constexpr const char* BlockName = "bhkPackedNiTriStripsShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkLiquidAction, bhkSerializable) {
@@ -833,7 +879,8 @@ public:
 	static constexpr const char* BlockName = "bhkLiquidAction";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(bhkOrientHingedBodyAction, bhkSerializable) {
@@ -853,8 +900,9 @@ public:
 	static constexpr const char* BlockName = "bhkOrientHingedBodyAction";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 STREAMABLECLASSDEF(bhkWorldObject, bhkSerializable) {
@@ -866,9 +914,9 @@ public:
 	std::array<uint8_t, 3> unkBytes{};
 	hkWorldObjCInfoProperty prop;
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
 };
 
 CLONEABLECLASSDEF(bhkPhantom, bhkWorldObject) {};
@@ -885,7 +933,8 @@ public:
 	static constexpr const char* BlockName = "bhkSimpleShapePhantom";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(bhkAabbPhantom, bhkShapePhantom) {
@@ -899,7 +948,8 @@ public:
 	static constexpr const char* BlockName = "bhkAabbPhantom";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 CLONEABLECLASSDEF(bhkEntity, bhkWorldObject) {};
@@ -953,9 +1003,10 @@ public:
 	static constexpr const char* BlockName = "bhkRigidBody";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 CLONEABLECLASSDEF(bhkRigidBodyT, bhkRigidBody) {
@@ -969,8 +1020,10 @@ public:
 	NiBlockPtrArray<bhkEntity> entityRefs;
 	uint32_t priority = 0;
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkHingeConstraint, bhkConstraint) {
@@ -980,7 +1033,8 @@ public:
 	static constexpr const char* BlockName = "bhkHingeConstraint";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(bhkLimitedHingeConstraint, bhkConstraint) {
@@ -990,7 +1044,8 @@ public:
 	static constexpr const char* BlockName = "bhkLimitedHingeConstraint";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 class ConstraintData {
@@ -1010,8 +1065,10 @@ public:
 	float damping = 0.0f;
 	float strength = 0.0f;
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const { return HeapSize(entityRefs); }
+	void ForEachPtr(const NiRefVisitor& visitor);
 };
 
 STREAMABLECLASSDEF(bhkBreakableConstraint, bhkConstraint) {
@@ -1022,8 +1079,10 @@ public:
 	static constexpr const char* BlockName = "bhkBreakableConstraint";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkRagdollConstraint, bhkConstraint) {
@@ -1033,7 +1092,8 @@ public:
 	static constexpr const char* BlockName = "bhkRagdollConstraint";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(bhkStiffSpringConstraint, bhkConstraint) {
@@ -1043,7 +1103,8 @@ public:
 	static constexpr const char* BlockName = "bhkStiffSpringConstraint";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(bhkPrismaticConstraint, bhkConstraint) {
@@ -1053,7 +1114,8 @@ public:
 	static constexpr const char* BlockName = "bhkPrismaticConstraint";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(bhkMalleableConstraint, bhkConstraint) {
@@ -1063,7 +1125,9 @@ public:
 	static constexpr const char* BlockName = "bhkMalleableConstraint";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkBallAndSocketConstraint, bhkConstraint) {
@@ -1073,7 +1137,8 @@ public:
 	static constexpr const char* BlockName = "bhkBallAndSocketConstraint";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
 };
 
 STREAMABLECLASSDEF(bhkBallSocketConstraintChain, bhkSerializable) {
@@ -1095,8 +1160,10 @@ public:
 	static constexpr const char* BlockName = "bhkBallSocketConstraintChain";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachPtr(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkCompressedMeshShapeData, bhkRefObject) {
@@ -1130,7 +1197,9 @@ public:
 	static constexpr const char* BlockName = "bhkCompressedMeshShapeData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
+	template<typename Stream>
+	void Sync(Stream& stream);
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkCompressedMeshShape, bhkShape) {
@@ -1147,10 +1216,10 @@ public:
 	static constexpr const char* BlockName = "bhkCompressedMeshShape";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
-	void GetPtrs(std::set<NiPtr*>& ptrs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	void ForEachPtr(const NiRefVisitor& visitor) override;
 };
 
 struct BoneMatrix {
@@ -1163,7 +1232,9 @@ class BonePose {
 public:
 	NiVector<BoneMatrix> matrices;
 
-	void Sync(NiStreamReversible& stream) { matrices.Sync(stream); }
+	template<typename Stream>
+	void Sync(Stream& stream) { matrices.Sync(stream); }
+	size_t GetHeapSize() const { return HeapSize(matrices); }
 };
 
 STREAMABLECLASSDEF(bhkPoseArray, NiObject) {
@@ -1174,8 +1245,10 @@ public:
 	static constexpr const char* BlockName = "bhkPoseArray";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkRagdollTemplate, NiExtraData) {
@@ -1185,9 +1258,10 @@ public:
 	static constexpr const char* BlockName = "bhkRagdollTemplate";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetChildRefs(std::set<NiRef*>& refs) override;
-	void GetChildIndices(std::vector<uint32_t>& indices) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachChildRef(const NiRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 
 STREAMABLECLASSDEF(bhkRagdollTemplateData, NiObject) {
@@ -1203,7 +1277,9 @@ public:
 	static constexpr const char* BlockName = "bhkRagdollTemplateData";
 	const char* GetBlockName() override { return BlockName; }
 
-	void Sync(NiStreamReversible& stream);
-	void GetStringRefs(std::vector<NiStringRef*>& refs) override;
+	template<typename Stream>
+	void Sync(Stream& stream);
+	void ForEachStringRef(const NiStringRefVisitor& visitor) override;
+	size_t GetHeapSize() const override;
 };
 } // namespace nifly
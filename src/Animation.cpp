@@ -5,10 +5,12 @@ See the included GPLv3 LICENSE file
 */
 
 #include "Animation.hpp"
+#include "NifUtil.hpp"
 
 using namespace nifly;
 
-void NiKeyframeData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiKeyframeData::Sync(Stream& stream) {
 	uint32_t numRotationKeys = 0;
 
 	if (stream.GetMode() == NiStreamReversible::Mode::Writing) {
@@ -44,35 +46,74 @@ void NiKeyframeData::Sync(NiStreamReversible& stream) {
 	translations.Sync(stream);
 	scales.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiKeyframeData)
+
+size_t NiKeyframeData::GetHeapSize() const {
+	size_t size = NiObject::GetHeapSize();
+	size += HeapSize(quaternionKeys);
+	size += HeapSize(xRotations);
+	size += HeapSize(yRotations);
+	size += HeapSize(zRotations);
+	size += HeapSize(translations);
+	size += HeapSize(scales);
+	return size;
+}
 
 
-void NiPosData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPosData::Sync(Stream& stream) {
 	data.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPosData)
+
+size_t NiPosData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(data);
+}
 
 
-void NiBoolData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBoolData::Sync(Stream& stream) {
 	data.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiBoolData)
+
+size_t NiBoolData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(data);
+}
 
 
-void NiFloatData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiFloatData::Sync(Stream& stream) {
 	data.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiFloatData)
+
+size_t NiFloatData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(data);
+}
 
 
-void NiBSplineData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBSplineData::Sync(Stream& stream) {
 	floatControlPoints.Sync(stream);
 	shortControlPoints.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiBSplineData)
 
+size_t NiBSplineData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(floatControlPoints) + HeapSize(shortControlPoints);
+}
 
-void NiBSplineBasisData::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void NiBSplineBasisData::Sync(Stream& stream) {
 	stream.Sync(numControlPoints);
 }
+NIFLY_SYNC_INSTANTIATE(NiBSplineBasisData)
 
 
-void NiTimeController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiTimeController::Sync(Stream& stream) {
 	nextControllerRef.Sync(stream);
 	stream.Sync(flags);
 	stream.Sync(frequency);
@@ -81,39 +122,37 @@ void NiTimeController::Sync(NiStreamReversible& stream) {
 	stream.Sync(stopTime);
 	targetRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiTimeController)
 
-void NiTimeController::GetChildRefs(std::set<NiRef*>& refs) {
-	NiObject::GetChildRefs(refs);
+void NiTimeController::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiObject::ForEachChildRef(visitor);
 
-	refs.insert(&nextControllerRef);
+	visitor(nextControllerRef);
 }
 
-void NiTimeController::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiObject::GetChildIndices(indices);
+void NiTimeController::ForEachPtr(const NiRefVisitor& visitor) {
+	NiObject::ForEachPtr(visitor);
 
-	indices.push_back(nextControllerRef.index);
+	visitor(targetRef);
 }
 
-void NiTimeController::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiObject::GetPtrs(ptrs);
 
-	ptrs.insert(&targetRef);
-}
-
-
-void NiLookAtController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiLookAtController::Sync(Stream& stream) {
 	stream.Sync(lookAtFlags);
 	lookAtNodePtr.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiLookAtController)
 
-void NiLookAtController::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiTimeController::GetPtrs(ptrs);
+void NiLookAtController::ForEachPtr(const NiRefVisitor& visitor) {
+	NiTimeController::ForEachPtr(visitor);
 
-	ptrs.insert(&lookAtNodePtr);
+	visitor(lookAtNodePtr);
 }
 
 
-void NiPathController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPathController::Sync(Stream& stream) {
 	stream.Sync(pathFlags);
 	stream.Sync(bankDir);
 	stream.Sync(maxBankAngle);
@@ -122,73 +161,73 @@ void NiPathController::Sync(NiStreamReversible& stream) {
 	pathDataRef.Sync(stream);
 	percentDataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPathController)
 
-void NiPathController::GetChildRefs(std::set<NiRef*>& refs) {
-	NiTimeController::GetChildRefs(refs);
-
-	refs.insert(&pathDataRef);
-	refs.insert(&percentDataRef);
-}
-
-void NiPathController::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiTimeController::GetChildIndices(indices);
+void NiPathController::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiTimeController::ForEachChildRef(visitor);
 
-	indices.push_back(pathDataRef.index);
-	indices.push_back(percentDataRef.index);
+	visitor(pathDataRef);
+	visitor(percentDataRef);
 }
 
 
-void NiUVData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiUVData::Sync(Stream& stream) {
 	uTrans.Sync(stream);
 	vTrans.Sync(stream);
 	uScale.Sync(stream);
 	vScale.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiUVData)
 
-
-void NiUVController::Sync(NiStreamReversible& stream) {
-	stream.Sync(textureSet);
-	dataRef.Sync(stream);
+size_t NiUVData::GetHeapSize() const {
+	size_t size = NiObject::GetHeapSize();
+	size += HeapSize(uTrans);
+	size += HeapSize(vTrans);
+	size += HeapSize(uScale);
+	size += HeapSize(vScale);
+	return size;
 }
 
-void NiUVController::GetChildRefs(std::set<NiRef*>& refs) {
-	NiTimeController::GetChildRefs(refs);
 
-	refs.insert(&dataRef);
+template<typename Stream>
+void NiUVController::Sync(Stream& stream) {
+	stream.Sync(textureSet);
+	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiUVController)
 
-void NiUVController::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiTimeController::GetChildIndices(indices);
+void NiUVController::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiTimeController::ForEachChildRef(visitor);
 
-	indices.push_back(dataRef.index);
+	visitor(dataRef);
 }
 
 
-void BSFrustumFOVController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSFrustumFOVController::Sync(Stream& stream) {
 	interpolatorRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSFrustumFOVController)
 
-void BSFrustumFOVController::GetChildRefs(std::set<NiRef*>& refs) {
-	NiTimeController::GetChildRefs(refs);
+void BSFrustumFOVController::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiTimeController::ForEachChildRef(visitor);
 
-	refs.insert(&interpolatorRef);
+	visitor(interpolatorRef);
 }
 
-void BSFrustumFOVController::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiTimeController::GetChildIndices(indices);
 
-	indices.push_back(interpolatorRef.index);
-}
-
-
-void BSLagBoneController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSLagBoneController::Sync(Stream& stream) {
 	stream.Sync(linearVelocity);
 	stream.Sync(linearRotation);
 	stream.Sync(maxDistance);
 }
+NIFLY_SYNC_INSTANTIATE(BSLagBoneController)
 
 
-void BSProceduralLightningController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSProceduralLightningController::Sync(Stream& stream) {
 	generationInterpRef.Sync(stream);
 	mutationInterpRef.Sync(stream);
 	subdivisionInterpRef.Sync(stream);
@@ -215,54 +254,47 @@ void BSProceduralLightningController::Sync(NiStreamReversible& stream) {
 
 	shaderPropertyRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSProceduralLightningController)
 
-void BSProceduralLightningController::GetChildRefs(std::set<NiRef*>& refs) {
-	NiTimeController::GetChildRefs(refs);
-
-	refs.insert(&generationInterpRef);
-	refs.insert(&mutationInterpRef);
-	refs.insert(&subdivisionInterpRef);
-	refs.insert(&numBranchesInterpRef);
-	refs.insert(&numBranchesVarInterpRef);
-	refs.insert(&lengthInterpRef);
-	refs.insert(&lengthVarInterpRef);
-	refs.insert(&widthInterpRef);
-	refs.insert(&arcOffsetInterpRef);
-	refs.insert(&shaderPropertyRef);
-}
-
-void BSProceduralLightningController::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiTimeController::GetChildIndices(indices);
+void BSProceduralLightningController::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiTimeController::ForEachChildRef(visitor);
 
-	indices.push_back(generationInterpRef.index);
-	indices.push_back(mutationInterpRef.index);
-	indices.push_back(subdivisionInterpRef.index);
-	indices.push_back(numBranchesInterpRef.index);
-	indices.push_back(numBranchesVarInterpRef.index);
-	indices.push_back(lengthInterpRef.index);
-	indices.push_back(lengthVarInterpRef.index);
-	indices.push_back(widthInterpRef.index);
-	indices.push_back(arcOffsetInterpRef.index);
-	indices.push_back(shaderPropertyRef.index);
+	visitor(generationInterpRef);
+	visitor(mutationInterpRef);
+	visitor(subdivisionInterpRef);
+	visitor(numBranchesInterpRef);
+	visitor(numBranchesVarInterpRef);
+	visitor(lengthInterpRef);
+	visitor(lengthVarInterpRef);
+	visitor(widthInterpRef);
+	visitor(arcOffsetInterpRef);
+	visitor(shaderPropertyRef);
 }
 
 
-void NiBoneLODController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBoneLODController::Sync(Stream& stream) {
 	stream.Sync(lod);
 	stream.Sync(numLODs);
 
 	boneArrays.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiBoneLODController)
 
-void NiBoneLODController::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiTimeController::GetPtrs(ptrs);
+void NiBoneLODController::ForEachPtr(const NiRefVisitor& visitor) {
+	NiTimeController::ForEachPtr(visitor);
 
 	for (auto& bp : boneArrays)
-		bp.GetIndexPtrs(ptrs);
+		bp.ForEachRef(visitor);
+}
+
+size_t NiBoneLODController::GetHeapSize() const {
+	return NiTimeController::GetHeapSize() + HeapSize(boneArrays);
 }
 
 
-void NiMorphData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiMorphData::Sync(Stream& stream) {
 	stream.Sync(numMorphs);
 	stream.Sync(numVertices);
 	stream.Sync(relativeTargets);
@@ -271,12 +303,17 @@ void NiMorphData::Sync(NiStreamReversible& stream) {
 	for (uint32_t i = 0; i < numMorphs; i++)
 		morphs[i].Sync(stream, numVertices);
 }
+NIFLY_SYNC_INSTANTIATE(NiMorphData)
 
-void NiMorphData::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiObject::GetStringRefs(refs);
+void NiMorphData::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiObject::ForEachStringRef(visitor);
 
 	for (auto& m : morphs)
-		m.GetStringRefs(refs);
+		m.ForEachStringRef(visitor);
+}
+
+size_t NiMorphData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(morphs);
 }
 
 std::vector<Morph> NiMorphData::GetMorphs() const {
@@ -292,234 +329,269 @@ void NiMorphData::SetMorphs(const uint32_t numVerts, const std::vector<Morph>& m
 		morph.vectors.resize(numVertices);
 }
 
+void NiMorphData::notifyVerticesReorder(const std::vector<uint16_t>& vertMap) {
+	if (vertMap.size() != numVertices)
+		return;
 
-void NiGeomMorpherController::Sync(NiStreamReversible& stream) {
+	for (auto& morph : morphs)
+		ApplyIndexPermutation(morph.vectors, vertMap);
+}
+
+
+template<typename Stream>
+void NiGeomMorpherController::Sync(Stream& stream) {
 	stream.Sync(morpherFlags);
 	dataRef.Sync(stream);
 	stream.Sync(alwaysUpdate);
 	interpWeights.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiGeomMorpherController)
 
-void NiGeomMorpherController::GetChildRefs(std::set<NiRef*>& refs) {
-	NiInterpController::GetChildRefs(refs);
+void NiGeomMorpherController::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiInterpController::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
+	visitor(dataRef);
 
 	for (auto& m : interpWeights)
-		m.GetChildRefs(refs);
+		m.ForEachChildRef(visitor);
 }
 
-void NiGeomMorpherController::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiInterpController::GetChildIndices(indices);
-
-	indices.push_back(dataRef.index);
-
-	for (auto& m : interpWeights)
-		m.GetChildIndices(indices);
+size_t NiGeomMorpherController::GetHeapSize() const {
+	return NiInterpController::GetHeapSize() + HeapSize(interpWeights);
 }
 
 
-void NiSingleInterpController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiSingleInterpController::Sync(Stream& stream) {
 	if (stream.GetVersion().File() >= V10_1_0_104)
 		interpolatorRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiSingleInterpController)
 
-void NiSingleInterpController::GetChildRefs(std::set<NiRef*>& refs) {
-	NiInterpController::GetChildRefs(refs);
-
-	refs.insert(&interpolatorRef);
-}
-
-void NiSingleInterpController::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiInterpController::GetChildIndices(indices);
+void NiSingleInterpController::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiInterpController::ForEachChildRef(visitor);
 
-	indices.push_back(interpolatorRef.index);
+	visitor(interpolatorRef);
 }
 
 
-void NiRollController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiRollController::Sync(Stream& stream) {
 	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiRollController)
 
-void NiRollController::GetChildRefs(std::set<NiRef*>& refs) {
-	NiSingleInterpController::GetChildRefs(refs);
+void NiRollController::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiSingleInterpController::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
+	visitor(dataRef);
 }
 
-void NiRollController::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiSingleInterpController::GetChildIndices(indices);
 
-	indices.push_back(dataRef.index);
-}
-
-
-void NiPoint3InterpController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPoint3InterpController::Sync(Stream& stream) {
 	stream.Sync(targetColor);
 }
+NIFLY_SYNC_INSTANTIATE(NiPoint3InterpController)
 
 
-void NiFloatExtraDataController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiFloatExtraDataController::Sync(Stream& stream) {
 	extraData.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiFloatExtraDataController)
 
-void NiFloatExtraDataController::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiExtraDataController::GetStringRefs(refs);
+void NiFloatExtraDataController::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiExtraDataController::ForEachStringRef(visitor);
 
-	refs.emplace_back(&extraData);
+	visitor(extraData);
+}
+
+size_t NiFloatExtraDataController::GetHeapSize() const {
+	return NiExtraDataController::GetHeapSize() + HeapSize(extraData);
 }
 
 
-void NiVisData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiVisData::Sync(Stream& stream) {
 	keys.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiVisData)
 
+size_t NiVisData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(keys);
+}
 
-void NiFlipController::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void NiFlipController::Sync(Stream& stream) {
 	stream.Sync(textureSlot);
 	sourceRefs.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiFlipController)
 
-void NiFlipController::GetChildRefs(std::set<NiRef*>& refs) {
-	NiFloatInterpController::GetChildRefs(refs);
+void NiFlipController::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiFloatInterpController::ForEachChildRef(visitor);
 
-	sourceRefs.GetIndexPtrs(refs);
+	sourceRefs.ForEachRef(visitor);
 }
 
-void NiFlipController::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiFloatInterpController::GetChildIndices(indices);
-
-	sourceRefs.GetIndices(indices);
+size_t NiFlipController::GetHeapSize() const {
+	return NiFloatInterpController::GetHeapSize() + HeapSize(sourceRefs);
 }
 
 
-void NiTextureTransformController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiTextureTransformController::Sync(Stream& stream) {
 	stream.Sync(shaderMap);
 	stream.Sync(textureSlot);
 	stream.Sync(operation);
 }
+NIFLY_SYNC_INSTANTIATE(NiTextureTransformController)
 
 
-void BSLightingShaderPropertyColorController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSLightingShaderPropertyColorController::Sync(Stream& stream) {
 	stream.Sync(typeOfControlledColor);
 }
+NIFLY_SYNC_INSTANTIATE(BSLightingShaderPropertyColorController)
 
 
-void BSLightingShaderPropertyFloatController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSLightingShaderPropertyFloatController::Sync(Stream& stream) {
 	stream.Sync(typeOfControlledVariable);
 }
+NIFLY_SYNC_INSTANTIATE(BSLightingShaderPropertyFloatController)
 
 
-void BSLightingShaderPropertyUShortController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSLightingShaderPropertyUShortController::Sync(Stream& stream) {
 	stream.Sync(typeOfControlledVariable);
 }
+NIFLY_SYNC_INSTANTIATE(BSLightingShaderPropertyUShortController)
 
 
-void BSEffectShaderPropertyColorController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSEffectShaderPropertyColorController::Sync(Stream& stream) {
 	stream.Sync(typeOfControlledColor);
 }
+NIFLY_SYNC_INSTANTIATE(BSEffectShaderPropertyColorController)
 
 
-void BSEffectShaderPropertyFloatController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSEffectShaderPropertyFloatController::Sync(Stream& stream) {
 	stream.Sync(typeOfControlledVariable);
 }
+NIFLY_SYNC_INSTANTIATE(BSEffectShaderPropertyFloatController)
 
 
-void NiMultiTargetTransformController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiMultiTargetTransformController::Sync(Stream& stream) {
 	targetRefs.SetKeepEmptyRefs();
 	targetRefs.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiMultiTargetTransformController)
 
-void NiMultiTargetTransformController::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiInterpController::GetPtrs(ptrs);
+void NiMultiTargetTransformController::ForEachPtr(const NiRefVisitor& visitor) {
+	NiInterpController::ForEachPtr(visitor);
 
-	targetRefs.GetIndexPtrs(ptrs);
+	targetRefs.ForEachRef(visitor);
 }
 
+size_t NiMultiTargetTransformController::GetHeapSize() const {
+	return NiInterpController::GetHeapSize() + HeapSize(targetRefs);
+}
 
-void NiPSysModifierCtlr::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void NiPSysModifierCtlr::Sync(Stream& stream) {
 	modifierName.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysModifierCtlr)
 
-void NiPSysModifierCtlr::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiSingleInterpController::GetStringRefs(refs);
+void NiPSysModifierCtlr::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiSingleInterpController::ForEachStringRef(visitor);
 
-	refs.emplace_back(&modifierName);
+	visitor(modifierName);
 }
 
-
-void NiPSysEmitterCtlr::Sync(NiStreamReversible& stream) {
-	visInterpolatorRef.Sync(stream);
+size_t NiPSysModifierCtlr::GetHeapSize() const {
+	return NiSingleInterpController::GetHeapSize() + HeapSize(modifierName);
 }
 
-void NiPSysEmitterCtlr::GetChildRefs(std::set<NiRef*>& refs) {
-	NiPSysModifierCtlr::GetChildRefs(refs);
 
-	refs.insert(&visInterpolatorRef);
+template<typename Stream>
+void NiPSysEmitterCtlr::Sync(Stream& stream) {
+	visInterpolatorRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysEmitterCtlr)
 
-void NiPSysEmitterCtlr::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiPSysModifierCtlr::GetChildIndices(indices);
+void NiPSysEmitterCtlr::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiPSysModifierCtlr::ForEachChildRef(visitor);
 
-	indices.push_back(visInterpolatorRef.index);
+	visitor(visInterpolatorRef);
 }
 
 
-void BSPSysMultiTargetEmitterCtlr::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPSysMultiTargetEmitterCtlr::Sync(Stream& stream) {
 	stream.Sync(maxEmitters);
 	masterParticleSystemRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSPSysMultiTargetEmitterCtlr)
 
-void BSPSysMultiTargetEmitterCtlr::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiPSysEmitterCtlr::GetPtrs(ptrs);
+void BSPSysMultiTargetEmitterCtlr::ForEachPtr(const NiRefVisitor& visitor) {
+	NiPSysEmitterCtlr::ForEachPtr(visitor);
 
-	ptrs.insert(&masterParticleSystemRef);
+	visitor(masterParticleSystemRef);
 }
 
 
-void NiBSplineInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBSplineInterpolator::Sync(Stream& stream) {
 	stream.Sync(startTime);
 	stream.Sync(stopTime);
 	splineDataRef.Sync(stream);
 	basisDataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiBSplineInterpolator)
 
-void NiBSplineInterpolator::GetChildRefs(std::set<NiRef*>& refs) {
-	NiInterpolator::GetChildRefs(refs);
-
-	refs.insert(&splineDataRef);
-	refs.insert(&basisDataRef);
-}
-
-void NiBSplineInterpolator::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiInterpolator::GetChildIndices(indices);
+void NiBSplineInterpolator::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiInterpolator::ForEachChildRef(visitor);
 
-	indices.push_back(splineDataRef.index);
-	indices.push_back(basisDataRef.index);
+	visitor(splineDataRef);
+	visitor(basisDataRef);
 }
 
 
-void NiBSplineCompFloatInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBSplineCompFloatInterpolator::Sync(Stream& stream) {
 	stream.Sync(radix);
 	stream.Sync(offset);
 	stream.Sync(bias);
 	stream.Sync(multiplier);
 }
+NIFLY_SYNC_INSTANTIATE(NiBSplineCompFloatInterpolator)
 
 
-void NiBSplinePoint3Interpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBSplinePoint3Interpolator::Sync(Stream& stream) {
 	stream.Sync(value);
 	stream.Sync(handle);
 }
+NIFLY_SYNC_INSTANTIATE(NiBSplinePoint3Interpolator)
 
 
-void NiBSplineCompPoint3Interpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBSplineCompPoint3Interpolator::Sync(Stream& stream) {
 	stream.Sync(positionOffset);
 	stream.Sync(positionHalfRange);
 }
+NIFLY_SYNC_INSTANTIATE(NiBSplineCompPoint3Interpolator)
 
 
-void NiBSplineTransformInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBSplineTransformInterpolator::Sync(Stream& stream) {
 	stream.Sync(translation);
 	stream.Sync(rotation);
 	stream.Sync(scale);
@@ -528,9 +600,11 @@ void NiBSplineTransformInterpolator::Sync(NiStreamReversible& stream) {
 	stream.Sync(rotationOffset);
 	stream.Sync(scaleOffset);
 }
+NIFLY_SYNC_INSTANTIATE(NiBSplineTransformInterpolator)
 
 
-void NiBSplineCompTransformInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBSplineCompTransformInterpolator::Sync(Stream& stream) {
 	stream.Sync(translationBias);
 	stream.Sync(translationMultiplier);
 	stream.Sync(rotationBias);
@@ -538,18 +612,22 @@ void NiBSplineCompTransformInterpolator::Sync(NiStreamReversible& stream) {
 	stream.Sync(scaleBias);
 	stream.Sync(scaleMultiplier);
 }
+NIFLY_SYNC_INSTANTIATE(NiBSplineCompTransformInterpolator)
 
 
-void InterpBlendItem::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void InterpBlendItem::Sync(Stream& stream) {
 	interpolatorRef.Sync(stream);
 	stream.Sync(weight);
 	stream.Sync(normalizedWeight);
 	stream.Sync(priority);
 	stream.Sync(easeSpinner);
 }
+NIFLY_SYNC_INSTANTIATE(InterpBlendItem)
 
 
-void NiBlendInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBlendInterpolator::Sync(Stream& stream) {
 	stream.Sync(flags);
 	stream.Sync(arraySize);
 	stream.Sync(weightThreshold);
@@ -569,98 +647,94 @@ void NiBlendInterpolator::Sync(NiStreamReversible& stream) {
 			item.Sync(stream);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(NiBlendInterpolator)
+
+size_t NiBlendInterpolator::GetHeapSize() const {
+	return NiInterpolator::GetHeapSize() + HeapSize(interpItems);
+}
 
 
-void NiBlendBoolInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBlendBoolInterpolator::Sync(Stream& stream) {
 	stream.Sync(value);
 }
+NIFLY_SYNC_INSTANTIATE(NiBlendBoolInterpolator)
 
 
-void NiBlendFloatInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBlendFloatInterpolator::Sync(Stream& stream) {
 	stream.Sync(value);
 }
+NIFLY_SYNC_INSTANTIATE(NiBlendFloatInterpolator)
 
 
-void NiBlendPoint3Interpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBlendPoint3Interpolator::Sync(Stream& stream) {
 	stream.Sync(point);
 }
+NIFLY_SYNC_INSTANTIATE(NiBlendPoint3Interpolator)
 
 
-void NiBoolInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBoolInterpolator::Sync(Stream& stream) {
 	stream.Sync(boolValue);
 	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiBoolInterpolator)
 
-void NiBoolInterpolator::GetChildRefs(std::set<NiRef*>& refs) {
-	NiKeyBasedInterpolator::GetChildRefs(refs);
-
-	refs.insert(&dataRef);
-}
-
-void NiBoolInterpolator::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiKeyBasedInterpolator::GetChildIndices(indices);
+void NiBoolInterpolator::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiKeyBasedInterpolator::ForEachChildRef(visitor);
 
-	indices.push_back(dataRef.index);
+	visitor(dataRef);
 }
 
 
-void NiFloatInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiFloatInterpolator::Sync(Stream& stream) {
 	stream.Sync(floatValue);
 	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiFloatInterpolator)
 
-void NiFloatInterpolator::GetChildRefs(std::set<NiRef*>& refs) {
-	NiKeyBasedInterpolator::GetChildRefs(refs);
+void NiFloatInterpolator::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiKeyBasedInterpolator::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
+	visitor(dataRef);
 }
 
-void NiFloatInterpolator::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiKeyBasedInterpolator::GetChildIndices(indices);
 
-	indices.push_back(dataRef.index);
-}
-
-
-void NiTransformInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiTransformInterpolator::Sync(Stream& stream) {
 	stream.Sync(translation);
 	stream.Sync(rotation);
 	stream.Sync(scale);
 	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiTransformInterpolator)
 
-void NiTransformInterpolator::GetChildRefs(std::set<NiRef*>& refs) {
-	NiKeyBasedInterpolator::GetChildRefs(refs);
-
-	refs.insert(&dataRef);
-}
-
-void NiTransformInterpolator::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiKeyBasedInterpolator::GetChildIndices(indices);
+void NiTransformInterpolator::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiKeyBasedInterpolator::ForEachChildRef(visitor);
 
-	indices.push_back(dataRef.index);
+	visitor(dataRef);
 }
 
 
-void NiPoint3Interpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPoint3Interpolator::Sync(Stream& stream) {
 	stream.Sync(point3Value);
 	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPoint3Interpolator)
 
-void NiPoint3Interpolator::GetChildRefs(std::set<NiRef*>& refs) {
-	NiKeyBasedInterpolator::GetChildRefs(refs);
+void NiPoint3Interpolator::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiKeyBasedInterpolator::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
+	visitor(dataRef);
 }
 
-void NiPoint3Interpolator::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiKeyBasedInterpolator::GetChildIndices(indices);
-
-	indices.push_back(dataRef.index);
-}
 
-
-void NiPathInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPathInterpolator::Sync(Stream& stream) {
 	stream.Sync(pathFlags);
 	stream.Sync(bankDir);
 	stream.Sync(maxBankAngle);
@@ -669,23 +743,18 @@ void NiPathInterpolator::Sync(NiStreamReversible& stream) {
 	pathDataRef.Sync(stream);
 	percentDataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPathInterpolator)
 
-void NiPathInterpolator::GetChildRefs(std::set<NiRef*>& refs) {
-	NiKeyBasedInterpolator::GetChildRefs(refs);
-
-	refs.insert(&pathDataRef);
-	refs.insert(&percentDataRef);
-}
-
-void NiPathInterpolator::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiKeyBasedInterpolator::GetChildIndices(indices);
+void NiPathInterpolator::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiKeyBasedInterpolator::ForEachChildRef(visitor);
 
-	indices.push_back(pathDataRef.index);
-	indices.push_back(percentDataRef.index);
+	visitor(pathDataRef);
+	visitor(percentDataRef);
 }
 
 
-void NiLookAtInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiLookAtInterpolator::Sync(Stream& stream) {
 	stream.Sync(flags);
 	lookAtRef.Sync(stream);
 	lookAtName.Sync(stream);
@@ -694,69 +763,73 @@ void NiLookAtInterpolator::Sync(NiStreamReversible& stream) {
 	rollInterpRef.Sync(stream);
 	scaleInterpRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiLookAtInterpolator)
 
-void NiLookAtInterpolator::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiInterpolator::GetStringRefs(refs);
+void NiLookAtInterpolator::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiInterpolator::ForEachStringRef(visitor);
 
-	refs.emplace_back(&lookAtName);
+	visitor(lookAtName);
 }
 
-void NiLookAtInterpolator::GetChildRefs(std::set<NiRef*>& refs) {
-	NiInterpolator::GetChildRefs(refs);
+void NiLookAtInterpolator::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiInterpolator::ForEachChildRef(visitor);
 
-	refs.insert(&translateInterpRef);
-	refs.insert(&rollInterpRef);
-	refs.insert(&scaleInterpRef);
+	visitor(translateInterpRef);
+	visitor(rollInterpRef);
+	visitor(scaleInterpRef);
 }
 
-void NiLookAtInterpolator::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiInterpolator::GetChildIndices(indices);
+void NiLookAtInterpolator::ForEachPtr(const NiRefVisitor& visitor) {
+	NiInterpolator::ForEachPtr(visitor);
 
-	indices.push_back(translateInterpRef.index);
-	indices.push_back(rollInterpRef.index);
-	indices.push_back(scaleInterpRef.index);
+	visitor(lookAtRef);
 }
 
-void NiLookAtInterpolator::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiInterpolator::GetPtrs(ptrs);
-
-	ptrs.insert(&lookAtRef);
+size_t NiLookAtInterpolator::GetHeapSize() const {
+	return NiInterpolator::GetHeapSize() + HeapSize(lookAtName);
 }
 
 
-void BSTreadTransfInterpolator::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSTreadTransfInterpolator::Sync(Stream& stream) {
 	treadTransforms.Sync(stream);
 	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSTreadTransfInterpolator)
 
-void BSTreadTransfInterpolator::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiInterpolator::GetStringRefs(refs);
+void BSTreadTransfInterpolator::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiInterpolator::ForEachStringRef(visitor);
 
 	for (auto& tt : treadTransforms)
-		tt.GetStringRefs(refs);
+		tt.ForEachStringRef(visitor);
 }
 
-void BSTreadTransfInterpolator::GetChildRefs(std::set<NiRef*>& refs) {
-	NiInterpolator::GetChildRefs(refs);
+void BSTreadTransfInterpolator::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiInterpolator::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
+	visitor(dataRef);
 }
 
-void BSTreadTransfInterpolator::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiInterpolator::GetChildIndices(indices);
-
-	indices.push_back(dataRef.index);
+size_t BSTreadTransfInterpolator::GetHeapSize() const {
+	return NiInterpolator::GetHeapSize() + HeapSize(treadTransforms);
 }
 
 
-void NiStringPalette::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiStringPalette::Sync(Stream& stream) {
 	palette.Sync(stream, 4);
 	length = static_cast<uint32_t>(palette.length());
 	stream.Sync(length);
 }
+NIFLY_SYNC_INSTANTIATE(NiStringPalette)
+
+size_t NiStringPalette::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(palette);
+}
 
 
-void NiSequence::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiSequence::Sync(Stream& stream) {
 	name.Sync(stream);
 
 	uint32_t sz = controlledBlocks.SyncSize(stream);
@@ -764,28 +837,28 @@ void NiSequence::Sync(NiStreamReversible& stream) {
 
 	controlledBlocks.SyncData(stream, sz);
 }
+NIFLY_SYNC_INSTANTIATE(NiSequence)
 
-void NiSequence::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiObject::GetStringRefs(refs);
+void NiSequence::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiObject::ForEachStringRef(visitor);
 
-	refs.emplace_back(&name);
-	controlledBlocks.GetStringRefs(refs);
+	visitor(name);
+	controlledBlocks.ForEachStringRef(visitor);
 }
 
-void NiSequence::GetChildRefs(std::set<NiRef*>& refs) {
-	NiObject::GetChildRefs(refs);
+void NiSequence::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiObject::ForEachChildRef(visitor);
 
-	controlledBlocks.GetChildRefs(refs);
+	controlledBlocks.ForEachChildRef(visitor);
 }
 
-void NiSequence::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiObject::GetChildIndices(indices);
-
-	controlledBlocks.GetChildIndices(indices);
+size_t NiSequence::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(name) + HeapSize(controlledBlocks);
 }
 
 
-void BSAnimNote::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSAnimNote::Sync(Stream& stream) {
 	stream.Sync(type);
 	stream.Sync(time);
 
@@ -797,26 +870,28 @@ void BSAnimNote::Sync(NiStreamReversible& stream) {
 		stream.Sync(state);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(BSAnimNote)
 
 
-void BSAnimNotes::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSAnimNotes::Sync(Stream& stream) {
 	animNoteRefs.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSAnimNotes)
 
-void BSAnimNotes::GetChildRefs(std::set<NiRef*>& refs) {
-	NiObject::GetChildRefs(refs);
+void BSAnimNotes::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiObject::ForEachChildRef(visitor);
 
-	animNoteRefs.GetIndexPtrs(refs);
+	animNoteRefs.ForEachRef(visitor);
 }
 
-void BSAnimNotes::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiObject::GetChildIndices(indices);
-
-	animNoteRefs.GetIndices(indices);
+size_t BSAnimNotes::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(animNoteRefs);
 }
 
 
-void NiControllerSequence::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiControllerSequence::Sync(Stream& stream) {
 	stream.Sync(weight);
 	textKeyRef.Sync(stream);
 	stream.Sync(cycleType);
@@ -831,53 +906,49 @@ void NiControllerSequence::Sync(NiStreamReversible& stream) {
 	else if (stream.GetVersion().Stream() > 28)
 		animNotesRefs.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiControllerSequence)
 
-void NiControllerSequence::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiSequence::GetStringRefs(refs);
+void NiControllerSequence::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiSequence::ForEachStringRef(visitor);
 
-	refs.emplace_back(&accumRootName);
+	visitor(accumRootName);
 }
 
-void NiControllerSequence::GetChildRefs(std::set<NiRef*>& refs) {
-	NiSequence::GetChildRefs(refs);
+void NiControllerSequence::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiSequence::ForEachChildRef(visitor);
 
-	refs.insert(&textKeyRef);
-	refs.insert(&animNotesRef);
-	animNotesRefs.GetIndexPtrs(refs);
+	visitor(textKeyRef);
+	visitor(animNotesRef);
+	animNotesRefs.ForEachRef(visitor);
 }
 
-void NiControllerSequence::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiSequence::GetChildIndices(indices);
+void NiControllerSequence::ForEachPtr(const NiRefVisitor& visitor) {
+	NiSequence::ForEachPtr(visitor);
 
-	indices.push_back(textKeyRef.index);
-	indices.push_back(animNotesRef.index);
-	animNotesRefs.GetIndices(indices);
+	visitor(managerRef);
 }
 
-void NiControllerSequence::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiSequence::GetPtrs(ptrs);
-
-	ptrs.insert(&managerRef);
+size_t NiControllerSequence::GetHeapSize() const {
+	return NiSequence::GetHeapSize() + HeapSize(accumRootName) + HeapSize(animNotesRefs);
 }
 
 
-void NiControllerManager::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiControllerManager::Sync(Stream& stream) {
 	stream.Sync(cumulative);
 
 	controllerSequenceRefs.Sync(stream);
 	objectPaletteRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiControllerManager)
 
-void NiControllerManager::GetChildRefs(std::set<NiRef*>& refs) {
-	NiTimeController::GetChildRefs(refs);
+void NiControllerManager::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiTimeController::ForEachChildRef(visitor);
 
-	controllerSequenceRefs.GetIndexPtrs(refs);
-	refs.insert(&objectPaletteRef);
+	controllerSequenceRefs.ForEachRef(visitor);
+	visitor(objectPaletteRef);
 }
 
-void NiControllerManager::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiTimeController::GetChildIndices(indices);
-
-	controllerSequenceRefs.GetIndices(indices);
-	indices.push_back(objectPaletteRef.index);
+size_t NiControllerManager::GetHeapSize() const {
+	return NiTimeController::GetHeapSize() + HeapSize(controllerSequenceRefs);
 }
@@ -52,6 +52,10 @@ void NiVersion::SetFile(NiFileVersion fileVer) {
 	file = fileVer;
 }
 
+size_t NiVersion::GetHeapSize() const {
+	return HeapSize(vstr);
+}
+
 
 void NiString::Read(NiIStream& stream, const int szSize) {
 	std::array<char, 2048 + 1> buf{};
@@ -159,7 +163,10 @@ void NiHeader::Clear() {
 	numBlockTypes = 0;
 	numStrings = 0;
 	numBlocks = 0;
+	blockListRevision++;
 	blocks = nullptr;
+	unsharedBlocks.clear();
+	hasBlockIds = false;
 	blockTypes.clear();
 	blockTypeIndices.clear();
 	blockSizes.clear();
@@ -209,13 +216,91 @@ void NiHeader::SetExportInfo(const std::string& exportInfo) {
 	}
 }
 
-uint32_t NiHeader::GetBlockID(NiObject* block) const {
-	auto it = find_if(*blocks, [&block](const auto& ptr) { return ptr.get() == block; });
+NiObject* NiHeader::UnshareBlock(const uint32_t blockId) {
+	if (blockId >= numBlocks)
+		return nullptr;
 
-	if (it != blocks->end())
-		return static_cast<uint32_t>(std::distance(blocks->begin(), it));
+	auto& block = (*blocks)[blockId];
+	if (block.use_count() > 1) {
+		const bool blockIdsCurrent = IsBlockIdsCurrent();
+		const NiObject* sharedBlock = block.get();
 
-	return NIF_NPOS;
+		std::shared_ptr<NiObject> copy(block->Clone());
+		unsharedBlocks[sharedBlock] = {block, copy};
+		block = std::move(copy);
+		UpdateBlockId(blockIdsCurrent, sharedBlock, blockId);
+	}
+
+	return block.get();
+}
+
+// Returns true if any reference or pointer of the block is affected by the index change
+template<typename Pred>
+static bool HasAffectedRefs(NiObject* block, Pred isAffected) {
+	bool affected = false;
+	block->ForEachRef([&](NiRef& r) {
+		if (!affected && !r.IsEmpty())
+			affected = isAffected(r.index);
+	});
+	return affected;
+}
+
+void NiHeader::BuildBlockIds() const {
+	blockIds.clear();
+	blockIds.reserve(blocks->size());
+	for (uint32_t i = 0; i < blocks->size(); i++)
+		blockIds.emplace((*blocks)[i].get(), i);
+
+	blockIdsRevision = blockListRevision;
+	hasBlockIds = true;
+}
+
+void NiHeader::UpdateBlockId(const bool wasCurrent, const NiObject* oldBlock, const uint32_t blockId) {
+	if (!wasCurrent) {
+		hasBlockIds = false;
+		return;
+	}
+
+	if (oldBlock)
+		blockIds.erase(oldBlock);
+
+	blockIds[(*blocks)[blockId].get()] = blockId;
+	blockIdsRevision = blockListRevision;
+}
+
+uint32_t NiHeader::GetBlockID(const NiObject* block) const {
+	if (!blocks || !block)
+		return NIF_NPOS;
+
+	if (!IsBlockIdsCurrent())
+		BuildBlockIds();
+
+	auto findBlock = [&](const NiObject* b) {
+		auto it = blockIds.find(b);
+		if (it != blockIds.end() && it->second < blocks->size() && (*blocks)[it->second].get() == b)
+			return it->second;
+
+		return NIF_NPOS;
+	};
+
+	uint32_t blockId = findBlock(block);
+
+	// Copies can be replaced again after they were shared. The shared block is still alive while its entry
+	// isn't expired, so the pointer wasn't reused for another block.
+	for (size_t i = 0; blockId == NIF_NPOS && i < unsharedBlocks.size(); i++) {
+		auto unshared = unsharedBlocks.find(block);
+		if (unshared == unsharedBlocks.end() || unshared->second.first.expired())
+			break;
+
+		auto copy = unshared->second.second.lock();
+		if (!copy)
+			break;
+
+		block = copy.get();
+		blockId = findBlock(block);
+	}
+
+	return blockId;
 }
 
 void NiHeader::DeleteBlock(const uint32_t blockId) {
@@ -243,10 +328,20 @@ void NiHeader::DeleteBlock(const uint32_t blockId) {
 
 	blocks->erase(blocks->begin() + blockId);
 	numBlocks--;
+	blockListRevision++;
 
 	// Next tell all the blocks that the deletion happened
-	for (auto& b : (*blocks))
-		BlockDeleted(b.get(), blockId);
+	for (uint32_t i = 0; i < numBlocks; i++) {
+		// Shared blocks are only copied if their references change
+		if (IsBlockShared(i)) {
+			if (!HasAffectedRefs((*blocks)[i].get(), [&](const uint32_t index) { return index >= blockId; }))
+				continue;
+
+			UnshareBlock(i);
+		}
+
+		BlockDeleted((*blocks)[i].get(), blockId);
+	}
 }
 
 void NiHeader::DeleteBlock(const NiRef& blockRef) {
@@ -273,15 +368,21 @@ void NiHeader::DeleteBlockByType(const std::string& blockTypeStr, const bool orp
 }
 
 uint32_t NiHeader::AddBlock(NiObject* newBlock) {
-	std::unique_ptr<NiObject> ownedBlock(newBlock);
-	uint16_t btID = AddOrFindBlockTypeId(ownedBlock->GetBlockName());
+	return AddBlock(std::shared_ptr<NiObject>(newBlock));
+}
+
+uint32_t NiHeader::AddBlock(std::shared_ptr<NiObject> newBlock) {
+	uint16_t btID = AddOrFindBlockTypeId(newBlock->GetBlockName());
 	blockTypeIndices.push_back(btID);
 
 	if (version.File() >= V20_2_0_5)
 		blockSizes.push_back(0);
 
-	blocks->emplace_back(std::move(ownedBlock));
+	const bool blockIdsCurrent = IsBlockIdsCurrent();
+	blocks->emplace_back(std::move(newBlock));
 	numBlocks++;
+	blockListRevision++;
+	UpdateBlockId(blockIdsCurrent, nullptr, numBlocks - 1);
 	return numBlocks - 1;
 }
 
@@ -310,7 +411,11 @@ uint32_t NiHeader::ReplaceBlock(const uint32_t oldBlockId, NiObject* newBlock) {
 	if (version.File() >= V20_2_0_5)
 		blockSizes[oldBlockId] = 0;
 
+	const bool blockIdsCurrent = IsBlockIdsCurrent();
+	const NiObject* oldBlock = (*blocks)[oldBlockId].get();
 	(*blocks)[oldBlockId].reset(ownedBlock.release());
+	blockListRevision++;
+	UpdateBlockId(blockIdsCurrent, oldBlock, oldBlockId);
 	return oldBlockId;
 }
 
@@ -318,8 +423,16 @@ void NiHeader::SetBlockOrder(std::vector<uint32_t>& newOrder) {
 	if (newOrder.size() != numBlocks)
 		return;
 
+	// Nothing to do if the blocks are already in this order, which is the case for most saves
+	bool isMoved = false;
+	for (uint32_t i = 0; i < numBlocks && !isMoved; i++)
+		isMoved = newOrder[i] != i;
+
+	if (!isMoved)
+		return;
+
 	std::vector<uint16_t> newBlockTypeIndices(blockTypeIndices.size());
-	std::vector<std::unique_ptr<NiObject>> newBlocks(blocks->size());
+	std::vector<std::shared_ptr<NiObject>> newBlocks(blocks->size());
 
 	for (uint32_t i = 0; i < numBlocks; i++) {
 		newBlockTypeIndices[newOrder[i]] = blockTypeIndices[i];
@@ -337,23 +450,111 @@ void NiHeader::SetBlockOrder(std::vector<uint32_t>& newOrder) {
 
 	blockTypeIndices = std::move(newBlockTypeIndices);
 	(*blocks) = std::move(newBlocks);
+	blockListRevision++;
+
+	auto isIndexMoved = [&](const uint32_t index) { return newOrder[index] != index; };
 
-	for (auto& b : (*blocks)) {
-		std::set<NiRef*> refs;
-		b->GetChildRefs(refs);
+	for (uint32_t i = 0; i < numBlocks; i++) {
+		// Shared blocks are only copied if their references change
+		if (IsBlockShared(i)) {
+			if (!HasAffectedRefs((*blocks)[i].get(), isIndexMoved))
+				continue;
 
-		for (auto& r : refs) {
-			if (!r->IsEmpty())
-				r->index = newOrder[r->index];
+			UnshareBlock(i);
 		}
 
-		std::set<NiRef*> ptrs;
-		b->GetPtrs(ptrs);
+		(*blocks)[i]->ForEachRef([&](NiRef& r) {
+			if (!r.IsEmpty())
+				r.index = newOrder[r.index];
+		});
+	}
+}
+
+void NiHeader::RemoveBlocks(const std::vector<bool>& removedBlocks) {
+	if (removedBlocks.size() != numBlocks)
+		return;
+
+	const bool hasBlockSizes = version.File() >= V20_2_0_5;
+
+	// Compact all lists in a single pass
+	std::vector<uint32_t> newIndices(numBlocks, NIF_NPOS);
+	std::vector<uint32_t> removedTypeCounts(blockTypes.size());
+	uint32_t newNumBlocks = 0;
+
+	for (uint32_t i = 0; i < numBlocks; i++) {
+		if (removedBlocks[i]) {
+			if (blockTypeIndices[i] < removedTypeCounts.size())
+				removedTypeCounts[blockTypeIndices[i]]++;
+			continue;
+		}
+
+		if (newNumBlocks != i) {
+			(*blocks)[newNumBlocks] = std::move((*blocks)[i]);
+			blockTypeIndices[newNumBlocks] = blockTypeIndices[i];
+			if (hasBlockSizes)
+				blockSizes[newNumBlocks] = blockSizes[i];
+		}
+
+		newIndices[i] = newNumBlocks++;
+	}
+
+	blocks->resize(newNumBlocks);
+	blockTypeIndices.resize(newNumBlocks);
+	if (hasBlockSizes)
+		blockSizes.resize(newNumBlocks);
+
+	numBlocks = newNumBlocks;
+	blockListRevision++;
+
+	// Remove block types that were only used by the removed blocks
+	std::vector<uint32_t> typeCounts(blockTypes.size());
+	for (uint16_t blockTypeIndex : blockTypeIndices)
+		if (blockTypeIndex < typeCounts.size())
+			typeCounts[blockTypeIndex]++;
+
+	std::vector<uint16_t> newTypeIndices(blockTypes.size());
+	uint16_t newNumBlockTypes = 0;
+	for (uint16_t t = 0; t < blockTypes.size(); t++) {
+		newTypeIndices[t] = newNumBlockTypes;
+		if (typeCounts[t] == 0 && removedTypeCounts[t] > 0)
+			continue;
+
+		if (newNumBlockTypes != t)
+			blockTypes[newNumBlockTypes] = std::move(blockTypes[t]);
 
-		for (auto& p : ptrs) {
-			if (!p->IsEmpty())
-				p->index = newOrder[p->index];
+		newNumBlockTypes++;
+	}
+
+	blockTypes.resize(newNumBlockTypes);
+	numBlockTypes = newNumBlockTypes;
+
+	for (uint16_t& blockTypeIndex : blockTypeIndices)
+		if (blockTypeIndex < newTypeIndices.size())
+			blockTypeIndex = newTypeIndices[blockTypeIndex];
+
+	// Update the references of the remaining blocks
+	auto isMoved = [&](const uint32_t index) {
+		return index < newIndices.size() && newIndices[index] != index;
+	};
+
+	for (uint32_t i = 0; i < numBlocks; i++) {
+		// Shared blocks are only copied if their references change
+		if (IsBlockShared(i)) {
+			if (!HasAffectedRefs((*blocks)[i].get(), isMoved))
+				continue;
+
+			UnshareBlock(i);
 		}
+
+		(*blocks)[i]->ForEachRef([&](NiRef& r) {
+			if (r.IsEmpty() || r.index >= newIndices.size())
+				return;
+
+			if (newIndices[r.index] == NIF_NPOS)
+				r.Clear();
+			else
+				r.index = newIndices[r.index];
+		});
 	}
 }
 
@@ -361,16 +562,20 @@ bool NiHeader::IsBlockReferenced(const uint32_t blockId, bool includePtrs) {
 	if (blockId == NIF_NPOS)
 		return false;
 
+	bool referenced = false;
+	auto checkRef = [&](NiRef& ref) {
+		if (ref.index == blockId)
+			referenced = true;
+	};
+
 	for (auto& block : (*blocks)) {
-		std::set<NiRef*> refs;
-		block->GetChildRefs(refs);
+		block->ForEachChildRef(checkRef);
 
 		if (includePtrs)
-			block->GetPtrs(refs);
+			block->ForEachPtr(checkRef);
 
-		for (auto& ref : refs)
-			if (ref->index == blockId)
-				return true;
+		if (referenced)
+			return true;
 	}
 
 	return false;
@@ -381,17 +586,16 @@ int NiHeader::GetBlockRefCount(const uint32_t blockId, bool includePtrs) {
 		return 0;
 
 	int refCount = 0;
+	auto countRef = [&](NiRef& ref) {
+		if (ref.index == blockId)
+			refCount++;
+	};
 
 	for (auto& block : (*blocks)) {
-		std::set<NiRef*> refs;
-		block->GetChildRefs(refs);
+		block->ForEachChildRef(countRef);
 
 		if (includePtrs)
-			block->GetPtrs(refs);
-
-		for (auto& ref : refs)
-			if (ref->index == blockId)
-				refCount++;
+			block->ForEachPtr(countRef);
 	}
 
 	return refCount;
@@ -510,22 +714,37 @@ void NiHeader::FillStringRefs() {
 	if (version.File() < V20_1_0_1)
 		return;
 
-	for (auto& b : (*blocks)) {
-		std::vector<NiStringRef*> stringRefs;
-		b->GetStringRefs(stringRefs);
+	auto getStringId = [&](const NiStringRef& r) {
+		uint32_t stringId = r.GetIndex();
 
-		for (auto& r : stringRefs) {
-			uint32_t stringId = r->GetIndex();
+		// Check if string index is overflowing
+		if (stringId != NIF_NPOS && stringId >= numStrings)
+			stringId -= numStrings;
 
-			// Check if string index is overflowing
-			if (stringId != NIF_NPOS && stringId >= numStrings) {
-				stringId -= numStrings;
-				r->SetIndex(stringId);
-			}
+		return stringId;
+	};
 
-			std::string str = GetStringById(stringId);
-			r->get() = str;
+	for (uint32_t i = 0; i < numBlocks; i++) {
+		// Shared blocks are only copied if a string changes
+		if (IsBlockShared(i)) {
+			bool changed = false;
+			(*blocks)[i]->ForEachStringRef([&](NiStringRef& r) {
+				const uint32_t stringId = getStringId(r);
+				if (stringId != r.GetIndex() || r.get() != GetStringById(stringId))
+					changed = true;
+			});
+
+			if (!changed)
+				continue;
+
+			UnshareBlock(i);
 		}
+
+		(*blocks)[i]->ForEachStringRef([&](NiStringRef& r) {
+			const uint32_t stringId = getStringId(r);
+			r.SetIndex(stringId);
+			r.get() = GetStringById(stringId);
+		});
 	}
 }
 
@@ -536,33 +755,60 @@ void NiHeader::UpdateHeaderStrings(const bool hasUnknown) {
 	if (version.File() < V20_1_0_1)
 		return;
 
-	for (auto& b : (*blocks)) {
-		std::vector<NiStringRef*> stringRefs;
-		b->GetStringRefs(stringRefs);
-
-		for (auto& r : stringRefs) {
-			bool addEmpty = (r->GetIndex() != NIF_NPOS);
-			int stringId = AddOrFindStringId(r->get(), addEmpty);
-			r->SetIndex(stringId);
+	for (uint32_t i = 0; i < numBlocks; i++) {
+		// Shared blocks are only copied if a string index changes
+		if (IsBlockShared(i)) {
+			bool changed = false;
+			(*blocks)[i]->ForEachStringRef([&](NiStringRef& r) {
+				bool addEmpty = (r.GetIndex() != NIF_NPOS);
+				if (AddOrFindStringId(r.get(), addEmpty) != r.GetIndex())
+					changed = true;
+			});
+
+			if (!changed)
+				continue;
+
+			UnshareBlock(i);
 		}
+
+		(*blocks)[i]->ForEachStringRef([&](NiStringRef& r) {
+			bool addEmpty = (r.GetIndex() != NIF_NPOS);
+			int stringId = AddOrFindStringId(r.get(), addEmpty);
+			r.SetIndex(stringId);
+		});
 	}
 
 	UpdateMaxStringLength();
 }
 
 void NiHeader::BlockDeleted(NiObject* o, const uint32_t blockId) {
-	std::set<NiRef*> refs;
-	o->GetChildRefs(refs);
-	o->GetPtrs(refs);
-
-	for (auto& r : refs) {
-		if (!r->IsEmpty()) {
-			if (r->index == blockId)
-				r->Clear();
-			else if (r->index > blockId)
-				r->index--;
+	o->ForEachRef([&](NiRef& r) {
+		if (!r.IsEmpty()) {
+			if (r.index == blockId)
+				r.Clear();
+			else if (r.index > blockId)
+				r.index--;
 		}
-	}
+	});
+}
+
+size_t NiHeader::GetHeapSize() const {
+	size_t size = NiObject::GetHeapSize();
+	size += version.GetHeapSize();
+	size += HeapSize(creator);
+	size += HeapSize(exportInfo1);
+	size += HeapSize(exportInfo2);
+	size += HeapSize(exportInfo3);
+	size += HeapSize(copyright1);
+	size += HeapSize(copyright2);
+	size += HeapSize(copyright3);
+	size += HeapSize(embedData);
+	size += HeapSize(blockTypes);
+	size += HeapSize(blockTypeIndices);
+	size += HeapSize(blockSizes);
+	size += HeapSize(strings);
+	size += HeapSize(groupSizes);
+	return size;
 }
 
 void NiHeader::Get(NiIStream& stream) {
@@ -788,9 +1034,15 @@ NiUnknown::NiUnknown(const uint32_t size) {
 	blockSize = size;
 }
 
-void NiUnknown::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiUnknown::Sync(Stream& stream) {
 	if (data.empty())
 		return;
 
 	stream.Sync(&data[0], blockSize);
 }
+NIFLY_SYNC_INSTANTIATE(NiUnknown)
+
+size_t NiUnknown::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(data);
+}
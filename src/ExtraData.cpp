@@ -10,71 +10,117 @@ See the included GPLv3 LICENSE file
 
 using namespace nifly;
 
-void NiExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiExtraData::Sync(Stream& stream) {
 	name.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiExtraData)
 
-void NiExtraData::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiObject::GetStringRefs(refs);
+void NiExtraData::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiObject::ForEachStringRef(visitor);
 
-	refs.emplace_back(&name);
+	visitor(name);
+}
+
+size_t NiExtraData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(name);
 }
 
 
-void NiBinaryExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBinaryExtraData::Sync(Stream& stream) {
 	data.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiBinaryExtraData)
 
+size_t NiBinaryExtraData::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(data);
+}
 
-void NiFloatExtraData::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void NiFloatExtraData::Sync(Stream& stream) {
 	stream.Sync(floatData);
 }
+NIFLY_SYNC_INSTANTIATE(NiFloatExtraData)
 
 
-void NiFloatsExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiFloatsExtraData::Sync(Stream& stream) {
 	floatsData.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiFloatsExtraData)
 
+size_t NiFloatsExtraData::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(floatsData);
+}
 
-void NiStringsExtraData::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void NiStringsExtraData::Sync(Stream& stream) {
 	stringsData.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiStringsExtraData)
+
+size_t NiStringsExtraData::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(stringsData);
+}
 
 
-void NiStringExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiStringExtraData::Sync(Stream& stream) {
 	stringData.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiStringExtraData)
+
+void NiStringExtraData::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiExtraData::ForEachStringRef(visitor);
 
-void NiStringExtraData::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiExtraData::GetStringRefs(refs);
+	visitor(stringData);
+}
 
-	refs.emplace_back(&stringData);
+size_t NiStringExtraData::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(stringData);
 }
 
 
-void NiBooleanExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBooleanExtraData::Sync(Stream& stream) {
 	stream.Sync(booleanData);
 }
+NIFLY_SYNC_INSTANTIATE(NiBooleanExtraData)
 
 
-void NiIntegerExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiIntegerExtraData::Sync(Stream& stream) {
 	stream.Sync(integerData);
 }
+NIFLY_SYNC_INSTANTIATE(NiIntegerExtraData)
 
 
-void NiIntegersExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiIntegersExtraData::Sync(Stream& stream) {
 	integersData.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiIntegersExtraData)
+
+size_t NiIntegersExtraData::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(integersData);
+}
 
 
-void NiVectorExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiVectorExtraData::Sync(Stream& stream) {
 	stream.Sync(vectorData);
 }
+NIFLY_SYNC_INSTANTIATE(NiVectorExtraData)
 
 
-void NiColorExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiColorExtraData::Sync(Stream& stream) {
 	stream.Sync(colorData);
 }
+NIFLY_SYNC_INSTANTIATE(NiColorExtraData)
 
 std::vector<NiStringRef*> NiStringExtraData::GetStringRefList() {
 	std::vector<NiStringRef*> refs;
@@ -82,22 +128,41 @@ std::vector<NiStringRef*> NiStringExtraData::GetStringRefList() {
 	return refs;
 }
 
-void BSWArray::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSWArray::Sync(Stream& stream) {
 	data.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSWArray)
+
+size_t BSWArray::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(data);
+}
 
 
-void BSPositionData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPositionData::Sync(Stream& stream) {
 	data.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSPositionData)
+
+size_t BSPositionData::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(data);
+}
 
 
-void BSEyeCenterExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSEyeCenterExtraData::Sync(Stream& stream) {
 	data.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSEyeCenterExtraData)
+
+size_t BSEyeCenterExtraData::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(data);
+}
 
 
-void BSPackedGeomData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPackedGeomData::Sync(Stream& stream) {
 	stream.Sync(numVertices);
 
 	stream.Sync(lodLevels);
@@ -172,6 +237,7 @@ void BSPackedGeomData::Sync(NiStreamReversible& stream) {
 	for (auto& t : triangles)
 		stream.Sync(t);
 }
+NIFLY_SYNC_INSTANTIATE(BSPackedGeomData)
 
 void BSPackedGeomData::SetVertices(const bool enable) {
 	if (enable) {
@@ -261,7 +327,8 @@ void BSPackedGeomData::SetFullPrecision(const bool enable) {
 }
 
 
-void BSPackedCombinedSharedGeomDataExtra::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPackedCombinedSharedGeomDataExtra::Sync(Stream& stream) {
 	vertexDesc.Sync(stream);
 	stream.Sync(numVertices);
 	stream.Sync(numTriangles);
@@ -278,17 +345,25 @@ void BSPackedCombinedSharedGeomDataExtra::Sync(NiStreamReversible& stream) {
 	for (uint32_t i = 0; i < numData; i++)
 		data[i].Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSPackedCombinedSharedGeomDataExtra)
+
+size_t BSPackedCombinedSharedGeomDataExtra::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(objects) + HeapSize(data);
+}
 
 
-void BSInvMarker::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSInvMarker::Sync(Stream& stream) {
 	stream.Sync(rotationX);
 	stream.Sync(rotationY);
 	stream.Sync(rotationZ);
 	stream.Sync(zoom);
 }
+NIFLY_SYNC_INSTANTIATE(BSInvMarker)
 
 
-void FurniturePosition::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void FurniturePosition::Sync(Stream& stream) {
 	stream.Sync(offset);
 
 	if (stream.GetVersion().User() <= 11) {
@@ -303,79 +378,119 @@ void FurniturePosition::Sync(NiStreamReversible& stream) {
 		stream.Sync(entryPoints);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(FurniturePosition)
 
 
-void BSFurnitureMarker::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSFurnitureMarker::Sync(Stream& stream) {
 	positions.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSFurnitureMarker)
 
-void DecalVectorBlock::Sync(NiStreamReversible& stream) {
+size_t BSFurnitureMarker::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(positions);
+}
+
+template<typename Stream>
+void DecalVectorBlock::Sync(Stream& stream) {
 	points.Sync(stream);
 	normals.SyncData(stream, points.size());
 }
+NIFLY_SYNC_INSTANTIATE(DecalVectorBlock)
 
 
-void BSDecalPlacementVectorExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSDecalPlacementVectorExtraData::Sync(Stream& stream) {
 	decalVectorBlocks.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSDecalPlacementVectorExtraData)
 
+size_t BSDecalPlacementVectorExtraData::GetHeapSize() const {
+	return NiFloatExtraData::GetHeapSize() + HeapSize(decalVectorBlocks);
+}
 
-void BSBehaviorGraphExtraData::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void BSBehaviorGraphExtraData::Sync(Stream& stream) {
 	behaviorGraphFile.Sync(stream);
 	stream.Sync(controlsBaseSkel);
 }
+NIFLY_SYNC_INSTANTIATE(BSBehaviorGraphExtraData)
+
+void BSBehaviorGraphExtraData::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiExtraData::ForEachStringRef(visitor);
 
-void BSBehaviorGraphExtraData::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiExtraData::GetStringRefs(refs);
+	visitor(behaviorGraphFile);
+}
 
-	refs.emplace_back(&behaviorGraphFile);
+size_t BSBehaviorGraphExtraData::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(behaviorGraphFile);
 }
 
 
-void BSBound::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSBound::Sync(Stream& stream) {
 	stream.Sync(center);
 	stream.Sync(halfExtents);
 }
+NIFLY_SYNC_INSTANTIATE(BSBound)
 
 
-void BoneLOD::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BoneLOD::Sync(Stream& stream) {
 	stream.Sync(distance);
 	boneName.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BoneLOD)
 
-void BoneLOD::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	refs.emplace_back(&boneName);
+void BoneLOD::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	visitor(boneName);
 }
 
 
-void BSBoneLODExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSBoneLODExtraData::Sync(Stream& stream) {
 	boneLODs.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSBoneLODExtraData)
+
+void BSBoneLODExtraData::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiExtraData::ForEachStringRef(visitor);
 
-void BSBoneLODExtraData::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiExtraData::GetStringRefs(refs);
+	boneLODs.ForEachStringRef(visitor);
+}
 
-	boneLODs.GetStringRefs(refs);
+size_t BSBoneLODExtraData::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(boneLODs);
 }
 
 
-void NiTextKeyExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiTextKeyExtraData::Sync(Stream& stream) {
 	textKeys.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiTextKeyExtraData)
+
+void NiTextKeyExtraData::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiExtraData::ForEachStringRef(visitor);
 
-void NiTextKeyExtraData::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiExtraData::GetStringRefs(refs);
+	textKeys.ForEachStringRef(visitor);
+}
 
-	textKeys.GetStringRefs(refs);
+size_t NiTextKeyExtraData::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(textKeys);
 }
 
 
-void BSDistantObjectLargeRefExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSDistantObjectLargeRefExtraData::Sync(Stream& stream) {
 	stream.Sync(largeRef);
 }
+NIFLY_SYNC_INSTANTIATE(BSDistantObjectLargeRefExtraData)
 
 
-void BSConnectPoint::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSConnectPoint::Sync(Stream& stream) {
 	root.Sync(stream, 4);
 	variableName.Sync(stream, 4);
 
@@ -383,26 +498,45 @@ void BSConnectPoint::Sync(NiStreamReversible& stream) {
 	stream.Sync(translation);
 	stream.Sync(scale);
 }
+NIFLY_SYNC_INSTANTIATE(BSConnectPoint)
 
 
-void BSConnectPointParents::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSConnectPointParents::Sync(Stream& stream) {
 	connectPoints.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSConnectPointParents)
+
+size_t BSConnectPointParents::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(connectPoints);
+}
 
 
-void BSConnectPointChildren::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSConnectPointChildren::Sync(Stream& stream) {
 	stream.Sync(skinned);
 	targets.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSConnectPointChildren)
+
+size_t BSConnectPointChildren::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(targets);
+}
 
 
 BSClothExtraData::BSClothExtraData(const uint32_t size) {
 	data.resize(size);
 }
 
-void BSClothExtraData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSClothExtraData::Sync(Stream& stream) {
 	data.SyncByteArray(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSClothExtraData)
+
+size_t BSClothExtraData::GetHeapSize() const {
+	return BSExtraData::GetHeapSize() + HeapSize(data);
+}
 
 
 bool BSClothExtraData::ToHKX(const std::string& fileName) {
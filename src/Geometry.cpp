@@ -12,26 +12,54 @@ See the included GPLv3 LICENSE file
 #include "NifUtil.hpp"
 
 #include <array>
+#include <cstring>
 
 using namespace nifly;
 
-void NiAdditionalGeometryData::Sync(NiStreamReversible& stream) {
+// Hash of the vertex positions, detects changes made without a MarkVerticesChanged call
+static uint64_t HashVertexPositions(const std::vector<Vector3>& verts) {
+	uint64_t hash = 14695981039346656037ull;
+	for (auto& v : verts) {
+		for (float f : {v.x, v.y, v.z}) {
+			uint32_t bits;
+			std::memcpy(&bits, &f, sizeof(bits));
+			hash = (hash ^ bits) * 1099511628211ull;
+		}
+	}
+
+	return hash;
+}
+
+template<typename Stream>
+void NiAdditionalGeometryData::Sync(Stream& stream) {
 	stream.Sync(numVertices);
 
 	blockInfos.Sync(stream);
 	blocks.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiAdditionalGeometryData)
+
+size_t NiAdditionalGeometryData::GetHeapSize() const {
+	return AdditionalGeomData::GetHeapSize() + HeapSize(blockInfos) + HeapSize(blocks);
+}
 
 
-void BSPackedAdditionalGeometryData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPackedAdditionalGeometryData::Sync(Stream& stream) {
 	stream.Sync(numVertices);
 
 	blockInfos.Sync(stream);
 	blocks.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSPackedAdditionalGeometryData)
+
+size_t BSPackedAdditionalGeometryData::GetHeapSize() const {
+	return AdditionalGeomData::GetHeapSize() + HeapSize(blockInfos) + HeapSize(blocks);
+}
 
 
-void NiGeometryData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiGeometryData::Sync(Stream& stream) {
 	if (stream.GetVersion().File() >= NiFileVersion::V10_1_0_114)
 		stream.Sync(groupID);
 
@@ -50,17 +78,22 @@ void NiGeometryData::Sync(NiStreamReversible& stream) {
 			stream.Sync(vertices[i]);
 	}
 
-	// Disable tangent flag for OB
+	// Disable tangent flag for OB, written files store them in binary extra data.
+	// The block keeps its flag, so that saving doesn't change it.
+	uint16_t syncDataFlags = dataFlags;
 	if (stream.GetVersion().IsOB())
-		dataFlags &= ~(1 << 12);
+		syncDataFlags &= ~(1 << 12);
 
 	if (stream.GetVersion().File() >= NiFileVersion::V10_0_1_0)
-		stream.Sync(dataFlags);
+		stream.Sync(syncDataFlags);
+
+	if (stream.GetMode() == NiStreamReversible::Mode::Reading)
+		dataFlags = syncDataFlags;
 
-	uint16_t nbtMethod = dataFlags & 0xF000;
-	uint8_t numTextureSets = dataFlags & 0x3F;
+	uint16_t nbtMethod = syncDataFlags & 0xF000;
+	uint8_t numTextureSets = syncDataFlags & 0x3F;
 	if (stream.GetVersion().Stream() >= 34)
-		numTextureSets = dataFlags & 0x1;
+		numTextureSets = syncDataFlags & 0x1;
 
 	if (stream.GetVersion().File() == NiFileVersion::V20_2_0_7 && stream.GetVersion().Stream() > 34)
 		stream.Sync(materialCRC);
@@ -107,17 +140,23 @@ void NiGeometryData::Sync(NiStreamReversible& stream) {
 	if (stream.GetVersion().File() >= NiFileVersion::V20_0_0_4)
 		additionalDataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiGeometryData)
 
-void NiGeometryData::GetChildRefs(std::set<NiRef*>& refs) {
-	NiObject::GetChildRefs(refs);
+void NiGeometryData::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiObject::ForEachChildRef(visitor);
 
-	refs.insert(&additionalDataRef);
+	visitor(additionalDataRef);
 }
 
-void NiGeometryData::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiObject::GetChildIndices(indices);
-
-	indices.push_back(additionalDataRef.index);
+size_t NiGeometryData::GetHeapSize() const {
+	size_t size = NiObject::GetHeapSize();
+	size += HeapSize(vertices);
+	size += HeapSize(normals);
+	size += HeapSize(tangents);
+	size += HeapSize(bitangents);
+	size += HeapSize(vertexColors);
+	size += HeapSize(uvSets);
+	return size;
 }
 
 uint16_t NiGeometryData::GetNumVertices() const {
@@ -126,6 +165,8 @@ uint16_t NiGeometryData::GetNumVertices() const {
 
 void NiGeometryData::SetVertices(const bool enable) {
 	hasVertices = enable;
+	MarkVerticesChanged();
+
 	if (enable) {
 		vertices.resize(numVertices);
 	}
@@ -199,6 +240,23 @@ void NiGeometryData::SetTriangles(const std::vector<Triangle>&){};
 
 void NiGeometryData::UpdateBounds() {
 	bounds = BoundingSphere(vertices);
+	boundsGeneration = vertexGeneration;
+	boundsVertexHash = HashVertexPositions(vertices);
+}
+
+bool NiGeometryData::IsBoundsDirty() const {
+	return boundsGeneration != vertexGeneration;
+}
+
+bool NiGeometryData::CheckVerticesChanged() {
+	if (boundsGeneration != vertexGeneration)
+		return true;
+
+	if (boundsVertexHash == HashVertexPositions(vertices))
+		return false;
+
+	MarkVerticesChanged();
+	return true;
 }
 
 void NiGeometryData::Create(NiVersion&,
@@ -218,6 +276,8 @@ void NiGeometryData::Create(NiVersion&,
 	for (uint16_t v = 0; v < numVertices; v++)
 		vertices[v] = (*verts)[v];
 
+	MarkVerticesChanged();
+
 	bounds = BoundingSphere(vertices);
 
 	if (uvs) {
@@ -250,6 +310,7 @@ void NiGeometryData::Create(NiVersion&,
 void NiGeometryData::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) {
 	EraseVectorIndices(vertices, vertIndices);
 	numVertices = static_cast<uint16_t>(vertices.size());
+	MarkVerticesChanged();
 	if (!normals.empty())
 		EraseVectorIndices(normals, vertIndices);
 	if (!tangents.empty())
@@ -262,6 +323,25 @@ void NiGeometryData::notifyVerticesDelete(const std::vector<uint16_t>& vertIndic
 		EraseVectorIndices(uvSet, vertIndices);
 }
 
+void NiGeometryData::notifyVerticesReorder(const std::vector<uint16_t>& vertMap) {
+	if (vertMap.size() != vertices.size())
+		return;
+
+	ApplyIndexPermutation(vertices, vertMap);
+	if (!normals.empty())
+		ApplyIndexPermutation(normals, vertMap);
+	if (!tangents.empty())
+		ApplyIndexPermutation(tangents, vertMap);
+	if (!bitangents.empty())
+		ApplyIndexPermutation(bitangents, vertMap);
+	if (!vertexColors.empty())
+		ApplyIndexPermutation(vertexColors, vertMap);
+	for (auto& uvSet : uvSets)
+		ApplyIndexPermutation(uvSet, vertMap);
+
+	MarkVerticesChanged();
+}
+
 void NiGeometryData::RecalcNormals(const bool, const float) {
 	SetNormals(true);
 }
@@ -396,6 +476,28 @@ void NiShape::UpdateBounds() {
 		geomData->UpdateBounds();
 }
 
+void NiShape::MarkVerticesChanged() {
+	auto geomData = GetGeomData();
+	if (geomData)
+		geomData->MarkVerticesChanged();
+}
+
+uint32_t NiShape::GetVertexGeneration() const {
+	auto geomData = GetGeomData();
+	if (geomData)
+		return geomData->GetVertexGeneration();
+
+	return 0;
+}
+
+bool NiShape::IsBoundsDirty() const {
+	auto geomData = GetGeomData();
+	if (geomData)
+		return geomData->IsBoundsDirty();
+
+	return false;
+}
+
 int NiShape::GetBoneID(const NiHeader& hdr, const std::string& boneName) const {
 	auto boneCont = hdr.GetBlock(SkinInstanceRef());
 	if (boneCont) {
@@ -441,7 +543,8 @@ BSTriShape::BSTriShape() {
 	vertexDesc.SetFlag(VF_SKINNED);
 }
 
-void BSTriShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSTriShape::Sync(Stream& stream) {
 	stream.Sync(flags);
 	stream.Sync(transform.translation);
 	stream.Sync(transform.rotation);
@@ -589,6 +692,7 @@ void BSTriShape::Sync(NiStreamReversible& stream) {
 		}
 	}
 }
+NIFLY_SYNC_INSTANTIATE(BSTriShape)
 
 void BSTriShape::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) {
 	deletedTris.clear();
@@ -597,6 +701,7 @@ void BSTriShape::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices)
 
 	EraseVectorIndices(vertData, vertIndices);
 	numVertices = static_cast<uint16_t>(vertData.size());
+	MarkVerticesChanged();
 
 	ApplyMapToTriangles(triangles, indexCollapse, &deletedTris);
 	numTriangles = static_cast<uint32_t>(triangles.size());
@@ -604,37 +709,73 @@ void BSTriShape::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices)
 	std::sort(deletedTris.begin(), deletedTris.end(), std::greater<>());
 }
 
-void BSTriShape::GetChildRefs(std::set<NiRef*>& refs) {
-	NiAVObject::GetChildRefs(refs);
+void BSTriShape::notifyVerticesReorder(const std::vector<uint16_t>& vertMap) {
+	if (vertMap.size() != vertData.size())
+		return;
+
+	ApplyIndexPermutation(vertData, vertMap);
+	ApplyMapToTriangles(triangles, vertMap);
+
+	if (particleVerts.size() == vertMap.size()) {
+		ApplyIndexPermutation(particleVerts, vertMap);
+		ApplyIndexPermutation(particleNorms, vertMap);
+		ApplyMapToTriangles(particleTris, vertMap);
+	}
+
+	MarkVerticesChanged();
+}
+
+void BSTriShape::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiAVObject::ForEachChildRef(visitor);
 
-	refs.insert(&skinInstanceRef);
-	refs.insert(&shaderPropertyRef);
-	refs.insert(&alphaPropertyRef);
+	visitor(skinInstanceRef);
+	visitor(shaderPropertyRef);
+	visitor(alphaPropertyRef);
 }
 
-void BSTriShape::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiAVObject::GetChildIndices(indices);
+size_t BSTriShape::GetHeapSize() const {
+	size_t size = NiShape::GetHeapSize();
+	size += HeapSize(particleVerts);
+	size += HeapSize(particleNorms);
+	size += HeapSize(particleTris);
 
-	indices.push_back(skinInstanceRef.index);
-	indices.push_back(shaderPropertyRef.index);
-	indices.push_back(alphaPropertyRef.index);
+	// Raw caches duplicate parts of vertData
+	size += HeapSize(rawVertices);
+	size += HeapSize(rawNormals);
+	size += HeapSize(rawTangents);
+	size += HeapSize(rawBitangents);
+	size += HeapSize(rawUvs);
+	size += HeapSize(rawColors);
+	size += HeapSize(rawEyeData);
+
+	size += HeapSize(deletedTris);
+	size += HeapSize(vertData);
+	size += HeapSize(triangles);
+	return size;
 }
 
-std::vector<Vector3>& BSTriShape::UpdateRawVertices() {
+const std::vector<Vector3>& BSTriShape::UpdateRawVertices() {
+	if (IsRawCacheValid(RAW_VERTICES, rawVertices.size()))
+		return rawVertices;
+
 	rawVertices.resize(numVertices);
 
 	for (uint16_t i = 0; i < numVertices; i++)
 		rawVertices[i] = vertData[i].vert;
 
+	rawGenerations[RAW_VERTICES] = vertexDataGeneration;
 	return rawVertices;
 }
 
-std::vector<Vector3>& BSTriShape::UpdateRawNormals() {
+const std::vector<Vector3>& BSTriShape::UpdateRawNormals() {
 	if (!HasNormals()) {
 		rawNormals.clear();
 		return rawNormals;
 	}
 
+	if (IsRawCacheValid(RAW_NORMALS, rawNormals.size()))
+		return rawNormals;
+
 	rawNormals.resize(numVertices);
 
 	for (uint16_t i = 0; i < numVertices; i++) {
@@ -643,15 +784,19 @@ std::vector<Vector3>& BSTriShape::UpdateRawNormals() {
 		rawNormals[i].z = ((static_cast<float>(vertData[i].normal[2])) / 255.0f) * 2.0f - 1.0f;
 	}
 
+	rawGenerations[RAW_NORMALS] = vertexDataGeneration;
 	return rawNormals;
 }
 
-std::vector<Vector3>& BSTriShape::UpdateRawTangents() {
+const std::vector<Vector3>& BSTriShape::UpdateRawTangents() {
 	if (!HasTangents()) {
 		rawTangents.clear();
 		return rawTangents;
 	}
 
+	if (IsRawCacheValid(RAW_TANGENTS, rawTangents.size()))
+		return rawTangents;
+
 	rawTangents.resize(numVertices);
 	for (uint16_t i = 0; i < numVertices; i++) {
 		rawTangents[i].x = ((static_cast<float>(vertData[i].tangent[0])) / 255.0f) * 2.0f - 1.0f;
@@ -659,15 +804,19 @@ std::vector<Vector3>& BSTriShape::UpdateRawTangents() {
 		rawTangents[i].z = ((static_cast<float>(vertData[i].tangent[2])) / 255.0f) * 2.0f - 1.0f;
 	}
 
+	rawGenerations[RAW_TANGENTS] = vertexDataGeneration;
 	return rawTangents;
 }
 
-std::vector<Vector3>& BSTriShape::UpdateRawBitangents() {
+const std::vector<Vector3>& BSTriShape::UpdateRawBitangents() {
 	if (!HasTangents()) {
 		rawBitangents.clear();
 		return rawBitangents;
 	}
 
+	if (IsRawCacheValid(RAW_BITANGENTS, rawBitangents.size()))
+		return rawBitangents;
+
 	rawBitangents.resize(numVertices);
 	for (uint16_t i = 0; i < numVertices; i++) {
 		rawBitangents[i].x = vertData[i].bitangentX;
@@ -675,29 +824,37 @@ std::vector<Vector3>& BSTriShape::UpdateRawBitangents() {
 		rawBitangents[i].z = ((static_cast<float>(vertData[i].bitangentZ)) / 255.0f) * 2.0f - 1.0f;
 	}
 
+	rawGenerations[RAW_BITANGENTS] = vertexDataGeneration;
 	return rawBitangents;
 }
 
-std::vector<Vector2>& BSTriShape::UpdateRawUvs() {
+const std::vector<Vector2>& BSTriShape::UpdateRawUvs() {
 	if (!HasUVs()) {
 		rawUvs.clear();
 		return rawUvs;
 	}
 
+	if (IsRawCacheValid(RAW_UVS, rawUvs.size()))
+		return rawUvs;
+
 	rawUvs.resize(numVertices);
 
 	for (uint16_t i = 0; i < numVertices; i++)
 		rawUvs[i] = vertData[i].uv;
 
+	rawGenerations[RAW_UVS] = vertexDataGeneration;
 	return rawUvs;
 }
 
-std::vector<Color4>& BSTriShape::UpdateRawColors() {
+const std::vector<Color4>& BSTriShape::UpdateRawColors() {
 	if (!HasVertexColors()) {
 		rawColors.clear();
 		return rawColors;
 	}
 
+	if (IsRawCacheValid(RAW_COLORS, rawColors.size()))
+		return rawColors;
+
 	rawColors.resize(numVertices);
 
 	for (uint16_t i = 0; i < numVertices; i++) {
@@ -707,20 +864,25 @@ std::vector<Color4>& BSTriShape::UpdateRawColors() {
 		rawColors[i].a = vertData[i].colorData[3] / 255.0f;
 	}
 
+	rawGenerations[RAW_COLORS] = vertexDataGeneration;
 	return rawColors;
 }
 
-std::vector<float>& BSTriShape::UpdateRawEyeData() {
+const std::vector<float>& BSTriShape::UpdateRawEyeData() {
 	if (!HasEyeData()) {
 		rawEyeData.clear();
 		return rawEyeData;
 	}
 
+	if (IsRawCacheValid(RAW_EYEDATA, rawEyeData.size()))
+		return rawEyeData;
+
 	rawEyeData.resize(numVertices);
 
 	for (uint16_t i = 0; i < numVertices; ++i)
 		rawEyeData[i] = vertData[i].eyeData;
 
+	rawGenerations[RAW_EYEDATA] = vertexDataGeneration;
 	return rawEyeData;
 }
 
@@ -729,6 +891,8 @@ uint16_t BSTriShape::GetNumVertices() const {
 }
 
 void BSTriShape::SetVertices(const bool enable) {
+	MarkVerticesChanged();
+
 	if (enable) {
 		vertexDesc.SetFlag(VF_VERTEX);
 		vertData.resize(numVertices);
@@ -783,6 +947,8 @@ void BSTriShape::SetVertexColors(const bool enable) {
 				v.colorData[2] = 255;
 				v.colorData[3] = 255;
 			}
+
+			MarkVertexDataChanged();
 		}
 
 		vertexDesc.SetFlag(VF_COLORS);
@@ -832,11 +998,25 @@ void BSTriShape::SetTriangles(const std::vector<Triangle>& tris) {
 void BSTriShape::UpdateBounds() {
 	UpdateRawVertices();
 	bounds = BoundingSphere(rawVertices);
+	boundsGeneration = vertexGeneration;
+}
+
+BoundingSphere BSTriShape::CalcBounds() const {
+	std::vector<Vector3> positions(numVertices);
+	for (uint16_t i = 0; i < numVertices; i++)
+		positions[i] = vertData[i].vert;
+
+	return BoundingSphere(positions);
+}
+
+bool BSTriShape::IsBoundsDirty() const {
+	return boundsGeneration != vertexGeneration;
 }
 
 void BSTriShape::SetVertexData(const std::vector<BSVertexData>& bsVertData) {
 	vertData = bsVertData;
 	numVertices = static_cast<uint16_t>(vertData.size());
+	MarkVerticesChanged();
 }
 
 void BSTriShape::SetNormals(const std::vector<Vector3>& inNorms) {
@@ -849,6 +1029,8 @@ void BSTriShape::SetNormals(const std::vector<Vector3>& inNorms) {
 		vertData[i].normal[1] = static_cast<uint8_t>(std::round((((inNorms[i].y + 1.0f) / 2.0f) * 255.0f)));
 		vertData[i].normal[2] = static_cast<uint8_t>(std::round((((inNorms[i].z + 1.0f) / 2.0f) * 255.0f)));
 	}
+
+	MarkVertexDataChanged();
 }
 
 void BSTriShape::SetTangentData(const std::vector<Vector3>& in) {
@@ -859,6 +1041,8 @@ void BSTriShape::SetTangentData(const std::vector<Vector3>& in) {
 		vertData[i].tangent[1] = static_cast<uint8_t>(std::round((((in[i].y + 1.0f) / 2.0f) * 255.0f)));
 		vertData[i].tangent[2] = static_cast<uint8_t>(std::round((((in[i].z + 1.0f) / 2.0f) * 255.0f)));
 	}
+
+	MarkVertexDataChanged();
 }
 
 void BSTriShape::SetBitangentData(const std::vector<Vector3>& in) {
@@ -869,6 +1053,8 @@ void BSTriShape::SetBitangentData(const std::vector<Vector3>& in) {
 		vertData[i].bitangentY = static_cast<uint8_t>(std::round((((in[i].y + 1.0f) / 2.0f) * 255.0f)));
 		vertData[i].bitangentZ = static_cast<uint8_t>(std::round((((in[i].z + 1.0f) / 2.0f) * 255.0f)));
 	}
+
+	MarkVertexDataChanged();
 }
 
 void BSTriShape::SetEyeData(const std::vector<float>& in) {
@@ -876,6 +1062,8 @@ void BSTriShape::SetEyeData(const std::vector<float>& in) {
 
 	for (uint16_t i = 0; i < numVertices; i++)
 		vertData[i].eyeData = in[i];
+
+	MarkVertexDataChanged();
 }
 
 static void CalculateNormals(const std::vector<Vector3>& verts,
@@ -944,6 +1132,8 @@ void BSTriShape::RecalcNormals(const bool smooth,
 		vertData[i].normal[1] = static_cast<uint8_t>(std::round((((rawNormals[i].y + 1.0f) / 2.0f) * 255.0f)));
 		vertData[i].normal[2] = static_cast<uint8_t>(std::round((((rawNormals[i].z + 1.0f) / 2.0f) * 255.0f)));
 	}
+
+	MarkVertexDataChanged();
 }
 
 void BSTriShape::CalcTangentSpace() {
@@ -1043,63 +1233,78 @@ void BSTriShape::CalcTangentSpace() {
 		vertData[i].bitangentZ = static_cast<uint8_t>(
 			std::round((((rawBitangents[i].z + 1.0f) / 2.0f) * 255.0f)));
 	}
+
+	MarkVertexDataChanged();
 }
 
-int BSTriShape::CalcDataSizes(NiVersion& version) {
-	vertexSize = 0;
-	dataSize = 0;
+// Vertex description and vertex size of the shape's vertex attributes (see CalcDataSizes)
+static VertexDesc CalcVertexDesc(const BSTriShape& shape, const NiVersion& version, uint32_t& outVertexSize) {
+	VertexDesc vertexDesc = shape.vertexDesc;
+	outVertexSize = 0;
 
 	VertexFlags vf = vertexDesc.GetFlags();
 	vertexDesc.ClearAttributeOffsets();
 
 	std::array<uint32_t, VA_COUNT> attributeSizes{};
-	if (HasVertices()) {
-		if (IsFullPrecision() || version.Stream() == 100)
+	if (shape.HasVertices()) {
+		if (shape.IsFullPrecision() || version.Stream() == 100)
 			attributeSizes[VA_POSITION] = 4;
 		else
 			attributeSizes[VA_POSITION] = 2;
 	}
 
-	if (HasUVs())
+	if (shape.HasUVs())
 		attributeSizes[VA_TEXCOORD0] = 1;
 
-	if (HasSecondUVs())
+	if (shape.HasSecondUVs())
 		attributeSizes[VA_TEXCOORD1] = 1;
 
-	if (HasNormals()) {
+	if (shape.HasNormals()) {
 		attributeSizes[VA_NORMAL] = 1;
 
-		if (HasTangents())
+		if (shape.HasTangents())
 			attributeSizes[VA_BINORMAL] = 1;
 	}
 
-	if (HasVertexColors())
+	if (shape.HasVertexColors())
 		attributeSizes[VA_COLOR] = 1;
 
-	if (IsSkinned())
+	if (shape.IsSkinned())
 		attributeSizes[VA_SKINNING] = 3;
 
-	if (HasEyeData())
+	if (shape.HasEyeData())
 		attributeSizes[VA_EYEDATA] = 1;
 
 	for (int va = 0; va < VA_COUNT; va++) {
 		if (attributeSizes[va] != 0) {
-			vertexDesc.SetAttributeOffset(VertexAttribute(va), vertexSize);
-			vertexSize += attributeSizes[va] * 4;
+			vertexDesc.SetAttributeOffset(VertexAttribute(va), outVertexSize);
+			outVertexSize += attributeSizes[va] * 4;
 		}
 	}
 
-	vertexDesc.SetSize(vertexSize);
+	vertexDesc.SetSize(outVertexSize);
 	vertexDesc.SetFlags(vf);
 
-	if (HasType<BSDynamicTriShape>())
+	if (shape.HasType<BSDynamicTriShape>())
 		vertexDesc.MakeDynamic();
 
+	return vertexDesc;
+}
+
+int BSTriShape::CalcDataSizes(NiVersion& version) {
+	vertexDesc = CalcVertexDesc(*this, version, vertexSize);
 	dataSize = vertexSize * numVertices + 6 * numTriangles;
 
 	return dataSize;
 }
 
+bool BSTriShape::IsDataSizeDirty(const NiVersion& version) const {
+	uint32_t newVertexSize = 0;
+	const VertexDesc newVertexDesc = CalcVertexDesc(*this, version, newVertexSize);
+	return newVertexDesc != vertexDesc || newVertexSize != vertexSize
+		   || newVertexSize * numVertices + 6 * numTriangles != dataSize;
+}
+
 void BSTriShape::Create(NiVersion& version,
 						const std::vector<Vector3>* verts,
 						const std::vector<Triangle>* tris,
@@ -1150,6 +1355,8 @@ void BSTriShape::Create(NiVersion& version,
 	for (uint32_t i = 0; i < numTriangles; i++)
 		triangles[i] = (*tris)[i];
 
+	MarkVerticesChanged();
+
 	UpdateRawVertices();
 	bounds = BoundingSphere(rawVertices);
 
@@ -1164,7 +1371,8 @@ void BSTriShape::Create(NiVersion& version,
 }
 
 
-void BSSubIndexTriShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSSubIndexTriShape::Sync(Stream& stream) {
 	if (stream.GetVersion().Stream() >= 130 && dataSize > 0) {
 		stream.Sync(segmentation.numPrimitives);
 		stream.Sync(segmentation.numSegments);
@@ -1216,6 +1424,11 @@ void BSSubIndexTriShape::Sync(NiStreamReversible& stream) {
 			segment.Sync(stream);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(BSSubIndexTriShape)
+
+size_t BSSubIndexTriShape::GetHeapSize() const {
+	return BSTriShape::GetHeapSize() + HeapSize(segments) + HeapSize(segmentation);
+}
 
 void BSSubIndexTriShape::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) {
 	BSTriShape::notifyVerticesDelete(vertIndices);
@@ -1485,11 +1698,13 @@ void BSSubIndexTriShape::SetSegmentation(const NifSegmentationInfo& inf, const s
 }
 
 
-void BSMeshLODTriShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSMeshLODTriShape::Sync(Stream& stream) {
 	stream.Sync(lodSize0);
 	stream.Sync(lodSize1);
 	stream.Sync(lodSize2);
 }
+NIFLY_SYNC_INSTANTIATE(BSMeshLODTriShape)
 
 void BSMeshLODTriShape::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) {
 	BSTriShape::notifyVerticesDelete(vertIndices);
@@ -1508,13 +1723,19 @@ BSDynamicTriShape::BSDynamicTriShape() {
 	dynamicDataSize = 0;
 }
 
-void BSDynamicTriShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSDynamicTriShape::Sync(Stream& stream) {
 	stream.Sync(dynamicDataSize);
 
 	dynamicData.resize(numVertices);
 	for (uint16_t i = 0; i < numVertices; i++)
 		stream.Sync(dynamicData[i]);
 }
+NIFLY_SYNC_INSTANTIATE(BSDynamicTriShape)
+
+size_t BSDynamicTriShape::GetHeapSize() const {
+	return BSTriShape::GetHeapSize() + HeapSize(dynamicData);
+}
 
 void BSDynamicTriShape::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) {
 	BSTriShape::notifyVerticesDelete(vertIndices);
@@ -1523,6 +1744,12 @@ void BSDynamicTriShape::notifyVerticesDelete(const std::vector<uint16_t>& vertIn
 	dynamicDataSize = static_cast<uint32_t>(dynamicData.size());
 }
 
+void BSDynamicTriShape::notifyVerticesReorder(const std::vector<uint16_t>& vertMap) {
+	BSTriShape::notifyVerticesReorder(vertMap);
+
+	ApplyIndexPermutation(dynamicData, vertMap);
+}
+
 void BSDynamicTriShape::CalcDynamicData() {
 	dynamicDataSize = numVertices * 16;
 
@@ -1539,6 +1766,26 @@ void BSDynamicTriShape::CalcDynamicData() {
 		else
 			vertex.eyeData = 0.0f;
 	}
+
+	MarkVertexDataChanged();
+}
+
+bool BSDynamicTriShape::IsDynamicDataDirty() const {
+	if (dynamicDataSize != numVertices * 16u || dynamicData.size() != numVertices)
+		return true;
+
+	for (uint16_t i = 0; i < numVertices; i++) {
+		auto& vertex = vertData[i];
+		auto& dynamic = dynamicData[i];
+		if (dynamic.x != vertex.vert.x || dynamic.y != vertex.vert.y || dynamic.z != vertex.vert.z
+			|| dynamic.w != vertex.bitangentX)
+			return true;
+
+		if (vertex.eyeData != (vertex.vert.x > 0.0f ? 1.0f : 0.0f))
+			return true;
+	}
+
+	return false;
 }
 
 void BSDynamicTriShape::Create(NiVersion& version,
@@ -1565,7 +1812,8 @@ void BSDynamicTriShape::Create(NiVersion& version,
 }
 
 
-void NiGeometry::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiGeometry::Sync(Stream& stream) {
 	dataRef.Sync(stream);
 	skinInstanceRef.Sync(stream);
 
@@ -1592,30 +1840,30 @@ void NiGeometry::Sync(NiStreamReversible& stream) {
 		alphaPropertyRef.Sync(stream);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(NiGeometry)
 
-void NiGeometry::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiAVObject::GetStringRefs(refs);
+void NiGeometry::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiAVObject::ForEachStringRef(visitor);
 
 	for (auto& mn : materialNames)
-		refs.emplace_back(&mn);
+		visitor(mn);
 }
 
-void NiGeometry::GetChildRefs(std::set<NiRef*>& refs) {
-	NiAVObject::GetChildRefs(refs);
+void NiGeometry::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiAVObject::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
-	refs.insert(&skinInstanceRef);
-	refs.insert(&shaderPropertyRef);
-	refs.insert(&alphaPropertyRef);
+	visitor(dataRef);
+	visitor(skinInstanceRef);
+	visitor(shaderPropertyRef);
+	visitor(alphaPropertyRef);
 }
 
-void NiGeometry::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiAVObject::GetChildIndices(indices);
-
-	indices.push_back(dataRef.index);
-	indices.push_back(skinInstanceRef.index);
-	indices.push_back(shaderPropertyRef.index);
-	indices.push_back(alphaPropertyRef.index);
+size_t NiGeometry::GetHeapSize() const {
+	size_t size = NiShape::GetHeapSize();
+	size += HeapSize(materialNames);
+	size += HeapSize(materialExtraData);
+	size += HeapSize(shaderName);
+	return size;
 }
 
 bool NiGeometry::IsSkinned() const {
@@ -1623,9 +1871,11 @@ bool NiGeometry::IsSkinned() const {
 }
 
 
-void NiTriBasedGeomData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiTriBasedGeomData::Sync(Stream& stream) {
 	stream.Sync(numTriangles);
 }
+NIFLY_SYNC_INSTANTIATE(NiTriBasedGeomData)
 
 void NiTriBasedGeomData::Create(NiVersion& version,
 								const std::vector<Vector3>* verts,
@@ -1648,7 +1898,8 @@ void NiTriBasedGeomData::Create(NiVersion& version,
 }
 
 
-void NiTriShapeData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiTriShapeData::Sync(Stream& stream) {
 	stream.Sync(numTrianglePoints);
 	stream.Sync(hasTriangles);
 
@@ -1675,6 +1926,11 @@ void NiTriShapeData::Sync(NiStreamReversible& stream) {
 	matchGroups.clear();
 	numMatchGroups = 0;
 }
+NIFLY_SYNC_INSTANTIATE(NiTriShapeData)
+
+size_t NiTriShapeData::GetHeapSize() const {
+	return NiTriBasedGeomData::GetHeapSize() + HeapSize(triangles) + HeapSize(matchGroups);
+}
 
 void NiTriShapeData::Create(NiVersion& version,
 							const std::vector<Vector3>* verts,
@@ -1713,6 +1969,20 @@ void NiTriShapeData::notifyVerticesDelete(const std::vector<uint16_t>& vertIndic
 	NiTriBasedGeomData::notifyVerticesDelete(vertIndices);
 }
 
+void NiTriShapeData::notifyVerticesReorder(const std::vector<uint16_t>& vertMap) {
+	if (vertMap.size() != vertices.size())
+		return;
+
+	ApplyMapToTriangles(triangles, vertMap);
+
+	for (auto& mg : matchGroups)
+		for (auto& m : mg.matches)
+			if (m < vertMap.size())
+				m = vertMap[m];
+
+	NiTriBasedGeomData::notifyVerticesReorder(vertMap);
+}
+
 std::vector<MatchGroup> NiTriShapeData::GetMatchGroups() const {
 	return matchGroups;
 }
@@ -1841,7 +2111,8 @@ void NiTriShape::SetGeomData(NiGeometryData* geomDataPtr) {
 }
 
 
-void StripsInfo::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void StripsInfo::Sync(Stream& stream) {
 	stripLengths.Sync(stream);
 
 	if (stream.GetVersion().File() >= NiFileVersion::V10_0_1_3)
@@ -1858,11 +2129,18 @@ void StripsInfo::Sync(NiStreamReversible& stream) {
 		}
 	}
 }
+NIFLY_SYNC_INSTANTIATE(StripsInfo)
 
 
-void NiTriStripsData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiTriStripsData::Sync(Stream& stream) {
 	stripsInfo.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiTriStripsData)
+
+size_t NiTriStripsData::GetHeapSize() const {
+	return NiTriBasedGeomData::GetHeapSize() + HeapSize(stripsInfo);
+}
 
 void NiTriStripsData::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) {
 	std::vector<int> indexCollapse = GenerateIndexCollapseMap(vertIndices, vertices.size());
@@ -1888,6 +2166,18 @@ void NiTriStripsData::notifyVerticesDelete(const std::vector<uint16_t>& vertIndi
 			numTriangles += len - 2;
 }
 
+void NiTriStripsData::notifyVerticesReorder(const std::vector<uint16_t>& vertMap) {
+	if (vertMap.size() != vertices.size())
+		return;
+
+	for (auto& strip : stripsInfo.points)
+		for (auto& p : strip)
+			if (p < vertMap.size())
+				p = vertMap[p];
+
+	NiTriBasedGeomData::notifyVerticesReorder(vertMap);
+}
+
 uint32_t NiTriStripsData::GetNumTriangles() const {
 	return static_cast<uint32_t>(StripsToTris().size());
 }
@@ -2012,11 +2302,18 @@ void NiTriStrips::SetGeomData(NiGeometryData* geomDataPtr) {
 }
 
 
-void NiLinesData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiLinesData::Sync(Stream& stream) {
 	lineFlags.resize(numVertices);
 	for (uint16_t i = 0; i < numVertices; i++)
 		stream.Sync(lineFlags[i]);
 }
+NIFLY_SYNC_INSTANTIATE(NiLinesData)
+
+size_t NiLinesData::GetHeapSize() const {
+	// Approximation, deques allocate in chunks
+	return NiGeometryData::GetHeapSize() + lineFlags.size() * sizeof(bool);
+}
 
 void NiLinesData::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) {
 	NiGeometryData::notifyVerticesDelete(vertIndices);
@@ -2036,7 +2333,8 @@ void NiLines::SetGeomData(NiGeometryData* geomDataPtr) {
 }
 
 
-void NiScreenElementsData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiScreenElementsData::Sync(Stream& stream) {
 	stream.Sync(maxPolygons);
 	polygons.resize(maxPolygons);
 	for (uint32_t i = 0; i < maxPolygons; i++)
@@ -2053,6 +2351,11 @@ void NiScreenElementsData::Sync(NiStreamReversible& stream) {
 	stream.Sync(maxIndices);
 	stream.Sync(indicesGrowBy);
 }
+NIFLY_SYNC_INSTANTIATE(NiScreenElementsData)
+
+size_t NiScreenElementsData::GetHeapSize() const {
+	return NiTriShapeData::GetHeapSize() + HeapSize(polygons) + HeapSize(polygonIndices);
+}
 
 void NiScreenElementsData::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) {
 	NiTriShapeData::notifyVerticesDelete(vertIndices);
@@ -2078,11 +2381,13 @@ void NiScreenElements::SetGeomData(NiGeometryData* geomDataPtr) {
 }
 
 
-void BSLODTriShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSLODTriShape::Sync(Stream& stream) {
 	stream.Sync(level0);
 	stream.Sync(level1);
 	stream.Sync(level2);
 }
+NIFLY_SYNC_INSTANTIATE(BSLODTriShape)
 
 NiGeometryData* BSLODTriShape::GetGeomData() const {
 	return shapeData;
@@ -2095,20 +2400,28 @@ void BSLODTriShape::SetGeomData(NiGeometryData* geomDataPtr) {
 }
 
 
-void BSGeometrySegmentData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSGeometrySegmentData::Sync(Stream& stream) {
 	stream.Sync(flags);
 	stream.Sync(index);
 	stream.Sync(numTris);
 }
+NIFLY_SYNC_INSTANTIATE(BSGeometrySegmentData)
 
 
-void BSSegmentedTriShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSSegmentedTriShape::Sync(Stream& stream) {
 	stream.Sync(numSegments);
 	segments.resize(numSegments);
 
 	for (auto& segment : segments)
 		segment.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSSegmentedTriShape)
+
+size_t BSSegmentedTriShape::GetHeapSize() const {
+	return NiTriShape::GetHeapSize() + HeapSize(segments);
+}
 
 std::vector<BSGeometrySegmentData> BSSegmentedTriShape::GetSegments() const {
 	return segments;
@@ -0,0 +1,173 @@
+/*
+nifly
+C++ NIF library for the Gamebryo/NetImmerse File Format
+See the included GPLv3 LICENSE file
+*/
+
+#include "NifBatch.hpp"
+#include "NifTrace.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace nifly;
+
+// Loads, processes and saves a single file, capturing errors in the result
+static void ProcessBatchFile(NifFile& nif,
+							 const NifBatchOptions& options,
+							 const NifBatchProcessFunc& processFunc,
+							 NifBatchResult& result) {
+	NIFLY_TRACE_SCOPE("NifBatch::ProcessFile");
+
+	try {
+		int error = nif.Load(result.fileName, options.loadOptions);
+		if (error) {
+			result.status = NBS_LOAD_FAILED;
+			result.error = error;
+			return;
+		}
+
+		if (processFunc) {
+			error = processFunc(nif, result.fileName);
+			if (error) {
+				result.status = NBS_PROCESS_FAILED;
+				result.error = error;
+				return;
+			}
+		}
+
+		if (options.outputFunc) {
+			std::filesystem::path outFileName = options.outputFunc(result.fileName);
+			if (!outFileName.empty()) {
+				error = nif.Save(outFileName, options.saveOptions);
+				if (error) {
+					result.status = NBS_SAVE_FAILED;
+					result.error = error;
+					return;
+				}
+
+				result.outFileName = std::move(outFileName);
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		result.status = NBS_EXCEPTION;
+		result.message = e.what();
+	}
+	catch (...) {
+		result.status = NBS_EXCEPTION;
+		result.message = "Unknown exception";
+	}
+}
+
+size_t NifBatch::Run(const std::vector<std::filesystem::path>& files,
+					 const NifBatchProcessFunc& processFunc,
+					 const NifBatchResultFunc& resultFunc) const {
+	NIFLY_TRACE_SCOPE("NifBatch::Run");
+
+	const size_t numFiles = files.size();
+	if (numFiles == 0)
+		return 0;
+
+	uint32_t numThreads = options.numThreads;
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	numThreads = static_cast<uint32_t>(std::min<size_t>(numThreads, numFiles));
+
+	size_t maxInFlight = options.maxInFlight;
+	if (maxInFlight == 0)
+		maxInFlight = static_cast<size_t>(numThreads) * 4;
+
+	maxInFlight = std::max<size_t>(maxInFlight, numThreads);
+
+	// Finished results wait in a ring buffer until all results before them were reported.
+	// A worker only starts file 'i' once 'i - nextReport' is inside the window.
+	std::vector<NifBatchResult> pending(maxInFlight);
+	std::vector<bool> pendingDone(maxInFlight, false);
+	size_t nextReport = 0;
+
+	std::mutex mutex;
+	std::condition_variable resultReady;
+	std::condition_variable windowMoved;
+	std::atomic<size_t> nextFile{0};
+
+	auto worker = [&]() {
+		// Reused between files so that its buffers don't need to be reallocated
+		NifFile nif;
+
+		// Stats sinks aren't synchronized, so each worker fills its own and merges them when done
+		NifStats loadStats;
+		NifStats saveStats;
+		NifBatchOptions workerOptions = options;
+		if (options.loadOptions.stats)
+			workerOptions.loadOptions.stats = &loadStats;
+		if (options.saveOptions.stats)
+			workerOptions.saveOptions.stats = &saveStats;
+
+		for (;;) {
+			const size_t index = nextFile++;
+			if (index >= numFiles)
+				break;
+
+			{
+				NIFLY_TRACE_SCOPE("NifBatch::WaitForWindow");
+				std::unique_lock<std::mutex> lock(mutex);
+				windowMoved.wait(lock, [&] { return index < nextReport + maxInFlight; });
+			}
+
+			NifBatchResult result;
+			result.index = index;
+			result.fileName = files[index];
+			ProcessBatchFile(nif, workerOptions, processFunc, result);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				const size_t slot = index % maxInFlight;
+				pending[slot] = std::move(result);
+				pendingDone[slot] = true;
+			}
+			resultReady.notify_one();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (options.loadOptions.stats)
+			options.loadOptions.stats->Add(loadStats);
+		if (options.saveOptions.stats)
+			options.saveOptions.stats->Add(saveStats);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads);
+	for (uint32_t i = 0; i < numThreads; i++)
+		threads.emplace_back(worker);
+
+	size_t numFailed = 0;
+	while (nextReport < numFiles) {
+		NifBatchResult result;
+		{
+			NIFLY_TRACE_SCOPE("NifBatch::WaitForResult");
+			std::unique_lock<std::mutex> lock(mutex);
+			const size_t slot = nextReport % maxInFlight;
+			resultReady.wait(lock, [&] { return pendingDone[slot]; });
+
+			result = std::move(pending[slot]);
+			pendingDone[slot] = false;
+			nextReport++;
+		}
+		windowMoved.notify_all();
+
+		if (result.status != NBS_OK)
+			numFailed++;
+
+		if (resultFunc)
+			resultFunc(result);
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	return numFailed;
+}
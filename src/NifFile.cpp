@@ -6,52 +6,165 @@ See the included GPLv3 LICENSE file
 
 #include "NifFile.hpp"
 #include "bhk.hpp"
+#include "NifTrace.hpp"
 #include "NifUtil.hpp"
 
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
 #include <regex>
 #include <set>
+#include <thread>
 #include <unordered_set>
 #include <queue>
 
 using namespace nifly;
 
+// Adds the wall time of its scope to a phase of the stats sink. Does nothing without a sink.
+class StatsPhaseTimer {
+	NifStatsPhase* phase = nullptr;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	StatsPhaseTimer(NifStats* stats, NifStatsPhase NifStats::*member) {
+		if (stats) {
+			phase = &(stats->*member);
+			start = std::chrono::steady_clock::now();
+		}
+	}
+
+	~StatsPhaseTimer() { Stop(); }
+
+	StatsPhaseTimer(const StatsPhaseTimer&) = delete;
+	StatsPhaseTimer& operator=(const StatsPhaseTimer&) = delete;
+
+	void Stop() {
+		if (!phase)
+			return;
+
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		phase->ns += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+		phase->count++;
+		phase = nullptr;
+	}
+};
+
+// Returns the bytes between two stream positions, or 0 if a position is invalid
+static uint64_t StreamDistance(const std::streampos start, const std::streampos end) {
+	if (start == std::streampos(-1) || end == std::streampos(-1) || end < start)
+		return 0;
+
+	return static_cast<uint64_t>(end - start);
+}
+
+static void AddStatsPhase(NifStatsPhase& phase, const NifStatsPhase& other) {
+	phase.count += other.count;
+	phase.ns += other.ns;
+}
+
+void NifStats::Add(const NifStats& other) {
+	AddStatsPhase(load, other.load);
+	AddStatsPhase(readHeader, other.readHeader);
+	AddStatsPhase(readBlocks, other.readBlocks);
+	AddStatsPhase(prepareData, other.prepareData);
+	AddStatsPhase(trimTexturePaths, other.trimTexturePaths);
+	AddStatsPhase(save, other.save);
+	AddStatsPhase(finalizeData, other.finalizeData);
+	AddStatsPhase(optimize, other.optimize);
+	AddStatsPhase(sortBlocks, other.sortBlocks);
+	AddStatsPhase(writeHeader, other.writeHeader);
+	AddStatsPhase(writeBlocks, other.writeBlocks);
+	AddStatsPhase(writeBlockSizes, other.writeBlockSizes);
+
+	headerBytesRead += other.headerBytesRead;
+	blocksRead += other.blocksRead;
+	bytesRead += other.bytesRead;
+	blocksWritten += other.blocksWritten;
+	bytesWritten += other.bytesWritten;
+
+	for (auto& [blockType, typeStats] : other.blockTypes) {
+		NifStatsBlockType& dest = blockTypes[blockType];
+		dest.count += typeStats.count;
+		dest.bytes += typeStats.bytes;
+		dest.ns += typeStats.ns;
+	}
+}
+
 template<class T>
 T* NifFile::FindBlockByName(const std::string& name) const {
-	for (auto& block : blocks) {
-		auto namedBlock = dynamic_cast<T*>(block.get());
+	for (uint32_t i = 0; i < blocks.size(); i++) {
+		auto namedBlock = dynamic_cast<T*>(blocks[i].get());
 		if (namedBlock && namedBlock->name == name)
-			return namedBlock;
+			return hdr.GetBlock<T>(i);
 	}
 
 	return nullptr;
 }
 
 uint32_t NifFile::GetBlockID(NiObject* block) const {
-	auto it = find_if(blocks, [&block](const auto& ptr) { return ptr.get() == block; });
+	return hdr.GetBlockID(block);
+}
 
-	if (it != blocks.end())
-		return static_cast<uint32_t>(std::distance(blocks.begin(), it));
+void NifFile::BuildParentIndex() const {
+	parentIndex.assign(blocks.size(), NIF_NPOS);
 
-	return NIF_NPOS;
+	// The first parent in block order is used if a block has more than one
+	for (uint32_t i = 0; i < blocks.size(); i++) {
+		auto node = dynamic_cast<NiNode*>(blocks[i].get());
+		if (!node)
+			continue;
+
+		for (auto& child : node->childRefs)
+			if (child.index < parentIndex.size() && parentIndex[child.index] == NIF_NPOS)
+				parentIndex[child.index] = i;
+	}
+
+	parentIndexRevision = hdr.GetBlockListRevision();
+	hasParentIndex = true;
 }
 
-NiNode* NifFile::GetParentNode(NiObject* childBlock) const {
-	if (childBlock != nullptr) {
-		int childId = GetBlockID(childBlock);
-		for (auto& block : blocks) {
-			auto node = dynamic_cast<NiNode*>(block.get());
-			if (node) {
-				auto children = node->childRefs;
-				for (auto& c : children) {
-					if (c == childId)
-						return node;
-				}
-			}
-		}
+void NifFile::SetParentNodeID(const uint32_t blockID, const uint32_t parentID) {
+	if (!IsParentIndexCurrent() || blockID >= parentIndex.size())
+		return;
+
+	// Parent isn't a block of this file
+	if (parentID == NIF_NPOS) {
+		InvalidateParentIndex();
+		return;
 	}
 
-	return nullptr;
+	parentIndex[blockID] = parentID;
+}
+
+void NifFile::RemapParentIndex(const std::vector<uint32_t>& newIndices) {
+	std::vector<uint32_t> newParentIndex(hdr.GetNumBlocks(), NIF_NPOS);
+	for (uint32_t i = 0; i < parentIndex.size() && i < newIndices.size(); i++) {
+		const uint32_t newId = newIndices[i];
+		const uint32_t parentId = parentIndex[i];
+		if (newId < newParentIndex.size() && parentId < newIndices.size())
+			newParentIndex[newId] = newIndices[parentId];
+	}
+
+	parentIndex = std::move(newParentIndex);
+	parentIndexRevision = hdr.GetBlockListRevision();
+}
+
+uint32_t NifFile::GetParentNodeID(const uint32_t blockID) const {
+	if (blockID >= blocks.size())
+		return NIF_NPOS;
+
+	if (!IsParentIndexCurrent())
+		BuildParentIndex();
+
+	return parentIndex[blockID];
+}
+
+NiNode* NifFile::GetParentNode(NiObject* childBlock) const {
+	if (!childBlock)
+		return nullptr;
+
+	return hdr.GetBlock<NiNode>(GetParentNodeID(GetBlockID(childBlock)));
 }
 
 void NifFile::SetParentNode(NiObject* childBlock, NiNode* newParent) {
@@ -69,34 +182,30 @@ void NifFile::SetParentNode(NiObject* childBlock, NiNode* newParent) {
 		return;
 
 	uint32_t childId = GetBlockID(childBlock);
-	for (auto& block : blocks) {
-		auto node = dynamic_cast<NiNode*>(block.get());
-		if (!node)
-			continue;
+	const uint32_t newParentId = GetBlockID(newParent);
+	uint32_t oldParentId = GetParentNodeID(childId);
+	if (oldParentId != NIF_NPOS) {
+		if (oldParentId == newParentId)
+			return;
 
-		auto& children = node->childRefs;
+		auto& children = hdr.GetBlockForWrite<NiNode>(oldParentId)->childRefs;
 		for (uint32_t ci = 0; ci < children.GetSize(); ++ci) {
-			if (childId != children.GetBlockRef(ci))
-				continue;
-
-			// We have now found the node's old parent
-			if (newParent != node) {
+			if (childId == children.GetBlockRef(ci)) {
 				children.RemoveBlockRef(ci);
-				newParent->childRefs.AddBlockRef(childId);
+				break;
 			}
-
-			return;
 		}
 	}
 
-	// If we get here, the node's old parent was not found.
+	newParent = GetBlockForWrite(newParent);
 	newParent->childRefs.AddBlockRef(childId);
+	SetParentNodeID(childId, newParentId);
 }
 
 std::vector<NiNode*> NifFile::GetNodes() const {
 	std::vector<NiNode*> outList;
-	for (auto& block : blocks) {
-		auto node = dynamic_cast<NiNode*>(block.get());
+	for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++) {
+		auto node = hdr.GetBlock<NiNode>(i);
 		if (node)
 			outList.push_back(node);
 	}
@@ -104,7 +213,16 @@ std::vector<NiNode*> NifFile::GetNodes() const {
 	return outList;
 }
 
-void NifFile::CopyFrom(const NifFile& other) {
+// NiGeometry blocks and their data are linked by pointer, so they can't be shared with other files
+static bool IsGeomDataLinked(NiObject* block) {
+	if (dynamic_cast<NiGeometryData*>(block))
+		return true;
+
+	auto shape = dynamic_cast<NiShape*>(block);
+	return shape && shape->DataRef();
+}
+
+void NifFile::CopyFrom(const NifFile& other, const bool copyOnWrite) {
 	if (isValid)
 		Clear();
 
@@ -113,22 +231,43 @@ void NifFile::CopyFrom(const NifFile& other) {
 	isTerrain = other.isTerrain;
 
 	hdr = NiHeader(other.hdr);
+	InvalidateParentIndex();
 
 	size_t nBlocks = other.blocks.size();
 	blocks.resize(nBlocks);
 
 	for (uint32_t i = 0; i < nBlocks; i++)
 	{
-		blocks[i].reset(other.blocks[i]->Clone());
+		const auto& otherBlock = other.blocks[i];
+		if (copyOnWrite && !IsGeomDataLinked(otherBlock.get()))
+			blocks[i] = otherBlock;
+		else
+			blocks[i].reset(otherBlock->Clone());
 	}
 
 	hdr.SetBlockReference(&blocks);
 	LinkGeomData();
 }
 
+void NifFile::MoveFrom(NifFile& other) {
+	if (&other == this)
+		return;
+
+	isValid = other.isValid;
+	hasUnknown = other.hasUnknown;
+	isTerrain = other.isTerrain;
+
+	hdr = std::move(other.hdr);
+	blocks = std::move(other.blocks);
+	hdr.SetBlockReference(&blocks);
+	InvalidateParentIndex();
+
+	other.Clear();
+}
+
 void NifFile::LinkGeomData() {
-	for (auto& block : blocks) {
-		auto geom = dynamic_cast<NiGeometry*>(block.get());
+	for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++) {
+		auto geom = hdr.GetBlock<NiGeometry>(i);
 		if (geom) {
 			auto geomData = hdr.GetBlock(geom->DataRef());
 			if (geomData)
@@ -137,19 +276,20 @@ void NifFile::LinkGeomData() {
 	}
 }
 
-void NifFile::RemoveInvalidTris() const {
+void NifFile::RemoveInvalidTris() {
 	for (auto& shape : GetShapes()) {
 		std::vector<Triangle> tris;
 		if (shape->GetTriangles(tris)) {
 			uint16_t numVerts = shape->GetNumVertices();
-			tris.erase(std::remove_if(tris.begin(),
-									  tris.end(),
-									  [&](auto& t) {
-										  return t.p1 >= numVerts || t.p2 >= numVerts || t.p3 >= numVerts;
-									  }),
-					   tris.end());
+			auto invalidTris = std::remove_if(tris.begin(), tris.end(), [&](auto& t) {
+				return t.p1 >= numVerts || t.p2 >= numVerts || t.p3 >= numVerts;
+			});
+
+			if (invalidTris == tris.end())
+				continue;
 
-			shape->SetTriangles(tris);
+			tris.erase(invalidTris, tris.end());
+			GetBlockForWrite(shape)->SetTriangles(tris);
 		}
 	}
 }
@@ -178,6 +318,57 @@ void NifFile::Clear() {
 
 	blocks.clear();
 	hdr.Clear();
+	InvalidateParentIndex();
+}
+
+NifMemoryUsage NifFile::GetMemoryUsage() const {
+	NifMemoryUsage usage;
+	usage.fileBytes = sizeof(NifFile) + HeapSize(blocks);
+	usage.headerBytes = hdr.GetHeapSize();
+
+	// Counted by type index first, block type names are only looked up once per type
+	std::vector<NifMemoryBlockType> typeUsage;
+	std::vector<uint32_t> typeFirstBlock;
+
+	for (uint32_t i = 0; i < blocks.size(); i++) {
+		const NiObject* block = blocks[i].get();
+		if (!block)
+			continue;
+
+		const size_t objectBytes = block->GetObjectSize();
+		const size_t heapBytes = block->GetHeapSize();
+		usage.objectBytes += objectBytes;
+		usage.heapBytes += heapBytes;
+
+		const uint16_t typeIndex = hdr.GetBlockTypeIndex(i);
+		if (typeIndex == 0xFFFF)
+			continue;
+
+		if (typeIndex >= typeUsage.size()) {
+			typeUsage.resize(typeIndex + 1);
+			typeFirstBlock.resize(typeIndex + 1, NIF_NPOS);
+		}
+
+		if (typeFirstBlock[typeIndex] == NIF_NPOS)
+			typeFirstBlock[typeIndex] = i;
+
+		NifMemoryBlockType& type = typeUsage[typeIndex];
+		type.count++;
+		type.objectBytes += objectBytes;
+		type.heapBytes += heapBytes;
+	}
+
+	for (size_t t = 0; t < typeUsage.size(); t++) {
+		if (typeFirstBlock[t] == NIF_NPOS)
+			continue;
+
+		NifMemoryBlockType& dest = usage.blockTypes[hdr.GetBlockTypeStringById(typeFirstBlock[t])];
+		dest.count += typeUsage[t].count;
+		dest.objectBytes += typeUsage[t].objectBytes;
+		dest.heapBytes += typeUsage[t].heapBytes;
+	}
+
+	return usage;
 }
 
 int NifFile::Load(const std::filesystem::path& fileName, const NifLoadOptions& options) {
@@ -191,13 +382,25 @@ int NifFile::Load(const std::string& fileName, const NifLoadOptions& options) {
 }
 
 int NifFile::Load(std::istream& file, const NifLoadOptions& options) {
+	NIFLY_TRACE_SCOPE("NifFile::Load");
+
+	NifStats* stats = options.stats;
+	StatsPhaseTimer loadTimer(stats, &NifStats::load);
+
 	Clear();
 
 	isTerrain = options.isTerrain;
 
 	if (file) {
+		std::streampos startPos;
+		if (stats)
+			startPos = file.tellg();
+
 		NiIStream stream(&file);
+
+		StatsPhaseTimer headerTimer(stats, &NifStats::readHeader);
 		hdr.Get(stream);
+		headerTimer.Stop();
 
 		if (!hdr.IsValid()) {
 			Clear();
@@ -214,8 +417,23 @@ int NifFile::Load(std::istream& file, const NifLoadOptions& options) {
 		uint32_t nBlocks = hdr.GetNumBlocks();
 		blocks.resize(nBlocks);
 
+		// Counters per block type index, merged into the stats sink by name afterwards
+		std::vector<NifStatsBlockType> typeStats;
+		std::vector<uint32_t> typeFirstBlock;
+		std::streampos blockPos;
+		if (stats) {
+			blockPos = file.tellg();
+			stats->headerBytesRead += StreamDistance(startPos, blockPos);
+		}
+
+		StatsPhaseTimer blocksTimer(stats, &NifStats::readBlocks);
+
 		auto& nifactories = NiFactoryRegister::Get();
 		for (uint32_t i = 0; i < nBlocks; i++) {
+			std::chrono::steady_clock::time_point blockStart;
+			if (stats)
+				blockStart = std::chrono::steady_clock::now();
+
 			std::string blockTypeStr = hdr.GetBlockTypeStringById(i);
 
 			auto nifactory = nifactories.GetFactoryByName(blockTypeStr);
@@ -232,6 +450,44 @@ int NifFile::Load(std::istream& file, const NifLoadOptions& options) {
 				hasUnknown = true;
 				blocks[i].reset(new NiUnknown(stream, hdr.GetBlockSize(i)));
 			}
+
+			if (stats) {
+				const uint16_t typeIndex = hdr.GetBlockTypeIndex(i);
+				if (typeIndex >= typeStats.size()) {
+					typeStats.resize(typeIndex + 1);
+					typeFirstBlock.resize(typeIndex + 1, NIF_NPOS);
+				}
+
+				if (typeFirstBlock[typeIndex] == NIF_NPOS)
+					typeFirstBlock[typeIndex] = i;
+
+				const std::streampos blockEnd = file.tellg();
+				auto elapsed = std::chrono::steady_clock::now() - blockStart;
+
+				NifStatsBlockType& blockStats = typeStats[typeIndex];
+				blockStats.count++;
+				blockStats.bytes += StreamDistance(blockPos, blockEnd);
+				blockStats.ns += static_cast<uint64_t>(
+					std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+				blockPos = blockEnd;
+			}
+		}
+
+		blocksTimer.Stop();
+
+		if (stats) {
+			for (size_t t = 0; t < typeStats.size(); t++) {
+				if (typeFirstBlock[t] == NIF_NPOS)
+					continue;
+
+				NifStatsBlockType& dest = stats->blockTypes[hdr.GetBlockTypeStringById(typeFirstBlock[t])];
+				dest.count += typeStats[t].count;
+				dest.bytes += typeStats[t].bytes;
+				dest.ns += typeStats[t].ns;
+			}
+
+			stats->blocksRead += nBlocks;
+			stats->bytesRead += StreamDistance(startPos, file.tellg());
 		}
 
 		hdr.SetBlockReference(&blocks);
@@ -241,7 +497,7 @@ int NifFile::Load(std::istream& file, const NifLoadOptions& options) {
 		return 1;
 	}
 
-	PrepareData();
+	PrepareData(stats);
 	isValid = true;
 	return 0;
 }
@@ -257,10 +513,7 @@ void NifFile::SetShapeOrder(const std::vector<std::string>& order) {
 	if (order.size() != shapes.size())
 		return;
 
-	SortState sortState{};
-	sortState.newIndices.resize(hdr.GetNumBlocks());
-	for (size_t i = 0; i < sortState.newIndices.size(); i++)
-		sortState.newIndices[i] = static_cast<uint32_t>(i);
+	SortState sortState(hdr.GetNumBlocks());
 
 	for (auto& s : order) {
 		auto shape = FindBlockByName<NiShape>(s);
@@ -274,13 +527,8 @@ void NifFile::SetShapeOrder(const std::vector<std::string>& order) {
 		SetSortIndices(sortState.newIndex, sortState);
 	}
 
-	for (size_t i = 0; i < sortState.newIndices.size(); i++) {
-		uint32_t index = static_cast<uint32_t>(i);
-		if (sortState.visitedIndices.count(index) == 0) {
-			sortState.newIndices[i] = sortState.newIndex++;
-			sortState.visitedIndices.insert(index);
-		}
-	}
+	for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++)
+		sortState.Visit(i);
 
 	hdr.SetBlockOrder(sortState.newIndices);
 }
@@ -308,10 +556,7 @@ void NifFile::SetSortIndices(uint32_t refIndex, SortState& sortState) {
 	}
 	else {
 		// Assign new sort index
-		if (sortState.visitedIndices.count(refIndex) == 0) {
-			sortState.newIndices[refIndex] = sortState.newIndex++;
-			sortState.visitedIndices.insert(refIndex);
-		}
+		sortState.Visit(refIndex);
 	}
 
 	if (!fullySorted) {
@@ -428,7 +673,7 @@ void NifFile::SortCollision(NiObject* parent, uint32_t parentIndex, SortState& s
 	if (constraint) {
 		for (auto& entityId : constraint->entityRefs) {
 			auto entity = hdr.GetBlock<NiObject>(entityId);
-			if (entity && sortState.visitedIndices.count(entityId.index) == 0)
+			if (entity && !sortState.IsVisited(entityId.index))
 				SortCollision(entity, entityId.index, sortState);
 		}
 	}
@@ -437,16 +682,16 @@ void NifFile::SortCollision(NiObject* parent, uint32_t parentIndex, SortState& s
 	if (constraintChain) {
 		for (auto& entityId : constraintChain->chainedEntityRefs) {
 			auto entity = hdr.GetBlock<NiObject>(entityId);
-			if (entity && sortState.visitedIndices.count(entityId.index) == 0)
+			if (entity && !sortState.IsVisited(entityId.index))
 				SortCollision(entity, entityId.index, sortState);
 		}
 
 		auto entityA = hdr.GetBlock<NiObject>(constraintChain->entityARef);
-		if (entityA && sortState.visitedIndices.count(constraintChain->entityARef.index) == 0)
+		if (entityA && !sortState.IsVisited(constraintChain->entityARef.index))
 			SortCollision(entityA, constraintChain->entityARef.index, sortState);
 
 		auto entityB = hdr.GetBlock<NiObject>(constraintChain->entityBRef);
-		if (entityB && sortState.visitedIndices.count(constraintChain->entityBRef.index) == 0)
+		if (entityB && !sortState.IsVisited(constraintChain->entityBRef.index))
 			SortCollision(entityB, constraintChain->entityBRef.index, sortState);
 	}
 
@@ -455,7 +700,7 @@ void NifFile::SortCollision(NiObject* parent, uint32_t parentIndex, SortState& s
 
 	for (auto& id : childIndices) {
 		auto child = hdr.GetBlock<NiObject>(id);
-		if (child && sortState.visitedIndices.count(id) == 0) {
+		if (child && !sortState.IsVisited(id)) {
 			bool childBeforeParent = child->HasType<bhkRefObject>() && !child->HasType<bhkConstraint>()
 									 && !child->HasType<bhkBallSocketConstraintChain>();
 			if (childBeforeParent)
@@ -464,14 +709,11 @@ void NifFile::SortCollision(NiObject* parent, uint32_t parentIndex, SortState& s
 	}
 
 	// Assign new sort index
-	if (sortState.visitedIndices.count(parentIndex) == 0) {
-		sortState.newIndices[parentIndex] = sortState.newIndex++;
-		sortState.visitedIndices.insert(parentIndex);
-	}
+	sortState.Visit(parentIndex);
 
 	for (auto& id : childIndices) {
 		auto child = hdr.GetBlock<NiObject>(id);
-		if (child && sortState.visitedIndices.count(id) == 0) {
+		if (child && !sortState.IsVisited(id)) {
 			bool childBeforeParent = child->HasType<bhkRefObject>() && !child->HasType<bhkConstraint>()
 									 && !child->HasType<bhkBallSocketConstraintChain>();
 			if (!childBeforeParent)
@@ -508,7 +750,8 @@ void NifFile::SortShape(NiShape* shape, SortState& sortState) {
 }
 
 void NifFile::SortGraph(NiNode* root, SortState& sortState) {
-	bool isRootNode = GetBlockID(root) == 0;
+	uint32_t rootId = GetBlockID(root);
+	bool isRootNode = rootId == 0;
 	SortAVObject(root, sortState);
 
 	std::vector<uint32_t> childIndices;
@@ -524,6 +767,13 @@ void NifFile::SortGraph(NiNode* root, SortState& sortState) {
 
 		NiBlockRefArray<NiAVObject> newChildRefs;
 
+		auto addChild = [&](const uint32_t index) {
+			newChildIndices.push_back(index);
+			newChildRefs.AddBlockRef(index);
+			if (index < sortState.addedChildren.size())
+				sortState.addedChildren[index] = true;
+		};
+
 		if (hdr.GetVersion().IsOB() || hdr.GetVersion().IsFO3()) {
 			// Order for OB/FO3:
 			// 1. Nodes with children
@@ -533,10 +783,8 @@ void NifFile::SortGraph(NiNode* root, SortState& sortState) {
 			// Add nodes with children
 			for (auto& index : childIndices) {
 				auto node = hdr.GetBlock<NiNode>(index);
-				if (node && node->childRefs.GetSize() > 0) {
-					newChildIndices.push_back(index);
-					newChildRefs.AddBlockRef(index);
-				}
+				if (node && node->childRefs.GetSize() > 0)
+					addChild(index);
 			}
 
 			// Add shapes
@@ -560,10 +808,8 @@ void NifFile::SortGraph(NiNode* root, SortState& sortState) {
 				}
 			}
 
-			for (auto& index : shapeIndices) {
-				newChildIndices.push_back(index);
-				newChildRefs.AddBlockRef(index);
-			}
+			for (auto& index : shapeIndices)
+				addChild(index);
 		}
 		else {
 			// Order:
@@ -574,10 +820,8 @@ void NifFile::SortGraph(NiNode* root, SortState& sortState) {
 			// Add nodes
 			for (auto& index : childIndices) {
 				auto node = hdr.GetBlock<NiNode>(index);
-				if (node) {
-					newChildIndices.push_back(index);
-					newChildRefs.AddBlockRef(index);
-				}
+				if (node)
+					addChild(index);
 			}
 
 			// Add shapes
@@ -601,33 +845,34 @@ void NifFile::SortGraph(NiNode* root, SortState& sortState) {
 				}
 			}
 
-			for (auto& index : shapeIndices) {
-				newChildIndices.push_back(index);
-				newChildRefs.AddBlockRef(index);
-			}
+			for (auto& index : shapeIndices)
+				addChild(index);
 		}
 
 		// Add missing others
 		for (auto& index : childIndices) {
-			if (!contains(newChildIndices, index)) {
-				auto obj = hdr.GetBlock<NiObject>(index);
-				if (obj) {
-					newChildIndices.push_back(index);
-					newChildRefs.AddBlockRef(index);
-				}
-			}
+			if (index < sortState.addedChildren.size() && sortState.addedChildren[index])
+				continue;
+
+			auto obj = hdr.GetBlock<NiObject>(index);
+			if (obj)
+				addChild(index);
 		}
 
 		// Add empty refs
-		for (auto& index : childIndices) {
-			if (index == NIF_NPOS) {
-				newChildIndices.push_back(index);
-				newChildRefs.AddBlockRef(index);
-			}
+		for (auto& index : childIndices)
+			if (index == NIF_NPOS)
+				addChild(index);
+
+		for (auto& index : newChildIndices)
+			if (index < sortState.addedChildren.size())
+				sortState.addedChildren[index] = false;
+
+		// Assign child ref array with new order, shared blocks are only copied if it changed
+		if (newChildIndices != childIndices) {
+			root = static_cast<NiNode*>(hdr.UnshareBlock(rootId));
+			root->childRefs = newChildRefs;
 		}
-
-		// Assign child ref array with new order
-		root->childRefs = newChildRefs;
 	}
 
 	std::vector<uint32_t> remainingChildIndices;
@@ -642,10 +887,7 @@ void NifFile::PrettySortBlocks() {
 	if (hasUnknown)
 		return;
 
-	SortState sortState{};
-	sortState.newIndices.resize(hdr.GetNumBlocks());
-	for (size_t i = 0; i < sortState.newIndices.size(); i++)
-		sortState.newIndices[i] = static_cast<uint32_t>(i);
+	SortState sortState(hdr.GetNumBlocks());
 
 	auto root = GetRootNode();
 	if (root) {
@@ -653,15 +895,15 @@ void NifFile::PrettySortBlocks() {
 		SetSortIndices(sortState.newIndex, sortState);
 	}
 
-	for (size_t i = 0; i < sortState.newIndices.size(); i++) {
-		uint32_t index = static_cast<uint32_t>(i);
-		if (sortState.visitedIndices.count(index) == 0) {
-			sortState.newIndices[i] = sortState.newIndex++;
-			sortState.visitedIndices.insert(index);
-		}
-	}
+	for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++)
+		sortState.Visit(i);
 
+	const bool parentIndexCurrent = IsParentIndexCurrent();
 	hdr.SetBlockOrder(sortState.newIndices);
+
+	// Only if the blocks were actually moved
+	if (parentIndexCurrent && !IsParentIndexCurrent())
+		RemapParentIndex(sortState.newIndices);
 }
 
 bool NifFile::DeleteUnreferencedNodes(int* deletionCount) {
@@ -697,36 +939,488 @@ bool NifFile::DeleteUnreferencedNodes(int* deletionCount) {
 	return true;
 }
 
+// Blocks that can be used by multiple parents without changing the result
+static bool IsDeduplicable(NiObject* block) {
+	return block->HasType<NiProperty>() || block->HasType<BSShaderTextureSet>()
+		   || block->HasType<NiKeyBasedInterpolator>() || block->HasType<NiBSplineInterpolator>()
+		   || block->HasType<NiKeyframeData>() || block->HasType<NiPosData>() || block->HasType<NiBoolData>()
+		   || block->HasType<NiFloatData>() || block->HasType<NiUVData>() || block->HasType<NiVisData>()
+		   || block->HasType<NiBSplineData>() || block->HasType<NiBSplineBasisData>();
+}
+
+uint32_t NifFile::DeduplicateBlocks() {
+	NIFLY_TRACE_SCOPE("NifFile::DeduplicateBlocks");
+
+	if (hasUnknown)
+		return 0;
+
+	enum class DedupeState : uint8_t { Pending, Visiting, Done };
+
+	const uint32_t numBlocks = hdr.GetNumBlocks();
+	std::vector<uint32_t> survivors(numBlocks);
+	std::vector<DedupeState> states(numBlocks, DedupeState::Pending);
+	std::unordered_map<std::string, uint32_t> survivorsByData;
+
+	// Returns the block that replaces the block, children are merged first
+	std::function<uint32_t(uint32_t)> dedupe = [&](const uint32_t id) -> uint32_t {
+		if (id >= numBlocks)
+			return id;
+
+		if (states[id] == DedupeState::Done)
+			return survivors[id];
+
+		// References in a cycle aren't merged
+		if (states[id] == DedupeState::Visiting)
+			return id;
+
+		survivors[id] = id;
+
+		NiObject* block = blocks[id].get();
+		if (!IsDeduplicable(block)) {
+			states[id] = DedupeState::Done;
+			return id;
+		}
+
+		states[id] = DedupeState::Visiting;
+
+		// References and strings of a copy are normalized, so that the file itself isn't modified
+		std::unique_ptr<NiObject> normalized(block->Clone());
+
+		normalized->ForEachRef([&](NiRef& r) {
+			if (!r.IsEmpty())
+				r.index = dedupe(r.index);
+		});
+
+		normalized->ForEachStringRef([](NiStringRef& str) { str.SetIndex(NIF_NPOS); });
+
+		std::ostringstream data;
+		data << normalized->GetBlockName() << '\0';
+
+		NiOStream stream(&data, hdr.GetVersion());
+		normalized->Put(stream);
+
+		normalized->ForEachStringRef([&](NiStringRef& str) { data << '\0' << str.get(); });
+
+		survivors[id] = survivorsByData.emplace(data.str(), id).first->second;
+		states[id] = DedupeState::Done;
+		return survivors[id];
+	};
+
+	std::vector<bool> removedBlocks(numBlocks);
+	uint32_t deletionCount = 0;
+
+	for (uint32_t i = 0; i < numBlocks; i++) {
+		if (dedupe(i) != i) {
+			removedBlocks[i] = true;
+			deletionCount++;
+		}
+	}
+
+	if (deletionCount == 0)
+		return 0;
+
+	// Redirect references to the survivors, shared blocks are only copied if affected
+	auto isMerged = [&](const NiRef& r) {
+		return !r.IsEmpty() && r.index < numBlocks && survivors[r.index] != r.index;
+	};
+
+	for (uint32_t i = 0; i < numBlocks; i++) {
+		if (removedBlocks[i])
+			continue;
+
+		bool merged = false;
+		blocks[i]->ForEachRef([&](NiRef& r) { merged = merged || isMerged(r); });
+		if (!merged)
+			continue;
+
+		hdr.UnshareBlock(i)->ForEachRef([&](NiRef& r) {
+			if (isMerged(r))
+				r.index = survivors[r.index];
+		});
+	}
+
+	hdr.RemoveBlocks(removedBlocks);
+	return deletionCount;
+}
+
+// FNV-1a, so that hashes are stable across runs and platforms
+constexpr uint64_t HashOffsetBasis = 14695981039346656037ull;
+constexpr uint64_t HashPrime = 1099511628211ull;
+
+static uint64_t HashBytes(uint64_t hash, const char* data, const size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= HashPrime;
+	}
+	return hash;
+}
+
+// Values are hashed as little-endian bytes
+static uint64_t HashValue(uint64_t hash, uint64_t value) {
+	for (int i = 0; i < 8; i++) {
+		hash ^= value & 0xFF;
+		hash *= HashPrime;
+		value >>= 8;
+	}
+	return hash;
+}
+
+// Finalizer of SplitMix64, spreads hashes that are combined by addition
+static uint64_t MixHash(uint64_t hash) {
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+	return hash ^ (hash >> 31);
+}
+
+// Combines the hashes of the referenced blocks in reference order.
+// PrettySortBlocks reorders the children of nodes, so only their set is hashed.
+template<typename ChildHashFn, typename PtrHashFn>
+static uint64_t HashBlockRefs(NiObject* block, ChildHashFn&& childHash, PtrHashFn&& ptrHash) {
+	const std::vector<NiBlockRef<NiAVObject>>* nodeChildRefs = nullptr;
+	auto node = dynamic_cast<NiNode*>(block);
+	if (node && !node->HasType<BSOrderedNode>())
+		nodeChildRefs = &node->childRefs.GetRefs();
+
+	uint64_t orderedHash = HashOffsetBasis;
+	uint64_t unorderedHash = 0;
+	size_t nextNodeChild = 0;
+
+	block->ForEachChildRef([&](NiRef& ref) {
+		const uint64_t hash = childHash(ref.index);
+		const bool isNodeChild = nodeChildRefs && nextNodeChild < nodeChildRefs->size()
+								 && &ref == &(*nodeChildRefs)[nextNodeChild];
+		if (isNodeChild) {
+			unorderedHash += MixHash(hash);
+			nextNodeChild++;
+		}
+		else
+			orderedHash = HashValue(orderedHash, hash);
+	});
+
+	block->ForEachPtr([&](NiRef& p) { orderedHash = HashValue(orderedHash, ptrHash(p.index)); });
+
+	return HashValue(orderedHash, unorderedHash);
+}
+
+// Block hashes of a file, computed on demand and cached
+class NifBlockHasher {
+	enum class HashState : uint8_t { Pending, Visiting, Done };
+
+	const NiHeader& hdr;
+	const std::vector<std::shared_ptr<NiObject>>& blocks;
+	const bool ignoreBlockOrder;
+
+	std::vector<uint64_t> localHashes;
+	std::vector<bool> hasLocalHash;
+	std::vector<uint64_t> blockHashes;
+	std::vector<HashState> states;
+
+	// Hashes the block data with normalized strings and optionally without references
+	uint64_t HashData(const uint32_t id, const bool clearRefs) const {
+		std::unique_ptr<NiObject> normalized(blocks[id]->Clone());
+
+		if (clearRefs)
+			normalized->ForEachRef([](NiRef& r) { r.Clear(); });
+
+		normalized->ForEachStringRef([](NiStringRef& str) { str.SetIndex(NIF_NPOS); });
+
+		std::ostringstream data;
+		data << normalized->GetBlockName() << '\0';
+
+		NiOStream stream(&data, hdr.GetVersion());
+		normalized->Put(stream);
+
+		normalized->ForEachStringRef([&](NiStringRef& str) { data << '\0' << str.get(); });
+
+		const std::string bytes = data.str();
+		return HashBytes(HashOffsetBasis, bytes.data(), bytes.size());
+	}
+
+public:
+	NifBlockHasher(const NiHeader& header,
+				   const std::vector<std::shared_ptr<NiObject>>& fileBlocks,
+				   const bool ignoreOrder)
+		: hdr(header)
+		, blocks(fileBlocks)
+		, ignoreBlockOrder(ignoreOrder)
+		, localHashes(fileBlocks.size())
+		, hasLocalHash(fileBlocks.size())
+		, blockHashes(fileBlocks.size())
+		, states(fileBlocks.size(), HashState::Pending) {}
+
+	// Hash of the block data without references
+	uint64_t LocalHash(const uint32_t id) {
+		if (id >= blocks.size())
+			return HashValue(HashOffsetBasis, NIF_NPOS);
+
+		if (!hasLocalHash[id]) {
+			localHashes[id] = HashData(id, true);
+			hasLocalHash[id] = true;
+		}
+		return localHashes[id];
+	}
+
+	uint64_t BlockHash(const uint32_t id) {
+		if (id >= blocks.size())
+			return HashValue(HashOffsetBasis, NIF_NPOS);
+
+		if (states[id] == HashState::Done)
+			return blockHashes[id];
+
+		// References in a cycle only contribute their own data
+		if (states[id] == HashState::Visiting)
+			return LocalHash(id);
+
+		if (!ignoreBlockOrder) {
+			blockHashes[id] = HashData(id, false);
+			states[id] = HashState::Done;
+			return blockHashes[id];
+		}
+
+		states[id] = HashState::Visiting;
+
+		// Pointers point upwards, so only the data of their targets is used
+		const uint64_t refsHash = HashBlockRefs(
+			blocks[id].get(),
+			[&](const uint32_t childId) { return BlockHash(childId); },
+			[&](const uint32_t ptrId) { return LocalHash(ptrId); });
+
+		uint64_t hash = LocalHash(id);
+		hash = HashValue(hash, refsHash);
+
+		blockHashes[id] = hash;
+		states[id] = HashState::Done;
+		return hash;
+	}
+};
+
+uint64_t NifFile::GetBlockHash(const uint32_t blockId, const bool ignoreBlockOrder) const {
+	NifBlockHasher hasher(hdr, blocks, ignoreBlockOrder);
+	return hasher.BlockHash(blockId);
+}
+
+// Root node ID like GetRootNode, without copying shared blocks
+static uint32_t FindRootNodeId(const std::vector<std::shared_ptr<NiObject>>& blocks) {
+	for (uint32_t i = 0; i < blocks.size(); i++)
+		if (dynamic_cast<NiNode*>(blocks[i].get()))
+			return i;
+
+	return NIF_NPOS;
+}
+
+uint64_t NifFile::GetFileHash(const bool ignoreBlockOrder) const {
+	NIFLY_TRACE_SCOPE("NifFile::GetFileHash");
+
+	const NiVersion& version = hdr.GetVersion();
+	uint64_t hash = HashValue(HashOffsetBasis, static_cast<uint32_t>(version.File()));
+	hash = HashValue(hash, version.User());
+	hash = HashValue(hash, version.Stream());
+	hash = HashValue(hash, blocks.size());
+
+	NifBlockHasher hasher(hdr, blocks, ignoreBlockOrder);
+	if (!ignoreBlockOrder) {
+		for (uint32_t i = 0; i < blocks.size(); i++)
+			hash = HashValue(hash, hasher.BlockHash(i));
+
+		return hash;
+	}
+
+	// The root hash covers the structure, the sum also covers blocks that aren't reachable from it
+	uint64_t blocksHash = 0;
+	for (uint32_t i = 0; i < blocks.size(); i++)
+		blocksHash += MixHash(hasher.BlockHash(i));
+
+	hash = HashValue(hash, blocksHash);
+	hash = HashValue(hash, hasher.BlockHash(FindRootNodeId(blocks)));
+	return hash;
+}
+
+// Identifies a block among its siblings by block type and name
+static uint64_t GetBlockIdentity(NiObject* block) {
+	std::string identity = block->GetBlockName();
+
+	if (auto objNET = dynamic_cast<NiObjectNET*>(block))
+		identity += '\0' + objNET->name.get();
+	else if (auto extraData = dynamic_cast<NiExtraData*>(block))
+		identity += '\0' + extraData->name.get();
+
+	return HashBytes(HashOffsetBasis, identity.data(), identity.size());
+}
+
+// Returns a key for each block, built from the block identities on the path from the root node.
+// Blocks that aren't reachable from the root node are keyed by their identity only.
+static std::vector<uint64_t> GetBlockPathKeys(const std::vector<std::shared_ptr<NiObject>>& blocks) {
+	const auto numBlocks = static_cast<uint32_t>(blocks.size());
+	std::vector<uint64_t> keys(numBlocks);
+	std::vector<bool> hasKey(numBlocks);
+
+	// Sibling occurrences of the same identity are numbered
+	auto assignKey = [&](const uint32_t id,
+						 const uint64_t parentKey,
+						 std::unordered_map<uint64_t, uint32_t>& occurrences) {
+		const uint64_t identity = GetBlockIdentity(blocks[id].get());
+		const uint32_t occurrence = occurrences[identity]++;
+		keys[id] = HashValue(HashValue(parentKey, identity), occurrence);
+		hasKey[id] = true;
+	};
+
+	const uint32_t rootId = FindRootNodeId(blocks);
+	if (rootId != NIF_NPOS) {
+		std::unordered_map<uint64_t, uint32_t> rootOccurrences;
+		assignKey(rootId, HashOffsetBasis, rootOccurrences);
+
+		std::queue<uint32_t> queue;
+		queue.push(rootId);
+
+		std::vector<uint32_t> childIndices;
+		while (!queue.empty()) {
+			const uint32_t id = queue.front();
+			queue.pop();
+
+			childIndices.clear();
+			blocks[id]->GetChildIndices(childIndices);
+
+			std::unordered_map<uint64_t, uint32_t> occurrences;
+			for (auto& childId : childIndices) {
+				if (childId >= numBlocks || hasKey[childId])
+					continue;
+
+				assignKey(childId, keys[id], occurrences);
+				queue.push(childId);
+			}
+		}
+	}
+
+	std::unordered_map<uint64_t, uint32_t> looseOccurrences;
+	const uint64_t looseKey = HashValue(HashOffsetBasis, NIF_NPOS);
+	for (uint32_t i = 0; i < numBlocks; i++)
+		if (!hasKey[i])
+			assignKey(i, looseKey, looseOccurrences);
+
+	return keys;
+}
+
+NifDiff NifFile::Diff(const NifFile& other, const bool ignoreBlockOrder) const {
+	NIFLY_TRACE_SCOPE("NifFile::Diff");
+
+	NifDiff diff;
+	NifBlockHasher hasher(hdr, blocks, ignoreBlockOrder);
+	NifBlockHasher otherHasher(other.hdr, other.blocks, ignoreBlockOrder);
+
+	const auto numBlocks = static_cast<uint32_t>(blocks.size());
+	const auto otherNumBlocks = static_cast<uint32_t>(other.blocks.size());
+
+	// Versions affect the data of all blocks
+	const NiVersion& version = hdr.GetVersion();
+	const NiVersion& otherVersion = other.hdr.GetVersion();
+	const bool sameVersion = version.File() == otherVersion.File() && version.User() == otherVersion.User()
+							 && version.Stream() == otherVersion.Stream();
+
+	if (!ignoreBlockOrder) {
+		const uint32_t numCompared = std::min(numBlocks, otherNumBlocks);
+		for (uint32_t i = 0; i < numCompared; i++)
+			if (!sameVersion || hasher.BlockHash(i) != otherHasher.BlockHash(i))
+				diff.changed.emplace_back(i, i);
+
+		for (uint32_t i = numCompared; i < numBlocks; i++)
+			diff.removed.push_back(i);
+		for (uint32_t i = numCompared; i < otherNumBlocks; i++)
+			diff.added.push_back(i);
+
+		return diff;
+	}
+
+	const std::vector<uint64_t> keys = GetBlockPathKeys(blocks);
+	const std::vector<uint64_t> otherKeys = GetBlockPathKeys(other.blocks);
+
+	std::unordered_map<uint64_t, uint32_t> otherIdsByKey;
+	for (uint32_t i = 0; i < otherNumBlocks; i++)
+		otherIdsByKey.emplace(otherKeys[i], i);
+
+	// References are compared by the path keys of their targets
+	const uint64_t missingKey = HashValue(HashOffsetBasis, NIF_NPOS);
+	auto getKey = [&](const uint32_t id) { return id < numBlocks ? keys[id] : missingKey; };
+	auto getOtherKey = [&](const uint32_t id) { return id < otherNumBlocks ? otherKeys[id] : missingKey; };
+
+	std::vector<bool> otherMatched(otherNumBlocks);
+	for (uint32_t i = 0; i < numBlocks; i++) {
+		auto it = otherIdsByKey.find(keys[i]);
+		if (it == otherIdsByKey.end() || otherMatched[it->second]) {
+			diff.removed.push_back(i);
+			continue;
+		}
+
+		const uint32_t otherId = it->second;
+		otherMatched[otherId] = true;
+
+		if (!sameVersion || hasher.LocalHash(i) != otherHasher.LocalHash(otherId)
+			|| HashBlockRefs(blocks[i].get(), getKey, getKey)
+				   != HashBlockRefs(other.blocks[otherId].get(), getOtherKey, getOtherKey))
+			diff.changed.emplace_back(i, otherId);
+	}
+
+	for (uint32_t i = 0; i < otherNumBlocks; i++)
+		if (!otherMatched[i])
+			diff.added.push_back(i);
+
+	return diff;
+}
+
 NiNode* NifFile::AddNode(const std::string& nodeName, const MatTransform& xformToParent, NiNode* parent) {
 	if (!parent)
 		parent = GetRootNode();
 	if (!parent)
 		return nullptr;
 
+	parent = GetBlockForWrite(parent);
+
 	std::unique_ptr<NiNode> newNode(new NiNode);
 	newNode->name.get() = nodeName;
 	newNode->SetTransformToParent(xformToParent);
 
+	const bool parentIndexCurrent = IsParentIndexCurrent();
+
 	uint32_t newNodeId = hdr.AddBlock(newNode.release());
-	if (newNodeId != NIF_NPOS)
+	if (newNodeId != NIF_NPOS) {
 		parent->childRefs.AddBlockRef(newNodeId);
 
+		if (parentIndexCurrent) {
+			parentIndex.push_back(NIF_NPOS);
+			parentIndexRevision = hdr.GetBlockListRevision();
+			SetParentNodeID(newNodeId, GetBlockID(parent));
+		}
+	}
+
 	return hdr.GetBlockUnsafe<NiNode>(newNodeId);
 }
 
 void NifFile::DeleteNode(const std::string& nodeName) {
-	hdr.DeleteBlock(GetBlockID(FindBlockByName<NiNode>(nodeName)));
+	const uint32_t nodeId = GetBlockID(FindBlockByName<NiNode>(nodeName));
+	if (nodeId == NIF_NPOS)
+		return;
+
+	const bool parentIndexCurrent = IsParentIndexCurrent();
+	hdr.DeleteBlock(nodeId);
+
+	if (parentIndexCurrent) {
+		// Children of the node don't have a parent anymore
+		std::vector<uint32_t> newIndices(blocks.size() + 1);
+		for (uint32_t i = 0; i < newIndices.size(); i++)
+			newIndices[i] = i < nodeId ? i : i - 1;
+
+		newIndices[nodeId] = NIF_NPOS;
+		RemapParentIndex(newIndices);
+	}
 }
 
 bool NifFile::CanDeleteNode(NiNode* node) {
 	if (!node)
 		return false;
 
-	std::set<NiRef*> refs;
-	node->GetChildRefs(refs);
-
 	// Only delete if the node has no child refs
-	return std::all_of(refs.cbegin(), refs.cend(), [](auto&& ref) { return ref->IsEmpty(); });
+	bool hasChildRefs = false;
+	node->ForEachChildRef([&](NiRef& ref) { hasChildRefs = hasChildRefs || !ref.IsEmpty(); });
+	return !hasChildRefs;
 }
 
 bool NifFile::CanDeleteNode(const std::string& nodeName) const {
@@ -748,7 +1442,7 @@ std::string NifFile::GetNodeName(const uint32_t blockID) const {
 }
 
 void NifFile::SetNodeName(const uint32_t blockID, const std::string& newName) {
-	auto node = hdr.GetBlock<NiNode>(blockID);
+	auto node = hdr.GetBlockForWrite<NiNode>(blockID);
 	if (!node)
 		return;
 
@@ -757,6 +1451,7 @@ void NifFile::SetNodeName(const uint32_t blockID, const std::string& newName) {
 
 uint32_t NifFile::AssignExtraData(NiAVObject* target, NiExtraData* extraData) {
 	int extraDataId = hdr.AddBlock(extraData);
+	target = GetBlockForWrite(target);
 	target->extraDataRefs.AddBlockRef(extraDataId);
 	return extraDataId;
 }
@@ -988,6 +1683,7 @@ void NifFile::SetTextureSlot(NiShape* shape, std::string& inTexFile, uint32_t te
 	if (shader) {
 		auto textureSet = hdr.GetBlock(shader->TextureSetRef());
 		if (textureSet && texIndex + 1 <= textureSet->textures.size()) {
+			textureSet = hdr.GetBlockForWrite(shader->TextureSetRef());
 			textureSet->textures[texIndex].get() = inTexFile;
 			return;
 		}
@@ -995,6 +1691,7 @@ void NifFile::SetTextureSlot(NiShape* shape, std::string& inTexFile, uint32_t te
 		if (!textureSet) {
 			auto effectShader = dynamic_cast<BSEffectShaderProperty*>(shader);
 			if (effectShader) {
+				effectShader = GetBlockForWrite(effectShader);
 				switch (texIndex) {
 					case 0: effectShader->sourceTexture.get() = inTexFile; break;
 					case 1: effectShader->normalTexture.get() = inTexFile; break;
@@ -1010,13 +1707,13 @@ void NifFile::SetTextureSlot(NiShape* shape, std::string& inTexFile, uint32_t te
 	// Set texture path in referenced NiSourceTexture block
 	auto setSourceTexturePath = [&hdr = hdr](const NiBlockRef<NiSourceTexture>& sourceRef,
 											 const std::string& texturePath) {
-		auto sourceTexture = hdr.GetBlock(sourceRef);
+		auto sourceTexture = hdr.GetBlockForWrite(sourceRef);
 		if (sourceTexture)
 			sourceTexture->fileName.get() = texturePath;
 	};
 
 	// NiTexturingProperty and NiSourceTexture for OB
-	auto texturingProp = GetTexturingProperty(shape);
+	auto texturingProp = GetBlockForWrite(GetTexturingProperty(shape));
 	if (texturingProp) {
 		texturingProp->textureCount = texIndex + 1;
 
@@ -1102,43 +1799,54 @@ void NifFile::TrimTexturePaths() {
 		return tex;
 	};
 
-	// Trim texture path in referenced NiSourceTexture block
-	auto trimSourceTexturePath = [&hdr = hdr,
-								  &fTrimPath = fTrimPath](const NiBlockRef<NiSourceTexture>& sourceRef) {
-		auto sourceTexture = hdr.GetBlock(sourceRef);
-		if (sourceTexture) {
-			std::string tex = sourceTexture->fileName.get();
-			sourceTexture->fileName.get() = fTrimPath(tex);
+	// Trims the texture paths of a block, shared blocks are only copied if a path changes
+	auto trimBlockPaths = [&](auto* block, auto getPaths) {
+		if (!block)
+			return;
+
+		bool changed = false;
+		for (std::string* path : getPaths(block)) {
+			std::string tex = *path;
+			changed = changed || fTrimPath(tex) != *path;
+		}
+
+		if (!changed)
+			return;
+
+		block = GetBlockForWrite(block);
+		for (std::string* path : getPaths(block)) {
+			std::string tex = *path;
+			*path = fTrimPath(tex);
 		}
 	};
 
+	// Trim texture path in referenced NiSourceTexture block
+	auto trimSourceTexturePath = [&](const NiBlockRef<NiSourceTexture>& sourceRef) {
+		trimBlockPaths(hdr.GetBlock(sourceRef), [](NiSourceTexture* sourceTexture) {
+			return std::vector<std::string*>{&sourceTexture->fileName.get()};
+		});
+	};
+
 	for (auto& shape : GetShapes()) {
 		auto shader = GetShader(shape);
 		if (shader) {
 			auto textureSet = hdr.GetBlock(shader->TextureSetRef());
 			if (textureSet) {
-				for (auto& i : textureSet->textures) {
-					std::string tex = i.get();
-					i.get() = fTrimPath(tex);
-				}
-
-				auto effectShader = dynamic_cast<BSEffectShaderProperty*>(shader);
-				if (effectShader) {
-					std::string tex = effectShader->sourceTexture.get();
-					effectShader->sourceTexture.get() = fTrimPath(tex);
-
-					tex = effectShader->normalTexture.get();
-					effectShader->normalTexture.get() = fTrimPath(tex);
-
-					tex = effectShader->greyscaleTexture.get();
-					effectShader->greyscaleTexture.get() = fTrimPath(tex);
-
-					tex = effectShader->envMapTexture.get();
-					effectShader->envMapTexture.get() = fTrimPath(tex);
-
-					tex = effectShader->envMaskTexture.get();
-					effectShader->envMaskTexture.get() = fTrimPath(tex);
-				}
+				trimBlockPaths(textureSet, [](BSShaderTextureSet* set) {
+					std::vector<std::string*> paths;
+					for (auto& i : set->textures)
+						paths.push_back(&i.get());
+					return paths;
+				});
+
+				trimBlockPaths(dynamic_cast<BSEffectShaderProperty*>(shader),
+							   [](BSEffectShaderProperty* effectShader) {
+								   return std::vector<std::string*>{&effectShader->sourceTexture.get(),
+																	&effectShader->normalTexture.get(),
+																	&effectShader->greyscaleTexture.get(),
+																	&effectShader->envMapTexture.get(),
+																	&effectShader->envMaskTexture.get()};
+							   });
 			}
 		}
 
@@ -1173,6 +1881,8 @@ void NifFile::CloneChildren(NiObject* block, NifFile* srcNif) {
 	if (!srcNif)
 		srcNif = this;
 
+	block = GetBlockForWrite(block);
+
 	// Assign new refs and strings, rebind ptrs where possible
 	std::function<void(NiObject*, uint32_t, uint32_t)> cloneBlock =
 		[&](NiObject* b, uint32_t parentOldId, uint32_t parentNewId) -> void {
@@ -1221,7 +1931,8 @@ NiShape* NifFile::CloneShape(NiShape* srcShape, const std::string& destShapeName
 	if (!srcShape)
 		return nullptr;
 
-	auto rootNode = GetRootNode();
+	// Copied shapes and bones are added to the root node
+	auto rootNode = GetBlockForWrite(GetRootNode());
 	auto srcRootNode = srcNif->GetRootNode();
 
 	// Geometry
@@ -1232,9 +1943,12 @@ NiShape* NifFile::CloneShape(NiShape* srcShape, const std::string& destShapeName
 	int destId = hdr.AddBlock(destShapeS.release());
 	if (srcNif == this) {
 		// Assign copied geometry to the same parent
-		auto parentNode = GetParentNode(srcShape);
-		if (parentNode)
+		const uint32_t parentId = GetParentNodeID(GetBlockID(srcShape));
+		auto parentNode = hdr.GetBlockForWrite<NiNode>(parentId);
+		if (parentNode) {
 			parentNode->childRefs.AddBlockRef(destId);
+			SetParentNodeID(destId, parentId);
+		}
 	}
 	else if (rootNode)
 		rootNode->childRefs.AddBlockRef(destId);
@@ -1287,6 +2001,7 @@ NiShape* NifFile::CloneShape(NiShape* srcShape, const std::string& destShapeName
 			if (!node) {
 				// Clone missing node into the right parent
 				boneID = CloneNamedNode(boneName, srcNif);
+				nodeParent = GetBlockForWrite(nodeParent);
 				nodeParent->childRefs.AddBlockRef(boneID);
 			}
 			else {
@@ -1296,127 +2011,631 @@ NiShape* NifFile::CloneShape(NiShape* srcShape, const std::string& destShapeName
 					MatTransform xformToParent;
 					srcNif->GetNodeTransformToParent(boneName, xformToParent);
 
-					std::set<NiRef*> childRefs;
-					oldParent->GetChildRefs(childRefs);
-					for (auto& ref : childRefs)
-						if (ref->index == boneID)
-							ref->Clear();
+					oldParent = GetBlockForWrite(oldParent);
+					oldParent->ForEachChildRef([&](NiRef& ref) {
+						if (ref.index == boneID)
+							ref.Clear();
+					});
 
+					nodeParent = GetBlockForWrite(nodeParent);
 					nodeParent->childRefs.AddBlockRef(boneID);
+					SetParentNodeID(boneID, GetBlockID(nodeParent));
 					SetNodeTransformToParent(boneName, xformToParent);
 				}
 			}
 
-			// Recurse children
-			for (auto& child : srcNode->childRefs) {
-				auto childNode = srcNif->hdr.GetBlock<NiNode>(child);
-				if (childNode)
-					cloneNodes(childNode);
-			}
-		};
+			// Recurse children
+			for (auto& child : srcNode->childRefs) {
+				auto childNode = srcNif->hdr.GetBlock<NiNode>(child);
+				if (childNode)
+					cloneNodes(childNode);
+			}
+		};
+
+		for (auto& child : srcRootNode->childRefs) {
+			auto srcChildNode = srcNif->hdr.GetBlock<NiNode>(child);
+			if (srcChildNode)
+				cloneNodes(srcChildNode);
+		}
+	}
+
+	// Add bones to container if used in skin
+	if (destBoneCont) {
+		for (auto& boneName : srcBoneList) {
+			auto node = FindBlockByName<NiNode>(boneName);
+			int boneID = GetBlockID(node);
+			if (node)
+				destBoneCont->boneRefs.AddBlockRef(boneID);
+		}
+	}
+	return destShape;
+}
+
+uint32_t NifFile::CloneNamedNode(const std::string& nodeName, NifFile* srcNif) {
+	if (!srcNif)
+		srcNif = this;
+
+	auto srcNode = srcNif->FindBlockByName<NiNode>(nodeName);
+	if (!srcNode)
+		return NIF_NPOS;
+
+	std::unique_ptr<NiNode> destNode(srcNode->Clone());
+	destNode->name.get() = nodeName;
+	destNode->collisionRef.Clear();
+	destNode->controllerRef.Clear();
+	destNode->childRefs.Clear();
+	destNode->effectRefs.Clear();
+
+	return hdr.AddBlock(destNode.release());
+}
+
+uint32_t NifFile::TransplantSubtree(NifFile& srcNif, NiAVObject* root, NiNode* destParent) {
+	NIFLY_TRACE_SCOPE("NifFile::TransplantSubtree");
+
+	// Unknown blocks could reference blocks of the subtree
+	if (&srcNif == this || srcNif.hasUnknown)
+		return NIF_NPOS;
+
+	if (!destParent)
+		destParent = GetRootNode();
+
+	const uint32_t srcRootId = srcNif.GetBlockID(root);
+	if (!destParent || srcRootId == NIF_NPOS)
+		return NIF_NPOS;
+
+	const uint32_t srcNumBlocks = srcNif.hdr.GetNumBlocks();
+	std::vector<uint32_t> childIndices;
+
+	// Collect the subtree, blocks are only read from the source file until they're moved
+	std::vector<uint32_t> subtree;
+	std::vector<bool> inSubtree(srcNumBlocks);
+	std::vector<uint32_t> pending{srcRootId};
+	inSubtree[srcRootId] = true;
+
+	while (!pending.empty()) {
+		const uint32_t id = pending.back();
+		pending.pop_back();
+		subtree.push_back(id);
+
+		childIndices.clear();
+		srcNif.blocks[id]->GetChildIndices(childIndices);
+
+		for (auto it = childIndices.rbegin(); it != childIndices.rend(); ++it) {
+			if (*it < srcNumBlocks && !inSubtree[*it]) {
+				inSubtree[*it] = true;
+				pending.push_back(*it);
+			}
+		}
+	}
+
+	// Blocks that are also referenced from outside of the subtree (and their children) are kept
+	std::vector<bool> keep(srcNumBlocks);
+	for (uint32_t i = 0; i < srcNumBlocks; i++) {
+		if (inSubtree[i])
+			continue;
+
+		srcNif.blocks[i]->ForEachRef([&](NiRef& r) {
+			if (!r.IsEmpty() && r.index < srcNumBlocks && r.index != srcRootId && inSubtree[r.index]
+				&& !keep[r.index]) {
+				keep[r.index] = true;
+				pending.push_back(r.index);
+			}
+		});
+	}
+
+	while (!pending.empty()) {
+		const uint32_t id = pending.back();
+		pending.pop_back();
+
+		childIndices.clear();
+		srcNif.blocks[id]->GetChildIndices(childIndices);
+
+		for (auto& c : childIndices) {
+			if (c < srcNumBlocks && c != srcRootId && inSubtree[c] && !keep[c]) {
+				keep[c] = true;
+				pending.push_back(c);
+			}
+		}
+	}
+
+	// Move or share the blocks
+	const uint32_t firstDestId = hdr.GetNumBlocks();
+	std::vector<uint32_t> destIndices(srcNumBlocks, NIF_NPOS);
+
+	for (auto& id : subtree) {
+		auto& srcBlock = srcNif.blocks[id];
+		if (!keep[id])
+			destIndices[id] = hdr.AddBlock(std::move(srcBlock));
+		else if (IsGeomDataLinked(srcBlock.get()))
+			destIndices[id] = hdr.AddBlock(srcBlock->Clone());
+		else
+			destIndices[id] = hdr.AddBlock(srcBlock);
+	}
+
+	// Pointers to nodes outside of the subtree are resolved by name
+	std::unordered_map<std::string, uint32_t> destNodeIds;
+	std::unordered_map<uint32_t, uint32_t> resolvedPtrs;
+
+	auto resolvePtr = [&](const uint32_t srcId) -> uint32_t {
+		auto resolved = resolvedPtrs.find(srcId);
+		if (resolved != resolvedPtrs.end())
+			return resolved->second;
+
+		auto srcNode = srcId < srcNumBlocks ? dynamic_cast<NiNode*>(srcNif.blocks[srcId].get()) : nullptr;
+		if (!srcNode)
+			return resolvedPtrs[srcId] = NIF_NPOS;
+
+		if (destNodeIds.empty()) {
+			for (uint32_t i = 0; i < firstDestId; i++) {
+				auto node = dynamic_cast<NiNode*>(blocks[i].get());
+				if (node)
+					destNodeIds.emplace(node->name.get(), i);
+			}
+		}
+
+		auto destNodeId = destNodeIds.find(srcNode->name.get());
+		if (destNodeId != destNodeIds.end())
+			return resolvedPtrs[srcId] = destNodeId->second;
+
+		// Add missing node without its children and references
+		std::unique_ptr<NiNode> destNode(srcNode->Clone());
+		destNode->childRefs.Clear();
+		destNode->effectRefs.Clear();
+		destNode->extraDataRefs.Clear();
+		destNode->propertyRefs.Clear();
+
+		destNode->ForEachRef([](NiRef& r) { r.Clear(); });
+
+		destNode->name.SetIndex(hdr.AddOrFindStringId(destNode->name.get()));
+
+		const uint32_t newNodeId = hdr.AddBlock(destNode.release());
+		auto rootNode = GetBlockForWrite(GetRootNode());
+		if (rootNode)
+			rootNode->childRefs.AddBlockRef(newNodeId);
+
+		destNodeIds.emplace(srcNode->name.get(), newNodeId);
+		return resolvedPtrs[srcId] = newNodeId;
+	};
+
+	// Assigns the references and strings of this file, returns true if anything changed
+	auto remapBlock = [&](NiObject* block, const bool apply) {
+		bool changed = false;
+
+		block->ForEachChildRef([&](NiRef& r) {
+			if (!r.IsEmpty()) {
+				uint32_t index = r.index < srcNumBlocks ? destIndices[r.index] : NIF_NPOS;
+				changed |= index != r.index;
+				if (apply)
+					r.index = index;
+			}
+		});
+
+		block->ForEachPtr([&](NiRef& p) {
+			if (!p.IsEmpty()) {
+				uint32_t index = p.index < srcNumBlocks && inSubtree[p.index] ? destIndices[p.index]
+																			  : resolvePtr(p.index);
+				changed |= index != p.index;
+				if (apply)
+					p.index = index;
+			}
+		});
+
+		block->ForEachStringRef([&](NiStringRef& str) {
+			bool addEmpty = (str.GetIndex() != NIF_NPOS);
+			uint32_t stringId = hdr.AddOrFindStringId(str.get(), addEmpty);
+			changed |= stringId != str.GetIndex();
+			if (apply)
+				str.SetIndex(stringId);
+		});
+
+		return changed;
+	};
+
+	const auto numMoved = static_cast<uint32_t>(subtree.size());
+	for (uint32_t destId = firstDestId; destId < firstDestId + numMoved; destId++) {
+		NiObject* block = blocks[destId].get();
+
+		// Shared blocks are only copied if their references or strings change
+		if (hdr.IsBlockShared(destId)) {
+			if (!remapBlock(block, false))
+				continue;
+
+			block = hdr.UnshareBlock(destId);
+		}
+
+		remapBlock(block, true);
+	}
+
+	for (uint32_t destId = firstDestId; destId < firstDestId + numMoved; destId++) {
+		auto geom = hdr.GetBlock<NiGeometry>(destId);
+		if (geom)
+			geom->SetGeomData(hdr.GetBlock(geom->DataRef()));
+	}
+
+	const uint32_t destRootId = destIndices[srcRootId];
+	destParent = GetBlockForWrite(destParent);
+	destParent->childRefs.AddBlockRef(destRootId);
+
+	// Remove the moved blocks from the source file
+	std::vector<bool> removedBlocks(srcNumBlocks);
+	for (auto& id : subtree)
+		removedBlocks[id] = !keep[id];
+
+	srcNif.hdr.RemoveBlocks(removedBlocks);
+	return destRootId;
+}
+
+int NifFile::Save(const std::filesystem::path& fileName, const NifSaveOptions& options) {
+	std::ofstream file(fileName, std::ios::out | std::ios::binary);
+	return Save(file, options);
+}
+
+int NifFile::Save(const std::string& fileName, const NifSaveOptions& options) {
+	std::ofstream file(fileName, std::ios::out | std::ios::binary);
+	return Save(file, options);
+}
+
+int NifFile::Save(std::ostream& file, const NifSaveOptions& options) {
+	NIFLY_TRACE_SCOPE("NifFile::Save");
+
+	NifStats* stats = options.stats;
+	StatsPhaseTimer saveTimer(stats, &NifStats::save);
+
+	if (file) {
+		if (hdr.GetVersion().IsFO76())
+			return 76;
+
+		PrepareSave(options);
+		WriteFile(file, stats);
+	}
+	else
+		return 1;
+
+	return 0;
+}
+
+// Stream buffer over memory of a fixed size, so that file data doesn't need to be copied.
+// Reading or writing past the end fails.
+class NifMemoryBuffer : public std::streambuf {
+	char* begin = nullptr;
+	char* end = nullptr;
+
+public:
+	NifMemoryBuffer(char* data, const size_t size)
+		: begin(data)
+		, end(data + size) {
+		setg(begin, begin, end);
+		setp(begin, end);
+	}
+
+protected:
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+		const bool in = (which & std::ios_base::in) != 0;
+		const bool out = (which & std::ios_base::out) != 0;
+		if (in == out && dir == std::ios_base::cur)
+			return pos_type(off_type(-1));
+
+		off_type pos = off;
+		if (dir == std::ios_base::cur)
+			pos += in ? gptr() - begin : pptr() - begin;
+		else if (dir == std::ios_base::end)
+			pos += end - begin;
+
+		if (pos < 0 || pos > end - begin)
+			return pos_type(off_type(-1));
+
+		if (in)
+			setg(begin, begin + pos, end);
+
+		if (out) {
+			setp(begin, end);
+			pbump(static_cast<int>(pos));
+		}
+
+		return pos_type(pos);
+	}
+
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+};
+
+int NifFile::Save(std::vector<uint8_t>& data, const NifSaveOptions& options) {
+	NIFLY_TRACE_SCOPE("NifFile::Save");
+
+	NifStats* stats = options.stats;
+	StatsPhaseTimer saveTimer(stats, &NifStats::save);
+
+	if (hdr.GetVersion().IsFO76())
+		return 76;
+
+	PrepareSave(options);
+
+	// Counted first, so that the file is written in one pass into a buffer of the exact size
+	data.resize(static_cast<size_t>(CountSerializedSize().GetTotal()));
+
+	NifMemoryBuffer buffer(reinterpret_cast<char*>(data.data()), data.size());
+	std::ostream file(&buffer);
+	WriteFile(file, stats);
+
+	if (!file || file.tellp() != std::streampos(static_cast<std::streamoff>(data.size()))) {
+		data.clear();
+		return 1;
+	}
+
+	return 0;
+}
+
+NifSerializedSize NifFile::CalcSerializedSize(const NifSaveOptions& options) {
+	NIFLY_TRACE_SCOPE("NifFile::CalcSerializedSize");
+
+	if (hdr.GetVersion().IsFO76())
+		return NifSerializedSize();
+
+	PrepareSave(options);
+	return CountSerializedSize();
+}
+
+void NifFile::PrepareSave(const NifSaveOptions& options) {
+	NifStats* stats = options.stats;
+
+	StatsPhaseTimer finalizeTimer(stats, &NifStats::finalizeData);
+	FinalizeData();
+	finalizeTimer.Stop();
+
+	if (options.optimize) {
+		StatsPhaseTimer optimizeTimer(stats, &NifStats::optimize);
+		Optimize();
+	}
+
+	if (options.sortBlocks) {
+		StatsPhaseTimer sortTimer(stats, &NifStats::sortBlocks);
+		PrettySortBlocks();
+	}
+}
+
+// Root references after the blocks
+static void WriteFooter(NiOStream& stream) {
+	uint32_t endPad = 1;
+	stream << endPad;
+	endPad = 0;
+	stream << endPad;
+}
+
+void NifFile::WriteFile(std::ostream& file, NifStats* stats) {
+	NiOStream stream(&file, hdr.GetVersion());
+
+	std::streampos startPos;
+	if (stats)
+		startPos = file.tellp();
+
+	StatsPhaseTimer headerTimer(stats, &NifStats::writeHeader);
+	hdr.Put(stream);
+	stream.InitBlockSize();
+	headerTimer.Stop();
+
+	StatsPhaseTimer blocksTimer(stats, &NifStats::writeBlocks);
+
+	// Retrieve block sizes from NiStream while writing
+	std::vector<std::streamsize> blockSizes(hdr.GetNumBlocks());
+	for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++) {
+		blocks[i]->Put(stream);
+		blockSizes[i] = stream.GetBlockSize();
+		stream.InitBlockSize();
+	}
+
+	WriteFooter(stream);
+
+	blocksTimer.Stop();
+
+	if (stats) {
+		stats->blocksWritten += hdr.GetNumBlocks();
+		stats->bytesWritten += StreamDistance(startPos, file.tellp());
+	}
+
+	// Get previous stream pos of block size array and overwrite
+	std::streampos blockSizePos = hdr.GetBlockSizeStreamPos();
+	if (blockSizePos != std::streampos()) {
+		StatsPhaseTimer blockSizesTimer(stats, &NifStats::writeBlockSizes);
+		const std::streampos endPos = file.tellp();
+		file.seekp(blockSizePos);
+
+		for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++)
+			stream << static_cast<uint32_t>(blockSizes[i]);
+
+		file.seekp(endPos);
+		hdr.ResetBlockSizeStreamPos();
+	}
+}
+
+NifSerializedSize NifFile::CountSerializedSize() {
+	NifSerializedSize size;
+	NiOStream stream(hdr.GetVersion());
 
-		for (auto& child : srcRootNode->childRefs) {
-			auto srcChildNode = srcNif->hdr.GetBlock<NiNode>(child);
-			if (srcChildNode)
-				cloneNodes(srcChildNode);
+	hdr.Put(stream);
+	hdr.ResetBlockSizeStreamPos();
+	size.headerBytes = static_cast<uint64_t>(stream.GetTotalSize());
+
+	size.blockBytes.resize(hdr.GetNumBlocks());
+	for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++) {
+		stream.InitBlockSize();
+		blocks[i]->Put(stream);
+		size.blockBytes[i] = static_cast<uint64_t>(stream.GetBlockSize());
+	}
+
+	stream.InitBlockSize();
+	WriteFooter(stream);
+	size.footerBytes = static_cast<uint64_t>(stream.GetBlockSize());
+	return size;
+}
+
+// Worker threads that run queued tasks in order. Threads are joined when the pool is destroyed.
+class NifTaskPool {
+	std::mutex mutex;
+	std::condition_variable taskReady;
+	std::queue<std::function<void()>> tasks;
+	std::vector<std::thread> threads;
+	bool stopping = false;
+
+public:
+	NifTaskPool(const uint32_t numThreads) {
+		threads.reserve(numThreads);
+		for (uint32_t i = 0; i < numThreads; i++) {
+			threads.emplace_back([this]() {
+				for (;;) {
+					std::function<void()> task;
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+						if (tasks.empty())
+							return;
+
+						task = std::move(tasks.front());
+						tasks.pop();
+					}
+					task();
+				}
+			});
 		}
 	}
 
-	// Add bones to container if used in skin
-	if (destBoneCont) {
-		for (auto& boneName : srcBoneList) {
-			auto node = FindBlockByName<NiNode>(boneName);
-			int boneID = GetBlockID(node);
-			if (node)
-				destBoneCont->boneRefs.AddBlockRef(boneID);
+	~NifTaskPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
 		}
-	}
-	return destShape;
-}
+		taskReady.notify_all();
 
-uint32_t NifFile::CloneNamedNode(const std::string& nodeName, NifFile* srcNif) {
-	if (!srcNif)
-		srcNif = this;
+		for (auto& thread : threads)
+			thread.join();
+	}
 
-	auto srcNode = srcNif->FindBlockByName<NiNode>(nodeName);
-	if (!srcNode)
-		return NIF_NPOS;
+	NifTaskPool(const NifTaskPool&) = delete;
+	NifTaskPool& operator=(const NifTaskPool&) = delete;
 
-	std::unique_ptr<NiNode> destNode(srcNode->Clone());
-	destNode->name.get() = nodeName;
-	destNode->collisionRef.Clear();
-	destNode->controllerRef.Clear();
-	destNode->childRefs.Clear();
-	destNode->effectRefs.Clear();
+	void Enqueue(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push(std::move(task));
+		}
+		taskReady.notify_one();
+	}
+};
 
-	return hdr.AddBlock(destNode.release());
+// I/O threads mostly wait, so there are more of them than cores
+static NifTaskPool& GetIOTaskPool() {
+	static NifTaskPool pool(std::max(4u, std::thread::hardware_concurrency() * 2));
+	return pool;
 }
 
-int NifFile::Save(const std::filesystem::path& fileName, const NifSaveOptions& options) {
-	std::ofstream file(fileName, std::ios::out | std::ios::binary);
-	return Save(file, options);
+// Decodes and encodes blocks
+static NifTaskPool& GetCodecTaskPool() {
+	static NifTaskPool pool(std::max(1u, std::thread::hardware_concurrency()));
+	return pool;
 }
 
-int NifFile::Save(const std::string& fileName, const NifSaveOptions& options) {
-	std::ofstream file(fileName, std::ios::out | std::ios::binary);
-	return Save(file, options);
+// Sets the result of a task or the exception it threw
+template<typename Func>
+static void RunAsyncTask(std::promise<int>& promise, Func&& func) {
+	try {
+		func();
+	}
+	catch (...) {
+		promise.set_exception(std::current_exception());
+	}
 }
 
-int NifFile::Save(std::ostream& file, const NifSaveOptions& options) {
-	if (file) {
-		if (hdr.GetVersion().IsFO76())
-			return 76;
+std::future<int> NifFile::LoadAsync(const std::filesystem::path& fileName, const NifLoadOptions& options) {
+	auto promise = std::make_shared<std::promise<int>>();
+	std::future<int> future = promise->get_future();
+
+	GetIOTaskPool().Enqueue([this, fileName, options, promise]() {
+		RunAsyncTask(*promise, [&]() {
+			NIFLY_TRACE_SCOPE("NifFile::LoadAsync::Read");
 
-		NiOStream stream(&file, hdr.GetVersion());
-		FinalizeData();
+			auto data = std::make_shared<std::vector<char>>();
 
-		if (options.optimize)
-			Optimize();
+			std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+			if (file) {
+				data->resize(static_cast<size_t>(file.tellg()));
+				file.seekg(0);
+				file.read(data->data(), static_cast<std::streamsize>(data->size()));
+			}
 
-		if (options.sortBlocks)
-			PrettySortBlocks();
+			if (!file) {
+				Clear();
+				promise->set_value(1);
+				return;
+			}
 
-		hdr.Put(stream);
-		stream.InitBlockSize();
+			// Decoding starts once the file was read, reads of other requests overlap with it
+			GetCodecTaskPool().Enqueue([this, options, promise, data]() {
+				RunAsyncTask(*promise, [&]() {
+					NifMemoryBuffer buffer(data->data(), data->size());
+					std::istream stream(&buffer);
+					promise->set_value(Load(stream, options));
+				});
+			});
+		});
+	});
 
-		// Retrieve block sizes from NiStream while writing
-		std::vector<std::streamsize> blockSizes(hdr.GetNumBlocks());
-		for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++) {
-			blocks[i]->Put(stream);
-			blockSizes[i] = stream.GetBlockSize();
-			stream.InitBlockSize();
-		}
+	return future;
+}
 
-		uint32_t endPad = 1;
-		stream << endPad;
-		endPad = 0;
-		stream << endPad;
+std::future<int> NifFile::SaveAsync(const std::filesystem::path& fileName, const NifSaveOptions& options) {
+	auto promise = std::make_shared<std::promise<int>>();
+	std::future<int> future = promise->get_future();
 
-		// Get previous stream pos of block size array and overwrite
-		std::streampos blockSizePos = hdr.GetBlockSizeStreamPos();
-		if (blockSizePos != std::streampos()) {
-			file.seekp(blockSizePos);
+	GetCodecTaskPool().Enqueue([this, fileName, options, promise]() {
+		RunAsyncTask(*promise, [&]() {
+			auto data = std::make_shared<std::vector<uint8_t>>();
+			const int error = Save(*data, options);
+			if (error) {
+				promise->set_value(error);
+				return;
+			}
 
-			for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++)
-				stream << static_cast<uint32_t>(blockSizes[i]);
+			GetIOTaskPool().Enqueue([fileName, promise, data]() {
+				RunAsyncTask(*promise, [&]() {
+					NIFLY_TRACE_SCOPE("NifFile::SaveAsync::Write");
 
-			hdr.ResetBlockSizeStreamPos();
-		}
-	}
-	else
-		return 1;
+					std::ofstream file(fileName, std::ios::out | std::ios::binary);
+					file.write(reinterpret_cast<const char*>(data->data()),
+							   static_cast<std::streamsize>(data->size()));
 
-	return 0;
+					promise->set_value(file ? 0 : 1);
+				});
+			});
+		});
+	});
+
+	return future;
 }
 
 void NifFile::Optimize() {
-	for (auto& s : GetShapes())
-		s->UpdateBounds();
+	for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++) {
+		auto shape = hdr.GetBlock<NiShape>(i);
+		if (!shape || !shape->IsBoundsDirty())
+			continue;
+
+		// Shared shapes are only copied if their bounds change (only BSTriShape blocks can be shared)
+		auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
+		if (bsTriShape && hdr.IsBlockShared(i)) {
+			const BoundingSphere bounds = bsTriShape->CalcBounds();
+			const BoundingSphere oldBounds = bsTriShape->GetBounds();
+			if (bounds.center == oldBounds.center && bounds.radius == oldBounds.radius)
+				continue;
+		}
+
+		hdr.GetBlockForWrite<NiShape>(i)->UpdateBounds();
+	}
 
 	DeleteUnreferencedBlocks();
 }
 
 OptResult NifFile::OptimizeFor(OptOptions& options) {
+	NIFLY_TRACE_SCOPE("NifFile::OptimizeFor");
+
 	OptResult result;
 
 	const bool toSSE = options.targetVersion.IsSSE() && hdr.GetVersion().IsSK();
@@ -1469,7 +2688,7 @@ OptResult NifFile::OptimizeFor(OptOptions& options) {
 			}
 
 			bool headPartEyes = false;
-			NiShader* shader = GetShader(shape);
+			NiShader* shader = GetBlockForWrite(GetShader(shape));
 			if (shader) {
 				auto bslsp = dynamic_cast<BSLightingShaderProperty*>(shader);
 				if (bslsp) {
@@ -1504,7 +2723,7 @@ OptResult NifFile::OptimizeFor(OptOptions& options) {
 							bslsp->shaderFlags1 &= ~(1 << 11);
 
 							// Remove parallax texture from set
-							auto textureSet = hdr.GetBlock(shader->TextureSetRef());
+							auto textureSet = hdr.GetBlockForWrite(shader->TextureSetRef());
 							if (textureSet && textureSet->textures.size() >= 4)
 								textureSet->textures[3].clear();
 
@@ -1582,8 +2801,10 @@ OptResult NifFile::OptimizeFor(OptOptions& options) {
 			if (bsOptShape->GetNumVertices() > 0) {
 				if (!removeVertexColors && !colors.empty()) {
 					bsOptShape->SetVertexColors(true);
+
+					auto& optVertData = bsOptShape->GetVertexDataForWrite();
 					for (uint16_t i = 0; i < bsOptShape->GetNumVertices(); i++) {
-						auto& vertex = bsOptShape->vertData[i];
+						auto& vertex = optVertData[i];
 
 						float f = std::max(0.0f, std::min(1.0f, colors[i].r));
 						vertex.colorData[0] = static_cast<uint8_t>(std::floor(f == 1.0f ? 255 : f * 256.0));
@@ -1623,20 +2844,21 @@ OptResult NifFile::OptimizeFor(OptOptions& options) {
 
 					auto skinInst = hdr.GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
 					if (skinInst) {
-						auto skinPart = hdr.GetBlock(skinInst->skinPartitionRef);
+						auto skinPart = hdr.GetBlockForWrite(skinInst->skinPartitionRef);
 						if (skinPart) {
 							bool triangulated = skinPart->ConvertStripsToTriangles();
 							if (triangulated)
 								result.shapesPartTriangulated.push_back(shapeName);
 
+							auto& optVertData = bsOptShape->GetVertexDataForWrite();
 							for (uint32_t partID = 0; partID < skinPart->numPartitions; partID++) {
 								NiSkinPartition::PartitionBlock& part = skinPart->partitions[partID];
 
 								for (uint32_t i = 0; i < part.numVertices; i++) {
 									const uint16_t v = part.vertexMap[i];
 
-									if (bsOptShape->vertData.size() > v) {
-										auto& vertex = bsOptShape->vertData[v];
+									if (optVertData.size() > v) {
+										auto& vertex = optVertData[v];
 
 										if (part.hasVertexWeights) {
 											auto& weights = part.vertexWeights[i];
@@ -1729,7 +2951,7 @@ OptResult NifFile::OptimizeFor(OptOptions& options) {
 				}
 			}
 
-			NiShader* shader = GetShader(shape);
+			NiShader* shader = GetBlockForWrite(GetShader(shape));
 			if (shader) {
 				auto bslsp = dynamic_cast<BSLightingShaderProperty*>(shader);
 				if (bslsp) {
@@ -1760,7 +2982,7 @@ OptResult NifFile::OptimizeFor(OptOptions& options) {
 							bslsp->shaderFlags1 &= ~(1 << 11);
 
 							// Remove parallax texture from set
-							auto textureSet = hdr.GetBlock(shader->TextureSetRef());
+							auto textureSet = hdr.GetBlockForWrite(shader->TextureSetRef());
 							if (textureSet && textureSet->textures.size() >= 4)
 								textureSet->textures[3].clear();
 
@@ -1844,7 +3066,7 @@ OptResult NifFile::OptimizeFor(OptOptions& options) {
 				if (shape->IsSkinned()) {
 					auto skinInst = hdr.GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
 					if (skinInst) {
-						auto skinPart = hdr.GetBlock(skinInst->skinPartitionRef);
+						auto skinPart = hdr.GetBlockForWrite(skinInst->skinPartitionRef);
 						if (skinPart) {
 							bool triangulated = skinPart->ConvertStripsToTriangles();
 							if (triangulated)
@@ -1876,13 +3098,20 @@ OptResult NifFile::OptimizeFor(OptOptions& options) {
 		PrettySortBlocks();
 	}
 
+	if (options.optimizeVertexCache)
+		for (auto& shape : GetShapes())
+			OptimizeVertexCache(shape);
+
 	return result;
 }
 
-void NifFile::PrepareData() {
+void NifFile::PrepareData(NifStats* stats) {
+	StatsPhaseTimer prepareTimer(stats, &NifStats::prepareData);
+
 	hdr.FillStringRefs();
 	LinkGeomData();
 	if (!preserveTexturePaths) {
+		StatsPhaseTimer trimTimer(stats, &NifStats::trimTexturePaths);
 		TrimTexturePaths();
 	}
 
@@ -1897,10 +3126,11 @@ void NifFile::PrepareData() {
 			if (!skinInst)
 				continue;
 
-			auto skinPart = hdr.GetBlock(skinInst->skinPartitionRef);
+			auto skinPart = hdr.GetBlockForWrite(skinInst->skinPartitionRef);
 			if (!skinPart)
 				continue;
 
+			bsTriShape = GetBlockForWrite(bsTriShape);
 			bsTriShape->SetVertexData(skinPart->vertData);
 
 			std::vector<Triangle> tris;
@@ -1912,13 +3142,17 @@ void NifFile::PrepareData() {
 
 			bsTriShape->SetTriangles(tris);
 
+			// Sizes of skinned shapes are only stored in the partition, calculate them like FinalizeData would
+			bsTriShape->CalcDataSizes(hdr.GetVersion());
+
 			auto dynamicShape = dynamic_cast<BSDynamicTriShape*>(bsTriShape);
 			if (dynamicShape) {
+				auto& dynVertData = dynamicShape->GetVertexDataForWrite();
 				for (uint16_t i = 0; i < dynamicShape->GetNumVertices(); i++) {
-					dynamicShape->vertData[i].vert.x = dynamicShape->dynamicData[i].x;
-					dynamicShape->vertData[i].vert.y = dynamicShape->dynamicData[i].y;
-					dynamicShape->vertData[i].vert.z = dynamicShape->dynamicData[i].z;
-					dynamicShape->vertData[i].bitangentX = dynamicShape->dynamicData[i].w;
+					dynVertData[i].vert.x = dynamicShape->dynamicData[i].x;
+					dynVertData[i].vert.y = dynamicShape->dynamicData[i].y;
+					dynVertData[i].vert.z = dynamicShape->dynamicData[i].z;
+					dynVertData[i].bitangentX = dynamicShape->dynamicData[i].w;
 				}
 			}
 		}
@@ -1937,26 +3171,57 @@ void NifFile::PrepareData() {
 	RemoveInvalidTris();
 }
 
+// Returns true if the partition already holds the vertex data of the shape (see FinalizeData).
+// The data size isn't compared, the partition recalculates it when it's written.
+static bool IsPartitionDataCurrent(const NiSkinPartition& skinPart, const BSTriShape& shape) {
+	if (skinPart.numVertices != shape.GetNumVertices() || skinPart.vertexSize != shape.vertexSize
+		|| skinPart.vertexDesc != shape.vertexDesc || skinPart.vertData != shape.GetVertexData())
+		return false;
+
+	for (uint32_t partInd = 0; partInd < skinPart.numPartitions; ++partInd)
+		if (skinPart.partitions[partInd].vertexDesc != shape.vertexDesc)
+			return false;
+
+	return true;
+}
+
 void NifFile::FinalizeData() {
-	for (auto& shape : GetShapes()) {
+	for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++) {
+		auto shape = hdr.GetBlock<NiShape>(i);
+		if (!shape)
+			continue;
+
 		auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
 		if (bsTriShape) {
+			// Shared blocks are only copied if their data changes
 			auto bsDynTriShape = dynamic_cast<BSDynamicTriShape*>(shape);
-			if (bsDynTriShape)
-				bsDynTriShape->CalcDynamicData();
+			if (!hdr.IsBlockShared(i) || (bsDynTriShape && bsDynTriShape->IsDynamicDataDirty())
+				|| bsTriShape->IsDataSizeDirty(hdr.GetVersion())) {
+				bsTriShape = hdr.GetBlockForWrite<BSTriShape>(i);
+				shape = bsTriShape;
 
-			bsTriShape->CalcDataSizes(hdr.GetVersion());
+				bsDynTriShape = dynamic_cast<BSDynamicTriShape*>(bsTriShape);
+				if (bsDynTriShape)
+					bsDynTriShape->CalcDynamicData();
+
+				bsTriShape->CalcDataSizes(hdr.GetVersion());
+			}
 
 			if (hdr.GetVersion().IsSSE()) {
 				// Move triangle and vertex data from shape to partition
 				auto skinInst = hdr.GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
 				if (skinInst) {
 					auto skinPart = hdr.GetBlock(skinInst->skinPartitionRef);
+					if (skinPart && hdr.IsBlockShared(skinInst->skinPartitionRef.index)
+						&& IsPartitionDataCurrent(*skinPart, *bsTriShape))
+						skinPart = nullptr;
+
 					if (skinPart) {
+						skinPart = hdr.GetBlockForWrite(skinInst->skinPartitionRef);
 						skinPart->numVertices = bsTriShape->GetNumVertices();
 						skinPart->dataSize = bsTriShape->dataSize;
 						skinPart->vertexSize = bsTriShape->vertexSize;
-						skinPart->vertData = bsTriShape->vertData;
+						skinPart->vertData = bsTriShape->GetVertexData();
 						skinPart->vertexDesc = bsTriShape->vertexDesc;
 
 						for (uint32_t partInd = 0; partInd < skinPart->numPartitions; ++partInd) {
@@ -2016,7 +3281,7 @@ NiShape* NifFile::CreateShapeFromData(const std::string& shapeName,
 									  const std::vector<Triangle>* t,
 									  const std::vector<Vector2>* uv,
 									  const std::vector<Vector3>* norms) {
-	auto rootNode = GetRootNode();
+	auto rootNode = GetBlockForWrite(GetRootNode());
 	if (!rootNode)
 		return nullptr;
 
@@ -2125,8 +3390,8 @@ std::vector<std::string> NifFile::GetShapeNames() const {
 
 std::vector<NiShape*> NifFile::GetShapes() const {
 	std::vector<NiShape*> outList;
-	for (auto& block : blocks) {
-		auto shape = dynamic_cast<NiShape*>(block.get());
+	for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++) {
+		auto shape = hdr.GetBlock<NiShape>(i);
 		if (shape)
 			outList.push_back(shape);
 	}
@@ -2135,6 +3400,7 @@ std::vector<NiShape*> NifFile::GetShapes() const {
 
 bool NifFile::RenameShape(NiShape* shape, const std::string& newName) {
 	if (shape) {
+		shape = GetBlockForWrite(shape);
 		shape->name.get() = newName;
 		return true;
 	}
@@ -2192,7 +3458,7 @@ bool NifFile::RenameDuplicateShapes() {
 						dup = "_" + std::to_string(dupCount);
 					}
 
-					shape->name.get() = shapeName + dup;
+					hdr.GetBlockForWrite<NiShape>(child)->name.get() = shapeName + dup;
 					dupCount++;
 					renamed = true;
 				}
@@ -2230,8 +3496,8 @@ NiNode* NifFile::GetRootNode() const {
 	auto root = hdr.GetBlock<NiNode>(0u);
 	if (!root) {
 		// Not a node, look for first node block
-		for (auto& block : blocks) {
-			auto node = dynamic_cast<NiNode*>(block.get());
+		for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++) {
+			auto node = hdr.GetBlock<NiNode>(i);
 			if (node) {
 				root = node;
 				break;
@@ -2272,16 +3538,18 @@ bool NifFile::GetNodeTransformToParent(const std::string& nodeName, MatTransform
 }
 
 bool NifFile::GetNodeTransformToGlobal(const std::string& nodeName, MatTransform& outTransform) const {
-	for (auto& block : blocks) {
-		auto* node = dynamic_cast<NiNode*>(block.get());
+	for (uint32_t i = 0; i < blocks.size(); i++) {
+		auto* node = dynamic_cast<NiNode*>(blocks[i].get());
 		if (!node || node->name != nodeName)
 			continue;
 
+		// Walks up by block ID, which doesn't need to search for the block of each parent
 		MatTransform xform = node->GetTransformToParent();
-		NiNode* parent = GetParentNode(node);
-		while (parent) {
+		uint32_t parentId = GetParentNodeID(i);
+		while (parentId != NIF_NPOS) {
+			auto parent = static_cast<NiNode*>(blocks[parentId].get());
 			xform = parent->GetTransformToParent().ComposeTransforms(xform);
-			parent = GetParentNode(parent);
+			parentId = GetParentNodeID(parentId);
 		}
 		outTransform = xform;
 		return true;
@@ -2300,7 +3568,7 @@ bool NifFile::SetNodeTransformToParent(const std::string& nodeName,
 				auto node = hdr.GetBlock<NiNode>(child);
 				if (node) {
 					if (node->name == nodeName) {
-						node->SetTransformToParent(inTransform);
+						hdr.GetBlockForWrite<NiNode>(child)->SetTransformToParent(inTransform);
 						return true;
 					}
 				}
@@ -2308,10 +3576,10 @@ bool NifFile::SetNodeTransformToParent(const std::string& nodeName,
 		}
 	}
 	else {
-		for (auto& block : blocks) {
-			auto node = dynamic_cast<NiNode*>(block.get());
+		for (uint32_t i = 0; i < blocks.size(); i++) {
+			auto node = dynamic_cast<NiNode*>(blocks[i].get());
 			if (node && node->name == nodeName) {
-				node->SetTransformToParent(inTransform);
+				hdr.GetBlockForWrite<NiNode>(i)->SetTransformToParent(inTransform);
 				return true;
 			}
 		}
@@ -2367,7 +3635,7 @@ void NifFile::SetShapeBoneIDList(NiShape* shape, std::vector<int>& inList) {
 			boneData = hdr.GetBlock(skinForBoneRef->dataRef);
 	}
 
-	auto boneCont = hdr.GetBlock<NiBoneContainer>(shape->SkinInstanceRef());
+	auto boneCont = hdr.GetBlockForWrite<NiBoneContainer>(shape->SkinInstanceRef());
 	if (!boneCont)
 		return;
 
@@ -2376,6 +3644,7 @@ void NifFile::SetShapeBoneIDList(NiShape* shape, std::vector<int>& inList) {
 	bool feedBoneData = false;
 	if (boneData && boneData->nBones != inList.size()) {
 		// Clear if size doesn't match
+		boneData = GetBlockForWrite(boneData);
 		boneData->nBones = 0;
 		boneData->boneXforms.clear();
 		feedBoneData = true;
@@ -2397,6 +3666,7 @@ void NifFile::SetShapeBoneIDList(NiShape* shape, std::vector<int>& inList) {
 
 			if (skinData->numBones != inList.size()) {
 				// Clear if size doesn't match
+				skinData = hdr.GetBlockForWrite(skinInst->dataRef);
 				skinData->numBones = 0;
 				skinData->bones.clear();
 				feedBoneData = true;
@@ -2422,7 +3692,7 @@ uint32_t NifFile::GetShapeBoneWeights(NiShape* shape,
 	if (bsTriShape) {
 		outWeights.reserve(bsTriShape->GetNumVertices());
 		for (uint16_t vid = 0; vid < bsTriShape->GetNumVertices(); vid++) {
-			auto& vertex = bsTriShape->vertData[vid];
+			auto& vertex = bsTriShape->GetVertexData()[vid];
 			for (size_t i = 0; i < 4; i++) {
 				if (vertex.weightBones[i] == boneIndex && vertex.weights[i] != 0.0f)
 					outWeights.emplace(vid, vertex.weights[i]);
@@ -2505,7 +3775,7 @@ void NifFile::SetShapeTransformGlobalToSkin(NiShape* shape, const MatTransform&
 	if (!skinInst)
 		return;
 
-	auto skinData = hdr.GetBlock(skinInst->dataRef);
+	auto skinData = hdr.GetBlockForWrite(skinInst->dataRef);
 	if (!skinData)
 		return;
 
@@ -2564,7 +3834,7 @@ void NifFile::SetShapeTransformSkinToBone(NiShape* shape,
 
 	auto skinForBoneRef = hdr.GetBlock<BSSkinInstance>(shape->SkinInstanceRef());
 	if (skinForBoneRef) {
-		auto bsSkin = hdr.GetBlock(skinForBoneRef->dataRef);
+		auto bsSkin = hdr.GetBlockForWrite(skinForBoneRef->dataRef);
 		if (!bsSkin)
 			return;
 
@@ -2578,7 +3848,7 @@ void NifFile::SetShapeTransformSkinToBone(NiShape* shape,
 	if (!skinInst)
 		return;
 
-	auto skinData = hdr.GetBlock(skinInst->dataRef);
+	auto skinData = hdr.GetBlockForWrite(skinInst->dataRef);
 	if (!skinData)
 		return;
 
@@ -2623,7 +3893,7 @@ bool NifFile::SetShapeBoneBounds(const std::string& shapeName,
 
 	auto skinForBoneRef = hdr.GetBlock<BSSkinInstance>(shape->SkinInstanceRef());
 	if (skinForBoneRef && boneIndex != 0xFFFFFFFF) {
-		auto bsSkin = hdr.GetBlock(skinForBoneRef->dataRef);
+		auto bsSkin = hdr.GetBlockForWrite(skinForBoneRef->dataRef);
 		if (!bsSkin)
 			return false;
 
@@ -2635,7 +3905,7 @@ bool NifFile::SetShapeBoneBounds(const std::string& shapeName,
 	if (!skinInst)
 		return false;
 
-	auto skinData = hdr.GetBlock(skinInst->dataRef);
+	auto skinData = hdr.GetBlockForWrite(skinInst->dataRef);
 	if (!skinData)
 		return false;
 
@@ -2681,7 +3951,7 @@ void NifFile::UpdateShapeBoneID(const std::string& shapeName, const uint32_t old
 	if (!shape)
 		return;
 
-	auto boneCont = hdr.GetBlock<NiBoneContainer>(shape->SkinInstanceRef());
+	auto boneCont = hdr.GetBlockForWrite<NiBoneContainer>(shape->SkinInstanceRef());
 	if (!boneCont)
 		return;
 
@@ -2704,7 +3974,7 @@ void NifFile::SetShapeBoneWeights(const std::string& shapeName,
 	if (!skinInst)
 		return;
 
-	auto skinData = hdr.GetBlock(skinInst->dataRef);
+	auto skinData = hdr.GetBlockForWrite(skinInst->dataRef);
 	if (!skinData)
 		return;
 
@@ -2723,7 +3993,7 @@ void NifFile::SetShapeBoneWeights(const std::string& shapeName,
 void NifFile::SetShapeVertWeights(const std::string& shapeName,
 								  const uint16_t vertIndex,
 								  std::vector<uint8_t>& boneids,
-								  std::vector<float>& weights) const {
+								  std::vector<float>& weights) {
 	auto shape = FindBlockByName<NiShape>(shapeName);
 	if (!shape)
 		return;
@@ -2732,10 +4002,12 @@ void NifFile::SetShapeVertWeights(const std::string& shapeName,
 	if (!bsTriShape)
 		return;
 
-	if (vertIndex < 0 || vertIndex >= bsTriShape->vertData.size())
+	if (vertIndex < 0 || vertIndex >= bsTriShape->GetVertexData().size())
 		return;
 
-	auto& vertex = bsTriShape->vertData[vertIndex];
+	bsTriShape = GetBlockForWrite(bsTriShape);
+
+	auto& vertex = bsTriShape->GetVertexDataForWrite()[vertIndex];
 	std::memset(&vertex.weights, 0, sizeof(float) * 4);
 	std::memset(&vertex.weightBones, 0, sizeof(uint8_t) * 4);
 
@@ -2752,16 +4024,16 @@ void NifFile::SetShapeVertWeights(const std::string& shapeName,
 	}
 }
 
-void NifFile::ClearShapeVertWeights(const std::string& shapeName) const {
+void NifFile::ClearShapeVertWeights(const std::string& shapeName) {
 	auto shape = FindBlockByName<NiShape>(shapeName);
 	if (!shape)
 		return;
 
-	auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
+	auto bsTriShape = GetBlockForWrite(dynamic_cast<BSTriShape*>(shape));
 	if (!bsTriShape)
 		return;
 
-	for (auto& vertex : bsTriShape->vertData) {
+	for (auto& vertex : bsTriShape->GetVertexDataForWrite()) {
 		std::memset(&vertex.weights, 0, sizeof(float) * 4);
 		std::memset(&vertex.weightBones, 0, sizeof(uint8_t) * 4);
 	}
@@ -2779,7 +4051,7 @@ bool NifFile::GetShapeSegments(NiShape* shape, NifSegmentationInfo& inf, std::ve
 void NifFile::SetShapeSegments(NiShape* shape,
 							   const NifSegmentationInfo& inf,
 							   const std::vector<int>& triParts) {
-	auto bssits = dynamic_cast<BSSubIndexTriShape*>(shape);
+	auto bssits = GetBlockForWrite(dynamic_cast<BSSubIndexTriShape*>(shape));
 	if (!bssits)
 		return;
 
@@ -2806,9 +4078,16 @@ bool NifFile::GetShapePartitions(NiShape* shape,
 	if (!skinPart)
 		return false;
 
-	// Generate triParts
+	// Generate triParts, shared partitions aren't modified and prepare a copy instead
 	std::vector<Triangle> shapeTris;
 	shape->GetTriangles(shapeTris);
+
+	std::unique_ptr<NiSkinPartition> preparedPart;
+	if (shapeTris.size() != skinPart->triParts.size() && hdr.IsBlockShared(skinInst->skinPartitionRef.index)) {
+		preparedPart.reset(skinPart->Clone());
+		skinPart = preparedPart.get();
+	}
+
 	skinPart->PrepareTriParts(shapeTris);
 	triParts = skinPart->triParts;
 
@@ -2834,7 +4113,7 @@ void NifFile::SetShapePartitions(NiShape* shape,
 	if (!skinInst)
 		return;
 
-	auto skinPart = hdr.GetBlock(skinInst->skinPartitionRef);
+	auto skinPart = hdr.GetBlockForWrite(skinInst->skinPartitionRef);
 	if (!skinPart)
 		return;
 
@@ -2873,7 +4152,7 @@ void NifFile::SetShapePartitions(NiShape* shape,
 	skinPart->GenerateTrueTrianglesFromTriParts(shapeTris);
 
 	// Set BSDismemberSkinInstance partition list
-	auto bsdSkinInst = hdr.GetBlock<BSDismemberSkinInstance>(shape->SkinInstanceRef());
+	auto bsdSkinInst = hdr.GetBlockForWrite<BSDismemberSkinInstance>(shape->SkinInstanceRef());
 	if (!bsdSkinInst && convertSkinInstance) {
 		auto newBsdSkinInst = std::make_unique<BSDismemberSkinInstance>();
 		bsdSkinInst = newBsdSkinInst.get();
@@ -2900,7 +4179,7 @@ void NifFile::SetDefaultPartition(NiShape* shape) {
 	uint16_t numVertices = shape->GetNumVertices();
 	bool bMappedIndices = !shape->HasType<BSTriShape>();
 
-	auto bsdSkinInst = hdr.GetBlock<BSDismemberSkinInstance>(shape->SkinInstanceRef());
+	auto bsdSkinInst = hdr.GetBlockForWrite<BSDismemberSkinInstance>(shape->SkinInstanceRef());
 	if (bsdSkinInst) {
 		BSDismemberSkinInstance::PartitionInfo partInfo;
 		partInfo.flags = PF_EDITOR_VISIBLE;
@@ -2914,7 +4193,7 @@ void NifFile::SetDefaultPartition(NiShape* shape) {
 	if (!skinInst)
 		return;
 
-	auto skinPart = hdr.GetBlock(skinInst->skinPartitionRef);
+	auto skinPart = hdr.GetBlockForWrite(skinInst->skinPartitionRef);
 	if (skinPart) {
 		NiSkinPartition::PartitionBlock part;
 		if (numVertices > 0) {
@@ -2951,13 +4230,13 @@ void NifFile::DeletePartitions(NiShape* shape, std::vector<uint32_t>& partInds)
 	if (!skinInst)
 		return;
 
-	auto skinPart = hdr.GetBlock(skinInst->skinPartitionRef);
+	auto skinPart = hdr.GetBlockForWrite(skinInst->skinPartitionRef);
 	if (!skinPart)
 		return;
 
 	skinPart->DeletePartitions(partInds);
 
-	auto bsdSkinInst = dynamic_cast<BSDismemberSkinInstance*>(skinInst);
+	auto bsdSkinInst = hdr.GetBlockForWrite<BSDismemberSkinInstance>(shape->SkinInstanceRef());
 	if (bsdSkinInst) {
 		bsdSkinInst->DeletePartitions(partInds);
 		UpdatePartitionFlags(shape);
@@ -2971,7 +4250,367 @@ bool NifFile::ReorderTriangles(NiShape* shape, const std::vector<uint32_t>& tria
 	if (shape->HasType<NiTriStrips>())
 		return false;
 
-	return shape->ReorderTriangles(triangleIndices);
+	return GetBlockForWrite(shape)->ReorderTriangles(triangleIndices);
+}
+
+// Size of the simulated post-transform vertex cache used by OptimizeVertexCache
+constexpr uint32_t VertexCacheSize = 32;
+
+// Vertex score of Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+static float VertexCacheScore(const int cachePos, const uint32_t remainingTris) {
+	if (remainingTris == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePos >= 3)
+		score = std::pow(1.0f - static_cast<float>(cachePos - 3) / (VertexCacheSize - 3), 1.5f);
+	else if (cachePos >= 0)
+		score = 0.75f; // Vertices of the last triangle get a fixed score
+
+	// Favor vertices with few remaining triangles to get rid of them quickly
+	return score + 2.0f / std::sqrt(static_cast<float>(remainingTris));
+}
+
+// Orders triangles for post-transform vertex cache locality and appends the result to 'order'.
+// All vertex indices of 'tris' must be below 'numVerts'.
+static void OptimizeTriangleOrder(const std::vector<Triangle>& tris,
+								  const uint32_t numVerts,
+								  std::vector<uint32_t>& order) {
+	const auto numTris = static_cast<uint32_t>(tris.size());
+	if (numTris == 0)
+		return;
+
+	// Triangles using each vertex (first 'remaining[v]' entries are the triangles not added yet)
+	std::vector<uint32_t> remaining(numVerts, 0);
+	for (auto& t : tris) {
+		remaining[t.p1]++;
+		remaining[t.p2]++;
+		remaining[t.p3]++;
+	}
+
+	std::vector<uint32_t> vertTriOffsets(numVerts + 1, 0);
+	for (uint32_t v = 0; v < numVerts; v++)
+		vertTriOffsets[v + 1] = vertTriOffsets[v] + remaining[v];
+
+	std::vector<uint32_t> vertTris(vertTriOffsets.back());
+	std::vector<uint32_t> vertTriFill(vertTriOffsets.begin(), vertTriOffsets.end() - 1);
+	for (uint32_t t = 0; t < numTris; t++) {
+		vertTris[vertTriFill[tris[t].p1]++] = t;
+		vertTris[vertTriFill[tris[t].p2]++] = t;
+		vertTris[vertTriFill[tris[t].p3]++] = t;
+	}
+
+	std::vector<int> cachePos(numVerts, -1);
+	std::vector<float> vertScores(numVerts);
+	for (uint32_t v = 0; v < numVerts; v++)
+		vertScores[v] = VertexCacheScore(-1, remaining[v]);
+
+	auto triScore = [&](const uint32_t t) {
+		return vertScores[tris[t].p1] + vertScores[tris[t].p2] + vertScores[tris[t].p3];
+	};
+
+	std::vector<bool> triAdded(numTris, false);
+
+	uint32_t bestTri = 0;
+	float bestScore = triScore(0);
+	for (uint32_t t = 1; t < numTris; t++) {
+		const float score = triScore(t);
+		if (score > bestScore) {
+			bestScore = score;
+			bestTri = t;
+		}
+	}
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(VertexCacheSize + 3);
+	newCache.reserve(VertexCacheSize + 3);
+
+	uint32_t nextTri = 0;
+	for (uint32_t n = 0; n < numTris; n++) {
+		if (bestTri == NIF_NPOS) {
+			// Nothing left in the cache, continue with the next triangle in the original order
+			while (triAdded[nextTri])
+				nextTri++;
+
+			bestTri = nextTri;
+		}
+
+		triAdded[bestTri] = true;
+		order.push_back(bestTri);
+
+		// Move the vertices of the triangle to the front of the cache
+		newCache.clear();
+		for (uint32_t v : {tris[bestTri].p1, tris[bestTri].p2, tris[bestTri].p3}) {
+			auto begin = vertTris.begin() + vertTriOffsets[v];
+			auto end = begin + remaining[v]--;
+			std::iter_swap(std::find(begin, end, bestTri), end - 1);
+
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+				newCache.push_back(v);
+		}
+
+		for (uint32_t v : cache)
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+				newCache.push_back(v);
+
+		// Update scores of the cached vertices, including the ones that just dropped out
+		for (size_t i = 0; i < newCache.size(); i++) {
+			const uint32_t v = newCache[i];
+			cachePos[v] = i < VertexCacheSize ? static_cast<int>(i) : -1;
+			vertScores[v] = VertexCacheScore(cachePos[v], remaining[v]);
+		}
+
+		if (newCache.size() > VertexCacheSize)
+			newCache.resize(VertexCacheSize);
+
+		std::swap(cache, newCache);
+
+		// Find the best triangle using a cached vertex
+		bestTri = NIF_NPOS;
+		bestScore = -1.0f;
+		for (uint32_t v : cache) {
+			for (uint32_t i = 0; i < remaining[v]; i++) {
+				const uint32_t t = vertTris[vertTriOffsets[v] + i];
+				const float score = triScore(t);
+				if (score > bestScore) {
+					bestScore = score;
+					bestTri = t;
+				}
+			}
+		}
+	}
+}
+
+// Generates a vertex index map that numbers vertices in the order they are first used by 'tris'.
+// Unused vertices keep their relative order at the end.
+static std::vector<uint16_t> GenerateFetchOrderMap(const std::vector<Triangle>& tris, const size_t numVerts) {
+	std::vector<uint16_t> vertMap(numVerts);
+	std::vector<bool> vertUsed(numVerts, false);
+
+	uint16_t nextIndex = 0;
+	for (auto& t : tris) {
+		for (uint16_t v : {t.p1, t.p2, t.p3}) {
+			if (v < numVerts && !vertUsed[v]) {
+				vertUsed[v] = true;
+				vertMap[v] = nextIndex++;
+			}
+		}
+	}
+
+	for (size_t v = 0; v < numVerts; v++)
+		if (!vertUsed[v])
+			vertMap[v] = nextIndex++;
+
+	return vertMap;
+}
+
+bool NifFile::OptimizeVertexCache(NiShape* shape) {
+	if (!shape || shape->HasType<NiTriStrips>())
+		return false;
+
+	std::vector<Triangle> tris;
+	if (!shape->GetTriangles(tris) || tris.empty())
+		return false;
+
+	const uint16_t numVerts = shape->GetNumVertices();
+	if (CalcMaxTriangleIndex(tris) >= numVerts)
+		return false;
+
+	const auto numTris = static_cast<uint32_t>(tris.size());
+	shape = GetBlockForWrite(shape);
+
+	NiSkinData* skinData = nullptr;
+	NiSkinPartition* skinPart = nullptr;
+	auto skinInst = hdr.GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
+	if (skinInst) {
+		skinData = hdr.GetBlockForWrite(skinInst->dataRef);
+		skinPart = hdr.GetBlockForWrite(skinInst->skinPartitionRef);
+	}
+
+	if (skinPart) {
+		// Strips can't be reordered
+		for (auto& p : skinPart->partitions)
+			if (p.numStrips > 0)
+				return false;
+
+		skinPart->PrepareTriParts(tris);
+	}
+
+	// Triangles are only reordered within runs that don't cross partitions, segments or LOD levels
+	std::vector<bool> runStart(numTris, false);
+	runStart[0] = true;
+
+	auto addRunStart = [&](const uint32_t triIndex) {
+		if (triIndex < numTris)
+			runStart[triIndex] = true;
+	};
+
+	auto addRunStarts = [&](const std::vector<int>& triParts) {
+		for (uint32_t t = 1; t < numTris && t < triParts.size(); t++)
+			if (triParts[t] != triParts[t - 1])
+				runStart[t] = true;
+	};
+
+	if (skinPart)
+		addRunStarts(skinPart->triParts);
+
+	std::vector<BSGeometrySegmentData> segments;
+	if (auto bssits = dynamic_cast<BSSubIndexTriShape*>(shape)) {
+		segments = bssits->GetSegments();
+
+		NifSegmentationInfo inf;
+		std::vector<int> segTriParts;
+		bssits->GetSegmentation(inf, segTriParts);
+		addRunStarts(segTriParts);
+	}
+	else if (auto bssts = dynamic_cast<BSSegmentedTriShape*>(shape)) {
+		segments = bssts->GetSegments();
+	}
+	else if (auto bsmlts = dynamic_cast<BSMeshLODTriShape*>(shape)) {
+		addRunStart(bsmlts->lodSize0);
+		addRunStart(bsmlts->lodSize0 + bsmlts->lodSize1);
+	}
+	else if (auto bslts = dynamic_cast<BSLODTriShape*>(shape)) {
+		addRunStart(bslts->level0);
+		addRunStart(bslts->level0 + bslts->level1);
+	}
+
+	for (auto& seg : segments) {
+		addRunStart(seg.index / 3);
+		addRunStart(seg.index / 3 + seg.numTris);
+	}
+
+	// Optimize the triangle order of each run using run-local vertex indices
+	std::vector<uint32_t> triOrder;
+	triOrder.reserve(numTris);
+
+	std::vector<int> localIndices(numVerts, -1);
+	std::vector<uint16_t> localVerts;
+	std::vector<Triangle> runTris;
+
+	auto localIndex = [&](const uint16_t v) {
+		if (localIndices[v] == -1) {
+			localIndices[v] = static_cast<int>(localVerts.size());
+			localVerts.push_back(v);
+		}
+		return static_cast<uint16_t>(localIndices[v]);
+	};
+
+	uint32_t runBegin = 0;
+	for (uint32_t t = 1; t <= numTris; t++) {
+		if (t < numTris && !runStart[t])
+			continue;
+
+		runTris.clear();
+		localVerts.clear();
+		for (uint32_t i = runBegin; i < t; i++)
+			runTris.emplace_back(localIndex(tris[i].p1), localIndex(tris[i].p2), localIndex(tris[i].p3));
+
+		const size_t runOffset = triOrder.size();
+		OptimizeTriangleOrder(runTris, static_cast<uint32_t>(localVerts.size()), triOrder);
+		for (size_t i = runOffset; i < triOrder.size(); i++)
+			triOrder[i] += runBegin;
+
+		for (uint16_t v : localVerts)
+			localIndices[v] = -1;
+
+		runBegin = t;
+	}
+
+	if (!shape->ReorderTriangles(triOrder))
+		return false;
+
+	// Renumber vertices in the order they are fetched by the new triangle order
+	std::vector<Triangle> orderedTris;
+	shape->GetTriangles(orderedTris);
+	const std::vector<uint16_t> vertMap = GenerateFetchOrderMap(orderedTris, numVerts);
+
+	auto geomData = shape->GetGeomData();
+	if (geomData)
+		geomData->notifyVerticesReorder(vertMap);
+	else
+		shape->notifyVerticesReorder(vertMap);
+
+	if (skinData)
+		skinData->notifyVerticesReorder(vertMap);
+
+	if (skinPart) {
+		std::vector<int> triParts(numTris);
+		for (uint32_t t = 0; t < numTris; t++)
+			triParts[t] = skinPart->triParts[triOrder[t]];
+
+		skinPart->triParts = std::move(triParts);
+		skinPart->notifyVerticesReorder(vertMap);
+
+		// Rebuild partition triangles in the new order
+		shape->GetTriangles(orderedTris);
+
+		for (auto& p : skinPart->partitions)
+			p.trueTriangles.clear();
+
+		const auto numPartitions = static_cast<int>(skinPart->partitions.size());
+		for (uint32_t t = 0; t < numTris; t++) {
+			const int partInd = skinPart->triParts[t];
+			if (partInd >= 0 && partInd < numPartitions)
+				skinPart->partitions[partInd].trueTriangles.push_back(orderedTris[t]);
+		}
+
+		for (auto& p : skinPart->partitions) {
+			// Order the partition's own vertices by first use as well
+			for (uint16_t i = 0; i < static_cast<uint16_t>(p.vertexMap.size()); i++)
+				if (p.vertexMap[i] < numVerts)
+					localIndices[p.vertexMap[i]] = i;
+
+			runTris.clear();
+			for (auto& t : p.trueTriangles)
+				if (localIndices[t.p1] != -1 && localIndices[t.p2] != -1 && localIndices[t.p3] != -1)
+					runTris.emplace_back(static_cast<uint16_t>(localIndices[t.p1]),
+										 static_cast<uint16_t>(localIndices[t.p2]),
+										 static_cast<uint16_t>(localIndices[t.p3]));
+
+			for (uint16_t v : p.vertexMap)
+				if (v < numVerts)
+					localIndices[v] = -1;
+
+			const std::vector<uint16_t> partMap = GenerateFetchOrderMap(runTris, p.vertexMap.size());
+			ApplyIndexPermutation(p.vertexMap, partMap);
+			ApplyIndexPermutation(p.vertexWeights, partMap);
+			ApplyIndexPermutation(p.boneIndices, partMap);
+
+			if (skinPart->bMappedIndices)
+				p.GenerateMappedTrianglesFromTrueTrianglesAndVertexMap();
+			else
+				p.triangles = p.trueTriangles;
+
+			p.numTriangles = static_cast<uint16_t>(p.triangles.size());
+		}
+	}
+
+	for (auto& extraDataRef : shape->extraDataRefs) {
+		auto integersExtraData = hdr.GetBlock<NiIntegersExtraData>(extraDataRef);
+		if (integersExtraData && integersExtraData->name == "LOCKEDNORM") {
+			integersExtraData = hdr.GetBlockForWrite<NiIntegersExtraData>(extraDataRef);
+			for (auto& val : integersExtraData->integersData)
+				if (val < numVerts)
+					val = vertMap[val];
+		}
+	}
+
+	// Morph targets of geometry morpher controllers are stored per vertex
+	auto controller = hdr.GetBlock(shape->controllerRef);
+	while (controller) {
+		auto geomMorpher = dynamic_cast<NiGeomMorpherController*>(controller);
+		if (geomMorpher) {
+			auto morphData = hdr.GetBlockForWrite(geomMorpher->dataRef);
+			if (morphData)
+				morphData->notifyVerticesReorder(vertMap);
+		}
+
+		controller = hdr.GetBlock(controller->nextControllerRef);
+	}
+
+	return true;
 }
 
 const std::vector<Vector3>* NifFile::GetVertsForShape(NiShape* shape) {
@@ -3113,7 +4752,7 @@ bool NifFile::GetVertsForShape(NiShape* shape, std::vector<Vector3>& outVerts) c
 			outVerts.resize(bsTriShape->GetNumVertices());
 
 			for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++)
-				outVerts[i] = bsTriShape->vertData[i].vert;
+				outVerts[i] = bsTriShape->GetVertexData()[i].vert;
 
 			return true;
 		}
@@ -3137,7 +4776,7 @@ bool NifFile::GetUvsForShape(NiShape* shape, std::vector<Vector2>& outUvs) const
 			outUvs.resize(bsTriShape->GetNumVertices());
 
 			for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++)
-				outUvs[i] = bsTriShape->vertData[i].uv;
+				outUvs[i] = bsTriShape->GetVertexData()[i].uv;
 
 			return true;
 		}
@@ -3159,11 +4798,12 @@ bool NifFile::GetColorsForShape(NiShape* shape, std::vector<Color4>& outColors)
 		if (bsTriShape && bsTriShape->HasVertexColors()) {
 			outColors.resize(bsTriShape->GetNumVertices());
 
+			const auto& vertData = bsTriShape->GetVertexData();
 			for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++) {
-				outColors[i].r = bsTriShape->vertData[i].colorData[0] / 255.0f;
-				outColors[i].g = bsTriShape->vertData[i].colorData[1] / 255.0f;
-				outColors[i].b = bsTriShape->vertData[i].colorData[2] / 255.0f;
-				outColors[i].a = bsTriShape->vertData[i].colorData[3] / 255.0f;
+				outColors[i].r = vertData[i].colorData[0] / 255.0f;
+				outColors[i].g = vertData[i].colorData[1] / 255.0f;
+				outColors[i].b = vertData[i].colorData[2] / 255.0f;
+				outColors[i].a = vertData[i].colorData[3] / 255.0f;
 			}
 
 			return true;
@@ -3186,13 +4826,11 @@ bool NifFile::GetTangentsForShape(NiShape* shape, std::vector<Vector3>& outTang)
 		if (bsTriShape && bsTriShape->HasTangents()) {
 			outTang.resize(bsTriShape->GetNumVertices());
 
+			const auto& vertData = bsTriShape->GetVertexData();
 			for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++) {
-				outTang[i].x = ((static_cast<float>(bsTriShape->vertData[i].tangent[0])) / 255.0f) * 2.0f
-							   - 1.0f;
-				outTang[i].y = ((static_cast<float>(bsTriShape->vertData[i].tangent[1])) / 255.0f) * 2.0f
-							   - 1.0f;
-				outTang[i].z = ((static_cast<float>(bsTriShape->vertData[i].tangent[2])) / 255.0f) * 2.0f
-							   - 1.0f;
+				outTang[i].x = ((static_cast<float>(vertData[i].tangent[0])) / 255.0f) * 2.0f - 1.0f;
+				outTang[i].y = ((static_cast<float>(vertData[i].tangent[1])) / 255.0f) * 2.0f - 1.0f;
+				outTang[i].z = ((static_cast<float>(vertData[i].tangent[2])) / 255.0f) * 2.0f - 1.0f;
 			}
 
 			return true;
@@ -3215,12 +4853,11 @@ bool NifFile::GetBitangentsForShape(NiShape* shape, std::vector<Vector3>& outBit
 		if (bsTriShape && bsTriShape->HasTangents()) {
 			outBitang.resize(bsTriShape->GetNumVertices());
 
+			const auto& vertData = bsTriShape->GetVertexData();
 			for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++) {
-				outBitang[i].x = bsTriShape->vertData[i].bitangentX;
-				outBitang[i].y = ((static_cast<float>(bsTriShape->vertData[i].bitangentY)) / 255.0f) * 2.0f
-								 - 1.0f;
-				outBitang[i].z = ((static_cast<float>(bsTriShape->vertData[i].bitangentZ)) / 255.0f) * 2.0f
-								 - 1.0f;
+				outBitang[i].x = vertData[i].bitangentX;
+				outBitang[i].y = ((static_cast<float>(vertData[i].bitangentY)) / 255.0f) * 2.0f - 1.0f;
+				outBitang[i].z = ((static_cast<float>(vertData[i].bitangentZ)) / 255.0f) * 2.0f - 1.0f;
 			}
 
 			return true;
@@ -3236,7 +4873,7 @@ bool NifFile::GetEyeDataForShape(NiShape* shape, std::vector<float>& outEyeData)
 		outEyeData.resize(bsTriShape->GetNumVertices());
 
 		for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++)
-			outEyeData[i] = bsTriShape->vertData[i].eyeData;
+			outEyeData[i] = bsTriShape->GetVertexData()[i].eyeData;
 
 		return true;
 	}
@@ -3248,13 +4885,18 @@ void NifFile::SetVertsForShape(NiShape* shape, const std::vector<Vector3>& verts
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
 	if (shape->HasType<NiTriBasedGeom>()) {
 		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
 		if (geomData) {
-			if (verts.size() != geomData->GetNumVertices())
+			if (verts.size() != geomData->GetNumVertices()) {
 				geomData->Create(hdr.GetVersion(), &verts, nullptr, nullptr, nullptr);
-			else
+			}
+			else {
 				geomData->vertices = verts;
+				geomData->MarkVerticesChanged();
+			}
 		}
 	}
 	else if (shape->HasType<BSTriShape>()) {
@@ -3264,8 +4906,9 @@ void NifFile::SetVertsForShape(NiShape* shape, const std::vector<Vector3>& verts
 				bsTriShape->Create(hdr.GetVersion(), &verts, nullptr, nullptr, nullptr);
 			}
 			else {
+				auto& vertData = bsTriShape->GetVertexDataForWrite();
 				for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++)
-					bsTriShape->vertData[i].vert = verts[i];
+					vertData[i].vert = verts[i];
 			}
 		}
 	}
@@ -3275,6 +4918,8 @@ void NifFile::SetUvsForShape(NiShape* shape, const std::vector<Vector2>& uvs) {
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
 	if (shape->HasType<NiTriBasedGeom>()) {
 		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
 		if (geomData && uvs.size() == geomData->GetNumVertices()) {
@@ -3287,8 +4932,9 @@ void NifFile::SetUvsForShape(NiShape* shape, const std::vector<Vector2>& uvs) {
 		if (bsTriShape && uvs.size() == bsTriShape->GetNumVertices()) {
 			bsTriShape->SetUVs(true);
 
+			auto& vertData = bsTriShape->GetVertexDataForWrite();
 			for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++)
-				bsTriShape->vertData[i].uv = uvs[i];
+				vertData[i].uv = uvs[i];
 		}
 	}
 }
@@ -3297,6 +4943,8 @@ void NifFile::SetColorsForShape(NiShape* shape, const std::vector<Color4>& color
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
 	if (shape->HasType<NiTriBasedGeom>()) {
 		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
 		if (geomData && colors.size() == geomData->GetNumVertices()) {
@@ -3309,8 +4957,9 @@ void NifFile::SetColorsForShape(NiShape* shape, const std::vector<Color4>& color
 		if (bsTriShape && colors.size() == bsTriShape->GetNumVertices()) {
 			bsTriShape->SetVertexColors(true);
 
+			auto& vertData = bsTriShape->GetVertexDataForWrite();
 			for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++) {
-				auto& vertex = bsTriShape->vertData[i];
+				auto& vertex = vertData[i];
 
 				float f = std::max(0.0f, std::min(1.0f, colors[i].r));
 				vertex.colorData[0] = static_cast<uint8_t>(std::floor(f == 1.0f ? 255 : f * 256.0));
@@ -3340,6 +4989,8 @@ void NifFile::SetTangentsForShape(NiShape* shape, const std::vector<Vector3>& ta
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
 	if (shape->HasType<NiTriBasedGeom>()) {
 		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
 		if (geomData) {
@@ -3358,6 +5009,8 @@ void NifFile::SetBitangentsForShape(NiShape* shape, const std::vector<Vector3>&
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
 	if (shape->HasType<NiTriBasedGeom>()) {
 		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
 		if (geomData) {
@@ -3376,6 +5029,8 @@ void NifFile::SetEyeDataForShape(NiShape* shape, const std::vector<float>& eyeDa
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
 	auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
 	if (bsTriShape && eyeData.size() == bsTriShape->GetNumVertices())
 		bsTriShape->SetEyeData(eyeData);
@@ -3441,7 +5096,7 @@ void NifFile::SetBinaryTangentData(NiShape* shape,
 	for (auto& extraData : shape->extraDataRefs) {
 		auto binaryExtraData = hdr.GetBlock<NiBinaryExtraData>(extraData);
 		if (binaryExtraData && binaryExtraData->name.get() == "Tangent space (binormal & tangent vectors)") {
-			binaryData = binaryExtraData;
+			binaryData = hdr.GetBlockForWrite<NiBinaryExtraData>(extraData);
 			break;
 		}
 	}
@@ -3486,31 +5141,26 @@ void NifFile::DeleteBinaryTangentData(NiShape* shape) {
 }
 
 void NifFile::InvertUVsForShape(NiShape* shape, bool invertX, bool invertY) {
-	if (!shape)
+	if (!shape || (!invertX && !invertY))
 		return;
 
-	if (shape->HasType<NiTriBasedGeom>()) {
-		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
-		if (geomData && !geomData->uvSets.empty()) {
-			if (invertX)
-				for (auto& i : geomData->uvSets[0])
-					i.u = 1.0f - i.u;
+	shape = GetBlockForWrite(shape);
 
-			if (invertY)
-				for (auto& i : geomData->uvSets[0])
-					i.v = 1.0f - i.v;
+	const Vector2 scale(invertX ? -1.0f : 1.0f, invertY ? -1.0f : 1.0f);
+	const Vector2 offset(invertX ? 1.0f : 0.0f, invertY ? 1.0f : 0.0f);
+
+	if (shape->HasType<NiTriBasedGeom>()) {
+		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
+		if (geomData && !geomData->uvSets.empty() && !geomData->uvSets[0].empty()) {
+			auto& uvs = geomData->uvSets[0];
+			TransformTexCoords(uvs.data(), uvs.size(), sizeof(Vector2), scale, offset);
 		}
 	}
 	else if (shape->HasType<BSTriShape>()) {
 		auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
-		if (bsTriShape) {
-			if (invertX)
-				for (auto& i : bsTriShape->vertData)
-					i.uv.u = 1.0f - i.uv.u;
-
-			if (invertY)
-				for (auto& i : bsTriShape->vertData)
-					i.uv.v = 1.0f - i.uv.v;
+		if (bsTriShape && !bsTriShape->GetVertexData().empty()) {
+			auto& vertData = bsTriShape->GetVertexDataForWrite();
+			TransformTexCoords(&vertData.front().uv, vertData.size(), sizeof(BSVertexData), scale, offset);
 		}
 	}
 }
@@ -3519,6 +5169,8 @@ void NifFile::MirrorShape(NiShape* shape, bool mirrorX, bool mirrorY, bool mirro
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
 	bool flipTris = false;
 	Matrix4 mirrorMat;
 
@@ -3540,32 +5192,23 @@ void NifFile::MirrorShape(NiShape* shape, bool mirrorX, bool mirrorY, bool mirro
 	if (shape->HasType<NiTriBasedGeom>()) {
 		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
 		if (geomData && !geomData->vertices.empty()) {
-			for (auto& vertice : geomData->vertices)
-				vertice = mirrorMat * vertice;
+			for (auto vecs : {&geomData->vertices, &geomData->normals, &geomData->tangents, &geomData->bitangents})
+				TransformPoints(vecs->data(), vecs->size(), sizeof(Vector3), mirrorMat);
 
-			for (auto& normal : geomData->normals)
-				normal = mirrorMat * normal;
-
-			for (auto& tangent : geomData->tangents)
-				tangent = mirrorMat * tangent;
-
-			for (auto& bitangent : geomData->bitangents)
-				bitangent = mirrorMat * bitangent;
+			geomData->MarkVerticesChanged();
 		}
 	}
 	else if (shape->HasType<BSTriShape>()) {
 		auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
-		if (bsTriShape) {
-			for (auto& i : bsTriShape->vertData)
-				i.vert = mirrorMat * i.vert;
+		if (bsTriShape && !bsTriShape->GetVertexData().empty()) {
+			auto& vertData = bsTriShape->GetVertexDataForWrite();
+			TransformPoints(&vertData.front().vert, vertData.size(), sizeof(BSVertexData), mirrorMat);
 
 			if (bsTriShape->HasNormals()) {
-				bsTriShape->UpdateRawNormals();
-
-				for (auto& normal : bsTriShape->rawNormals)
-					normal = mirrorMat * normal;
+				std::vector<Vector3> normals = bsTriShape->UpdateRawNormals();
+				TransformPoints(normals.data(), normals.size(), sizeof(Vector3), mirrorMat);
 
-				bsTriShape->SetNormals(bsTriShape->rawNormals);
+				bsTriShape->SetNormals(normals);
 
 				if (bsTriShape->HasTangents())
 					bsTriShape->CalcTangentSpace();
@@ -3588,6 +5231,8 @@ void NifFile::SetNormalsForShape(NiShape* shape, const std::vector<Vector3>& nor
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
 	if (shape->HasType<NiTriBasedGeom>()) {
 		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
 		if (geomData) {
@@ -3609,12 +5254,16 @@ void NifFile::CalcNormalsForShape(NiShape* shape,
 	if (!shape)
 		return;
 
+	NIFLY_TRACE_SCOPE("NifFile::CalcNormalsForShape");
+
 	if (hdr.GetVersion().IsSK() || hdr.GetVersion().IsSSE()) {
 		NiShader* shader = GetShader(shape);
 		if (shader && shader->IsModelSpace() && !force)
 			return;
 	}
 
+	shape = GetBlockForWrite(shape);
+
 	std::unordered_set<uint32_t> lockedIndices;
 
 	for (auto& extraDataRef : shape->extraDataRefs) {
@@ -3640,6 +5289,10 @@ void NifFile::CalcTangentsForShape(NiShape* shape) {
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
+	NIFLY_TRACE_SCOPE("NifFile::CalcTangentsForShape");
+
 	if (shape->HasType<NiTriBasedGeom>()) {
 		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
 		if (geomData)
@@ -3698,6 +5351,7 @@ int NifFile::ApplyNormalsFromFile(NifFile& srcNif, const std::string& shapeName)
 		workNorms[i] = sn;
 	}
 
+	shape = GetBlockForWrite(shape);
 	SetNormalsForShape(shape, workNorms);
 
 	for (auto& extraDataRef : shape->extraDataRefs) {
@@ -3722,176 +5376,171 @@ void NifFile::MoveVertex(NiShape* shape, const Vector3& pos, const int id) {
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
 	if (shape->HasType<NiTriBasedGeom>()) {
 		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
-		if (geomData && geomData->GetNumVertices() > id)
+		if (geomData && geomData->GetNumVertices() > id) {
 			geomData->vertices[id] = pos;
+			geomData->MarkVerticesChanged();
+		}
 	}
 	else if (shape->HasType<BSTriShape>()) {
 		auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
-		if (bsTriShape && bsTriShape->GetNumVertices() > id)
-			bsTriShape->vertData[id].vert = pos;
+		if (bsTriShape && bsTriShape->GetNumVertices() > id) {
+			bsTriShape->GetVertexDataForWrite()[id].vert = pos;
+		}
 	}
 }
 
-void NifFile::OffsetShape(NiShape* shape, const Vector3& offset, std::unordered_map<uint16_t, float>* mask) {
-	if (!shape)
+// Converts a masking map (1 = fully masked) to per-vertex transform weights
+static std::vector<float> MaskToWeights(const std::unordered_map<uint16_t, float>& mask, const uint16_t numVerts) {
+	std::vector<float> weights(numVerts, 1.0f);
+	for (auto& m : mask)
+		if (m.first < numVerts)
+			weights[m.first] = 1.0f - m.second;
+
+	return weights;
+}
+
+// Applies the transformation to the vertex positions of the shape in place.
+// Each vertex is blended by its weight if weights are specified.
+static void TransformShapeVertices(NiShape* shape, const Matrix4& mat, const std::vector<float>* weights) {
+	if (weights && weights->size() != shape->GetNumVertices())
 		return;
 
+	const float* weightData = weights ? weights->data() : nullptr;
+
 	if (shape->HasType<NiTriBasedGeom>()) {
-		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
-		if (geomData) {
-			for (uint16_t i = 0; i < geomData->GetNumVertices(); i++) {
-				if (mask) {
-					float maskFactor = 1.0f;
-					Vector3 diff = offset;
-					if (mask->find(i) != mask->end()) {
-						maskFactor = 1.0f - (*mask)[i];
-						diff *= maskFactor;
-					}
-					geomData->vertices[i] += diff;
-				}
-				else
-					geomData->vertices[i] += offset;
-			}
+		auto geomData = shape->GetGeomData();
+		if (geomData && geomData->vertices.size() == shape->GetNumVertices()) {
+			TransformPoints(geomData->vertices.data(), geomData->vertices.size(), sizeof(Vector3), mat, weightData);
+			geomData->MarkVerticesChanged();
 		}
 	}
 	else if (shape->HasType<BSTriShape>()) {
 		auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
-		if (bsTriShape) {
-			for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++) {
-				if (mask) {
-					float maskFactor = 1.0f;
-					Vector3 diff = offset;
-					if (mask->find(i) != mask->end()) {
-						maskFactor = 1.0f - (*mask)[i];
-						diff *= maskFactor;
-					}
-					bsTriShape->vertData[i].vert += diff;
-				}
-				else
-					bsTriShape->vertData[i].vert += offset;
-			}
+		if (bsTriShape && !bsTriShape->GetVertexData().empty()) {
+			auto& vertData = bsTriShape->GetVertexDataForWrite();
+			TransformPoints(&vertData.front().vert, vertData.size(), sizeof(BSVertexData), mat, weightData);
 		}
 	}
 }
 
+static Matrix4 GetOffsetMatrix(const Vector3& offset) {
+	Matrix4 mat;
+	mat.Translate(offset);
+	return mat;
+}
+
+static Matrix4 GetScaleMatrix(const Vector3& scale, const Vector3& root) {
+	Matrix4 mat;
+	mat.Translate(-root.x, -root.y, -root.z);
+	mat.Scale(scale.x, scale.y, scale.z);
+	return mat;
+}
+
+static Matrix4 GetRotationMatrix(const Vector3& angle, const Vector3& root) {
+	Matrix4 mat;
+	mat.Translate(-root.x, -root.y, -root.z);
+	mat.Rotate(angle.x * DEG2RAD, Vector3(1.0f, 0.0f, 0.0f));
+	mat.Rotate(angle.y * DEG2RAD, Vector3(0.0f, 1.0f, 0.0f));
+	mat.Rotate(angle.z * DEG2RAD, Vector3(0.0f, 0.0f, 1.0f));
+	return mat;
+}
+
+void NifFile::OffsetShape(NiShape* shape, const Vector3& offset, std::unordered_map<uint16_t, float>* mask) {
+	if (!shape)
+		return;
+
+	shape = GetBlockForWrite(shape);
+
+	std::vector<float> weights;
+	if (mask)
+		weights = MaskToWeights(*mask, shape->GetNumVertices());
+
+	TransformShapeVertices(shape, GetOffsetMatrix(offset), mask ? &weights : nullptr);
+}
+
+void NifFile::OffsetShape(NiShape* shape, const Vector3& offset, const std::vector<float>& weights) {
+	if (!shape)
+		return;
+
+	shape = GetBlockForWrite(shape);
+
+	TransformShapeVertices(shape, GetOffsetMatrix(offset), &weights);
+}
+
+// All vertices are moved by the negated root translation, only the scaling or rotation is weighted
+static void TransformShapeVerticesFromRoot(NiShape* shape,
+										   const Matrix4& mat,
+										   const Vector3& root,
+										   const std::vector<float>& weights) {
+	if (weights.size() != shape->GetNumVertices())
+		return;
+
+	if (!root.IsZero())
+		TransformShapeVertices(shape, GetOffsetMatrix(root * -1.0f), nullptr);
+
+	TransformShapeVertices(shape, mat, &weights);
+}
+
 void NifFile::ScaleShape(NiShape* shape, const Vector3& scale, std::unordered_map<uint16_t, float>* mask) {
 	if (!shape)
 		return;
 
+	if (mask) {
+		ScaleShape(shape, scale, MaskToWeights(*mask, shape->GetNumVertices()));
+		return;
+	}
+
+	shape = GetBlockForWrite(shape);
+
 	Vector3 root;
 	GetRootTranslation(root);
 
-	if (shape->HasType<NiTriBasedGeom>()) {
-		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
-		if (!geomData)
-			return;
+	TransformShapeVertices(shape, GetScaleMatrix(scale, root), nullptr);
+}
 
-		std::unordered_map<uint16_t, Vector3> diff;
-		for (uint16_t i = 0; i < geomData->GetNumVertices(); i++) {
-			Vector3 target = geomData->vertices[i] - root;
-			target.x *= scale.x;
-			target.y *= scale.y;
-			target.z *= scale.z;
-			diff[i] = geomData->vertices[i] - target;
-
-			if (mask) {
-				float maskFactor = 1.0f;
-				if (mask->find(i) != mask->end()) {
-					maskFactor = 1.0f - (*mask)[i];
-					diff[i] *= maskFactor;
-					target = geomData->vertices[i] - root + diff[i];
-				}
-			}
-			geomData->vertices[i] = target;
-		}
-	}
-	else if (shape->HasType<BSTriShape>()) {
-		auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
-		if (!bsTriShape)
-			return;
+void NifFile::ScaleShape(NiShape* shape, const Vector3& scale, const std::vector<float>& weights) {
+	if (!shape)
+		return;
 
-		std::unordered_map<uint16_t, Vector3> diff;
-		for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++) {
-			Vector3 target = bsTriShape->vertData[i].vert - root;
-			target.x *= scale.x;
-			target.y *= scale.y;
-			target.z *= scale.z;
-			diff[i] = bsTriShape->vertData[i].vert - target;
-
-			if (mask) {
-				float maskFactor = 1.0f;
-				if (mask->find(i) != mask->end()) {
-					maskFactor = 1.0f - (*mask)[i];
-					diff[i] *= maskFactor;
-					target = bsTriShape->vertData[i].vert - root + diff[i];
-				}
-			}
-			bsTriShape->vertData[i].vert = target;
-		}
-	}
+	shape = GetBlockForWrite(shape);
+
+	Vector3 root;
+	GetRootTranslation(root);
+
+	TransformShapeVerticesFromRoot(shape, GetScaleMatrix(scale, Vector3()), root, weights);
 }
 
 void NifFile::RotateShape(NiShape* shape, const Vector3& angle, std::unordered_map<uint16_t, float>* mask) {
 	if (!shape)
 		return;
 
+	if (mask) {
+		RotateShape(shape, angle, MaskToWeights(*mask, shape->GetNumVertices()));
+		return;
+	}
+
+	shape = GetBlockForWrite(shape);
+
 	Vector3 root;
 	GetRootTranslation(root);
 
-	if (shape->HasType<NiTriBasedGeom>()) {
-		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
-		if (!geomData)
-			return;
+	TransformShapeVertices(shape, GetRotationMatrix(angle, root), nullptr);
+}
 
-		std::unordered_map<uint16_t, Vector3> diff;
-		for (uint16_t i = 0; i < geomData->GetNumVertices(); i++) {
-			Vector3 target = geomData->vertices[i] - root;
-			Matrix4 mat;
-			mat.Rotate(angle.x * DEG2RAD, Vector3(1.0f, 0.0f, 0.0f));
-			mat.Rotate(angle.y * DEG2RAD, Vector3(0.0f, 1.0f, 0.0f));
-			mat.Rotate(angle.z * DEG2RAD, Vector3(0.0f, 0.0f, 1.0f));
-			target = mat * target;
-			diff[i] = geomData->vertices[i] - target;
-
-			if (mask) {
-				float maskFactor = 1.0f;
-				if (mask->find(i) != mask->end()) {
-					maskFactor = 1.0f - (*mask)[i];
-					diff[i] *= maskFactor;
-					target = geomData->vertices[i] - root + diff[i];
-				}
-			}
-			geomData->vertices[i] = target;
-		}
-	}
-	else if (shape->HasType<BSTriShape>()) {
-		auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
-		if (!bsTriShape)
-			return;
+void NifFile::RotateShape(NiShape* shape, const Vector3& angle, const std::vector<float>& weights) {
+	if (!shape)
+		return;
 
-		std::unordered_map<uint16_t, Vector3> diff;
-		for (uint16_t i = 0; i < bsTriShape->GetNumVertices(); i++) {
-			Vector3 target = bsTriShape->vertData[i].vert - root;
-			Matrix4 mat;
-			mat.Rotate(angle.x * DEG2RAD, Vector3(1.0f, 0.0f, 0.0f));
-			mat.Rotate(angle.y * DEG2RAD, Vector3(0.0f, 1.0f, 0.0f));
-			mat.Rotate(angle.z * DEG2RAD, Vector3(0.0f, 0.0f, 1.0f));
-			target = mat * target;
-			diff[i] = bsTriShape->vertData[i].vert - target;
-
-			if (mask) {
-				float maskFactor = 1.0f;
-				if (mask->find(i) != mask->end()) {
-					maskFactor = 1.0f - (*mask)[i];
-					diff[i] *= maskFactor;
-					target = bsTriShape->vertData[i].vert - root + diff[i];
-				}
-			}
-			bsTriShape->vertData[i].vert = target;
-		}
-	}
+	shape = GetBlockForWrite(shape);
+
+	Vector3 root;
+	GetRootTranslation(root);
+
+	TransformShapeVerticesFromRoot(shape, GetRotationMatrix(angle, Vector3()), root, weights);
 }
 
 NiAlphaProperty* NifFile::GetAlphaProperty(NiShape* shape) const {
@@ -3909,6 +5558,7 @@ NiAlphaProperty* NifFile::GetAlphaProperty(NiShape* shape) const {
 
 uint32_t NifFile::AssignAlphaProperty(NiShape* shape, NiAlphaProperty* alphaProp) {
 	std::unique_ptr<NiAlphaProperty> alpha(alphaProp);
+	shape = GetBlockForWrite(shape);
 	RemoveAlphaProperty(shape);
 
 	NiShader* shader = GetShader(shape);
@@ -3928,6 +5578,7 @@ uint32_t NifFile::AssignAlphaProperty(NiShape* shape, NiAlphaProperty* alphaProp
 void NifFile::RemoveAlphaProperty(NiShape* shape) {
 	auto alpha = hdr.GetBlock(shape->AlphaPropertyRef());
 	if (alpha) {
+		shape = GetBlockForWrite(shape);
 		hdr.DeleteBlock(*shape->AlphaPropertyRef());
 		shape->AlphaPropertyRef()->Clear();
 	}
@@ -3946,6 +5597,8 @@ void NifFile::DeleteShape(NiShape* shape) {
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
 	if (shape->HasData())
 		hdr.DeleteBlock(*shape->DataRef());
 
@@ -3969,6 +5622,7 @@ void NifFile::DeleteShape(NiShape* shape) {
 void NifFile::DeleteShader(NiShape* shape) {
 	auto shader = hdr.GetBlock(shape->ShaderPropertyRef());
 	if (shader) {
+		shape = GetBlockForWrite(shape);
 		if (shader->HasTextureSet()) {
 			if (hdr.GetBlockRefCount(shader->TextureSetRef()->index, false) == 1)
 				hdr.DeleteBlock(*shader->TextureSetRef());
@@ -4000,6 +5654,8 @@ void NifFile::DeleteShader(NiShape* shape) {
 }
 
 void NifFile::DeleteSkinning(NiShape* shape) {
+	shape = GetBlockForWrite(shape);
+
 	auto skinInst = hdr.GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
 	if (skinInst) {
 		hdr.DeleteBlock(skinInst->dataRef);
@@ -4023,7 +5679,7 @@ void NifFile::DeleteSkinning(NiShape* shape) {
 
 	shape->SetSkinned(false);
 
-	NiShader* shader = GetShader(shape);
+	NiShader* shader = GetBlockForWrite(GetShader(shape));
 	if (shader)
 		shader->SetSkinned(false);
 }
@@ -4032,13 +5688,17 @@ void NifFile::RemoveEmptyPartitions(NiShape* shape) {
 	if (!shape)
 		return;
 
+	shape = GetBlockForWrite(shape);
+
 	auto skinInst = hdr.GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
 	if (skinInst) {
 		auto skinPartition = hdr.GetBlock(skinInst->skinPartitionRef);
 		if (skinPartition) {
+			skinPartition = hdr.GetBlockForWrite(skinInst->skinPartitionRef);
+
 			std::vector<uint32_t> emptyIndices;
 			if (skinPartition->RemoveEmptyPartitions(emptyIndices)) {
-				auto bsdSkinInst = dynamic_cast<BSDismemberSkinInstance*>(skinInst);
+				auto bsdSkinInst = hdr.GetBlockForWrite<BSDismemberSkinInstance>(shape->SkinInstanceRef());
 				if (bsdSkinInst) {
 					bsdSkinInst->DeletePartitions(emptyIndices);
 					UpdatePartitionFlags(shape);
@@ -4055,6 +5715,8 @@ bool NifFile::DeleteVertsForShape(NiShape* shape, const std::vector<uint16_t>& i
 	if (!shape)
 		return false;
 
+	shape = GetBlockForWrite(shape);
+
 	auto geomData = hdr.GetBlock<NiTriBasedGeomData>(shape->DataRef());
 	if (geomData) {
 		geomData->notifyVerticesDelete(indices);
@@ -4075,17 +5737,17 @@ bool NifFile::DeleteVertsForShape(NiShape* shape, const std::vector<uint16_t>& i
 
 	auto skinInst = hdr.GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
 	if (skinInst) {
-		auto skinData = hdr.GetBlock(skinInst->dataRef);
+		auto skinData = hdr.GetBlockForWrite(skinInst->dataRef);
 		if (skinData)
 			skinData->notifyVerticesDelete(indices);
 
-		auto skinPartition = hdr.GetBlock(skinInst->skinPartitionRef);
+		auto skinPartition = hdr.GetBlockForWrite(skinInst->skinPartitionRef);
 		if (skinPartition) {
 			skinPartition->notifyVerticesDelete(indices);
 
 			std::vector<uint32_t> emptyIndices;
 			if (skinPartition->RemoveEmptyPartitions(emptyIndices)) {
-				auto bsdSkinInst = dynamic_cast<BSDismemberSkinInstance*>(skinInst);
+				auto bsdSkinInst = hdr.GetBlockForWrite<BSDismemberSkinInstance>(shape->SkinInstanceRef());
 				if (bsdSkinInst) {
 					bsdSkinInst->DeletePartitions(emptyIndices);
 					UpdatePartitionFlags(shape);
@@ -4116,19 +5778,41 @@ bool NifFile::DeleteVertsForShape(NiShape* shape, const std::vector<uint16_t>& i
 					val = indexCollapse[val];
 			}
 
-			integersExtraData->integersData = std::move(integersData);
+			hdr.GetBlockForWrite<NiIntegersExtraData>(extraDataRef)->integersData = std::move(integersData);
 		}
 	}
 
 	return false;
 }
 
+// Converts sparse difference data to the difference map format
+static void SparseDiffToMap(const SparseDiffData& diffData, std::unordered_map<uint16_t, Vector3>& outDiffData) {
+	outDiffData.reserve(diffData.size());
+	for (size_t i = 0; i < diffData.size(); i++)
+		outDiffData[diffData.indices[i]] = diffData.GetDiff(i);
+}
+
 int NifFile::CalcShapeDiff(NiShape* shape,
 						   const std::vector<Vector3>* targetData,
 						   std::unordered_map<uint16_t, Vector3>& outDiffData,
 						   float scale) {
 	outDiffData.clear();
 
+	SparseDiffData diffData;
+	int res = CalcShapeDiff(shape, targetData, diffData, scale);
+	if (res != 0)
+		return res;
+
+	SparseDiffToMap(diffData, outDiffData);
+	return 0;
+}
+
+int NifFile::CalcShapeDiff(NiShape* shape,
+						   const std::vector<Vector3>* targetData,
+						   SparseDiffData& outDiffData,
+						   float scale) {
+	outDiffData.clear();
+
 	const std::vector<Vector3>* myData = GetVertsForShape(shape);
 	if (!myData)
 		return 1;
@@ -4139,27 +5823,28 @@ int NifFile::CalcShapeDiff(NiShape* shape,
 	if (myData->size() != targetData->size())
 		return 3;
 
-	for (uint16_t i = 0; i < static_cast<uint16_t>(myData->size()); i++) {
-		auto& target = targetData->at(i);
-		auto& src = myData->at(i);
-
-		Vector3 v;
-		v.x = (target.x * scale) - src.x;
-		v.y = (target.y * scale) - src.y;
-		v.z = (target.z * scale) - src.z;
+	outDiffData.Calc(myData->data(), targetData->data(), myData->size(), scale);
+	return 0;
+}
 
-		if (v.IsZero(true))
-			continue;
+int NifFile::CalcUVDiff(NiShape* shape,
+						const std::vector<Vector2>* targetData,
+						std::unordered_map<uint16_t, Vector3>& outDiffData,
+						float scale) {
+	outDiffData.clear();
 
-		outDiffData[i] = v;
-	}
+	SparseDiffData diffData;
+	int res = CalcUVDiff(shape, targetData, diffData, scale);
+	if (res != 0)
+		return res;
 
+	SparseDiffToMap(diffData, outDiffData);
 	return 0;
 }
 
 int NifFile::CalcUVDiff(NiShape* shape,
 						const std::vector<Vector2>* targetData,
-						std::unordered_map<uint16_t, Vector3>& outDiffData,
+						SparseDiffData& outDiffData,
 						float scale) {
 	outDiffData.clear();
 
@@ -4173,40 +5858,187 @@ int NifFile::CalcUVDiff(NiShape* shape,
 	if (myData->size() != targetData->size())
 		return 3;
 
-	for (uint16_t i = 0; i < static_cast<uint16_t>(myData->size()); i++) {
-		Vector3 v;
-		v.x = (targetData->at(i).u - myData->at(i).u) * scale;
-		v.y = (targetData->at(i).v - myData->at(i).v) * scale;
+	outDiffData.Calc(myData->data(), targetData->data(), myData->size(), 1.0f, scale);
+	return 0;
+}
+
+void NifFile::ApplyShapeDiff(NiShape* shape, const SparseDiffData& diffData, const float weight) {
+	if (!shape || diffData.empty())
+		return;
 
-		if (v.IsZero(true))
-			continue;
+	shape = GetBlockForWrite(shape);
 
-		outDiffData[i] = v;
+	if (shape->HasType<NiTriBasedGeom>()) {
+		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
+		if (geomData) {
+			diffData.ApplyTo(geomData->vertices.data(), geomData->vertices.size(), sizeof(Vector3), weight);
+			geomData->MarkVerticesChanged();
+		}
+	}
+	else if (shape->HasType<BSTriShape>()) {
+		auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
+		if (bsTriShape && !bsTriShape->GetVertexData().empty()) {
+			auto& vertData = bsTriShape->GetVertexDataForWrite();
+			diffData.ApplyTo(&vertData.front().vert, vertData.size(), sizeof(BSVertexData), weight);
+		}
 	}
+}
 
-	return 0;
+void NifFile::ApplyUVDiff(NiShape* shape, const SparseDiffData& diffData, const float weight) {
+	if (!shape || diffData.empty())
+		return;
+
+	shape = GetBlockForWrite(shape);
+
+	if (shape->HasType<NiTriBasedGeom>()) {
+		auto geomData = hdr.GetBlock<NiGeometryData>(shape->DataRef());
+		if (geomData && !geomData->uvSets.empty()) {
+			auto& uvs = geomData->uvSets[0];
+			diffData.ApplyTo(uvs.data(), uvs.size(), sizeof(Vector2), weight);
+		}
+	}
+	else if (shape->HasType<BSTriShape>()) {
+		auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
+		if (bsTriShape && !bsTriShape->GetVertexData().empty()) {
+			auto& vertData = bsTriShape->GetVertexDataForWrite();
+			diffData.ApplyTo(&vertData.front().uv, vertData.size(), sizeof(BSVertexData), weight);
+		}
+	}
+}
+
+// Bone membership of a skin partition as a bitset over all bones of the skin
+struct PartitionBones {
+	std::vector<bool> used;
+	uint16_t count = 0;
+
+	PartitionBones(const uint16_t numBones)
+		: used(numBones) {}
+
+	uint16_t CountNew(const uint16_t* bones, const uint8_t numBones) const {
+		uint16_t newBones = 0;
+		for (uint8_t i = 0; i < numBones; i++)
+			if (!used[bones[i]])
+				newBones++;
+
+		return newBones;
+	}
+
+	void Add(const uint16_t* bones, const uint8_t numBones) {
+		for (uint8_t i = 0; i < numBones; i++) {
+			if (!used[bones[i]]) {
+				used[bones[i]] = true;
+				count++;
+			}
+		}
+	}
+};
+
+using TriangleBones = std::array<uint16_t, 12>;
+
+// Packs the triangles "partTris" into as few partitions as possible.  Triangles with
+// identical bone sets are grouped, then the groups are placed largest first into the
+// partition requiring the fewest additional bones (best fit decreasing).
+static std::vector<PartitionBones> ClusterTrianglesByBones(const std::vector<uint32_t>& partTris,
+														   const std::vector<TriangleBones>& triBones,
+														   const std::vector<uint8_t>& triBoneCounts,
+														   const uint16_t numBones,
+														   const uint16_t maxBonesPerPartition,
+														   std::vector<uint16_t>& outTriClusters) {
+	// Sort triangles by their (sorted) bone sets so that equal sets are adjacent
+	std::vector<std::pair<TriangleBones, uint32_t>> sortedTris;
+	sortedTris.reserve(partTris.size());
+	for (uint32_t i = 0; i < partTris.size(); i++) {
+		TriangleBones bones = triBones[partTris[i]];
+		const uint8_t count = triBoneCounts[partTris[i]];
+		std::sort(bones.begin(), bones.begin() + count);
+		std::fill(bones.begin() + count, bones.end(), std::numeric_limits<uint16_t>::max());
+		sortedTris.emplace_back(bones, i);
+	}
+
+	std::sort(sortedTris.begin(), sortedTris.end());
+
+	struct BoneGroup {
+		uint32_t first = 0;
+		uint32_t last = 0;
+		uint8_t numBones = 0;
+	};
+
+	std::vector<BoneGroup> groups;
+	for (uint32_t i = 0; i < sortedTris.size(); i++) {
+		if (i == 0 || sortedTris[i].first != sortedTris[i - 1].first) {
+			BoneGroup group;
+			group.first = i;
+			group.numBones = triBoneCounts[partTris[sortedTris[i].second]];
+			groups.push_back(group);
+		}
+
+		groups.back().last = i;
+	}
+
+	std::stable_sort(groups.begin(), groups.end(), [](const BoneGroup& lhs, const BoneGroup& rhs) {
+		return lhs.numBones > rhs.numBones;
+	});
+
+	std::vector<PartitionBones> clusters;
+	outTriClusters.resize(partTris.size());
+
+	for (auto& group : groups) {
+		const uint16_t* bones = sortedTris[group.first].first.data();
+
+		size_t bestCluster = clusters.size();
+		uint16_t bestNewBones = std::numeric_limits<uint16_t>::max();
+		for (size_t c = 0; c < clusters.size(); c++) {
+			const uint16_t newBones = clusters[c].CountNew(bones, group.numBones);
+			if (clusters[c].count + newBones > maxBonesPerPartition)
+				continue;
+
+			if (newBones < bestNewBones
+				|| (newBones == bestNewBones && clusters[c].count > clusters[bestCluster].count)) {
+				bestCluster = c;
+				bestNewBones = newBones;
+			}
+		}
+
+		if (bestCluster == clusters.size())
+			clusters.emplace_back(numBones);
+
+		clusters[bestCluster].Add(bones, group.numBones);
+
+		for (uint32_t i = group.first; i <= group.last; i++)
+			outTriClusters[sortedTris[i].second] = static_cast<uint16_t>(bestCluster);
+	}
+
+	return clusters;
 }
 
 void NifFile::UpdateSkinPartitions(NiShape* shape) {
+	UpdateSkinPartitions(shape, SkinPartitionOptions());
+}
+
+SkinPartitionResult NifFile::UpdateSkinPartitions(NiShape* shape, const SkinPartitionOptions& options) {
+	NIFLY_TRACE_SCOPE("NifFile::UpdateSkinPartitions");
+
+	SkinPartitionResult result;
+
 	NiSkinData* skinData = nullptr;
 	NiSkinPartition* skinPart = nullptr;
 	auto skinInst = hdr.GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
 	if (skinInst) {
 		skinData = hdr.GetBlock(skinInst->dataRef);
-		skinPart = hdr.GetBlock(skinInst->skinPartitionRef);
+		skinPart = hdr.GetBlockForWrite(skinInst->skinPartitionRef);
 
 		if (!skinData || !skinPart)
-			return;
+			return result;
 	}
 	else
-		return;
+		return result;
 
 	std::vector<Triangle> tris;
 	if (!shape->GetTriangles(tris))
-		return;
+		return result;
 
-	auto bsdSkinInst = dynamic_cast<BSDismemberSkinInstance*>(skinInst);
-	auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
+	auto bsdSkinInst = hdr.GetBlockForWrite<BSDismemberSkinInstance>(shape->SkinInstanceRef());
+	auto bsTriShape = GetBlockForWrite(dynamic_cast<BSTriShape*>(shape));
 	if (bsTriShape)
 		bsTriShape->CalcDataSizes(hdr.GetVersion());
 
@@ -4214,26 +6046,43 @@ void NifFile::UpdateSkinPartitions(NiShape* shape) {
 	for (auto& t : tris)
 		t.rot();
 
-	// Make maps of vertices to bones and weights
-	std::unordered_map<uint16_t, std::vector<SkinWeight>> vertBoneWeights;
-	uint16_t boneIndex = 0;
-	for (auto& bone : skinData->bones) {
-		for (auto& bw : bone.vertexWeights)
-			vertBoneWeights[bw.index].push_back(SkinWeight(boneIndex, bw.weight));
+	// Enforce maximum vertex bone weight count
+	constexpr uint16_t maxBonesPerVertex = 4;
 
-		boneIndex++;
-	}
+	size_t numVerts = shape->GetNumVertices();
+	for (auto& t : tris)
+		numVerts = std::max<size_t>(numVerts, static_cast<size_t>(std::max({t.p1, t.p2, t.p3})) + 1);
 
-	// Sort weights and corresponding bones
-	for (auto& bw : vertBoneWeights)
-		sort(bw.second.begin(), bw.second.end(), BoneWeightsSort());
+	// Flat table of the strongest bone weights of each vertex, sorted by weight (descending).
+	// Weights of equal strength keep their bone order.
+	std::vector<std::array<SkinWeight, maxBonesPerVertex>> vertBoneWeights(numVerts);
+	std::vector<uint8_t> vertBoneCounts(numVerts, 0);
 
-	// Enforce maximum vertex bone weight count
-	const uint16_t maxBonesPerVertex = 4;
+	const auto numBones = static_cast<uint16_t>(skinData->bones.size());
+	for (uint16_t boneIndex = 0; boneIndex < numBones; boneIndex++) {
+		for (auto& bw : skinData->bones[boneIndex].vertexWeights) {
+			if (bw.index >= numVerts)
+				continue;
+
+			auto& weights = vertBoneWeights[bw.index];
+			uint8_t& count = vertBoneCounts[bw.index];
+
+			uint8_t pos = count;
+			while (pos > 0 && weights[pos - 1].weight < bw.weight)
+				pos--;
+
+			if (pos >= maxBonesPerVertex)
+				continue;
+
+			for (uint8_t i = std::min<uint8_t>(count, maxBonesPerVertex - 1); i > pos; i--)
+				weights[i] = weights[i - 1];
+
+			weights[pos] = SkinWeight(boneIndex, bw.weight);
 
-	for (auto& bw : vertBoneWeights)
-		if (bw.second.size() > maxBonesPerVertex)
-			bw.second.resize(maxBonesPerVertex);
+			if (count < maxBonesPerVertex)
+				count++;
+		}
+	}
 
 	skinPart->PrepareTriParts(tris);
 	std::vector<int>& triParts = skinPart->triParts;
@@ -4244,50 +6093,112 @@ void NifFile::UpdateSkinPartitions(NiShape* shape) {
 	else if (hdr.GetVersion().IsSSE())
 		maxBonesPerPartition = 80;
 
+	result.maxBonesPerPartition = maxBonesPerPartition;
+
+	// Get associated bones for each tri
+	std::vector<TriangleBones> triBones(tris.size());
+	std::vector<uint8_t> triBoneCounts(tris.size(), 0);
+	for (size_t triIndex = 0; triIndex < tris.size(); ++triIndex) {
+		auto& bones = triBones[triIndex];
+		uint8_t& numTriBones = triBoneCounts[triIndex];
+
+		for (uint32_t i = 0; i < 3; i++) {
+			const uint16_t v = tris[triIndex][i];
+			for (uint8_t w = 0; w < vertBoneCounts[v]; w++) {
+				const uint16_t tb = vertBoneWeights[v][w].index;
+				if (std::find(bones.begin(), bones.begin() + numTriBones, tb) == bones.begin() + numTriBones)
+					bones[numTriBones++] = tb;
+			}
+		}
+	}
+
 	// Make a list of the bones used by each partition.  If any partition
-	// has too many bones, split it.
-	std::vector<std::set<int>> partBones(skinPart->partitions.size());
+	// has too many bones, split it.  Each existing partition becomes one or
+	// more consecutive partitions, a new one is started with the triangle
+	// that would exceed the bone limit.
+	const size_t numOldParts = skinPart->partitions.size();
+	std::vector<std::vector<PartitionBones>> splitBones(numOldParts);
+	for (auto& split : splitBones)
+		split.emplace_back(numBones);
+
+	std::vector<uint16_t> triSplit(tris.size(), 0);
 	for (size_t triIndex = 0; triIndex < tris.size(); ++triIndex) {
-		int partInd = triParts[triIndex];
-		if (partInd < 0)
+		const int partInd = triParts[triIndex];
+		if (partInd < 0 || static_cast<size_t>(partInd) >= numOldParts)
 			continue;
 
-		Triangle tri = tris[triIndex];
-
-		// Get associated bones for the current tri
-		std::set<int> triBones;
-		for (uint32_t i = 0; i < 3; i++)
-			for (auto& tb : vertBoneWeights[tri[i]])
-				triBones.insert(tb.index);
+		auto& split = splitBones[partInd];
 
 		// How many new bones are in the tri's bone list?
-		uint16_t newBoneCount = 0;
-		for (auto& tb : triBones)
-			if (partBones[partInd].find(tb) == partBones[partInd].end())
-				newBoneCount++;
-
-		const auto partBonesSize = static_cast<uint16_t>(partBones[partInd].size());
-		if (partBonesSize + newBoneCount > maxBonesPerPartition) {
+		const uint16_t newBoneCount = split.back().CountNew(triBones[triIndex].data(), triBoneCounts[triIndex]);
+		if (split.back().count + newBoneCount > maxBonesPerPartition) {
 			// Too many bones for this partition, make a new partition starting with this triangle
-			for (size_t j = 0; j < tris.size(); ++j)
-				if (triParts[j] > partInd || (j >= triIndex && triParts[j] >= partInd))
-					++triParts[j];
+			split.emplace_back(numBones);
+		}
+
+		split.back().Add(triBones[triIndex].data(), triBoneCounts[triIndex]);
+		triSplit[triIndex] = static_cast<uint16_t>(split.size() - 1);
+	}
+
+	if (options.strategy == SPS_BONE_SIMILARITY) {
+		// Re-split overfull partitions by grouping triangles with similar bones,
+		// keeping the sequential split where it resulted in fewer partitions
+		std::vector<std::vector<uint32_t>> oldPartTris(numOldParts);
+		for (uint32_t triIndex = 0; triIndex < tris.size(); ++triIndex) {
+			const int partInd = triParts[triIndex];
+			if (partInd >= 0 && static_cast<size_t>(partInd) < numOldParts)
+				oldPartTris[partInd].push_back(triIndex);
+		}
+
+		for (size_t partInd = 0; partInd < numOldParts; partInd++) {
+			if (splitBones[partInd].size() < 2)
+				continue;
+
+			std::vector<uint16_t> triClusters;
+			auto clusters = ClusterTrianglesByBones(oldPartTris[partInd],
+													triBones,
+													triBoneCounts,
+													numBones,
+													maxBonesPerPartition,
+													triClusters);
+
+			if (clusters.size() < splitBones[partInd].size()) {
+				splitBones[partInd] = std::move(clusters);
+
+				for (size_t i = 0; i < triClusters.size(); i++)
+					triSplit[oldPartTris[partInd][i]] = triClusters[i];
+			}
+		}
+	}
+
+	// Renumber partitions of all triangles in one pass
+	std::vector<int> partOffsets(numOldParts, 0);
+	for (size_t partInd = 1; partInd < numOldParts; partInd++)
+		partOffsets[partInd] = partOffsets[partInd - 1] + static_cast<int>(splitBones[partInd - 1].size());
 
-			partBones.insert(partBones.begin() + partInd + 1, std::set<int>());
+	for (size_t triIndex = 0; triIndex < tris.size(); ++triIndex) {
+		const int partInd = triParts[triIndex];
+		if (partInd >= 0 && static_cast<size_t>(partInd) < numOldParts)
+			triParts[triIndex] = partOffsets[partInd] + triSplit[triIndex];
+	}
 
-			if (bsdSkinInst) {
+	if (bsdSkinInst) {
+		// Split partitions keep the partition ID of their original partition
+		for (size_t partInd = std::min<size_t>(numOldParts, bsdSkinInst->partitions.size()); partInd-- > 0;) {
+			for (size_t i = 1; i < splitBones[partInd].size(); i++) {
 				BSDismemberSkinInstance::PartitionInfo info;
 				info.flags = PF_EDITOR_VISIBLE;
-				info.partID = bsdSkinInst->partitions[partInd].partID;
-				bsdSkinInst->partitions.insert(partInd + 1, info);
+				info.partID = bsdSkinInst->partitions[static_cast<uint32_t>(partInd)].partID;
+				bsdSkinInst->partitions.insert(static_cast<uint32_t>(partInd + 1), info);
 			}
-
-			++partInd;
 		}
-
-		partBones[partInd].insert(triBones.begin(), triBones.end());
 	}
 
+	std::vector<PartitionBones> partBones;
+	for (auto& split : splitBones)
+		for (auto& bones : split)
+			partBones.push_back(std::move(bones));
+
 	// Re-create partitions
 	std::vector<NiSkinPartition::PartitionBlock> partitions(partBones.size());
 	for (size_t partInd = 0; partInd < partBones.size(); partInd++) {
@@ -4305,6 +6216,7 @@ void NifFile::UpdateSkinPartitions(NiShape* shape) {
 	skinPart->GenerateTrueTrianglesFromTriParts(tris);
 	skinPart->PrepareVertexMapsAndTriangles();
 
+	std::vector<uint8_t> boneLookup(numBones, 0);
 	for (uint32_t partInd = 0; partInd < skinPart->numPartitions; ++partInd) {
 		NiSkinPartition::PartitionBlock& part = skinPart->partitions[partInd];
 
@@ -4312,16 +6224,19 @@ void NifFile::UpdateSkinPartitions(NiShape* shape) {
 		if (bsTriShape)
 			part.vertexDesc = bsTriShape->vertexDesc;
 
-		std::unordered_map<int, uint8_t> boneLookup;
-		boneLookup.reserve(partBones[partInd].size());
-		part.numBones = static_cast<uint16_t>(partBones[partInd].size());
+		part.numBones = partBones[partInd].count;
 		part.bones.reserve(part.numBones);
 
-		for (auto& b : partBones[partInd]) {
-			part.bones.push_back(b);
-			boneLookup[b] = static_cast<uint8_t>(part.bones.size() - 1);
+		for (uint16_t b = 0; b < numBones; b++) {
+			if (partBones[partInd].used[b]) {
+				boneLookup[b] = static_cast<uint8_t>(part.bones.size());
+				part.bones.push_back(b);
+			}
 		}
 
+		part.boneIndices.reserve(part.vertexMap.size());
+		part.vertexWeights.reserve(part.vertexMap.size());
+
 		for (auto& v : part.vertexMap) {
 			BoneIndices b;
 			VertexWeight vw;
@@ -4330,10 +6245,7 @@ void NifFile::UpdateSkinPartitions(NiShape* shape) {
 			float* pw = &vw.w1;
 
 			float tot = 0.0f;
-			for (size_t bi = 0; bi < vertBoneWeights[v].size(); bi++) {
-				if (bi == 4)
-					break;
-
+			for (uint8_t bi = 0; bi < vertBoneCounts[v]; bi++) {
 				pb[bi] = boneLookup[vertBoneWeights[v][bi].index];
 				pw[bi] = vertBoneWeights[v][bi].weight;
 				tot += pw[bi];
@@ -4352,15 +6264,24 @@ void NifFile::UpdateSkinPartitions(NiShape* shape) {
 		skinPart->numVertices = bsTriShape->GetNumVertices();
 		skinPart->dataSize = bsTriShape->dataSize;
 		skinPart->vertexSize = bsTriShape->vertexSize;
-		skinPart->vertData = bsTriShape->vertData;
+		skinPart->vertData = bsTriShape->GetVertexData();
 		skinPart->vertexDesc = bsTriShape->vertexDesc;
 	}
 
 	UpdatePartitionFlags(shape);
+
+	result.numPartitions = skinPart->numPartitions;
+	result.numAddedPartitions = skinPart->numPartitions - static_cast<uint32_t>(numOldParts);
+	for (auto& part : skinPart->partitions) {
+		result.maxBones = std::max(result.maxBones, part.numBones);
+		result.totalBones += part.numBones;
+	}
+
+	return result;
 }
 
 void NifFile::UpdatePartitionFlags(NiShape* shape) {
-	auto bsdSkinInst = hdr.GetBlock<BSDismemberSkinInstance>(shape->SkinInstanceRef());
+	auto bsdSkinInst = hdr.GetBlockForWrite<BSDismemberSkinInstance>(shape->SkinInstanceRef());
 	if (!bsdSkinInst)
 		return;
 
@@ -4392,6 +6313,8 @@ void NifFile::UpdatePartitionFlags(NiShape* shape) {
 }
 
 void NifFile::CreateSkinning(NiShape* shape) {
+	shape = GetBlockForWrite(shape);
+
 	if (shape->HasType<NiTriShape>()) {
 		if (shape->SkinInstanceRef()->IsEmpty()) {
 			int skinDataID = hdr.AddBlock(new NiSkinData);
@@ -4465,7 +6388,7 @@ void NifFile::CreateSkinning(NiShape* shape) {
 		}
 	}
 
-	NiShader* shader = GetShader(shape);
+	NiShader* shader = GetBlockForWrite(GetShader(shape));
 	if (shader)
 		shader->SetSkinned(true);
 }
@@ -0,0 +1,277 @@
+/*
+nifly
+C++ NIF library for the Gamebryo/NetImmerse File Format
+See the included GPLv3 LICENSE file
+*/
+
+#include "NifGenerator.hpp"
+#include "bhk.hpp"
+
+using namespace nifly;
+
+// Triangulated grid with the requested vertex count, the last row may be incomplete
+struct GridData {
+	uint16_t width = 0;
+	std::vector<Vector3> verts;
+	std::vector<Vector2> uvs;
+	std::vector<Vector3> normals;
+	std::vector<Triangle> tris;
+};
+
+static GridData GenerateGrid(const uint16_t numVerts) {
+	GridData grid;
+	grid.width = static_cast<uint16_t>(std::ceil(std::sqrt(static_cast<float>(numVerts))));
+	if (grid.width < 2)
+		grid.width = 2;
+
+	const uint16_t height = static_cast<uint16_t>((numVerts + grid.width - 1) / grid.width);
+	const float invWidth = 1.0f / static_cast<float>(grid.width - 1);
+	const float invHeight = 1.0f / static_cast<float>(std::max<uint16_t>(height - 1, 1));
+
+	grid.verts.reserve(numVerts);
+	grid.uvs.reserve(numVerts);
+	grid.normals.resize(numVerts, Vector3(0.0f, 0.0f, 1.0f));
+
+	for (uint16_t i = 0; i < numVerts; i++) {
+		const uint16_t x = i % grid.width;
+		const uint16_t y = i / grid.width;
+		grid.verts.emplace_back(static_cast<float>(x), static_cast<float>(y), 0.0f);
+		grid.uvs.emplace_back(static_cast<float>(x) * invWidth, static_cast<float>(y) * invHeight);
+	}
+
+	// Only quads with all four corners in range
+	for (uint16_t y = 0; y + 1 < height; y++) {
+		for (uint16_t x = 0; x + 1 < grid.width; x++) {
+			const auto v0 = static_cast<uint16_t>(y * grid.width + x);
+			const auto v1 = static_cast<uint16_t>(v0 + 1);
+			const auto v2 = static_cast<uint16_t>(v0 + grid.width);
+			const auto v3 = static_cast<uint16_t>(v2 + 1);
+
+			if (v2 < numVerts)
+				grid.tris.emplace_back(v0, v1, v2);
+			if (v3 < numVerts)
+				grid.tris.emplace_back(v1, v3, v2);
+		}
+	}
+
+	return grid;
+}
+
+// Skins the shape to the bones, which are blended across the grid columns
+static void GenerateSkin(NifFile& nif,
+						 NiShape* shape,
+						 const GridData& grid,
+						 std::vector<int>& boneIds,
+						 const std::vector<Vector3>& boneTranslations) {
+	NiHeader& hdr = nif.GetHeader();
+
+	nif.CreateSkinning(shape);
+	nif.SetShapeBoneIDList(shape, boneIds);
+
+	const auto numBones = static_cast<uint16_t>(boneIds.size());
+	for (uint16_t b = 0; b < numBones; b++) {
+		// Bones are only translated, so skin-to-bone is the negated global translation
+		MatTransform skinToBone;
+		skinToBone.translation = boneTranslations[b] * -1.0f;
+		nif.SetShapeTransformSkinToBone(shape, b, skinToBone);
+	}
+
+	// Weights are written to the blocks directly, the name-based setters would search the whole file
+	NiSkinData* skinData = nullptr;
+	auto skinInst = hdr.GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
+	if (skinInst)
+		skinData = hdr.GetBlock(skinInst->dataRef);
+
+	auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
+
+	const auto numVerts = static_cast<uint16_t>(grid.verts.size());
+	for (uint16_t v = 0; v < numVerts; v++) {
+		const uint16_t x = v % grid.width;
+		const auto b0 = static_cast<uint16_t>(x * numBones / grid.width);
+		const auto b1 = static_cast<uint16_t>(std::min<int>(b0 + 1, numBones - 1));
+		const float w0 = b0 == b1 ? 1.0f : 0.75f;
+		const float w1 = 1.0f - w0;
+
+		if (skinData) {
+			skinData->bones[b0].vertexWeights.emplace_back(v, w0);
+			if (w1 > 0.0f)
+				skinData->bones[b1].vertexWeights.emplace_back(v, w1);
+		}
+
+		if (bsTriShape && v < bsTriShape->GetVertexData().size()) {
+			auto& vertex = bsTriShape->GetVertexDataForWrite()[v];
+			vertex.weights = {w0, w1, 0.0f, 0.0f};
+			vertex.weightBones = {static_cast<uint8_t>(b0), static_cast<uint8_t>(w1 > 0.0f ? b1 : 0), 0, 0};
+		}
+	}
+
+	if (skinData) {
+		for (auto& bone : skinData->bones)
+			bone.numVertices = static_cast<uint16_t>(bone.vertexWeights.size());
+
+		nif.UpdateSkinPartitions(shape);
+	}
+}
+
+static void GenerateController(NiHeader& hdr, NiNode* node, const uint32_t nodeId) {
+	const Vector3 translation = node->GetTransformToParent().translation;
+
+	auto data = std::make_unique<NiTransformData>();
+	data->translations.SetInterpolationType(LINEAR_KEY);
+
+	NiAnimationKey<Vector3> key;
+	key.type = LINEAR_KEY;
+	key.time = 0.0f;
+	key.value = translation;
+	data->translations.AddKey(key);
+	key.time = 1.0f;
+	key.value = translation + Vector3(0.0f, 0.0f, 1.0f);
+	data->translations.AddKey(key);
+
+	auto interp = std::make_unique<NiTransformInterpolator>();
+	interp->translation = translation;
+	interp->scale = 1.0f;
+	interp->dataRef.index = hdr.AddBlock(data.release());
+
+	auto controller = std::make_unique<NiTransformController>();
+	controller->startTime = 0.0f;
+	controller->stopTime = 1.0f;
+	controller->targetRef.index = nodeId;
+	controller->interpolatorRef.index = hdr.AddBlock(interp.release());
+
+	node->controllerRef.index = hdr.AddBlock(controller.release());
+}
+
+static void GenerateCollision(NiHeader& hdr, NiNode* node, const uint32_t nodeId) {
+	auto box = std::make_unique<bhkBoxShape>();
+	box->dimensions = Vector3(0.5f, 0.5f, 0.5f);
+	box->radius = 0.05f;
+
+	auto body = std::make_unique<bhkRigidBody>();
+	body->shapeRef.index = hdr.AddBlock(box.release());
+
+	auto collision = std::make_unique<bhkCollisionObject>();
+	collision->targetRef.index = nodeId;
+	collision->bodyRef.index = hdr.AddBlock(body.release());
+
+	node->collisionRef.index = hdr.AddBlock(collision.release());
+}
+
+int NifGenerator::Generate(NifFile& nif) const {
+	if (options.vertsPerShape < 3 || options.nodeDepth == 0)
+		return 1;
+
+	// Bone indices of BSTriShape vertices are 8-bit
+	if (options.bonesPerSkin > 256)
+		return 1;
+
+	nif.CreateNamed<NiNode>(options.version, "Scene Root");
+
+	NiHeader& hdr = nif.GetHeader();
+	NiNode* rootNode = nif.GetRootNode();
+
+	// Block IDs and pointers are tracked here, since looking them up would search the whole file
+	struct GeneratedNode {
+		NiNode* node = nullptr;
+		uint32_t id = 0;
+		Vector3 globalTranslation;
+	};
+
+	std::vector<GeneratedNode> nodes;
+	std::vector<GeneratedNode> leafNodes;
+
+	// Bones need a node each
+	const uint32_t numNodes = std::max<uint32_t>(options.nodeCount, options.bonesPerSkin);
+	nodes.reserve(numNodes);
+
+	for (uint32_t i = 0; i < numNodes; i++) {
+		const uint32_t level = i % options.nodeDepth;
+
+		MatTransform xformToParent;
+		if (level == 0)
+			xformToParent.translation = Vector3(static_cast<float>(i / options.nodeDepth) * 2.0f, 0.0f, 0.0f);
+		else
+			xformToParent.translation = Vector3(0.0f, 0.0f, 1.0f);
+
+		NiNode* parent = level == 0 ? rootNode : nodes.back().node;
+
+		GeneratedNode genNode;
+		genNode.node = nif.AddNode("Node" + std::to_string(i), xformToParent, parent);
+		genNode.id = hdr.GetNumBlocks() - 1;
+		genNode.globalTranslation = xformToParent.translation;
+		if (level > 0)
+			genNode.globalTranslation += nodes.back().globalTranslation;
+
+		nodes.push_back(genNode);
+
+		if (level + 1 == options.nodeDepth || i + 1 == numNodes)
+			leafNodes.push_back(genNode);
+	}
+
+	if (leafNodes.empty())
+		leafNodes.push_back({rootNode, 0, Vector3()});
+
+	const GridData grid = GenerateGrid(options.vertsPerShape);
+
+	std::vector<int> boneIds;
+	std::vector<Vector3> boneTranslations;
+
+	for (uint32_t s = 0; s < options.shapeCount; s++) {
+		NiShape* shape = nif.CreateShapeFromData("Shape" + std::to_string(s),
+												 &grid.verts,
+												 &grid.tris,
+												 &grid.uvs,
+												 &grid.normals);
+		if (!shape)
+			return 1;
+
+		// The shape is always added last and attached to the root node
+		const uint32_t shapeId = hdr.GetNumBlocks() - 1;
+		const GeneratedNode& parent = leafNodes[s % leafNodes.size()];
+		if (parent.node != rootNode) {
+			rootNode->childRefs.RemoveBlockRef(rootNode->childRefs.GetSize() - 1);
+			parent.node->childRefs.AddBlockRef(shapeId);
+		}
+
+		if (options.bonesPerSkin > 0) {
+			boneIds.clear();
+			boneTranslations.clear();
+
+			for (uint32_t b = 0; b < options.bonesPerSkin; b++) {
+				const GeneratedNode& bone = nodes[(s * options.bonesPerSkin + b) % nodes.size()];
+				boneIds.push_back(static_cast<int>(bone.id));
+				boneTranslations.push_back(bone.globalTranslation);
+			}
+
+			GenerateSkin(nif, shape, grid, boneIds, boneTranslations);
+		}
+	}
+
+	const uint32_t numControllers = std::min<uint32_t>(options.controllerCount, numNodes);
+	for (uint32_t i = 0; i < numControllers; i++)
+		GenerateController(hdr, nodes[i].node, nodes[i].id);
+
+	// Havok blocks of FO4 and later are stored in a binary blob, which isn't generated
+	const bool collision = options.collision && !options.version.IsFO4() && !options.version.IsFO76();
+	if (collision)
+		for (auto& leafNode : leafNodes)
+			GenerateCollision(hdr, leafNode.node, leafNode.id);
+
+	// Pad to the block count with extra data, spread across all nodes
+	uint32_t numExtraData = 0;
+	while (hdr.GetNumBlocks() < options.blockCount) {
+		auto extraData = std::make_unique<NiIntegerExtraData>();
+		extraData->name.get() = "GeneratedData";
+		extraData->integerData = numExtraData;
+
+		NiNode* node = rootNode;
+		const uint32_t nodeIndex = numExtraData % (numNodes + 1);
+		if (nodeIndex > 0)
+			node = nodes[nodeIndex - 1].node;
+
+		node->extraDataRefs.AddBlockRef(hdr.AddBlock(extraData.release()));
+		numExtraData++;
+	}
+
+	return 0;
+}
@@ -0,0 +1,196 @@
+/*
+nifly
+C++ NIF library for the Gamebryo/NetImmerse File Format
+See the included GPLv3 LICENSE file
+*/
+
+#include "NifTrace.hpp"
+
+#ifdef NIFLY_ENABLE_TRACING
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#endif
+
+using namespace nifly;
+
+#ifdef NIFLY_ENABLE_TRACING
+// Single-writer ring buffer of a thread.
+// Each slot has a sequence number that is odd while the slot is written,
+// so that a concurrent reader can detect and skip torn events.
+struct TraceThreadBuffer {
+	struct Slot {
+		std::atomic<uint64_t> sequence{0};
+		std::atomic<const char*> name{nullptr};
+		std::atomic<uint64_t> startNs{0};
+		std::atomic<uint64_t> endNs{0};
+	};
+
+	uint32_t threadIndex = 0;
+	std::atomic<bool> owned{false};
+	std::atomic<uint64_t> writeIndex{0};
+	std::unique_ptr<Slot[]> slots{new Slot[trace::ThreadBufferSize]};
+
+	void Record(const char* name, const uint64_t startNs, const uint64_t endNs) {
+		const uint64_t index = writeIndex.load(std::memory_order_relaxed);
+		Slot& slot = slots[index % trace::ThreadBufferSize];
+
+		slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.startNs.store(startNs, std::memory_order_relaxed);
+		slot.endNs.store(endNs, std::memory_order_relaxed);
+
+		slot.sequence.store(index * 2 + 2, std::memory_order_release);
+		writeIndex.store(index + 1, std::memory_order_release);
+	}
+};
+
+// Buffers are never freed, so events of finished threads can still be written.
+// Buffers of finished threads are reused by new threads.
+struct TraceRegistry {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<TraceThreadBuffer>> buffers;
+
+	static TraceRegistry& Get() {
+		static TraceRegistry registry;
+		return registry;
+	}
+
+	TraceThreadBuffer* Acquire() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& buffer : buffers) {
+			bool expected = false;
+			if (buffer->owned.compare_exchange_strong(expected, true))
+				return buffer.get();
+		}
+
+		auto buffer = std::make_unique<TraceThreadBuffer>();
+		buffer->threadIndex = static_cast<uint32_t>(buffers.size());
+		buffer->owned = true;
+		buffers.push_back(std::move(buffer));
+		return buffers.back().get();
+	}
+};
+
+// Owns the buffer of a thread and releases it for reuse when the thread ends
+struct TraceThreadHandle {
+	TraceThreadBuffer* buffer = TraceRegistry::Get().Acquire();
+	~TraceThreadHandle() { buffer->owned = false; }
+};
+
+static TraceThreadBuffer& GetThreadBuffer() {
+	thread_local TraceThreadHandle handle;
+	return *handle.buffer;
+}
+
+uint64_t trace::Now() {
+	static const auto epoch = std::chrono::steady_clock::now();
+	auto elapsed = std::chrono::steady_clock::now() - epoch;
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void trace::Record(const char* name, const uint64_t startNs, const uint64_t endNs) {
+	GetThreadBuffer().Record(name, startNs, endNs);
+}
+
+bool trace::IsEnabled() {
+	return true;
+}
+
+static void WriteTraceString(std::ostream& out, const char* str) {
+	out << '"';
+	for (; *str; str++) {
+		const char c = *str;
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (static_cast<unsigned char>(c) >= 0x20)
+			out << c;
+	}
+	out << '"';
+}
+
+// Writes nanoseconds as microseconds with three decimals
+static void WriteTraceTime(std::ostream& out, const uint64_t ns) {
+	const uint64_t fraction = ns % 1000;
+	out << ns / 1000 << '.' << static_cast<char>('0' + fraction / 100) << static_cast<char>('0' + fraction / 10 % 10)
+		<< static_cast<char>('0' + fraction % 10);
+}
+
+void trace::WriteChromeTrace(std::ostream& out) {
+	struct Event {
+		const char* name;
+		uint64_t startNs;
+		uint64_t endNs;
+	};
+
+	out << "{\"traceEvents\":[";
+
+	TraceRegistry& registry = TraceRegistry::Get();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	bool first = true;
+	std::vector<Event> events;
+	for (auto& buffer : registry.buffers) {
+		const uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+		const uint64_t begin = end > ThreadBufferSize ? end - ThreadBufferSize : 0;
+
+		// Copy the events first to keep the window for torn reads short
+		events.clear();
+		for (uint64_t i = begin; i < end; i++) {
+			const auto& slot = buffer->slots[i % ThreadBufferSize];
+			if (slot.sequence.load(std::memory_order_acquire) != i * 2 + 2)
+				continue;
+
+			Event event{slot.name.load(std::memory_order_relaxed),
+						slot.startNs.load(std::memory_order_relaxed),
+						slot.endNs.load(std::memory_order_relaxed)};
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) != i * 2 + 2)
+				continue;
+
+			events.push_back(event);
+		}
+
+		for (auto& event : events) {
+			out << (first ? "\n" : ",\n");
+			out << "{\"name\":";
+			WriteTraceString(out, event.name ? event.name : "");
+			out << ",\"cat\":\"nifly\",\"ph\":\"X\",\"ts\":";
+			WriteTraceTime(out, event.startNs);
+			out << ",\"dur\":";
+			WriteTraceTime(out, event.endNs - event.startNs);
+			out << ",\"pid\":1,\"tid\":" << buffer->threadIndex << "}";
+			first = false;
+		}
+	}
+
+	out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+void trace::Clear() {
+	TraceRegistry& registry = TraceRegistry::Get();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	for (auto& buffer : registry.buffers) {
+		for (uint32_t i = 0; i < ThreadBufferSize; i++)
+			buffer->slots[i].sequence.store(0, std::memory_order_relaxed);
+
+		buffer->writeIndex.store(0, std::memory_order_release);
+	}
+}
+#else
+bool trace::IsEnabled() {
+	return false;
+}
+
+void trace::WriteChromeTrace(std::ostream& out) {
+	out << "{\"traceEvents\":[],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+void trace::Clear() {}
+#endif
@@ -8,25 +8,24 @@ See the included GPLv3 LICENSE file
 
 using namespace nifly;
 
-void NiNode::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiNode::Sync(Stream& stream) {
 	childRefs.Sync(stream);
 
 	if (stream.GetVersion().User() <= 12 && stream.GetVersion().Stream() < 130)
 		effectRefs.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiNode)
 
-void NiNode::GetChildRefs(std::set<NiRef*>& refs) {
-	NiAVObject::GetChildRefs(refs);
+void NiNode::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiAVObject::ForEachChildRef(visitor);
 
-	childRefs.GetIndexPtrs(refs);
-	effectRefs.GetIndexPtrs(refs);
+	childRefs.ForEachRef(visitor);
+	effectRefs.ForEachRef(visitor);
 }
 
-void NiNode::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiAVObject::GetChildIndices(indices);
-
-	childRefs.GetIndices(indices);
-	effectRefs.GetIndices(indices);
+size_t NiNode::GetHeapSize() const {
+	return NiAVObject::GetHeapSize() + HeapSize(childRefs) + HeapSize(effectRefs);
 }
 
 NiBlockRefArray<NiAVObject>& NiNode::GetChildren() {
@@ -38,144 +37,161 @@ NiBlockRefArray<NiDynamicEffect>& NiNode::GetEffects() {
 }
 
 
-void BSValueNode::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSValueNode::Sync(Stream& stream) {
 	stream.Sync(value);
 	stream.Sync(valueFlags);
 }
+NIFLY_SYNC_INSTANTIATE(BSValueNode)
 
 
-void BSTreeNode::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSTreeNode::Sync(Stream& stream) {
 	bones1.Sync(stream);
 	bones2.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSTreeNode)
 
-void BSTreeNode::GetChildRefs(std::set<NiRef*>& refs) {
-	NiNode::GetChildRefs(refs);
+void BSTreeNode::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiNode::ForEachChildRef(visitor);
 
-	bones1.GetIndexPtrs(refs);
-	bones2.GetIndexPtrs(refs);
+	bones1.ForEachRef(visitor);
+	bones2.ForEachRef(visitor);
 }
 
-void BSTreeNode::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiNode::GetChildIndices(indices);
-
-	bones1.GetIndices(indices);
-	bones2.GetIndices(indices);
+size_t BSTreeNode::GetHeapSize() const {
+	return NiNode::GetHeapSize() + HeapSize(bones1) + HeapSize(bones2);
 }
 
 
-void BSOrderedNode::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSOrderedNode::Sync(Stream& stream) {
 	stream.Sync(alphaSortBound);
 	stream.Sync(isStaticBound);
 }
+NIFLY_SYNC_INSTANTIATE(BSOrderedNode)
 
 
-void BSMultiBoundOBB::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSMultiBoundOBB::Sync(Stream& stream) {
 	stream.Sync(center);
 	stream.Sync(size);
 	stream.Sync(rotation);
 }
+NIFLY_SYNC_INSTANTIATE(BSMultiBoundOBB)
 
 
-void BSMultiBoundAABB::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSMultiBoundAABB::Sync(Stream& stream) {
 	stream.Sync(center);
 	stream.Sync(halfExtent);
 }
+NIFLY_SYNC_INSTANTIATE(BSMultiBoundAABB)
 
 
-void BSMultiBoundSphere::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSMultiBoundSphere::Sync(Stream& stream) {
 	stream.Sync(center);
 	stream.Sync(radius);
 }
+NIFLY_SYNC_INSTANTIATE(BSMultiBoundSphere)
 
 
-void BSMultiBound::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSMultiBound::Sync(Stream& stream) {
 	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSMultiBound)
 
-void BSMultiBound::GetChildRefs(std::set<NiRef*>& refs) {
-	NiObject::GetChildRefs(refs);
+void BSMultiBound::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiObject::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
+	visitor(dataRef);
 }
 
-void BSMultiBound::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiObject::GetChildIndices(indices);
-
-	indices.push_back(dataRef.index);
-}
 
-
-void BSMultiBoundNode::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSMultiBoundNode::Sync(Stream& stream) {
 	multiBoundRef.Sync(stream);
 
 	if (stream.GetVersion().User() >= 12)
 		stream.Sync(cullingMode);
 }
+NIFLY_SYNC_INSTANTIATE(BSMultiBoundNode)
 
-void BSMultiBoundNode::GetChildRefs(std::set<NiRef*>& refs) {
-	NiNode::GetChildRefs(refs);
+void BSMultiBoundNode::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiNode::ForEachChildRef(visitor);
 
-	refs.insert(&multiBoundRef);
+	visitor(multiBoundRef);
 }
 
-void BSMultiBoundNode::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiNode::GetChildIndices(indices);
-
-	indices.push_back(multiBoundRef.index);
-}
 
-
-void BSRangeNode::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSRangeNode::Sync(Stream& stream) {
 	stream.Sync(min);
 	stream.Sync(max);
 	stream.Sync(current);
 }
+NIFLY_SYNC_INSTANTIATE(BSRangeNode)
 
 
-void NiBillboardNode::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiBillboardNode::Sync(Stream& stream) {
 	stream.Sync(billboardMode);
 }
+NIFLY_SYNC_INSTANTIATE(NiBillboardNode)
 
 
-void NiSwitchNode::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiSwitchNode::Sync(Stream& stream) {
 	stream.Sync(flags);
 	stream.Sync(index);
 }
+NIFLY_SYNC_INSTANTIATE(NiSwitchNode)
 
 
-void NiRangeLODData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiRangeLODData::Sync(Stream& stream) {
 	stream.Sync(lodCenter);
 	lodLevels.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiRangeLODData)
+
+size_t NiRangeLODData::GetHeapSize() const {
+	return NiLODData::GetHeapSize() + HeapSize(lodLevels);
+}
 
 
-void NiScreenLODData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiScreenLODData::Sync(Stream& stream) {
 	stream.Sync(boundCenter);
 	stream.Sync(boundRadius);
 	stream.Sync(worldCenter);
 	stream.Sync(worldRadius);
 	proportionLevels.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiScreenLODData)
 
-
-void NiLODNode::Sync(NiStreamReversible& stream) {
-	lodLevelData.Sync(stream);
+size_t NiScreenLODData::GetHeapSize() const {
+	return NiLODData::GetHeapSize() + HeapSize(proportionLevels);
 }
 
-void NiLODNode::GetChildRefs(std::set<NiRef*>& refs) {
-	NiSwitchNode::GetChildRefs(refs);
 
-	refs.insert(&lodLevelData);
+template<typename Stream>
+void NiLODNode::Sync(Stream& stream) {
+	lodLevelData.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiLODNode)
 
-void NiLODNode::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiSwitchNode::GetChildIndices(indices);
+void NiLODNode::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiSwitchNode::ForEachChildRef(visitor);
 
-	indices.push_back(lodLevelData.index);
+	visitor(lodLevelData);
 }
 
 
-void NiSortAdjustNode::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiSortAdjustNode::Sync(Stream& stream) {
 	stream.Sync(sortingMode);
 }
+NIFLY_SYNC_INSTANTIATE(NiSortAdjustNode)
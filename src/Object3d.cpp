@@ -207,6 +207,131 @@ MatTransform CalcMedianMatTransform(const std::vector<MatTransform>& ts) {
 	res.scale = CalcMedianOfFloats(scales);
 	return res;
 }
+
+// The transform loops below are kept free of branches and calls so the compiler can vectorize them.
+void TransformPoints(Vector3* points,
+					 const size_t count,
+					 const size_t stride,
+					 const Matrix4& mat,
+					 const float* weights) {
+	const float m0 = mat[0], m1 = mat[1], m2 = mat[2], m3 = mat[3];
+	const float m4 = mat[4], m5 = mat[5], m6 = mat[6], m7 = mat[7];
+	const float m8 = mat[8], m9 = mat[9], m10 = mat[10], m11 = mat[11];
+
+	auto data = reinterpret_cast<char*>(points);
+
+	if (weights) {
+		for (size_t i = 0; i < count; i++) {
+			auto& p = *reinterpret_cast<Vector3*>(data + i * stride);
+			const float x = p.x, y = p.y, z = p.z;
+			const float w = weights[i];
+			p.x = x + (m0 * x + m1 * y + m2 * z + m3 - x) * w;
+			p.y = y + (m4 * x + m5 * y + m6 * z + m7 - y) * w;
+			p.z = z + (m8 * x + m9 * y + m10 * z + m11 - z) * w;
+		}
+	}
+	else {
+		for (size_t i = 0; i < count; i++) {
+			auto& p = *reinterpret_cast<Vector3*>(data + i * stride);
+			const float x = p.x, y = p.y, z = p.z;
+			p.x = m0 * x + m1 * y + m2 * z + m3;
+			p.y = m4 * x + m5 * y + m6 * z + m7;
+			p.z = m8 * x + m9 * y + m10 * z + m11;
+		}
+	}
+}
+
+void TransformTexCoords(Vector2* uvs,
+						const size_t count,
+						const size_t stride,
+						const Vector2& scale,
+						const Vector2& offset) {
+	const float su = scale.u, sv = scale.v;
+	const float ou = offset.u, ov = offset.v;
+
+	auto data = reinterpret_cast<char*>(uvs);
+	for (size_t i = 0; i < count; i++) {
+		auto& uv = *reinterpret_cast<Vector2*>(data + i * stride);
+		uv.u = uv.u * su + ou;
+		uv.v = uv.v * sv + ov;
+	}
+}
+
+// Number of points that are compared at once by SparseDiffData::Calc
+constexpr size_t SparseDiffBlockSize = 256;
+
+// Calculates the differences of a block of points with 'calcDiff' and appends the ones that aren't nearly zero.
+// Differences and threshold tests are done for the whole block first so that the compiler can vectorize them.
+template<typename CalcDiffFunc>
+static void CalcSparseDiffBlocks(SparseDiffData& diffData, const size_t count, CalcDiffFunc calcDiff) {
+	diffData.clear();
+
+	float dx[SparseDiffBlockSize];
+	float dy[SparseDiffBlockSize];
+	float dz[SparseDiffBlockSize];
+	uint8_t keep[SparseDiffBlockSize];
+
+	for (size_t first = 0; first < count; first += SparseDiffBlockSize) {
+		const size_t n = std::min(SparseDiffBlockSize, count - first);
+
+		for (size_t i = 0; i < n; i++) {
+			calcDiff(first + i, dx[i], dy[i], dz[i]);
+			keep[i] = !((std::fabs(dx[i]) < EPSILON) & (std::fabs(dy[i]) < EPSILON) & (std::fabs(dz[i]) < EPSILON));
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			if (keep[i]) {
+				diffData.indices.push_back(static_cast<uint16_t>(first + i));
+				diffData.x.push_back(dx[i]);
+				diffData.y.push_back(dy[i]);
+				diffData.z.push_back(dz[i]);
+			}
+		}
+	}
+}
+
+void SparseDiffData::Calc(const Vector3* source,
+						  const Vector3* target,
+						  const size_t count,
+						  const float targetScale,
+						  const float diffScale) {
+	CalcSparseDiffBlocks(*this, count, [&](const size_t i, float& dx, float& dy, float& dz) {
+		dx = (target[i].x * targetScale - source[i].x) * diffScale;
+		dy = (target[i].y * targetScale - source[i].y) * diffScale;
+		dz = (target[i].z * targetScale - source[i].z) * diffScale;
+	});
+}
+
+void SparseDiffData::Calc(const Vector2* source,
+						  const Vector2* target,
+						  const size_t count,
+						  const float targetScale,
+						  const float diffScale) {
+	CalcSparseDiffBlocks(*this, count, [&](const size_t i, float& dx, float& dy, float& dz) {
+		dx = (target[i].u * targetScale - source[i].u) * diffScale;
+		dy = (target[i].v * targetScale - source[i].v) * diffScale;
+		dz = 0.0f;
+	});
+}
+
+void SparseDiffData::ApplyTo(Vector3* points, const size_t count, const size_t stride, const float weight) const {
+	auto data = reinterpret_cast<char*>(points);
+	for (size_t i = 0; i < indices.size() && indices[i] < count; i++) {
+		auto& p = *reinterpret_cast<Vector3*>(data + indices[i] * stride);
+		p.x += x[i] * weight;
+		p.y += y[i] * weight;
+		p.z += z[i] * weight;
+	}
+}
+
+void SparseDiffData::ApplyTo(Vector2* uvs, const size_t count, const size_t stride, const float weight) const {
+	auto data = reinterpret_cast<char*>(uvs);
+	for (size_t i = 0; i < indices.size() && indices[i] < count; i++) {
+		auto& uv = *reinterpret_cast<Vector2*>(data + indices[i] * stride);
+		uv.u += x[i] * weight;
+		uv.v += y[i] * weight;
+	}
+}
 } // namespace nifly
 
 
@@ -9,7 +9,8 @@ See the included GPLv3 LICENSE file
 
 using namespace nifly;
 
-void NiObjectNET::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiObjectNET::Sync(Stream& stream) {
 	if (bBSLightingShaderProperty && stream.GetVersion().User() >= 12 && stream.GetVersion().Stream() <= 130)
 		stream.Sync(bslspShaderType);
 
@@ -18,29 +19,28 @@ void NiObjectNET::Sync(NiStreamReversible& stream) {
 	extraDataRefs.Sync(stream);
 	controllerRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiObjectNET)
 
-void NiObjectNET::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiObject::GetStringRefs(refs);
+void NiObjectNET::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiObject::ForEachStringRef(visitor);
 
-	refs.emplace_back(&name);
+	visitor(name);
 }
 
-void NiObjectNET::GetChildRefs(std::set<NiRef*>& refs) {
-	NiObject::GetChildRefs(refs);
+void NiObjectNET::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiObject::ForEachChildRef(visitor);
 
-	extraDataRefs.GetIndexPtrs(refs);
-	refs.insert(&controllerRef);
+	extraDataRefs.ForEachRef(visitor);
+	visitor(controllerRef);
 }
 
-void NiObjectNET::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiObject::GetChildIndices(indices);
-
-	extraDataRefs.GetIndices(indices);
-	indices.push_back(controllerRef.index);
+size_t NiObjectNET::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(name) + HeapSize(extraDataRefs);
 }
 
 
-void NiAVObject::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiAVObject::Sync(Stream& stream) {
 	if (HasType<BSTriShape>()) {
 		// The order of definition for BSTriShape deviates slightly from previous versions.
 		// NiObjectNET -> NiAVObject (duplicated in BSTriShape) -> BSTriShape
@@ -65,36 +65,41 @@ void NiAVObject::Sync(NiStreamReversible& stream) {
 	if (stream.GetVersion().File() >= V10_0_1_0)
 		collisionRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiAVObject)
 
-void NiAVObject::GetChildRefs(std::set<NiRef*>& refs) {
-	NiObjectNET::GetChildRefs(refs);
+void NiAVObject::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiObjectNET::ForEachChildRef(visitor);
 
-	propertyRefs.GetIndexPtrs(refs);
-	refs.insert(&collisionRef);
+	propertyRefs.ForEachRef(visitor);
+	visitor(collisionRef);
 }
 
-void NiAVObject::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiObjectNET::GetChildIndices(indices);
-
-	propertyRefs.GetIndices(indices);
-	indices.push_back(collisionRef.index);
+size_t NiAVObject::GetHeapSize() const {
+	return NiObjectNET::GetHeapSize() + HeapSize(propertyRefs);
 }
 
 
-void NiDefaultAVObjectPalette::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiDefaultAVObjectPalette::Sync(Stream& stream) {
 	sceneRef.Sync(stream);
 	objects.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiDefaultAVObjectPalette)
 
-void NiDefaultAVObjectPalette::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiAVObjectPalette::GetPtrs(ptrs);
+void NiDefaultAVObjectPalette::ForEachPtr(const NiRefVisitor& visitor) {
+	NiAVObjectPalette::ForEachPtr(visitor);
 
-	ptrs.insert(&sceneRef);
-	objects.GetPtrs(ptrs);
+	visitor(sceneRef);
+	objects.ForEachPtr(visitor);
 }
 
+size_t NiDefaultAVObjectPalette::GetHeapSize() const {
+	return NiAVObjectPalette::GetHeapSize() + HeapSize(objects);
+}
 
-void NiCamera::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void NiCamera::Sync(Stream& stream) {
 	stream.Sync(obsoleteFlags);
 	stream.Sync(frustumLeft);
 	stream.Sync(frustumRight);
@@ -113,21 +118,17 @@ void NiCamera::Sync(NiStreamReversible& stream) {
 	stream.Sync(numScreenPolygons);
 	stream.Sync(numScreenTextures);
 }
+NIFLY_SYNC_INSTANTIATE(NiCamera)
 
-void NiCamera::GetChildRefs(std::set<NiRef*>& refs) {
-	NiAVObject::GetChildRefs(refs);
-
-	refs.insert(&sceneRef);
-}
-
-void NiCamera::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiAVObject::GetChildIndices(indices);
+void NiCamera::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiAVObject::ForEachChildRef(visitor);
 
-	indices.push_back(sceneRef.index);
+	visitor(sceneRef);
 }
 
 
-void NiPalette::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPalette::Sync(Stream& stream) {
 	stream.Sync(hasAlpha);
 
 	if (stream.GetMode() == NiStreamReversible::Mode::Writing) {
@@ -143,9 +144,15 @@ void NiPalette::Sync(NiStreamReversible& stream) {
 
 	palette.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPalette)
 
+size_t NiPalette::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(palette);
+}
 
-void TextureRenderData::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void TextureRenderData::Sync(Stream& stream) {
 	stream.Sync(pixelFormat);
 	stream.Sync(bitsPerPixel);
 	stream.Sync(rendererHint);
@@ -167,21 +174,21 @@ void TextureRenderData::Sync(NiStreamReversible& stream) {
 
 	mipmaps.SyncData(stream, sz);
 }
+NIFLY_SYNC_INSTANTIATE(TextureRenderData)
 
-void TextureRenderData::GetChildRefs(std::set<NiRef*>& refs) {
-	NiObject::GetChildRefs(refs);
+void TextureRenderData::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiObject::ForEachChildRef(visitor);
 
-	refs.insert(&paletteRef);
+	visitor(paletteRef);
 }
 
-void TextureRenderData::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiObject::GetChildIndices(indices);
-
-	indices.push_back(paletteRef.index);
+size_t TextureRenderData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(mipmaps);
 }
 
 
-void NiPersistentSrcTextureRendererData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPersistentSrcTextureRendererData::Sync(Stream& stream) {
 	stream.Sync(numPixels);
 	stream.Sync(padNumPixels);
 	stream.Sync(numFaces);
@@ -194,9 +201,15 @@ void NiPersistentSrcTextureRendererData::Sync(NiStreamReversible& stream) {
 			stream.Sync(pixelData[f][p]);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(NiPersistentSrcTextureRendererData)
+
+size_t NiPersistentSrcTextureRendererData::GetHeapSize() const {
+	return TextureRenderData::GetHeapSize() + HeapSize(pixelData);
+}
 
 
-void NiPixelData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPixelData::Sync(Stream& stream) {
 	stream.Sync(numPixels);
 	stream.Sync(numFaces);
 
@@ -207,9 +220,15 @@ void NiPixelData::Sync(NiStreamReversible& stream) {
 			stream.Sync(pixelData[f][p]);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(NiPixelData)
 
+size_t NiPixelData::GetHeapSize() const {
+	return TextureRenderData::GetHeapSize() + HeapSize(pixelData);
+}
 
-void NiSourceTexture::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void NiSourceTexture::Sync(Stream& stream) {
 	const NiFileVersion fileVersion = stream.GetVersion().File();
 
 	stream.Sync(useExternal);
@@ -245,27 +264,27 @@ void NiSourceTexture::Sync(NiStreamReversible& stream) {
 	if (fileVersion >= NiVersion::ToFile(20, 2, 0, 4))
 		stream.Sync(persistentRenderData);
 }
+NIFLY_SYNC_INSTANTIATE(NiSourceTexture)
 
-void NiSourceTexture::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiTexture::GetStringRefs(refs);
+void NiSourceTexture::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiTexture::ForEachStringRef(visitor);
 
-	refs.emplace_back(&fileName);
+	visitor(fileName);
 }
 
-void NiSourceTexture::GetChildRefs(std::set<NiRef*>& refs) {
-	NiTexture::GetChildRefs(refs);
+void NiSourceTexture::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiTexture::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
+	visitor(dataRef);
 }
 
-void NiSourceTexture::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiTexture::GetChildIndices(indices);
-
-	indices.push_back(dataRef.index);
+size_t NiSourceTexture::GetHeapSize() const {
+	return NiTexture::GetHeapSize() + HeapSize(fileName);
 }
 
 
-void NiDynamicEffect::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiDynamicEffect::Sync(Stream& stream) {
 	if (stream.GetVersion().Stream() < 130) {
 		if (stream.GetVersion().File() > NiFileVersion::V10_1_0_101)
 			stream.Sync(switchState);
@@ -274,15 +293,21 @@ void NiDynamicEffect::Sync(NiStreamReversible& stream) {
 			affectedNodes.Sync(stream);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(NiDynamicEffect)
 
-void NiDynamicEffect::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiAVObject::GetPtrs(ptrs);
+void NiDynamicEffect::ForEachPtr(const NiRefVisitor& visitor) {
+	NiAVObject::ForEachPtr(visitor);
 
-	affectedNodes.GetIndexPtrs(ptrs);
+	affectedNodes.ForEachRef(visitor);
+}
+
+size_t NiDynamicEffect::GetHeapSize() const {
+	return NiAVObject::GetHeapSize() + HeapSize(affectedNodes);
 }
 
 
-void NiTextureEffect::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiTextureEffect::Sync(Stream& stream) {
 	stream.Sync(modelProjectionMatrix);
 	stream.Sync(modelProjectionTranslation);
 	stream.Sync(textureFiltering);
@@ -293,37 +318,38 @@ void NiTextureEffect::Sync(NiStreamReversible& stream) {
 	stream.Sync(clippingPlane);
 	stream.Sync(plane);
 }
+NIFLY_SYNC_INSTANTIATE(NiTextureEffect)
 
-void NiTextureEffect::GetChildRefs(std::set<NiRef*>& refs) {
-	NiDynamicEffect::GetChildRefs(refs);
-
-	refs.insert(&sourceTexture);
-}
-
-void NiTextureEffect::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiDynamicEffect::GetChildIndices(indices);
+void NiTextureEffect::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiDynamicEffect::ForEachChildRef(visitor);
 
-	indices.push_back(sourceTexture.index);
+	visitor(sourceTexture);
 }
 
 
-void NiLight::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiLight::Sync(Stream& stream) {
 	stream.Sync(dimmer);
 	stream.Sync(ambientColor);
 	stream.Sync(diffuseColor);
 	stream.Sync(specularColor);
 }
+NIFLY_SYNC_INSTANTIATE(NiLight)
 
 
-void NiPointLight::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPointLight::Sync(Stream& stream) {
 	stream.Sync(constantAttenuation);
 	stream.Sync(linearAttenuation);
 	stream.Sync(quadraticAttenuation);
 }
+NIFLY_SYNC_INSTANTIATE(NiPointLight)
 
 
-void NiSpotLight::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiSpotLight::Sync(Stream& stream) {
 	stream.Sync(outerSpotAngle);
 	stream.Sync(innerSpotAngle);
 	stream.Sync(exponent);
 }
+NIFLY_SYNC_INSTANTIATE(NiSpotLight)
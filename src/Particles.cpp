@@ -12,7 +12,8 @@ NiParticlesData::NiParticlesData() {
 	NiGeometryData::isPSys = true;
 }
 
-void NiParticlesData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiParticlesData::Sync(Stream& stream) {
 	stream.Sync(hasRadii);
 	stream.Sync(numActive);
 	stream.Sync(hasSizes);
@@ -42,95 +43,115 @@ void NiParticlesData::Sync(NiStreamReversible& stream) {
 		stream.Sync(speedToAspectSpeed2);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(NiParticlesData)
 
-
-void NiParticleMeshesData::Sync(NiStreamReversible& stream) {
-	dataRef.Sync(stream);
+size_t NiParticlesData::GetHeapSize() const {
+	return NiGeometryData::GetHeapSize() + HeapSize(subtexOffsets);
 }
 
-void NiParticleMeshesData::GetChildRefs(std::set<NiRef*>& refs) {
-	NiRotatingParticlesData::GetChildRefs(refs);
 
-	refs.insert(&dataRef);
+template<typename Stream>
+void NiParticleMeshesData::Sync(Stream& stream) {
+	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiParticleMeshesData)
 
-void NiParticleMeshesData::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiRotatingParticlesData::GetChildIndices(indices);
+void NiParticleMeshesData::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiRotatingParticlesData::ForEachChildRef(visitor);
 
-	indices.push_back(dataRef.index);
+	visitor(dataRef);
 }
 
 
-void NiPSysData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysData::Sync(Stream& stream) {
 	if (stream.GetVersion().Stream() == 155)
 		stream.Sync(unknownVector);
 
 	stream.Sync(hasRotationSpeeds);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysData)
 
 
-void NiMeshPSysData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiMeshPSysData::Sync(Stream& stream) {
 	stream.Sync(defaultPoolSize);
 	stream.Sync(fillPoolsOnLoad);
 
 	generationPoolSize.Sync(stream);
 	nodeRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiMeshPSysData)
 
-void NiMeshPSysData::GetChildRefs(std::set<NiRef*>& refs) {
-	NiPSysData::GetChildRefs(refs);
+void NiMeshPSysData::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiPSysData::ForEachChildRef(visitor);
 
-	refs.insert(&nodeRef);
+	visitor(nodeRef);
 }
 
-void NiMeshPSysData::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiPSysData::GetChildIndices(indices);
-
-	indices.push_back(nodeRef.index);
+size_t NiMeshPSysData::GetHeapSize() const {
+	return NiPSysData::GetHeapSize() + HeapSize(generationPoolSize);
 }
 
 
-void BSStripPSysData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSStripPSysData::Sync(Stream& stream) {
 	stream.Sync(maxPointCount);
 	stream.Sync(startCapSize);
 	stream.Sync(endCapSize);
 	stream.Sync(doZPrepass);
 }
+NIFLY_SYNC_INSTANTIATE(BSStripPSysData)
 
 
-void NiPSysEmitterCtlrData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysEmitterCtlrData::Sync(Stream& stream) {
 	floatKeys.Sync(stream);
 	visibilityKeys.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysEmitterCtlrData)
+
+size_t NiPSysEmitterCtlrData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(floatKeys) + HeapSize(visibilityKeys);
+}
 
 
-void NiPSysModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysModifier::Sync(Stream& stream) {
 	name.Sync(stream);
 
 	stream.Sync(order);
 	targetRef.Sync(stream);
 	stream.Sync(isActive);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysModifier)
 
-void NiPSysModifier::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiObject::GetStringRefs(refs);
+void NiPSysModifier::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiObject::ForEachStringRef(visitor);
 
-	refs.emplace_back(&name);
+	visitor(name);
 }
 
-void NiPSysModifier::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiObject::GetPtrs(ptrs);
+void NiPSysModifier::ForEachPtr(const NiRefVisitor& visitor) {
+	NiObject::ForEachPtr(visitor);
+
+	visitor(targetRef);
+}
 
-	ptrs.insert(&targetRef);
+size_t NiPSysModifier::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(name);
 }
 
 
-void BSPSysStripUpdateModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPSysStripUpdateModifier::Sync(Stream& stream) {
 	stream.Sync(updateDeltaTime);
 }
+NIFLY_SYNC_INSTANTIATE(BSPSysStripUpdateModifier)
 
 
-void NiPSysSpawnModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysSpawnModifier::Sync(Stream& stream) {
 	stream.Sync(numSpawnGenerations);
 	stream.Sync(percentSpawned);
 	stream.Sync(minSpawned);
@@ -140,35 +161,35 @@ void NiPSysSpawnModifier::Sync(NiStreamReversible& stream) {
 	stream.Sync(lifeSpan);
 	stream.Sync(lifeSpanVariation);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysSpawnModifier)
 
 
-void NiPSysAgeDeathModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysAgeDeathModifier::Sync(Stream& stream) {
 	stream.Sync(spawnOnDeath);
 	spawnModifierRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysAgeDeathModifier)
 
-void NiPSysAgeDeathModifier::GetChildRefs(std::set<NiRef*>& refs) {
-	NiPSysModifier::GetChildRefs(refs);
+void NiPSysAgeDeathModifier::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiPSysModifier::ForEachChildRef(visitor);
 
-	refs.insert(&spawnModifierRef);
+	visitor(spawnModifierRef);
 }
 
-void NiPSysAgeDeathModifier::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiPSysModifier::GetChildIndices(indices);
 
-	indices.push_back(spawnModifierRef.index);
-}
-
-
-void BSPSysLODModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPSysLODModifier::Sync(Stream& stream) {
 	stream.Sync(lodBeginDistance);
 	stream.Sync(lodEndDistance);
 	stream.Sync(endEmitScale);
 	stream.Sync(endSize);
 }
+NIFLY_SYNC_INSTANTIATE(BSPSysLODModifier)
 
 
-void BSPSysSimpleColorModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPSysSimpleColorModifier::Sync(Stream& stream) {
 	stream.Sync(fadeInPercent);
 	stream.Sync(fadeOutPercent);
 	stream.Sync(color1EndPercent);
@@ -184,9 +205,11 @@ void BSPSysSimpleColorModifier::Sync(NiStreamReversible& stream) {
 			stream.Sync(unknownShort);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(BSPSysSimpleColorModifier)
 
 
-void NiPSysRotationModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysRotationModifier::Sync(Stream& stream) {
 	stream.Sync(initialSpeed);
 	stream.Sync(initialSpeedVariation);
 
@@ -201,14 +224,22 @@ void NiPSysRotationModifier::Sync(NiStreamReversible& stream) {
 	stream.Sync(randomInitialAxis);
 	stream.Sync(initialAxis);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysRotationModifier)
 
 
-void BSPSysScaleModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPSysScaleModifier::Sync(Stream& stream) {
 	floats.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSPSysScaleModifier)
+
+size_t BSPSysScaleModifier::GetHeapSize() const {
+	return NiPSysModifier::GetHeapSize() + HeapSize(floats);
+}
 
 
-void NiPSysGravityModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysGravityModifier::Sync(Stream& stream) {
 	gravityObjRef.Sync(stream);
 	stream.Sync(gravityAxis);
 	stream.Sync(decay);
@@ -218,49 +249,57 @@ void NiPSysGravityModifier::Sync(NiStreamReversible& stream) {
 	stream.Sync(turbulenceScale);
 	stream.Sync(worldAligned);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysGravityModifier)
 
-void NiPSysGravityModifier::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiPSysModifier::GetPtrs(ptrs);
+void NiPSysGravityModifier::ForEachPtr(const NiRefVisitor& visitor) {
+	NiPSysModifier::ForEachPtr(visitor);
 
-	ptrs.insert(&gravityObjRef);
+	visitor(gravityObjRef);
 }
 
 
-void NiPSysBoundUpdateModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysBoundUpdateModifier::Sync(Stream& stream) {
 	stream.Sync(updateSkip);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysBoundUpdateModifier)
 
 
-void NiPSysDragModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysDragModifier::Sync(Stream& stream) {
 	parentRef.Sync(stream);
 	stream.Sync(dragAxis);
 	stream.Sync(percentage);
 	stream.Sync(range);
 	stream.Sync(rangeFalloff);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysDragModifier)
 
-void NiPSysDragModifier::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiPSysModifier::GetPtrs(ptrs);
+void NiPSysDragModifier::ForEachPtr(const NiRefVisitor& visitor) {
+	NiPSysModifier::ForEachPtr(visitor);
 
-	ptrs.insert(&parentRef);
+	visitor(parentRef);
 }
 
 
-void BSPSysInheritVelocityModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPSysInheritVelocityModifier::Sync(Stream& stream) {
 	targetNodeRef.Sync(stream);
 	stream.Sync(changeToInherit);
 	stream.Sync(velocityMult);
 	stream.Sync(velocityVar);
 }
+NIFLY_SYNC_INSTANTIATE(BSPSysInheritVelocityModifier)
 
-void BSPSysInheritVelocityModifier::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiPSysModifier::GetPtrs(ptrs);
+void BSPSysInheritVelocityModifier::ForEachPtr(const NiRefVisitor& visitor) {
+	NiPSysModifier::ForEachPtr(visitor);
 
-	ptrs.insert(&targetNodeRef);
+	visitor(targetNodeRef);
 }
 
 
-void BSPSysSubTexModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPSysSubTexModifier::Sync(Stream& stream) {
 	stream.Sync(startFrame);
 	stream.Sync(startFrameVariation);
 	stream.Sync(endFrame);
@@ -269,9 +308,11 @@ void BSPSysSubTexModifier::Sync(NiStreamReversible& stream) {
 	stream.Sync(frameCount);
 	stream.Sync(frameCountVariation);
 }
+NIFLY_SYNC_INSTANTIATE(BSPSysSubTexModifier)
 
 
-void NiPSysBombModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysBombModifier::Sync(Stream& stream) {
 	bombNodeRef.Sync(stream);
 	stream.Sync(bombAxis);
 	stream.Sync(decay);
@@ -279,37 +320,41 @@ void NiPSysBombModifier::Sync(NiStreamReversible& stream) {
 	stream.Sync(decayType);
 	stream.Sync(symmetryType);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysBombModifier)
 
-void NiPSysBombModifier::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiPSysModifier::GetPtrs(ptrs);
+void NiPSysBombModifier::ForEachPtr(const NiRefVisitor& visitor) {
+	NiPSysModifier::ForEachPtr(visitor);
 
-	ptrs.insert(&bombNodeRef);
+	visitor(bombNodeRef);
 }
 
 
-void NiColorData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiColorData::Sync(Stream& stream) {
 	data.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiColorData)
 
-
-void NiPSysColorModifier::Sync(NiStreamReversible& stream) {
-	dataRef.Sync(stream);
+size_t NiColorData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(data);
 }
 
-void NiPSysColorModifier::GetChildRefs(std::set<NiRef*>& refs) {
-	NiPSysModifier::GetChildRefs(refs);
 
-	refs.insert(&dataRef);
+template<typename Stream>
+void NiPSysColorModifier::Sync(Stream& stream) {
+	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysColorModifier)
 
-void NiPSysColorModifier::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiPSysModifier::GetChildIndices(indices);
+void NiPSysColorModifier::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiPSysModifier::ForEachChildRef(visitor);
 
-	indices.push_back(dataRef.index);
+	visitor(dataRef);
 }
 
 
-void NiPSysGrowFadeModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysGrowFadeModifier::Sync(Stream& stream) {
 	stream.Sync(growTime);
 	stream.Sync(growGeneration);
 	stream.Sync(fadeTime);
@@ -318,68 +363,74 @@ void NiPSysGrowFadeModifier::Sync(NiStreamReversible& stream) {
 	if (stream.GetVersion().Stream() >= 34)
 		stream.Sync(baseScale);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysGrowFadeModifier)
 
 
-void NiPSysMeshUpdateModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysMeshUpdateModifier::Sync(Stream& stream) {
 	meshRefs.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysMeshUpdateModifier)
 
-void NiPSysMeshUpdateModifier::GetChildRefs(std::set<NiRef*>& refs) {
-	NiPSysModifier::GetChildRefs(refs);
+void NiPSysMeshUpdateModifier::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiPSysModifier::ForEachChildRef(visitor);
 
-	meshRefs.GetIndexPtrs(refs);
+	meshRefs.ForEachRef(visitor);
 }
 
-void NiPSysMeshUpdateModifier::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiPSysModifier::GetChildIndices(indices);
-
-	meshRefs.GetIndices(indices);
+size_t NiPSysMeshUpdateModifier::GetHeapSize() const {
+	return NiPSysModifier::GetHeapSize() + HeapSize(meshRefs);
 }
 
 
-void NiPSysFieldModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysFieldModifier::Sync(Stream& stream) {
 	fieldObjectRef.Sync(stream);
 	stream.Sync(magnitude);
 	stream.Sync(attenuation);
 	stream.Sync(useMaxDistance);
 	stream.Sync(maxDistance);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysFieldModifier)
 
-void NiPSysFieldModifier::GetChildRefs(std::set<NiRef*>& refs) {
-	NiPSysModifier::GetChildRefs(refs);
-
-	refs.insert(&fieldObjectRef);
-}
-
-void NiPSysFieldModifier::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiPSysModifier::GetChildIndices(indices);
+void NiPSysFieldModifier::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiPSysModifier::ForEachChildRef(visitor);
 
-	indices.push_back(fieldObjectRef.index);
+	visitor(fieldObjectRef);
 }
 
 
-void NiPSysVortexFieldModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysVortexFieldModifier::Sync(Stream& stream) {
 	stream.Sync(direction);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysVortexFieldModifier)
 
 
-void NiPSysGravityFieldModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysGravityFieldModifier::Sync(Stream& stream) {
 	stream.Sync(direction);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysGravityFieldModifier)
 
 
-void NiPSysDragFieldModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysDragFieldModifier::Sync(Stream& stream) {
 	stream.Sync(useDirection);
 	stream.Sync(direction);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysDragFieldModifier)
 
 
-void NiPSysTurbulenceFieldModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysTurbulenceFieldModifier::Sync(Stream& stream) {
 	stream.Sync(frequency);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysTurbulenceFieldModifier)
 
 
-void NiPSysAirFieldModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysAirFieldModifier::Sync(Stream& stream) {
 	stream.Sync(direction);
 	stream.Sync(airFriction);
 	stream.Sync(inheritVelocity);
@@ -388,75 +439,84 @@ void NiPSysAirFieldModifier::Sync(NiStreamReversible& stream) {
 	stream.Sync(enableSpread);
 	stream.Sync(spread);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysAirFieldModifier)
 
 
-void NiPSysRadialFieldModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysRadialFieldModifier::Sync(Stream& stream) {
 	stream.Sync(radialType);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysRadialFieldModifier)
 
 
-void BSWindModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSWindModifier::Sync(Stream& stream) {
 	stream.Sync(strength);
 }
+NIFLY_SYNC_INSTANTIATE(BSWindModifier)
 
 
-void BSPSysRecycleBoundModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPSysRecycleBoundModifier::Sync(Stream& stream) {
 	stream.Sync(boundOffset);
 	stream.Sync(boundExtent);
 	targetNodeRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSPSysRecycleBoundModifier)
 
-void BSPSysRecycleBoundModifier::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiPSysModifier::GetPtrs(ptrs);
+void BSPSysRecycleBoundModifier::ForEachPtr(const NiRefVisitor& visitor) {
+	NiPSysModifier::ForEachPtr(visitor);
 
-	ptrs.insert(&targetNodeRef);
+	visitor(targetNodeRef);
 }
 
 
-void BSPSysHavokUpdateModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSPSysHavokUpdateModifier::Sync(Stream& stream) {
 	nodeRefs.Sync(stream);
 	modifierRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSPSysHavokUpdateModifier)
 
-void BSPSysHavokUpdateModifier::GetChildRefs(std::set<NiRef*>& refs) {
-	NiPSysModifier::GetChildRefs(refs);
+void BSPSysHavokUpdateModifier::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiPSysModifier::ForEachChildRef(visitor);
 
-	nodeRefs.GetIndexPtrs(refs);
-	refs.insert(&modifierRef);
+	nodeRefs.ForEachRef(visitor);
+	visitor(modifierRef);
 }
 
-void BSPSysHavokUpdateModifier::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiPSysModifier::GetChildIndices(indices);
-
-	nodeRefs.GetIndices(indices);
-	indices.push_back(modifierRef.index);
+size_t BSPSysHavokUpdateModifier::GetHeapSize() const {
+	return NiPSysModifier::GetHeapSize() + HeapSize(nodeRefs);
 }
 
 
-void BSParentVelocityModifier::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSParentVelocityModifier::Sync(Stream& stream) {
 	stream.Sync(damping);
 }
+NIFLY_SYNC_INSTANTIATE(BSParentVelocityModifier)
 
 
-void BSMasterParticleSystem::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSMasterParticleSystem::Sync(Stream& stream) {
 	stream.Sync(maxEmitterObjs);
 	particleSysRefs.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSMasterParticleSystem)
 
-void BSMasterParticleSystem::GetChildRefs(std::set<NiRef*>& refs) {
-	NiNode::GetChildRefs(refs);
+void BSMasterParticleSystem::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiNode::ForEachChildRef(visitor);
 
-	particleSysRefs.GetIndexPtrs(refs);
+	particleSysRefs.ForEachRef(visitor);
 }
 
-void BSMasterParticleSystem::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiNode::GetChildIndices(indices);
-
-	particleSysRefs.GetIndices(indices);
+size_t BSMasterParticleSystem::GetHeapSize() const {
+	return NiNode::GetHeapSize() + HeapSize(particleSysRefs);
 }
 
 
-void NiParticleSystem::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiParticleSystem::Sync(Stream& stream) {
 	if (stream.GetVersion().Stream() >= 100) {
 		stream.Sync(bounds);
 
@@ -508,38 +568,37 @@ void NiParticleSystem::Sync(NiStreamReversible& stream) {
 	stream.Sync(isWorldSpace);
 	modifierRefs.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiParticleSystem)
 
-void NiParticleSystem::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiAVObject::GetStringRefs(refs);
+void NiParticleSystem::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiAVObject::ForEachStringRef(visitor);
 
 	for (auto& mn : materialNames)
-		refs.emplace_back(&mn);
+		visitor(mn);
 }
 
-void NiParticleSystem::GetChildRefs(std::set<NiRef*>& refs) {
-	NiAVObject::GetChildRefs(refs);
+void NiParticleSystem::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiAVObject::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
-	refs.insert(&skinInstanceRef);
-	refs.insert(&shaderPropertyRef);
-	refs.insert(&alphaPropertyRef);
-	refs.insert(&psysDataRef);
-	modifierRefs.GetIndexPtrs(refs);
+	visitor(dataRef);
+	visitor(skinInstanceRef);
+	visitor(shaderPropertyRef);
+	visitor(alphaPropertyRef);
+	visitor(psysDataRef);
+	modifierRefs.ForEachRef(visitor);
 }
 
-void NiParticleSystem::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiAVObject::GetChildIndices(indices);
-
-	indices.push_back(dataRef.index);
-	indices.push_back(skinInstanceRef.index);
-	indices.push_back(shaderPropertyRef.index);
-	indices.push_back(alphaPropertyRef.index);
-	indices.push_back(psysDataRef.index);
-	modifierRefs.GetIndices(indices);
+size_t NiParticleSystem::GetHeapSize() const {
+	size_t size = NiAVObject::GetHeapSize();
+	size += HeapSize(materialNames);
+	size += HeapSize(materialExtraData);
+	size += HeapSize(modifierRefs);
+	return size;
 }
 
 
-void NiPSysCollider::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysCollider::Sync(Stream& stream) {
 	stream.Sync(bounce);
 	stream.Sync(spawnOnCollide);
 	stream.Sync(dieOnCollide);
@@ -548,60 +607,55 @@ void NiPSysCollider::Sync(NiStreamReversible& stream) {
 	nextColliderRef.Sync(stream);
 	colliderNodeRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysCollider)
 
-void NiPSysCollider::GetChildRefs(std::set<NiRef*>& refs) {
-	NiObject::GetChildRefs(refs);
+void NiPSysCollider::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiObject::ForEachChildRef(visitor);
 
-	refs.insert(&spawnModifierRef);
-	refs.insert(&nextColliderRef);
+	visitor(spawnModifierRef);
+	visitor(nextColliderRef);
 }
 
-void NiPSysCollider::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiObject::GetChildIndices(indices);
+void NiPSysCollider::ForEachPtr(const NiRefVisitor& visitor) {
+	NiObject::ForEachPtr(visitor);
 
-	indices.push_back(spawnModifierRef.index);
-	indices.push_back(nextColliderRef.index);
+	visitor(managerRef);
+	visitor(colliderNodeRef);
 }
 
-void NiPSysCollider::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiObject::GetPtrs(ptrs);
 
-	ptrs.insert(&managerRef);
-	ptrs.insert(&colliderNodeRef);
-}
-
-
-void NiPSysSphericalCollider::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysSphericalCollider::Sync(Stream& stream) {
 	stream.Sync(radius);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysSphericalCollider)
 
 
-void NiPSysPlanarCollider::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysPlanarCollider::Sync(Stream& stream) {
 	stream.Sync(width);
 	stream.Sync(height);
 	stream.Sync(xAxis);
 	stream.Sync(yAxis);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysPlanarCollider)
 
 
-void NiPSysColliderManager::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysColliderManager::Sync(Stream& stream) {
 	colliderRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysColliderManager)
 
-void NiPSysColliderManager::GetChildRefs(std::set<NiRef*>& refs) {
-	NiPSysModifier::GetChildRefs(refs);
+void NiPSysColliderManager::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiPSysModifier::ForEachChildRef(visitor);
 
-	refs.insert(&colliderRef);
+	visitor(colliderRef);
 }
 
-void NiPSysColliderManager::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiPSysModifier::GetChildIndices(indices);
-
-	indices.push_back(colliderRef.index);
-}
 
-
-void NiPSysEmitter::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysEmitter::Sync(Stream& stream) {
 	stream.Sync(speed);
 	stream.Sync(speedVariation);
 	stream.Sync(declination);
@@ -614,47 +668,62 @@ void NiPSysEmitter::Sync(NiStreamReversible& stream) {
 	stream.Sync(lifeSpan);
 	stream.Sync(lifeSpanVariation);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysEmitter)
 
 
-void NiPSysVolumeEmitter::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysVolumeEmitter::Sync(Stream& stream) {
 	emitterNodeRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysVolumeEmitter)
 
-void NiPSysVolumeEmitter::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiPSysEmitter::GetPtrs(ptrs);
+void NiPSysVolumeEmitter::ForEachPtr(const NiRefVisitor& visitor) {
+	NiPSysEmitter::ForEachPtr(visitor);
 
-	ptrs.insert(&emitterNodeRef);
+	visitor(emitterNodeRef);
 }
 
 
-void NiPSysSphereEmitter::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysSphereEmitter::Sync(Stream& stream) {
 	stream.Sync(radius);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysSphereEmitter)
 
 
-void NiPSysCylinderEmitter::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysCylinderEmitter::Sync(Stream& stream) {
 	stream.Sync(radius);
 	stream.Sync(height);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysCylinderEmitter)
 
 
-void NiPSysBoxEmitter::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysBoxEmitter::Sync(Stream& stream) {
 	stream.Sync(width);
 	stream.Sync(height);
 	stream.Sync(depth);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysBoxEmitter)
 
 
-void NiPSysMeshEmitter::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiPSysMeshEmitter::Sync(Stream& stream) {
 	meshRefs.Sync(stream);
 
 	stream.Sync(velocityType);
 	stream.Sync(emissionType);
 	stream.Sync(emissionAxis);
 }
+NIFLY_SYNC_INSTANTIATE(NiPSysMeshEmitter)
+
+void NiPSysMeshEmitter::ForEachPtr(const NiRefVisitor& visitor) {
+	NiPSysEmitter::ForEachPtr(visitor);
 
-void NiPSysMeshEmitter::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiPSysEmitter::GetPtrs(ptrs);
+	meshRefs.ForEachRef(visitor);
+}
 
-	meshRefs.GetIndexPtrs(ptrs);
+size_t NiPSysMeshEmitter::GetHeapSize() const {
+	return NiPSysEmitter::GetHeapSize() + HeapSize(meshRefs);
 }
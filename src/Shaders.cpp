@@ -8,17 +8,22 @@ See the included GPLv3 LICENSE file
 
 using namespace nifly;
 
-void NiShadeProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiShadeProperty::Sync(Stream& stream) {
 	stream.Sync(flags);
 }
+NIFLY_SYNC_INSTANTIATE(NiShadeProperty)
 
 
-void NiSpecularProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiSpecularProperty::Sync(Stream& stream) {
 	stream.Sync(flags);
 }
+NIFLY_SYNC_INSTANTIATE(NiSpecularProperty)
 
 
-void NiTexturingProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiTexturingProperty::Sync(Stream& stream) {
 	const NiFileVersion fileVersion = stream.GetVersion().File();
 
 	if (fileVersion <= NiFileVersion::V10_0_1_2)
@@ -130,45 +135,33 @@ void NiTexturingProperty::Sync(NiStreamReversible& stream) {
 	if (fileVersion >= NiFileVersion::V10_0_1_0)
 		shaderTex.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiTexturingProperty)
 
-void NiTexturingProperty::GetChildRefs(std::set<NiRef*>& refs) {
-	NiProperty::GetChildRefs(refs);
-
-	baseTex.GetChildRefs(refs);
-	darkTex.GetChildRefs(refs);
-	detailTex.GetChildRefs(refs);
-	glossTex.GetChildRefs(refs);
-	glowTex.GetChildRefs(refs);
-	bumpTex.GetChildRefs(refs);
-	normalTex.GetChildRefs(refs);
-	parallaxTex.GetChildRefs(refs);
-	decalTex0.GetChildRefs(refs);
-	decalTex1.GetChildRefs(refs);
-	decalTex2.GetChildRefs(refs);
-	decalTex3.GetChildRefs(refs);
-	shaderTex.GetChildRefs(refs);
-}
-
-void NiTexturingProperty::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiProperty::GetChildIndices(indices);
-
-	baseTex.GetChildIndices(indices);
-	darkTex.GetChildIndices(indices);
-	detailTex.GetChildIndices(indices);
-	glossTex.GetChildIndices(indices);
-	glowTex.GetChildIndices(indices);
-	bumpTex.GetChildIndices(indices);
-	normalTex.GetChildIndices(indices);
-	parallaxTex.GetChildIndices(indices);
-	decalTex0.GetChildIndices(indices);
-	decalTex1.GetChildIndices(indices);
-	decalTex2.GetChildIndices(indices);
-	decalTex3.GetChildIndices(indices);
-	shaderTex.GetChildIndices(indices);
-}
-
-
-void NiVertexColorProperty::Sync(NiStreamReversible& stream) {
+void NiTexturingProperty::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiProperty::ForEachChildRef(visitor);
+
+	baseTex.ForEachChildRef(visitor);
+	darkTex.ForEachChildRef(visitor);
+	detailTex.ForEachChildRef(visitor);
+	glossTex.ForEachChildRef(visitor);
+	glowTex.ForEachChildRef(visitor);
+	bumpTex.ForEachChildRef(visitor);
+	normalTex.ForEachChildRef(visitor);
+	parallaxTex.ForEachChildRef(visitor);
+	decalTex0.ForEachChildRef(visitor);
+	decalTex1.ForEachChildRef(visitor);
+	decalTex2.ForEachChildRef(visitor);
+	decalTex3.ForEachChildRef(visitor);
+	shaderTex.ForEachChildRef(visitor);
+}
+
+size_t NiTexturingProperty::GetHeapSize() const {
+	return NiProperty::GetHeapSize() + HeapSize(shaderTex);
+}
+
+
+template<typename Stream>
+void NiVertexColorProperty::Sync(Stream& stream) {
 	stream.Sync(flags);
 
 	if (stream.GetVersion().File() <= NiFileVersion::V20_0_0_5) {
@@ -176,31 +169,41 @@ void NiVertexColorProperty::Sync(NiStreamReversible& stream) {
 		stream.Sync(lightingMode);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(NiVertexColorProperty)
 
 
-void NiDitherProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiDitherProperty::Sync(Stream& stream) {
 	stream.Sync(flags);
 }
+NIFLY_SYNC_INSTANTIATE(NiDitherProperty)
 
 
-void NiFogProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiFogProperty::Sync(Stream& stream) {
 	stream.Sync(flags);
 	stream.Sync(fogDepth);
 	stream.Sync(fogColor);
 }
+NIFLY_SYNC_INSTANTIATE(NiFogProperty)
 
 
-void NiWireframeProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiWireframeProperty::Sync(Stream& stream) {
 	stream.Sync(flags);
 }
+NIFLY_SYNC_INSTANTIATE(NiWireframeProperty)
 
 
-void NiZBufferProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiZBufferProperty::Sync(Stream& stream) {
 	stream.Sync(flags);
 }
+NIFLY_SYNC_INSTANTIATE(NiZBufferProperty)
 
 
-void BSShaderProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSShaderProperty::Sync(Stream& stream) {
 	if (stream.GetVersion().User() == 12 && stream.GetVersion().Stream() == 155 && name.GetIndex() != NIF_NPOS)
 		return;
 
@@ -235,6 +238,11 @@ void BSShaderProperty::Sync(NiStreamReversible& stream) {
 		}
 	}
 }
+NIFLY_SYNC_INSTANTIATE(BSShaderProperty)
+
+size_t BSShaderProperty::GetHeapSize() const {
+	return NiShader::GetHeapSize() + HeapSize(SF1) + HeapSize(SF2);
+}
 
 uint32_t BSShaderProperty::GetShaderType() const {
 	return shaderType;
@@ -346,20 +354,38 @@ Vector2 BSShaderProperty::GetUVScale() const {
 }
 
 
-void TallGrassShaderProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void TallGrassShaderProperty::Sync(Stream& stream) {
 	fileName.Sync(stream, 4);
 }
+NIFLY_SYNC_INSTANTIATE(TallGrassShaderProperty)
+
+size_t TallGrassShaderProperty::GetHeapSize() const {
+	return BSShaderProperty::GetHeapSize() + HeapSize(fileName);
+}
 
 
-void SkyShaderProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void SkyShaderProperty::Sync(Stream& stream) {
 	fileName.Sync(stream, 4);
 	stream.Sync(skyObjectType);
 }
+NIFLY_SYNC_INSTANTIATE(SkyShaderProperty)
+
+size_t SkyShaderProperty::GetHeapSize() const {
+	return BSShaderLightingProperty::GetHeapSize() + HeapSize(fileName);
+}
 
 
-void TileShaderProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void TileShaderProperty::Sync(Stream& stream) {
 	fileName.Sync(stream, 4);
 }
+NIFLY_SYNC_INSTANTIATE(TileShaderProperty)
+
+size_t TileShaderProperty::GetHeapSize() const {
+	return BSShaderLightingProperty::GetHeapSize() + HeapSize(fileName);
+}
 
 
 BSShaderTextureSet::BSShaderTextureSet(NiVersion& version) {
@@ -373,9 +399,15 @@ BSShaderTextureSet::BSShaderTextureSet(NiVersion& version) {
 		textures.resize(6);
 }
 
-void BSShaderTextureSet::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSShaderTextureSet::Sync(Stream& stream) {
 	textures.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSShaderTextureSet)
+
+size_t BSShaderTextureSet::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(textures);
+}
 
 BSLightingShaderProperty::BSLightingShaderProperty() {
 	NiObjectNET::bBSLightingShaderProperty = true;
@@ -401,7 +433,8 @@ BSLightingShaderProperty::BSLightingShaderProperty(NiVersion& version)
 		glossiness = 20.0f;
 }
 
-void BSLightingShaderProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSLightingShaderProperty::Sync(Stream& stream) {
 	if (stream.GetVersion().User() == 12 && stream.GetVersion().Stream() == 155 && name.GetIndex() != NIF_NPOS)
 		return;
 
@@ -520,23 +553,22 @@ void BSLightingShaderProperty::Sync(NiStreamReversible& stream) {
 			break;
 	}
 }
+NIFLY_SYNC_INSTANTIATE(BSLightingShaderProperty)
 
-void BSLightingShaderProperty::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	BSShaderProperty::GetStringRefs(refs);
+void BSLightingShaderProperty::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	BSShaderProperty::ForEachStringRef(visitor);
 
-	refs.emplace_back(&rootMaterialName);
+	visitor(rootMaterialName);
 }
 
-void BSLightingShaderProperty::GetChildRefs(std::set<NiRef*>& refs) {
-	BSShaderProperty::GetChildRefs(refs);
+void BSLightingShaderProperty::ForEachChildRef(const NiRefVisitor& visitor) {
+	BSShaderProperty::ForEachChildRef(visitor);
 
-	refs.insert(&textureSetRef);
+	visitor(textureSetRef);
 }
 
-void BSLightingShaderProperty::GetChildIndices(std::vector<uint32_t>& indices) {
-	BSShaderProperty::GetChildIndices(indices);
-
-	indices.push_back(textureSetRef.index);
+size_t BSLightingShaderProperty::GetHeapSize() const {
+	return BSShaderProperty::GetHeapSize() + HeapSize(rootMaterialName) + HeapSize(textureArrays);
 }
 
 bool BSLightingShaderProperty::IsSkinTinted() const {
@@ -650,7 +682,8 @@ void BSLightingShaderProperty::SetWetMaterialName(const std::string& matName) {
 }
 
 
-void BSEffectShaderProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSEffectShaderProperty::Sync(Stream& stream) {
 	if (stream.GetVersion().User() == 12 && stream.GetVersion().Stream() == 155 && name.GetIndex() != NIF_NPOS)
 		return;
 
@@ -689,6 +722,20 @@ void BSEffectShaderProperty::Sync(NiStreamReversible& stream) {
 		stream.Sync(finalExposureMax);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(BSEffectShaderProperty)
+
+size_t BSEffectShaderProperty::GetHeapSize() const {
+	size_t size = BSShaderProperty::GetHeapSize();
+	size += HeapSize(sourceTexture);
+	size += HeapSize(greyscaleTexture);
+	size += HeapSize(envMapTexture);
+	size += HeapSize(normalTexture);
+	size += HeapSize(envMaskTexture);
+	size += HeapSize(reflectanceTexture);
+	size += HeapSize(lightingTexture);
+	size += HeapSize(emitGradientTexture);
+	return size;
+}
 
 float BSEffectShaderProperty::GetEnvironmentMapScale() const {
 	return envMapScale;
@@ -711,30 +758,41 @@ void BSEffectShaderProperty::SetEmissiveMultiple(const float emissive) {
 }
 
 
-void BSWaterShaderProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSWaterShaderProperty::Sync(Stream& stream) {
 	if (stream.GetVersion().User() == 12 && stream.GetVersion().Stream() == 155 && name.GetIndex() != NIF_NPOS)
 		return;
 
 	stream.Sync(waterFlags);
 }
+NIFLY_SYNC_INSTANTIATE(BSWaterShaderProperty)
 
 
-void BSSkyShaderProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSSkyShaderProperty::Sync(Stream& stream) {
 	if (stream.GetVersion().User() == 12 && stream.GetVersion().Stream() == 155 && name.GetIndex() != NIF_NPOS)
 		return;
 
 	baseTexture.Sync(stream, 4);
 	stream.Sync(skyFlags);
 }
+NIFLY_SYNC_INSTANTIATE(BSSkyShaderProperty)
 
+size_t BSSkyShaderProperty::GetHeapSize() const {
+	return BSShaderProperty::GetHeapSize() + HeapSize(baseTexture);
+}
 
-void BSShaderLightingProperty::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void BSShaderLightingProperty::Sync(Stream& stream) {
 	if (stream.GetVersion().User() <= 11)
 		stream.Sync(textureClampMode);
 }
+NIFLY_SYNC_INSTANTIATE(BSShaderLightingProperty)
 
 
-void BSShaderPPLightingProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSShaderPPLightingProperty::Sync(Stream& stream) {
 	textureSetRef.Sync(stream);
 
 	if (stream.GetVersion().User() == 11 && stream.GetVersion().Stream() > 14) {
@@ -750,17 +808,12 @@ void BSShaderPPLightingProperty::Sync(NiStreamReversible& stream) {
 	if (stream.GetVersion().User() >= 12)
 		stream.Sync(emissiveColor);
 }
+NIFLY_SYNC_INSTANTIATE(BSShaderPPLightingProperty)
 
-void BSShaderPPLightingProperty::GetChildRefs(std::set<NiRef*>& refs) {
-	BSShaderLightingProperty::GetChildRefs(refs);
-
-	refs.insert(&textureSetRef);
-}
-
-void BSShaderPPLightingProperty::GetChildIndices(std::vector<uint32_t>& indices) {
-	BSShaderLightingProperty::GetChildIndices(indices);
+void BSShaderPPLightingProperty::ForEachChildRef(const NiRefVisitor& visitor) {
+	BSShaderLightingProperty::ForEachChildRef(visitor);
 
-	indices.push_back(textureSetRef.index);
+	visitor(textureSetRef);
 }
 
 bool BSShaderPPLightingProperty::IsSkinned() const {
@@ -775,7 +828,8 @@ void BSShaderPPLightingProperty::SetSkinned(const bool enable) {
 }
 
 
-void BSShaderNoLightingProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSShaderNoLightingProperty::Sync(Stream& stream) {
 	baseTexture.Sync(stream, 4);
 
 	if (stream.GetVersion().Stream() > 26) {
@@ -785,6 +839,11 @@ void BSShaderNoLightingProperty::Sync(NiStreamReversible& stream) {
 		stream.Sync(falloffStopOpacity);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(BSShaderNoLightingProperty)
+
+size_t BSShaderNoLightingProperty::GetHeapSize() const {
+	return BSShaderLightingProperty::GetHeapSize() + HeapSize(baseTexture);
+}
 
 bool BSShaderNoLightingProperty::IsSkinned() const {
 	return (shaderFlags1 & (1 << 1)) != 0;
@@ -798,13 +857,16 @@ void BSShaderNoLightingProperty::SetSkinned(const bool enable) {
 }
 
 
-void NiAlphaProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiAlphaProperty::Sync(Stream& stream) {
 	stream.Sync(flags);
 	stream.Sync(threshold);
 }
+NIFLY_SYNC_INSTANTIATE(NiAlphaProperty)
 
 
-void NiMaterialProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiMaterialProperty::Sync(Stream& stream) {
 	const NiFileVersion fileVersion = stream.GetVersion().File();
 
 	if (fileVersion >= NiFileVersion::V3_0 && fileVersion <= NiFileVersion::V10_0_1_2)
@@ -823,6 +885,7 @@ void NiMaterialProperty::Sync(NiStreamReversible& stream) {
 	if (stream.GetVersion().Stream() > 21)
 		stream.Sync(emitMulti);
 }
+NIFLY_SYNC_INSTANTIATE(NiMaterialProperty)
 
 bool NiMaterialProperty::IsEmissive() const {
 	return !colorEmissive.IsZero();
@@ -879,7 +942,8 @@ void NiMaterialProperty::SetAlpha(const float alphaValue) {
 }
 
 
-void NiStencilProperty::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiStencilProperty::Sync(Stream& stream) {
 	const NiFileVersion fileVersion = stream.GetVersion().File();
 
 	if (fileVersion >= NiFileVersion::V3_0 && fileVersion <= NiFileVersion::V10_0_1_2)
@@ -901,3 +965,4 @@ void NiStencilProperty::Sync(NiStreamReversible& stream) {
 		stream.Sync(stencilMask);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(NiStencilProperty)
@@ -11,7 +11,8 @@ See the included GPLv3 LICENSE file
 
 using namespace nifly;
 
-void NiSkinData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiSkinData::Sync(Stream& stream) {
 	stream.Sync(skinTransform.rotation);
 	stream.Sync(skinTransform.translation);
 	stream.Sync(skinTransform.scale);
@@ -45,6 +46,11 @@ void NiSkinData::Sync(NiStreamReversible& stream) {
 					static_cast<std::streamsize>(numVerts) * sizeof(SkinWeight));
 	}
 }
+NIFLY_SYNC_INSTANTIATE(NiSkinData)
+
+size_t NiSkinData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(bones);
+}
 
 void NiSkinData::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) {
 	uint16_t highestRemoved = vertIndices.back();
@@ -70,8 +76,16 @@ void NiSkinData::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices)
 	}
 }
 
+void NiSkinData::notifyVerticesReorder(const std::vector<uint16_t>& vertMap) {
+	for (auto& b : bones)
+		for (auto& vw : b.vertexWeights)
+			if (vw.index < vertMap.size())
+				vw.index = vertMap[vw.index];
+}
+
 
-void NiSkinPartition::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiSkinPartition::Sync(Stream& stream) {
 	stream.Sync(numPartitions);
 	partitions.resize(numPartitions);
 
@@ -209,6 +223,15 @@ void NiSkinPartition::Sync(NiStreamReversible& stream) {
 		}
 	}
 }
+NIFLY_SYNC_INSTANTIATE(NiSkinPartition)
+
+size_t NiSkinPartition::GetHeapSize() const {
+	size_t size = NiObject::GetHeapSize();
+	size += HeapSize(vertData); // Duplicate of the shape's vertex data (SSE)
+	size += HeapSize(partitions);
+	size += HeapSize(triParts);
+	return size;
+}
 
 void NiSkinPartition::notifyVerticesDelete(const std::vector<uint16_t>& vertIndices) {
 	if (vertIndices.empty())
@@ -279,6 +302,32 @@ void NiSkinPartition::notifyVerticesDelete(const std::vector<uint16_t>& vertIndi
 	}
 }
 
+void NiSkinPartition::notifyVerticesReorder(const std::vector<uint16_t>& vertMap) {
+	const size_t mapSize = vertMap.size();
+	auto remap = [&](uint16_t& i) {
+		if (i < mapSize)
+			i = vertMap[i];
+	};
+
+	for (auto& p : partitions) {
+		// Mapped triangles and strips index into vertexMap, which keeps its order
+		for (uint16_t& i : p.vertexMap)
+			remap(i);
+
+		ApplyMapToTriangles(p.trueTriangles, vertMap);
+
+		if (!bMappedIndices) {
+			ApplyMapToTriangles(p.triangles, vertMap);
+			for (auto& strip : p.strips)
+				for (uint16_t& i : strip)
+					remap(i);
+		}
+	}
+
+	if (!vertData.empty())
+		ApplyIndexPermutation(vertData, vertMap);
+}
+
 void NiSkinPartition::DeletePartitions(const std::vector<uint32_t>& partInds) {
 	if (partInds.empty())
 		return;
@@ -489,37 +538,38 @@ void NiSkinPartition::PrepareTriParts(const std::vector<Triangle>& shapeTris) {
 }
 
 
-void NiSkinInstance::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiSkinInstance::Sync(Stream& stream) {
 	dataRef.Sync(stream);
 	skinPartitionRef.Sync(stream);
 	targetRef.Sync(stream);
 	boneRefs.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiSkinInstance)
 
-void NiSkinInstance::GetChildRefs(std::set<NiRef*>& refs) {
-	NiObject::GetChildRefs(refs);
+void NiSkinInstance::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiObject::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
-	refs.insert(&skinPartitionRef);
+	visitor(dataRef);
+	visitor(skinPartitionRef);
 }
 
-void NiSkinInstance::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiObject::GetChildIndices(indices);
+void NiSkinInstance::ForEachPtr(const NiRefVisitor& visitor) {
+	NiObject::ForEachPtr(visitor);
 
-	indices.push_back(dataRef.index);
-	indices.push_back(skinPartitionRef.index);
+	visitor(targetRef);
+	boneRefs.ForEachRef(visitor);
 }
 
-void NiSkinInstance::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiObject::GetPtrs(ptrs);
 
-	ptrs.insert(&targetRef);
-	boneRefs.GetIndexPtrs(ptrs);
+template<typename Stream>
+void BSDismemberSkinInstance::Sync(Stream& stream) {
+	partitions.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSDismemberSkinInstance)
 
-
-void BSDismemberSkinInstance::Sync(NiStreamReversible& stream) {
-	partitions.Sync(stream);
+size_t BSDismemberSkinInstance::GetHeapSize() const {
+	return NiSkinInstance::GetHeapSize() + HeapSize(partitions);
 }
 
 void BSDismemberSkinInstance::DeletePartitions(const std::vector<uint32_t>& partInds) {
@@ -530,7 +580,8 @@ void BSDismemberSkinInstance::DeletePartitions(const std::vector<uint32_t>& part
 }
 
 
-void BSSkinBoneData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BSSkinBoneData::Sync(Stream& stream) {
 	stream.Sync(nBones);
 	boneXforms.resize(nBones);
 	for (uint32_t i = 0; i < nBones; i++) {
@@ -540,30 +591,35 @@ void BSSkinBoneData::Sync(NiStreamReversible& stream) {
 		stream.Sync(boneXforms[i].boneTransform.scale);
 	}
 }
+NIFLY_SYNC_INSTANTIATE(BSSkinBoneData)
 
+size_t BSSkinBoneData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(boneXforms);
+}
 
-void BSSkinInstance::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void BSSkinInstance::Sync(Stream& stream) {
 	targetRef.Sync(stream);
 	dataRef.Sync(stream);
 	boneRefs.Sync(stream);
 	scales.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(BSSkinInstance)
 
-void BSSkinInstance::GetChildRefs(std::set<NiRef*>& refs) {
-	NiObject::GetChildRefs(refs);
+void BSSkinInstance::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiObject::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
+	visitor(dataRef);
 }
 
-void BSSkinInstance::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiObject::GetChildIndices(indices);
+void BSSkinInstance::ForEachPtr(const NiRefVisitor& visitor) {
+	NiObject::ForEachPtr(visitor);
 
-	indices.push_back(dataRef.index);
+	visitor(targetRef);
+	boneRefs.ForEachRef(visitor);
 }
 
-void BSSkinInstance::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiObject::GetPtrs(ptrs);
-
-	ptrs.insert(&targetRef);
-	boneRefs.GetIndexPtrs(ptrs);
+size_t BSSkinInstance::GetHeapSize() const {
+	return NiBoneContainer::GetHeapSize() + HeapSize(scales);
 }
@@ -8,14 +8,16 @@ See the included GPLv3 LICENSE file
 
 using namespace nifly;
 
-void NiCollisionObject::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiCollisionObject::Sync(Stream& stream) {
 	targetRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiCollisionObject)
 
-void NiCollisionObject::GetPtrs(std::set<NiPtr*>& ptrs) {
-	NiObject::GetPtrs(ptrs);
+void NiCollisionObject::ForEachPtr(const NiRefVisitor& visitor) {
+	NiObject::ForEachPtr(visitor);
 
-	ptrs.insert(&targetRef);
+	visitor(targetRef);
 }
 
 BoundingVolume& BoundingVolume::operator=(const BoundingVolume& other) {
@@ -28,7 +30,8 @@ BoundingVolume& BoundingVolume::operator=(const BoundingVolume& other) {
 	return *this;
 }
 
-void BoundingVolume::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void BoundingVolume::Sync(Stream& stream) {
 	stream.Sync(collisionType);
 
 	switch (collisionType) {
@@ -40,9 +43,15 @@ void BoundingVolume::Sync(NiStreamReversible& stream) {
 		default: break;
 	}
 }
+NIFLY_SYNC_INSTANTIATE(BoundingVolume)
+
+size_t BoundingVolume::GetHeapSize() const {
+	return sizeof(UnionBV) + bvUnion->GetHeapSize();
+}
 
 
-void NiCollisionData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void NiCollisionData::Sync(Stream& stream) {
 	stream.Sync(propagationMode);
 	stream.Sync(collisionMode);
 	stream.Sync(useABV);
@@ -50,90 +59,124 @@ void NiCollisionData::Sync(NiStreamReversible& stream) {
 	if (useABV)
 		boundingVolume.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(NiCollisionData)
 
-
-void bhkNiCollisionObject::Sync(NiStreamReversible& stream) {
-	stream.Sync(flags);
-	bodyRef.Sync(stream);
+size_t NiCollisionData::GetHeapSize() const {
+	return NiCollisionObject::GetHeapSize() + HeapSize(boundingVolume);
 }
 
-void bhkNiCollisionObject::GetChildRefs(std::set<NiRef*>& refs) {
-	NiCollisionObject::GetChildRefs(refs);
 
-	refs.insert(&bodyRef);
+template<typename Stream>
+void bhkNiCollisionObject::Sync(Stream& stream) {
+	stream.Sync(flags);
+	bodyRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkNiCollisionObject)
 
-void bhkNiCollisionObject::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiCollisionObject::GetChildIndices(indices);
+void bhkNiCollisionObject::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiCollisionObject::ForEachChildRef(visitor);
 
-	indices.push_back(bodyRef.index);
+	visitor(bodyRef);
 }
 
 
-void bhkNPCollisionObject::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkNPCollisionObject::Sync(Stream& stream) {
 	stream.Sync(bodyID);
 }
+NIFLY_SYNC_INSTANTIATE(bhkNPCollisionObject)
 
 
-void bhkBlendCollisionObject::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkBlendCollisionObject::Sync(Stream& stream) {
 	stream.Sync(heirGain);
 	stream.Sync(velGain);
 }
+NIFLY_SYNC_INSTANTIATE(bhkBlendCollisionObject)
 
 
 bhkPhysicsSystem::bhkPhysicsSystem(const uint32_t size) {
 	data.resize(size);
 }
 
-void bhkPhysicsSystem::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkPhysicsSystem::Sync(Stream& stream) {
 	data.SyncByteArray(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkPhysicsSystem)
+
+size_t bhkPhysicsSystem::GetHeapSize() const {
+	return BSExtraData::GetHeapSize() + HeapSize(data);
+}
 
 
 bhkRagdollSystem::bhkRagdollSystem(const uint32_t size) {
 	data.resize(size);
 }
 
-void bhkRagdollSystem::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkRagdollSystem::Sync(Stream& stream) {
 	data.SyncByteArray(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkRagdollSystem)
+
+size_t bhkRagdollSystem::GetHeapSize() const {
+	return BSExtraData::GetHeapSize() + HeapSize(data);
+}
 
 
-void bhkBlendController::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkBlendController::Sync(Stream& stream) {
 	stream.Sync(keys);
 }
+NIFLY_SYNC_INSTANTIATE(bhkBlendController)
 
 
-void bhkHeightFieldShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkHeightFieldShape::Sync(Stream& stream) {
 	stream.Sync(material);
 }
+NIFLY_SYNC_INSTANTIATE(bhkHeightFieldShape)
 
 
-void bhkPlaneShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkPlaneShape::Sync(Stream& stream) {
 	stream.Sync(unkVec);
 	stream.Sync(plane);
 	stream.Sync(halfExtents);
 	stream.Sync(center);
 }
+NIFLY_SYNC_INSTANTIATE(bhkPlaneShape)
 
 
-void bhkSphereRepShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkSphereRepShape::Sync(Stream& stream) {
 	stream.Sync(material);
 }
+NIFLY_SYNC_INSTANTIATE(bhkSphereRepShape)
 
 
-void bhkConvexShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkConvexShape::Sync(Stream& stream) {
 	stream.Sync(radius);
 }
+NIFLY_SYNC_INSTANTIATE(bhkConvexShape)
 
 
-void bhkMultiSphereShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkMultiSphereShape::Sync(Stream& stream) {
 	stream.Sync(shapeProperty);
 	spheres.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkMultiSphereShape)
+
+size_t bhkMultiSphereShape::GetHeapSize() const {
+	return bhkSphereRepShape::GetHeapSize() + HeapSize(spheres);
+}
 
 
-void bhkConvexListShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkConvexListShape::Sync(Stream& stream) {
 	shapeRefs.Sync(stream);
 	stream.Sync(material);
 	stream.Sync(radius);
@@ -143,66 +186,72 @@ void bhkConvexListShape::Sync(NiStreamReversible& stream) {
 	stream.Sync(useCachedAABB);
 	stream.Sync(closestPointMinDistance);
 }
+NIFLY_SYNC_INSTANTIATE(bhkConvexListShape)
 
-void bhkConvexListShape::GetChildRefs(std::set<NiRef*>& refs) {
-	bhkShape::GetChildRefs(refs);
+void bhkConvexListShape::ForEachChildRef(const NiRefVisitor& visitor) {
+	bhkShape::ForEachChildRef(visitor);
 
-	shapeRefs.GetIndexPtrs(refs);
+	shapeRefs.ForEachRef(visitor);
 }
 
-void bhkConvexListShape::GetChildIndices(std::vector<uint32_t>& indices) {
-	bhkShape::GetChildIndices(indices);
-
-	shapeRefs.GetIndices(indices);
+size_t bhkConvexListShape::GetHeapSize() const {
+	return bhkShape::GetHeapSize() + HeapSize(shapeRefs);
 }
 
 
-void bhkConvexVerticesShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkConvexVerticesShape::Sync(Stream& stream) {
 	stream.Sync(vertsProp);
 	stream.Sync(normalsProp);
 	verts.Sync(stream);
 	normals.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkConvexVerticesShape)
+
+size_t bhkConvexVerticesShape::GetHeapSize() const {
+	return bhkConvexShape::GetHeapSize() + HeapSize(verts) + HeapSize(normals);
+}
 
 
-void bhkBoxShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkBoxShape::Sync(Stream& stream) {
 	stream.Sync(padding);
 	stream.Sync(dimensions);
 	stream.Sync(radius2);
 }
+NIFLY_SYNC_INSTANTIATE(bhkBoxShape)
 
 
-void bhkTransformShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkTransformShape::Sync(Stream& stream) {
 	shapeRef.Sync(stream);
 	stream.Sync(material);
 	stream.Sync(radius);
 	stream.Sync(padding);
 	stream.Sync(xform);
 }
+NIFLY_SYNC_INSTANTIATE(bhkTransformShape)
 
-void bhkTransformShape::GetChildRefs(std::set<NiRef*>& refs) {
-	bhkShape::GetChildRefs(refs);
-
-	refs.insert(&shapeRef);
-}
-
-void bhkTransformShape::GetChildIndices(std::vector<uint32_t>& indices) {
-	bhkShape::GetChildIndices(indices);
+void bhkTransformShape::ForEachChildRef(const NiRefVisitor& visitor) {
+	bhkShape::ForEachChildRef(visitor);
 
-	indices.push_back(shapeRef.index);
+	visitor(shapeRef);
 }
 
 
-void bhkCapsuleShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkCapsuleShape::Sync(Stream& stream) {
 	stream.Sync(padding);
 	stream.Sync(point1);
 	stream.Sync(radius1);
 	stream.Sync(point2);
 	stream.Sync(radius2);
 }
+NIFLY_SYNC_INSTANTIATE(bhkCapsuleShape)
 
 
-void bhkMoppBvTreeShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkMoppBvTreeShape::Sync(Stream& stream) {
 	shapeRef.Sync(stream);
 	stream.Sync(userData);
 	stream.Sync(shapeCollection);
@@ -216,21 +265,21 @@ void bhkMoppBvTreeShape::Sync(NiStreamReversible& stream) {
 
 	data.SyncData(stream, sz);
 }
+NIFLY_SYNC_INSTANTIATE(bhkMoppBvTreeShape)
 
-void bhkMoppBvTreeShape::GetChildRefs(std::set<NiRef*>& refs) {
-	bhkBvTreeShape::GetChildRefs(refs);
+void bhkMoppBvTreeShape::ForEachChildRef(const NiRefVisitor& visitor) {
+	bhkBvTreeShape::ForEachChildRef(visitor);
 
-	refs.insert(&shapeRef);
+	visitor(shapeRef);
 }
 
-void bhkMoppBvTreeShape::GetChildIndices(std::vector<uint32_t>& indices) {
-	bhkBvTreeShape::GetChildIndices(indices);
-
-	indices.push_back(shapeRef.index);
+size_t bhkMoppBvTreeShape::GetHeapSize() const {
+	return bhkBvTreeShape::GetHeapSize() + HeapSize(data);
 }
 
 
-void bhkNiTriStripsShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkNiTriStripsShape::Sync(Stream& stream) {
 	stream.Sync(material);
 	stream.Sync(radius);
 	stream.Sync(unused1);
@@ -244,21 +293,21 @@ void bhkNiTriStripsShape::Sync(NiStreamReversible& stream) {
 	partRefs.Sync(stream);
 	filters.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkNiTriStripsShape)
 
-void bhkNiTriStripsShape::GetChildRefs(std::set<NiRef*>& refs) {
-	bhkShape::GetChildRefs(refs);
+void bhkNiTriStripsShape::ForEachChildRef(const NiRefVisitor& visitor) {
+	bhkShape::ForEachChildRef(visitor);
 
-	partRefs.GetIndexPtrs(refs);
+	partRefs.ForEachRef(visitor);
 }
 
-void bhkNiTriStripsShape::GetChildIndices(std::vector<uint32_t>& indices) {
-	bhkShape::GetChildIndices(indices);
-
-	partRefs.GetIndices(indices);
+size_t bhkNiTriStripsShape::GetHeapSize() const {
+	return bhkShape::GetHeapSize() + HeapSize(partRefs) + HeapSize(filters);
 }
 
 
-void bhkListShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkListShape::Sync(Stream& stream) {
 	subShapeRefs.Sync(stream);
 
 	stream.Sync(material);
@@ -267,21 +316,21 @@ void bhkListShape::Sync(NiStreamReversible& stream) {
 
 	filters.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkListShape)
 
-void bhkListShape::GetChildRefs(std::set<NiRef*>& refs) {
-	bhkShapeCollection::GetChildRefs(refs);
+void bhkListShape::ForEachChildRef(const NiRefVisitor& visitor) {
+	bhkShapeCollection::ForEachChildRef(visitor);
 
-	subShapeRefs.GetIndexPtrs(refs);
+	subShapeRefs.ForEachRef(visitor);
 }
 
-void bhkListShape::GetChildIndices(std::vector<uint32_t>& indices) {
-	bhkShapeCollection::GetChildIndices(indices);
-
-	subShapeRefs.GetIndices(indices);
+size_t bhkListShape::GetHeapSize() const {
+	return bhkShapeCollection::GetHeapSize() + HeapSize(subShapeRefs) + HeapSize(filters);
 }
 
 
-void hkPackedNiTriStripsData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void hkPackedNiTriStripsData::Sync(Stream& stream) {
 	stream.Sync(keyCount);
 
 	if (stream.GetVersion().Stream() > 11) {
@@ -307,9 +356,20 @@ void hkPackedNiTriStripsData::Sync(NiStreamReversible& stream) {
 	if (stream.GetVersion().Stream() > 11)
 		subPartData.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(hkPackedNiTriStripsData)
+
+size_t hkPackedNiTriStripsData::GetHeapSize() const {
+	size_t size = bhkShapeCollection::GetHeapSize();
+	size += HeapSize(triData);
+	size += HeapSize(triNormData);
+	size += HeapSize(compressedVertData);
+	size += HeapSize(subPartData);
+	return size;
+}
 
 
-void bhkPackedNiTriStripsShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkPackedNiTriStripsShape::Sync(Stream& stream) {
 	if (stream.GetVersion().Stream() <= 11)
 		subPartData.Sync(stream);
 
@@ -322,21 +382,21 @@ void bhkPackedNiTriStripsShape::Sync(NiStreamReversible& stream) {
 	stream.Sync(scaling2);
 	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkPackedNiTriStripsShape)
 
-void bhkPackedNiTriStripsShape::GetChildRefs(std::set<NiRef*>& refs) {
-	bhkShapeCollection::GetChildRefs(refs);
+void bhkPackedNiTriStripsShape::ForEachChildRef(const NiRefVisitor& visitor) {
+	bhkShapeCollection::ForEachChildRef(visitor);
 
-	refs.insert(&dataRef);
+	visitor(dataRef);
 }
 
-void bhkPackedNiTriStripsShape::GetChildIndices(std::vector<uint32_t>& indices) {
-	bhkShapeCollection::GetChildIndices(indices);
-
-	indices.push_back(dataRef.index);
+size_t bhkPackedNiTriStripsShape::GetHeapSize() const {
+	return bhkShapeCollection::GetHeapSize() + HeapSize(subPartData);
 }
 
 
-void bhkLiquidAction::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkLiquidAction::Sync(Stream& stream) {
 	stream.Sync(userData);
 	stream.Sync(unkInt1);
 	stream.Sync(unkInt2);
@@ -345,9 +405,11 @@ void bhkLiquidAction::Sync(NiStreamReversible& stream) {
 	stream.Sync(neighborDistance);
 	stream.Sync(neighborStrength);
 }
+NIFLY_SYNC_INSTANTIATE(bhkLiquidAction)
 
 
-void bhkOrientHingedBodyAction::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkOrientHingedBodyAction::Sync(Stream& stream) {
 	bodyRef.Sync(stream);
 	stream.Sync(unkInt1);
 	stream.Sync(unkInt2);
@@ -358,15 +420,17 @@ void bhkOrientHingedBodyAction::Sync(NiStreamReversible& stream) {
 	stream.Sync(damping);
 	stream.Sync(padding2);
 }
+NIFLY_SYNC_INSTANTIATE(bhkOrientHingedBodyAction)
 
-void bhkOrientHingedBodyAction::GetPtrs(std::set<NiPtr*>& ptrs) {
-	bhkSerializable::GetPtrs(ptrs);
+void bhkOrientHingedBodyAction::ForEachPtr(const NiRefVisitor& visitor) {
+	bhkSerializable::ForEachPtr(visitor);
 
-	ptrs.insert(&bodyRef);
+	visitor(bodyRef);
 }
 
 
-void bhkWorldObject::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkWorldObject::Sync(Stream& stream) {
 	shapeRef.Sync(stream);
 	stream.Sync(collisionFilter);
 	stream.Sync(unkInt1);
@@ -374,34 +438,34 @@ void bhkWorldObject::Sync(NiStreamReversible& stream) {
 	stream.Sync(reinterpret_cast<char*>(&unkBytes), 3);
 	stream.Sync(prop);
 }
+NIFLY_SYNC_INSTANTIATE(bhkWorldObject)
 
-void bhkWorldObject::GetChildRefs(std::set<NiRef*>& refs) {
-	bhkSerializable::GetChildRefs(refs);
-
-	refs.insert(&shapeRef);
-}
-
-void bhkWorldObject::GetChildIndices(std::vector<uint32_t>& indices) {
-	bhkSerializable::GetChildIndices(indices);
+void bhkWorldObject::ForEachChildRef(const NiRefVisitor& visitor) {
+	bhkSerializable::ForEachChildRef(visitor);
 
-	indices.push_back(shapeRef.index);
+	visitor(shapeRef);
 }
 
 
-void bhkSimpleShapePhantom::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkSimpleShapePhantom::Sync(Stream& stream) {
 	stream.Sync(padding);
 	stream.Sync(transform);
 }
+NIFLY_SYNC_INSTANTIATE(bhkSimpleShapePhantom)
 
 
-void bhkAabbPhantom::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkAabbPhantom::Sync(Stream& stream) {
 	stream.Sync(padding);
 	stream.Sync(aabbMin);
 	stream.Sync(aabbMax);
 }
+NIFLY_SYNC_INSTANTIATE(bhkAabbPhantom)
 
 
-void bhkRigidBody::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkRigidBody::Sync(Stream& stream) {
 	stream.Sync(collisionResponse);
 	stream.Sync(unusedByte1);
 	stream.Sync(processContactCallbackDelay);
@@ -460,46 +524,56 @@ void bhkRigidBody::Sync(NiStreamReversible& stream) {
 	else
 		stream.Sync(bodyFlags);
 }
+NIFLY_SYNC_INSTANTIATE(bhkRigidBody)
 
-void bhkRigidBody::GetChildRefs(std::set<NiRef*>& refs) {
-	bhkEntity::GetChildRefs(refs);
+void bhkRigidBody::ForEachChildRef(const NiRefVisitor& visitor) {
+	bhkEntity::ForEachChildRef(visitor);
 
-	constraintRefs.GetIndexPtrs(refs);
+	constraintRefs.ForEachRef(visitor);
 }
 
-void bhkRigidBody::GetChildIndices(std::vector<uint32_t>& indices) {
-	bhkEntity::GetChildIndices(indices);
-
-	constraintRefs.GetIndices(indices);
+size_t bhkRigidBody::GetHeapSize() const {
+	return bhkEntity::GetHeapSize() + HeapSize(constraintRefs);
 }
 
 
-void bhkConstraint::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkConstraint::Sync(Stream& stream) {
 	entityRefs.SetKeepEmptyRefs();
 	entityRefs.SetSize(2);
 	entityRefs.Sync(stream);
 
 	stream.Sync(priority);
 }
+NIFLY_SYNC_INSTANTIATE(bhkConstraint)
+
+void bhkConstraint::ForEachPtr(const NiRefVisitor& visitor) {
+	bhkSerializable::ForEachPtr(visitor);
 
-void bhkConstraint::GetPtrs(std::set<NiPtr*>& ptrs) {
-	bhkSerializable::GetPtrs(ptrs);
+	entityRefs.ForEachRef(visitor);
+}
 
-	entityRefs.GetIndexPtrs(ptrs);
+size_t bhkConstraint::GetHeapSize() const {
+	return bhkSerializable::GetHeapSize() + HeapSize(entityRefs);
 }
 
 
-void bhkHingeConstraint::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkHingeConstraint::Sync(Stream& stream) {
 	hinge.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkHingeConstraint)
 
 
-void bhkLimitedHingeConstraint::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkLimitedHingeConstraint::Sync(Stream& stream) {
 	limitedHinge.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkLimitedHingeConstraint)
 
 
-void ConstraintData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void ConstraintData::Sync(Stream& stream) {
 	stream.Sync(type);
 
 	entityRefs.SetKeepEmptyRefs();
@@ -523,25 +597,33 @@ void ConstraintData::Sync(NiStreamReversible& stream) {
 	else if (stream.GetVersion().File() >= NiFileVersion::V20_2_0_7)
 		stream.Sync(strength);
 }
+NIFLY_SYNC_INSTANTIATE(ConstraintData)
 
-void ConstraintData::GetPtrs(std::set<NiPtr*>& ptrs) {
-	entityRefs.GetIndexPtrs(ptrs);
+void ConstraintData::ForEachPtr(const NiRefVisitor& visitor) {
+	entityRefs.ForEachRef(visitor);
 }
 
 
-void bhkBreakableConstraint::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkBreakableConstraint::Sync(Stream& stream) {
 	subConstraint.Sync(stream);
 	stream.Sync(removeWhenBroken);
 }
+NIFLY_SYNC_INSTANTIATE(bhkBreakableConstraint)
+
+void bhkBreakableConstraint::ForEachPtr(const NiRefVisitor& visitor) {
+	bhkConstraint::ForEachPtr(visitor);
 
-void bhkBreakableConstraint::GetPtrs(std::set<NiPtr*>& ptrs) {
-	bhkConstraint::GetPtrs(ptrs);
+	subConstraint.ForEachPtr(visitor);
+}
 
-	subConstraint.GetPtrs(ptrs);
+size_t bhkBreakableConstraint::GetHeapSize() const {
+	return bhkConstraint::GetHeapSize() + HeapSize(subConstraint);
 }
 
 
-void bhkRagdollConstraint::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkRagdollConstraint::Sync(Stream& stream) {
 	if (stream.GetVersion().Stream() <= 16) {
 		// OB/FO3
 		stream.Sync(ragdoll.pivotA);
@@ -573,32 +655,46 @@ void bhkRagdollConstraint::Sync(NiStreamReversible& stream) {
 	if (stream.GetVersion().Stream() > 16)
 		ragdoll.motorDesc.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkRagdollConstraint)
 
 
-void bhkStiffSpringConstraint::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkStiffSpringConstraint::Sync(Stream& stream) {
 	stream.Sync(stiffSpring.pivotA);
 	stream.Sync(stiffSpring.pivotB);
 	stream.Sync(stiffSpring.length);
 }
+NIFLY_SYNC_INSTANTIATE(bhkStiffSpringConstraint)
 
 
-void bhkPrismaticConstraint::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkPrismaticConstraint::Sync(Stream& stream) {
 	prismatic.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkPrismaticConstraint)
 
 
-void bhkMalleableConstraint::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkMalleableConstraint::Sync(Stream& stream) {
 	subConstraint.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkMalleableConstraint)
+
+size_t bhkMalleableConstraint::GetHeapSize() const {
+	return bhkConstraint::GetHeapSize() + HeapSize(subConstraint);
+}
 
 
-void bhkBallAndSocketConstraint::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkBallAndSocketConstraint::Sync(Stream& stream) {
 	stream.Sync(ballAndSocket.translationA);
 	stream.Sync(ballAndSocket.translationB);
 }
+NIFLY_SYNC_INSTANTIATE(bhkBallAndSocketConstraint)
 
 
-void bhkBallSocketConstraintChain::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkBallSocketConstraintChain::Sync(Stream& stream) {
 	pivots.Sync(stream);
 
 	stream.Sync(tau);
@@ -616,17 +712,23 @@ void bhkBallSocketConstraintChain::Sync(NiStreamReversible& stream) {
 	entityBRef.Sync(stream);
 	stream.Sync(priority);
 }
+NIFLY_SYNC_INSTANTIATE(bhkBallSocketConstraintChain)
 
-void bhkBallSocketConstraintChain::GetPtrs(std::set<NiPtr*>& ptrs) {
-	bhkSerializable::GetPtrs(ptrs);
+void bhkBallSocketConstraintChain::ForEachPtr(const NiRefVisitor& visitor) {
+	bhkSerializable::ForEachPtr(visitor);
 
-	chainedEntityRefs.GetIndexPtrs(ptrs);
-	ptrs.insert(&entityARef);
-	ptrs.insert(&entityBRef);
+	chainedEntityRefs.ForEachRef(visitor);
+	visitor(entityARef);
+	visitor(entityBRef);
 }
 
+size_t bhkBallSocketConstraintChain::GetHeapSize() const {
+	return bhkSerializable::GetHeapSize() + HeapSize(pivots) + HeapSize(chainedEntityRefs);
+}
 
-void bhkCompressedMeshShapeData::Sync(NiStreamReversible& stream) {
+
+template<typename Stream>
+void bhkCompressedMeshShapeData::Sync(Stream& stream) {
 	stream.Sync(bitsPerIndex);
 	stream.Sync(bitsPerWIndex);
 	stream.Sync(maskWIndex);
@@ -653,9 +755,24 @@ void bhkCompressedMeshShapeData::Sync(NiStreamReversible& stream) {
 
 	stream.Sync(numConvexPieceA);
 }
+NIFLY_SYNC_INSTANTIATE(bhkCompressedMeshShapeData)
+
+size_t bhkCompressedMeshShapeData::GetHeapSize() const {
+	size_t size = bhkRefObject::GetHeapSize();
+	size += HeapSize(mat32);
+	size += HeapSize(mat16);
+	size += HeapSize(mat8);
+	size += HeapSize(materials);
+	size += HeapSize(transforms);
+	size += HeapSize(bigVerts);
+	size += HeapSize(bigTris);
+	size += HeapSize(chunks);
+	return size;
+}
 
 
-void bhkCompressedMeshShape::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkCompressedMeshShape::Sync(Stream& stream) {
 	targetRef.Sync(stream);
 	stream.Sync(userData);
 	stream.Sync(radius);
@@ -665,57 +782,59 @@ void bhkCompressedMeshShape::Sync(NiStreamReversible& stream) {
 	stream.Sync(scaling2);
 	dataRef.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkCompressedMeshShape)
 
-void bhkCompressedMeshShape::GetChildRefs(std::set<NiRef*>& refs) {
-	bhkShape::GetChildRefs(refs);
-
-	refs.insert(&dataRef);
-}
-
-void bhkCompressedMeshShape::GetChildIndices(std::vector<uint32_t>& indices) {
-	bhkShape::GetChildIndices(indices);
+void bhkCompressedMeshShape::ForEachChildRef(const NiRefVisitor& visitor) {
+	bhkShape::ForEachChildRef(visitor);
 
-	indices.push_back(dataRef.index);
+	visitor(dataRef);
 }
 
-void bhkCompressedMeshShape::GetPtrs(std::set<NiPtr*>& ptrs) {
-	bhkShape::GetPtrs(ptrs);
+void bhkCompressedMeshShape::ForEachPtr(const NiRefVisitor& visitor) {
+	bhkShape::ForEachPtr(visitor);
 
-	ptrs.insert(&targetRef);
+	visitor(targetRef);
 }
 
 
-void bhkPoseArray::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkPoseArray::Sync(Stream& stream) {
 	bones.Sync(stream);
 	poses.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkPoseArray)
 
-void bhkPoseArray::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiObject::GetStringRefs(refs);
+void bhkPoseArray::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiObject::ForEachStringRef(visitor);
 
 	for (auto& b : bones)
-		refs.emplace_back(&b);
+		visitor(b);
+}
+
+size_t bhkPoseArray::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(bones) + HeapSize(poses);
 }
 
 
-void bhkRagdollTemplate::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkRagdollTemplate::Sync(Stream& stream) {
 	boneRefs.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkRagdollTemplate)
 
-void bhkRagdollTemplate::GetChildRefs(std::set<NiRef*>& refs) {
-	NiExtraData::GetChildRefs(refs);
+void bhkRagdollTemplate::ForEachChildRef(const NiRefVisitor& visitor) {
+	NiExtraData::ForEachChildRef(visitor);
 
-	boneRefs.GetIndexPtrs(refs);
+	boneRefs.ForEachRef(visitor);
 }
 
-void bhkRagdollTemplate::GetChildIndices(std::vector<uint32_t>& indices) {
-	NiExtraData::GetChildIndices(indices);
-
-	boneRefs.GetIndices(indices);
+size_t bhkRagdollTemplate::GetHeapSize() const {
+	return NiExtraData::GetHeapSize() + HeapSize(boneRefs);
 }
 
 
-void bhkRagdollTemplateData::Sync(NiStreamReversible& stream) {
+template<typename Stream>
+void bhkRagdollTemplateData::Sync(Stream& stream) {
 	name.Sync(stream);
 	stream.Sync(mass);
 	stream.Sync(restitution);
@@ -724,9 +843,14 @@ void bhkRagdollTemplateData::Sync(NiStreamReversible& stream) {
 	stream.Sync(material);
 	constraints.Sync(stream);
 }
+NIFLY_SYNC_INSTANTIATE(bhkRagdollTemplateData)
 
-void bhkRagdollTemplateData::GetStringRefs(std::vector<NiStringRef*>& refs) {
-	NiObject::GetStringRefs(refs);
+void bhkRagdollTemplateData::ForEachStringRef(const NiStringRefVisitor& visitor) {
+	NiObject::ForEachStringRef(visitor);
+
+	visitor(name);
+}
 
-	refs.emplace_back(&name);
+size_t bhkRagdollTemplateData::GetHeapSize() const {
+	return NiObject::GetHeapSize() + HeapSize(name) + HeapSize(constraints);
 }
@@ -0,0 +1,559 @@
+/*
+nifly
+C++ NIF library for the Gamebryo/NetImmerse File Format
+See the included GPLv3 LICENSE file
+*/
+
+// Benchmarks for common NifFile workloads.
+// Runs on the tests/*.nif corpus plus synthetic scale-up files and writes the results as JSON.
+//
+// Usage: nifly_bench [--corpus <dir>] [--output <file>] [--filter <text>] [--min-time <seconds>]
+//
+// Each benchmark repeats its operation until at least "min-time" seconds were spent in it.
+// Setup work (e.g. copying a file before it is modified) isn't included in the measured time.
+// "bytes_per_sec" refers to the serialized file size for file operations and to
+// the vertex positions (12 bytes per vertex) for geometry operations.
+// "peak_rss_bytes" is the peak resident set size of the whole run.
+
+#include <KDMatcher.hpp>
+#include <NifFile.hpp>
+#include <NifGenerator.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace nifly;
+
+namespace {
+struct BenchResult {
+	std::string name;
+	std::string input;
+	uint64_t iterations = 0;
+	double seconds = 0.0;
+	double opsPerSec = 0.0;
+	double bytesPerSec = 0.0;
+};
+
+struct BenchInput {
+	std::string name;
+	NifFile nif;
+	std::string data; // Serialized file
+};
+
+struct BenchConfig {
+	std::filesystem::path corpusDir = NIFLY_BENCH_CORPUS_DIR;
+	std::filesystem::path outputFile;
+	std::string filter;
+	double minTime = 0.2;
+};
+
+// Returns the peak resident set size of the process in bytes
+uint64_t GetPeakRSS() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+	return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+std::string EscapeJSON(const std::string& str) {
+	std::string out;
+	out.reserve(str.size());
+	for (char c : str) {
+		switch (c) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char buf[8];
+					std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+					out += buf;
+				}
+				else
+					out += c;
+				break;
+		}
+	}
+	return out;
+}
+
+void WriteJSON(std::ostream& out, const BenchConfig& config, const std::vector<BenchResult>& results) {
+	out.precision(6);
+	out << std::fixed;
+	out << "{\n";
+	out << "\t\"corpus\": \"" << EscapeJSON(config.corpusDir.string()) << "\",\n";
+	out << "\t\"min_time\": " << config.minTime << ",\n";
+	out << "\t\"results\": [";
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult& r = results[i];
+		out << (i ? ",\n" : "\n");
+		out << "\t\t{\"name\": \"" << EscapeJSON(r.name) << "\", ";
+		out << "\"input\": \"" << EscapeJSON(r.input) << "\", ";
+		out << "\"iterations\": " << r.iterations << ", ";
+		out << "\"seconds\": " << r.seconds << ", ";
+		out << "\"ops_per_sec\": " << r.opsPerSec << ", ";
+		out << "\"bytes_per_sec\": " << r.bytesPerSec << "}";
+	}
+
+	out << "\n\t],\n";
+	out << "\t\"peak_rss_bytes\": " << GetPeakRSS() << "\n";
+	out << "}\n";
+}
+
+class BenchRunner {
+	const BenchConfig& config;
+	std::vector<BenchResult> results;
+
+public:
+	BenchRunner(const BenchConfig& benchConfig)
+		: config(benchConfig) {}
+
+	const std::vector<BenchResult>& GetResults() const { return results; }
+
+	// Repeats "op" until the minimum time was spent in it. "setup" runs before each call of "op" and isn't timed.
+	void Run(const std::string& name,
+			 const std::string& input,
+			 const size_t bytesPerOp,
+			 const std::function<void()>& op,
+			 const std::function<void()>& setup = nullptr) {
+		const std::string fullName = name + "/" + input;
+		if (!config.filter.empty() && fullName.find(config.filter) == std::string::npos)
+			return;
+
+		using clock = std::chrono::steady_clock;
+
+		BenchResult result;
+		result.name = name;
+		result.input = input;
+
+		std::chrono::duration<double> elapsed{0.0};
+		do {
+			if (setup)
+				setup();
+
+			auto start = clock::now();
+			op();
+			elapsed += clock::now() - start;
+			result.iterations++;
+		} while (elapsed.count() < config.minTime);
+
+		result.seconds = elapsed.count();
+		if (result.seconds > 0.0) {
+			result.opsPerSec = static_cast<double>(result.iterations) / result.seconds;
+			result.bytesPerSec = result.opsPerSec * static_cast<double>(bytesPerOp);
+		}
+
+		std::cerr << fullName << ": " << result.iterations << " iterations, " << result.opsPerSec
+				  << " ops/sec\n";
+		results.push_back(std::move(result));
+	}
+};
+
+std::string SaveToString(NifFile& nif) {
+	std::ostringstream stream(std::ios_base::binary);
+	nif.Save(stream);
+	return stream.str();
+}
+
+size_t GetVertexBytes(NifFile& nif) {
+	size_t numVerts = 0;
+	for (auto& shape : nif.GetShapes())
+		numVerts += shape->GetNumVertices();
+	return numVerts * sizeof(Vector3);
+}
+
+// Loads all input files of the corpus, ignoring expected and output files of the tests
+std::vector<BenchInput> LoadCorpus(const std::filesystem::path& corpusDir) {
+	std::vector<std::filesystem::path> files;
+	for (auto& entry : std::filesystem::directory_iterator(corpusDir)) {
+		if (!entry.is_regular_file() || entry.path().extension() != ".nif")
+			continue;
+
+		const std::string stem = entry.path().stem().string();
+		auto endsWith = [&stem](const std::string& suffix) {
+			return stem.size() >= suffix.size()
+				   && stem.compare(stem.size() - suffix.size(), suffix.size(), suffix) == 0;
+		};
+
+		if (endsWith("_expected") || endsWith("_output"))
+			continue;
+
+		files.push_back(entry.path());
+	}
+
+	std::sort(files.begin(), files.end());
+
+	std::vector<BenchInput> inputs;
+	for (auto& file : files) {
+		BenchInput input;
+		input.name = file.filename().string();
+		if (input.nif.Load(file) != 0) {
+			std::cerr << "Failed to load '" << file.string() << "', skipping it.\n";
+			continue;
+		}
+
+		input.data = SaveToString(input.nif);
+		inputs.push_back(std::move(input));
+	}
+
+	return inputs;
+}
+
+// Creates a single large shape made of separate grid tiles.
+// Vertices on the tile borders are duplicated, like on UV seams of real meshes.
+BenchInput CreateGridInput(const NiVersion& version, const uint16_t tilesX, const uint16_t tilesY) {
+	constexpr uint16_t tileSize = 15; // Quads per tile edge, (15 + 1)^2 = 256 vertices per tile
+	constexpr uint16_t tileVerts = tileSize + 1;
+
+	std::vector<Vector3> verts;
+	std::vector<Vector2> uvs;
+	std::vector<Triangle> tris;
+
+	const size_t numVerts = static_cast<size_t>(tilesX) * tilesY * tileVerts * tileVerts;
+	verts.reserve(numVerts);
+	uvs.reserve(numVerts);
+	tris.reserve(static_cast<size_t>(tilesX) * tilesY * tileSize * tileSize * 2);
+
+	const float invSizeX = 1.0f / static_cast<float>(tilesX * tileSize);
+	const float invSizeY = 1.0f / static_cast<float>(tilesY * tileSize);
+
+	for (uint16_t ty = 0; ty < tilesY; ty++) {
+		for (uint16_t tx = 0; tx < tilesX; tx++) {
+			const auto base = static_cast<uint16_t>(verts.size());
+
+			for (uint16_t y = 0; y < tileVerts; y++) {
+				for (uint16_t x = 0; x < tileVerts; x++) {
+					const float gx = static_cast<float>(tx * tileSize + x);
+					const float gy = static_cast<float>(ty * tileSize + y);
+					verts.emplace_back(gx, gy, std::sin(gx * 0.1f) * std::cos(gy * 0.1f) * 4.0f);
+					uvs.emplace_back(gx * invSizeX, gy * invSizeY);
+				}
+			}
+
+			for (uint16_t y = 0; y < tileSize; y++) {
+				for (uint16_t x = 0; x < tileSize; x++) {
+					const auto v0 = static_cast<uint16_t>(base + y * tileVerts + x);
+					const auto v1 = static_cast<uint16_t>(v0 + 1);
+					const auto v2 = static_cast<uint16_t>(v0 + tileVerts);
+					const auto v3 = static_cast<uint16_t>(v2 + 1);
+					tris.emplace_back(v0, v1, v3);
+					tris.emplace_back(v0, v3, v2);
+				}
+			}
+		}
+	}
+
+	BenchInput input;
+	input.name = "synthetic_grid_" + std::to_string(verts.size()) + "v";
+	input.nif.Create(version);
+	input.nif.CreateShapeFromData("Grid", &verts, &tris, &uvs);
+	input.data = SaveToString(input.nif);
+	return input;
+}
+
+// Clones all shapes of a file (including their skinning) to scale it up
+BenchInput CreateClonedInput(const BenchInput& source, const uint32_t copies) {
+	BenchInput input;
+	input.name = source.name.substr(0, source.name.rfind('.')) + "_x" + std::to_string(copies);
+	input.nif.CopyFrom(source.nif);
+
+	auto shapes = input.nif.GetShapes();
+	for (uint32_t i = 1; i < copies; i++)
+		for (auto& shape : shapes)
+			input.nif.CloneShape(shape, shape->name.get() + "_" + std::to_string(i));
+
+	input.data = SaveToString(input.nif);
+	return input;
+}
+
+// Generates a skinned file with a larger scene graph than any file of the corpus
+BenchInput CreateGeneratedInput(const NiVersion& version, const std::string& name) {
+	NifGeneratorOptions options;
+	options.version = version;
+	options.nodeCount = 400;
+	options.nodeDepth = 4;
+	options.shapeCount = 40;
+	options.vertsPerShape = 1000;
+	options.bonesPerSkin = 8;
+	options.controllerCount = 40;
+	options.collision = true;
+	options.blockCount = 2000;
+
+	BenchInput input;
+	input.name = name;
+	NifGenerator(options).Generate(input.nif);
+	input.data = SaveToString(input.nif);
+	return input;
+}
+
+const BenchInput* FindInput(const std::vector<BenchInput>& inputs, const std::string& name) {
+	for (auto& input : inputs)
+		if (input.name == name)
+			return &input;
+	return nullptr;
+}
+
+void BenchFileOperations(BenchRunner& runner, const std::vector<BenchInput>& inputs) {
+	for (auto& input : inputs) {
+		NifFile nif;
+		runner.Run("load", input.name, input.data.size(), [&]() {
+			std::istringstream stream(input.data, std::ios_base::binary);
+			nif.Load(stream);
+		});
+	}
+
+	for (auto& input : inputs) {
+		NifFile nif = input.nif;
+		runner.Run("save", input.name, input.data.size(), [&]() {
+			std::ostringstream stream(std::ios_base::binary);
+			nif.Save(stream);
+		});
+	}
+
+	for (auto& input : inputs) {
+		NifFile nif = input.nif;
+		runner.Run("pretty_sort_blocks", input.name, input.data.size(), [&]() { nif.PrettySortBlocks(); });
+	}
+
+	for (auto& input : inputs) {
+		NifFile nif;
+		runner.Run(
+			"delete_unreferenced_blocks",
+			input.name,
+			input.data.size(),
+			[&]() { nif.DeleteUnreferencedBlocks(); },
+			[&]() { nif = input.nif; });
+	}
+}
+
+void BenchOptimize(BenchRunner& runner, const std::vector<BenchInput>& inputs) {
+	struct OptimizeCase {
+		const char* name;
+		const char* fileName;
+		NiVersion targetVersion;
+	};
+
+	const OptimizeCase cases[] = {
+		{"optimize_le_to_se", "TestNifFile_Optimize_LE_to_SE.nif", NiVersion::getSSE()},
+		{"optimize_le_to_se", "TestNifFile_Optimize_Dynamic_LE_to_SE.nif", NiVersion::getSSE()},
+		{"optimize_se_to_le", "TestNifFile_Optimize_SE_to_LE.nif", NiVersion::getSK()},
+		{"optimize_se_to_le", "TestNifFile_Optimize_Dynamic_SE_to_LE.nif", NiVersion::getSK()},
+	};
+
+	for (auto& c : cases) {
+		auto input = FindInput(inputs, c.fileName);
+		if (!input)
+			continue;
+
+		NifFile nif;
+		runner.Run(
+			c.name,
+			input->name,
+			input->data.size(),
+			[&]() {
+				OptOptions options;
+				options.targetVersion = c.targetVersion;
+				nif.OptimizeFor(options);
+			},
+			[&]() { nif = input->nif; });
+	}
+}
+
+void BenchGeometry(BenchRunner& runner, const std::vector<BenchInput>& inputs) {
+	for (auto& input : inputs) {
+		NifFile nif = input.nif;
+		const size_t vertexBytes = GetVertexBytes(nif);
+		if (vertexBytes == 0)
+			continue;
+
+		auto shapes = nif.GetShapes();
+		runner.Run("calc_normals", input.name, vertexBytes, [&]() {
+			for (auto& shape : shapes)
+				nif.CalcNormalsForShape(shape);
+		});
+	}
+
+	for (auto& input : inputs) {
+		NifFile nif = input.nif;
+		const size_t vertexBytes = GetVertexBytes(nif);
+		if (vertexBytes == 0)
+			continue;
+
+		// Tangents require normals and UVs
+		auto shapes = nif.GetShapes();
+		std::vector<NiShape*> tangentShapes;
+		for (auto& shape : shapes) {
+			if (!nif.GetNormalsForShape(shape))
+				nif.CalcNormalsForShape(shape);
+			if (nif.GetNormalsForShape(shape) && nif.GetUvsForShape(shape))
+				tangentShapes.push_back(shape);
+		}
+
+		if (tangentShapes.empty())
+			continue;
+
+		runner.Run("calc_tangents", input.name, vertexBytes, [&]() {
+			for (auto& shape : tangentShapes)
+				nif.CalcTangentsForShape(shape);
+		});
+	}
+
+	for (auto& input : inputs) {
+		NifFile nif = input.nif;
+
+		std::vector<NiShape*> skinnedShapes;
+		for (auto& shape : nif.GetShapes())
+			if (shape->IsSkinned())
+				skinnedShapes.push_back(shape);
+
+		if (skinnedShapes.empty())
+			continue;
+
+		runner.Run("update_skin_partitions", input.name, GetVertexBytes(nif), [&]() {
+			for (auto& shape : skinnedShapes)
+				nif.UpdateSkinPartitions(shape);
+		});
+	}
+}
+
+void BenchMatchers(BenchRunner& runner, const std::vector<BenchInput>& inputs) {
+	for (auto& input : inputs) {
+		// Use the largest shape of each file
+		NifFile nif = input.nif;
+		std::vector<Vector3> verts;
+		for (auto& shape : nif.GetShapes()) {
+			auto shapeVerts = nif.GetVertsForShape(shape);
+			if (shapeVerts && shapeVerts->size() > verts.size())
+				verts = *shapeVerts;
+		}
+
+		if (verts.empty())
+			continue;
+
+		const auto count = static_cast<uint16_t>(verts.size());
+		const size_t vertexBytes = verts.size() * sizeof(Vector3);
+		size_t matchCount = 0;
+
+		runner.Run("kd_matcher", input.name, vertexBytes, [&]() {
+			kd_matcher matcher(verts.data(), count);
+			matchCount += matcher.matches.size();
+		});
+
+		runner.Run("sorting_matcher", input.name, vertexBytes, [&]() {
+			SortingMatcher matcher(verts.data(), count);
+			matchCount += matcher.matches.size();
+		});
+
+		// Builds the tree and queries the nearest neighbors of every point
+		runner.Run("kd_tree_nn", input.name, vertexBytes, [&]() {
+			kd_tree<uint16_t> tree(verts.data(), count);
+			for (auto& v : verts)
+				matchCount += tree.kd_nn(&v, 0.01f);
+		});
+
+		if (matchCount == 0)
+			std::cerr << input.name << ": no matches found\n";
+	}
+}
+
+bool ParseArguments(int argc, char* argv[], BenchConfig& config) {
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for argument '" << arg << "'.\n";
+			return false;
+		}
+
+		const std::string value = argv[++i];
+		if (arg == "--corpus")
+			config.corpusDir = value;
+		else if (arg == "--output")
+			config.outputFile = value;
+		else if (arg == "--filter")
+			config.filter = value;
+		else if (arg == "--min-time")
+			config.minTime = std::stod(value);
+		else {
+			std::cerr << "Unknown argument '" << arg << "'.\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+	BenchConfig config;
+	if (!ParseArguments(argc, argv, config)) {
+		std::cerr
+			<< "Usage: nifly_bench [--corpus <dir>] [--output <file>] [--filter <text>] [--min-time <seconds>]\n";
+		return 1;
+	}
+
+	std::vector<BenchInput> inputs = LoadCorpus(config.corpusDir);
+	if (inputs.empty()) {
+		std::cerr << "No files found in corpus '" << config.corpusDir.string() << "'.\n";
+		return 1;
+	}
+
+	// Synthetic scale-up inputs
+	inputs.push_back(CreateGridInput(NiVersion::getSSE(), 16, 15));
+	inputs.push_back(CreateGridInput(NiVersion::getSK(), 16, 15));
+	inputs.push_back(CreateGeneratedInput(NiVersion::getSSE(), "synthetic_generated_se"));
+	inputs.push_back(CreateGeneratedInput(NiVersion::getSK(), "synthetic_generated_le"));
+
+	auto skinnedInput = FindInput(inputs, "TestNifFile_Skinned_SE.nif");
+	if (skinnedInput)
+		inputs.push_back(CreateClonedInput(*skinnedInput, 16));
+
+	auto deepGraphInput = FindInput(inputs, "TestNifFile_DeepGraph_SE.nif");
+	if (deepGraphInput)
+		inputs.push_back(CreateClonedInput(*deepGraphInput, 16));
+
+	BenchRunner runner(config);
+	BenchFileOperations(runner, inputs);
+	BenchOptimize(runner, inputs);
+	BenchGeometry(runner, inputs);
+	BenchMatchers(runner, inputs);
+
+	if (config.outputFile.empty()) {
+		WriteJSON(std::cout, config, runner.GetResults());
+	}
+	else {
+		std::ofstream file(config.outputFile, std::ios_base::binary);
+		if (!file) {
+			std::cerr << "Failed to open output file '" << config.outputFile.string() << "'.\n";
+			return 1;
+		}
+
+		WriteJSON(file, config, runner.GetResults());
+	}
+
+	return 0;
+}
@@ -2,7 +2,12 @@
 
 #include <catch2/catch.hpp>
 
+#include <NifBatch.hpp>
 #include <NifFile.hpp>
+#include <NifGenerator.hpp>
+#include <NifTrace.hpp>
+
+#include <atomic>
 
 using namespace nifly;
 
@@ -240,3 +245,1204 @@ TEST_CASE("Load, optimize (SE to LE, dynamic) and save file", "[NifFile]") {
 
 	REQUIRE(CompareBinaryFiles(fileOutput, fileExpected));
 }
+
+TEST_CASE("Bounds are only updated for modified shapes", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Static_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	auto shapes = nif.GetShapes();
+	REQUIRE(!shapes.empty());
+
+	nif.Optimize();
+	for (auto& shape : shapes)
+		REQUIRE(!shape->IsBoundsDirty());
+
+	auto shape = shapes.front();
+	const uint32_t generation = shape->GetVertexGeneration();
+	nif.OffsetShape(shape, Vector3(10.0f, 0.0f, 0.0f));
+	REQUIRE(shape->GetVertexGeneration() != generation);
+	REQUIRE(shape->IsBoundsDirty());
+
+	const Vector3 center = shape->GetBounds().center;
+	nif.Optimize();
+	REQUIRE(!shape->IsBoundsDirty());
+	REQUIRE(shape->GetBounds().center.x != center.x);
+
+	// Positions written through the vertex data accessor
+	auto bsTriShape = dynamic_cast<BSTriShape*>(shape);
+	REQUIRE(bsTriShape);
+	bsTriShape->GetVertexDataForWrite()[0].vert.x += 1000.0f;
+	REQUIRE(shape->IsBoundsDirty());
+
+	const float radius = shape->GetBounds().radius;
+	nif.Optimize();
+	REQUIRE(!shape->IsBoundsDirty());
+	REQUIRE(shape->GetBounds().radius > radius);
+	REQUIRE((*nif.GetVertsForShape(shape))[0].x == bsTriShape->GetVertexData()[0].vert.x);
+}
+
+TEST_CASE("Bounds are updated for direct geometry data edits", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_OB";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	nif.Optimize();
+
+	auto shape = nif.GetShapes().front();
+	auto geomData = shape->GetGeomData();
+	REQUIRE(geomData);
+	REQUIRE(!shape->IsBoundsDirty());
+
+	// Positions written into the geometry data directly, without MarkVerticesChanged
+	geomData->vertices[0].x += 1000.0f;
+	REQUIRE(!shape->IsBoundsDirty());
+	REQUIRE(geomData->CheckVerticesChanged());
+	REQUIRE(shape->IsBoundsDirty());
+	REQUIRE(geomData->CheckVerticesChanged());
+
+	const float radius = shape->GetBounds().radius;
+	nif.Optimize();
+	REQUIRE(!shape->IsBoundsDirty());
+	REQUIRE(shape->GetBounds().radius > radius);
+	REQUIRE(!geomData->CheckVerticesChanged());
+}
+
+TEST_CASE("Raw vertex data is refreshed after modification", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Static_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	auto shape = nif.GetShapes().front();
+	auto verts = nif.GetVertsForShape(shape);
+	REQUIRE(verts);
+	REQUIRE(!verts->empty());
+
+	const Vector3 pos = (*verts)[0] + Vector3(1.0f, 2.0f, 3.0f);
+	nif.MoveVertex(shape, pos, 0);
+
+	verts = nif.GetVertsForShape(shape);
+	REQUIRE(verts);
+	REQUIRE((*verts)[0] == pos);
+
+	auto uvs = nif.GetUvsForShape(shape);
+	REQUIRE(uvs);
+	const Vector2 uv = (*uvs)[0];
+	nif.InvertUVsForShape(shape, true, false);
+
+	uvs = nif.GetUvsForShape(shape);
+	REQUIRE(uvs);
+	REQUIRE((*uvs)[0].u == 1.0f - uv.u);
+}
+
+TEST_CASE("Update skin partitions with bone similarity strategy (OB)", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_OB";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	auto countPartitions = [&](const SkinPartitionStrategy strategy) {
+		NifFile nif;
+		REQUIRE(nif.Load(fileInput) == 0);
+
+		auto shape = nif.GetShapes().front();
+		auto skinInst = nif.GetHeader().GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
+		REQUIRE(skinInst);
+
+		auto skinData = nif.GetHeader().GetBlock(skinInst->dataRef);
+		REQUIRE(skinData);
+
+		// Spread weights over more bones than a single partition allows
+		constexpr uint16_t numBones = 40;
+		auto bone = skinData->bones.front();
+		bone.vertexWeights.clear();
+		skinData->bones.assign(numBones, bone);
+
+		for (uint16_t v = 0; v < shape->GetNumVertices(); v++) {
+			SkinWeight sw;
+			sw.index = v;
+			sw.weight = 1.0f;
+			skinData->bones[(v / 8) % numBones].vertexWeights.push_back(sw);
+		}
+
+		SkinPartitionOptions options;
+		options.strategy = strategy;
+		const SkinPartitionResult result = nif.UpdateSkinPartitions(shape, options);
+		REQUIRE(result.maxBones <= result.maxBonesPerPartition);
+
+		auto skinPart = nif.GetHeader().GetBlock(skinInst->skinPartitionRef);
+		REQUIRE(skinPart);
+		REQUIRE(skinPart->numPartitions == result.numPartitions);
+		REQUIRE(skinPart->triParts.size() == shape->GetNumTriangles());
+
+		for (auto& part : skinPart->partitions)
+			REQUIRE(part.numBones <= result.maxBonesPerPartition);
+
+		return result.numPartitions;
+	};
+
+	const uint32_t numSequential = countPartitions(SPS_SEQUENTIAL);
+	const uint32_t numSimilarity = countPartitions(SPS_BONE_SIMILARITY);
+	REQUIRE(numSequential > 1);
+	REQUIRE(numSimilarity <= numSequential);
+}
+
+TEST_CASE("Update skin partitions (SE)", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	// Checks that the partitions cover all triangles once and the bones of all their vertices
+	auto checkPartitions = [](NifFile& nif, NiShape* shape, const SkinPartitionResult& result) {
+		auto skinInst = nif.GetHeader().GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
+		REQUIRE(skinInst);
+		auto skinData = nif.GetHeader().GetBlock(skinInst->dataRef);
+		REQUIRE(skinData);
+		auto skinPart = nif.GetHeader().GetBlock(skinInst->skinPartitionRef);
+		REQUIRE(skinPart);
+
+		REQUIRE(result.maxBonesPerPartition == 80);
+		REQUIRE(result.maxBones <= result.maxBonesPerPartition);
+		REQUIRE(result.numPartitions == skinPart->numPartitions);
+		REQUIRE(skinPart->partitions.size() == skinPart->numPartitions);
+
+		// Non-zero bone weights of each vertex, read from the skin data
+		std::vector<std::vector<SkinWeight>> vertWeights(shape->GetNumVertices());
+		for (uint16_t b = 0; b < skinData->bones.size(); b++)
+			for (auto& bw : skinData->bones[b].vertexWeights)
+				if (bw.index < vertWeights.size() && bw.weight > 0.0f)
+					vertWeights[bw.index].emplace_back(b, bw.weight);
+
+		auto inVertexMap = [](const NiSkinPartition::PartitionBlock& part, const uint16_t v) {
+			return std::find(part.vertexMap.begin(), part.vertexMap.end(), v) != part.vertexMap.end();
+		};
+
+		std::vector<Triangle> partTris;
+		std::vector<bool> vertCovered(shape->GetNumVertices(), false);
+		for (auto& part : skinPart->partitions) {
+			REQUIRE(part.numBones == part.bones.size());
+			REQUIRE(part.numBones <= result.maxBonesPerPartition);
+			REQUIRE(std::is_sorted(part.bones.begin(), part.bones.end()));
+			REQUIRE(std::adjacent_find(part.bones.begin(), part.bones.end()) == part.bones.end());
+
+			REQUIRE(part.triangles.size() == part.trueTriangles.size());
+			REQUIRE(part.boneIndices.size() == part.vertexMap.size());
+			REQUIRE(part.vertexWeights.size() == part.vertexMap.size());
+
+			for (size_t t = 0; t < part.trueTriangles.size(); t++) {
+				const Triangle& tri = part.trueTriangles[t];
+				Triangle mapped = part.triangles[t];
+				if (skinPart->bMappedIndices) {
+					auto& vm = part.vertexMap;
+					mapped = Triangle(vm[mapped.p1], vm[mapped.p2], vm[mapped.p3]);
+				}
+
+				REQUIRE(mapped == tri);
+				REQUIRE(inVertexMap(part, tri.p1));
+				REQUIRE(inVertexMap(part, tri.p2));
+				REQUIRE(inVertexMap(part, tri.p3));
+
+				Triangle rotated = tri;
+				rotated.rot();
+				partTris.push_back(rotated);
+			}
+
+			for (size_t i = 0; i < part.vertexMap.size(); i++) {
+				const uint16_t v = part.vertexMap[i];
+				vertCovered[v] = true;
+
+				// Each weight of the vertex references one of its bones in the partition's bone list
+				const uint8_t* pb = &part.boneIndices[i].i1;
+				const float* pw = &part.vertexWeights[i].w1;
+				size_t numWeights = 0;
+				for (int w = 0; w < 4; w++) {
+					if (pw[w] == 0.0f)
+						continue;
+
+					REQUIRE(pb[w] < part.numBones);
+					const uint16_t bone = part.bones[pb[w]];
+					auto& weights = vertWeights[v];
+					REQUIRE(std::any_of(weights.begin(), weights.end(), [&](const SkinWeight& sw) {
+						return sw.index == bone;
+					}));
+					numWeights++;
+				}
+
+				REQUIRE(numWeights == std::min<size_t>(vertWeights[v].size(), 4));
+			}
+		}
+
+		std::vector<Triangle> shapeTris;
+		REQUIRE(shape->GetTriangles(shapeTris));
+		for (auto& t : shapeTris)
+			t.rot();
+
+		std::sort(shapeTris.begin(), shapeTris.end());
+		std::sort(partTris.begin(), partTris.end());
+		REQUIRE(partTris == shapeTris);
+
+		for (auto& t : shapeTris) {
+			REQUIRE(vertCovered[t.p1]);
+			REQUIRE(vertCovered[t.p2]);
+			REQUIRE(vertCovered[t.p3]);
+		}
+	};
+
+	SECTION("Fixture weights") {
+		NifFile nif;
+		REQUIRE(nif.Load(fileInput) == 0);
+
+		for (auto& shape : nif.GetShapes()) {
+			const SkinPartitionResult result = nif.UpdateSkinPartitions(shape, SkinPartitionOptions());
+			REQUIRE(result.numAddedPartitions == 0);
+			checkPartitions(nif, shape, result);
+		}
+	}
+
+	SECTION("Weights over more bones than a partition allows") {
+		for (auto strategy : {SPS_SEQUENTIAL, SPS_BONE_SIMILARITY}) {
+			NifFile nif;
+			REQUIRE(nif.Load(fileInput) == 0);
+
+			auto shape = nif.GetShapes().front();
+			auto skinInst = nif.GetHeader().GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
+			REQUIRE(skinInst);
+			auto skinData = nif.GetHeader().GetBlock(skinInst->dataRef);
+			REQUIRE(skinData);
+
+			// Each vertex is weighted to a bone of its own and the one of the next vertex
+			const uint16_t numBones = shape->GetNumVertices();
+			REQUIRE(numBones > 80);
+
+			auto bone = skinData->bones.front();
+			bone.vertexWeights.clear();
+			skinData->bones.assign(numBones, bone);
+
+			for (uint16_t v = 0; v < numBones; v++) {
+				skinData->bones[v].vertexWeights.emplace_back(v, 0.75f);
+				skinData->bones[static_cast<size_t>((v + 1) % numBones)].vertexWeights.emplace_back(v, 0.25f);
+			}
+
+			SkinPartitionOptions options;
+			options.strategy = strategy;
+			const SkinPartitionResult result = nif.UpdateSkinPartitions(shape, options);
+			REQUIRE(result.numAddedPartitions > 0);
+			checkPartitions(nif, shape, result);
+		}
+	}
+}
+
+TEST_CASE("Optimize vertex cache of skinned shapes (SE)", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	// Triangles described by their vertex positions, independent of vertex and triangle order
+	auto getTrianglePositions = [&](NiShape* shape) {
+		std::vector<Triangle> tris;
+		shape->GetTriangles(tris);
+		auto verts = nif.GetVertsForShape(shape);
+
+		std::vector<std::array<float, 9>> triPositions;
+		for (auto& t : tris) {
+			std::array<Vector3, 3> pos = {(*verts)[t.p1], (*verts)[t.p2], (*verts)[t.p3]};
+			std::sort(pos.begin(), pos.end(), [](const Vector3& a, const Vector3& b) {
+				return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+			});
+			triPositions.push_back(
+				{pos[0].x, pos[0].y, pos[0].z, pos[1].x, pos[1].y, pos[1].z, pos[2].x, pos[2].y, pos[2].z});
+		}
+
+		std::sort(triPositions.begin(), triPositions.end());
+		return triPositions;
+	};
+
+	for (auto& shape : nif.GetShapes()) {
+		auto skinInst = nif.GetHeader().GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
+		REQUIRE(skinInst);
+		auto skinPart = nif.GetHeader().GetBlock(skinInst->skinPartitionRef);
+		REQUIRE(skinPart);
+
+		const auto triPositions = getTrianglePositions(shape);
+		std::vector<uint16_t> partTriCounts;
+		for (auto& p : skinPart->partitions)
+			partTriCounts.push_back(p.numTriangles);
+
+		REQUIRE(nif.OptimizeVertexCache(shape));
+		REQUIRE(getTrianglePositions(shape) == triPositions);
+
+		// Vertices are numbered in the order the triangles use them
+		std::vector<Triangle> tris;
+		shape->GetTriangles(tris);
+		bool fetchOrder = true;
+		uint16_t nextVert = 0;
+		for (auto& t : tris) {
+			for (uint16_t v : {t.p1, t.p2, t.p3}) {
+				if (v > nextVert)
+					fetchOrder = false;
+				else if (v == nextVert)
+					nextVert++;
+			}
+		}
+		REQUIRE(fetchOrder);
+
+		for (size_t i = 0; i < partTriCounts.size(); i++)
+			REQUIRE(skinPart->partitions[i].numTriangles == partTriCounts[i]);
+	}
+
+	REQUIRE(nif.Save(fileOutput) == 0);
+
+	NifFile nifSaved;
+	REQUIRE(nifSaved.Load(fileOutput) == 0);
+	REQUIRE(nifSaved.GetShapes().size() == nif.GetShapes().size());
+}
+
+TEST_CASE("Transform shapes with per-vertex weights", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Static_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	auto shape = nif.GetShapes().front();
+	const std::vector<Vector3> verts = *nif.GetVertsForShape(shape);
+
+	std::vector<float> weights(verts.size(), 0.0f);
+	for (size_t i = 0; i < weights.size(); i += 2)
+		weights[i] = 1.0f;
+
+	const Vector3 offset(1.0f, 2.0f, 3.0f);
+	nif.OffsetShape(shape, offset, weights);
+
+	auto offsetVerts = nif.GetVertsForShape(shape);
+	bool weighted = true;
+	for (size_t i = 0; i < verts.size(); i++)
+		if (!(*offsetVerts)[i].IsNearlyEqualTo(verts[i] + offset * weights[i]))
+			weighted = false;
+	REQUIRE(weighted);
+
+	// A masking map is equivalent to weights of (1 - mask value)
+	std::unordered_map<uint16_t, float> mask;
+	for (uint16_t i = 0; i < static_cast<uint16_t>(weights.size()); i++)
+		if (weights[i] == 1.0f)
+			mask[i] = 1.0f;
+
+	nif.OffsetShape(shape, offset * -1.0f, &mask);
+
+	offsetVerts = nif.GetVertsForShape(shape);
+	bool masked = true;
+	for (size_t i = 0; i < verts.size(); i++)
+		if (!(*offsetVerts)[i].IsNearlyEqualTo(verts[i] + offset * (2.0f * weights[i] - 1.0f)))
+			masked = false;
+	REQUIRE(masked);
+
+	// Full weights match the unmasked transform
+	NifFile nifUnmasked;
+	REQUIRE(nifUnmasked.Load(fileInput) == 0);
+	auto shapeUnmasked = nifUnmasked.GetShapes().front();
+
+	nif.ScaleShape(shape, Vector3(2.0f, 2.0f, 2.0f), std::vector<float>(verts.size(), 1.0f));
+	nifUnmasked.OffsetShape(shapeUnmasked, offset * (2.0f * weights[0] - 1.0f));
+	nifUnmasked.ScaleShape(shapeUnmasked, Vector3(2.0f, 2.0f, 2.0f));
+
+	auto scaledVerts = nif.GetVertsForShape(shape);
+	auto unmaskedVerts = nifUnmasked.GetVertsForShape(shapeUnmasked);
+	REQUIRE(scaledVerts->front().IsNearlyEqualTo(unmaskedVerts->front()));
+}
+
+TEST_CASE("Transform masked shapes from a moved root", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Static_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	MatTransform rootXform;
+	rootXform.translation.x = 10.0f;
+	rootXform.translation.y = 20.0f;
+	rootXform.translation.z = -5.0f;
+	nif.GetRootNode()->SetTransformToParent(rootXform);
+	const Vector3 root = rootXform.translation;
+
+	auto shape = nif.GetShapes().front();
+	std::vector<Vector3> verts = *nif.GetVertsForShape(shape);
+	REQUIRE(verts.size() > 2);
+
+	// Masked vertices are only moved by the root translation, others are transformed around the root
+	std::unordered_map<uint16_t, float> mask;
+	mask[0] = 1.0f;
+	mask[1] = 0.5f;
+
+	nif.ScaleShape(shape, Vector3(2.0f, 2.0f, 2.0f), &mask);
+
+	auto scaledVerts = nif.GetVertsForShape(shape);
+	REQUIRE((*scaledVerts)[0].IsNearlyEqualTo(verts[0] - root));
+	REQUIRE((*scaledVerts)[1].IsNearlyEqualTo((verts[1] - root) * 1.5f));
+	REQUIRE((*scaledVerts)[2].IsNearlyEqualTo((verts[2] - root) * 2.0f));
+
+	verts = *scaledVerts;
+	nif.RotateShape(shape, Vector3(0.0f, 0.0f, 180.0f), &mask);
+
+	auto rotatedVerts = nif.GetVertsForShape(shape);
+	const Vector3 rotated = verts[2] - root;
+	REQUIRE((*rotatedVerts)[0].IsNearlyEqualTo(verts[0] - root));
+	REQUIRE((*rotatedVerts)[2].IsNearlyEqualTo(Vector3(-rotated.x, -rotated.y, rotated.z)));
+}
+
+TEST_CASE("Calculate and apply sparse shape diff", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Static_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	auto shape = nif.GetShapes().front();
+	const std::vector<Vector3> verts = *nif.GetVertsForShape(shape);
+
+	std::vector<Vector3> target = verts;
+	for (size_t i = 0; i < target.size(); i += 3)
+		target[i] += Vector3(0.5f, -1.0f, 2.0f);
+
+	std::unordered_map<uint16_t, Vector3> diffMap;
+	REQUIRE(nif.CalcShapeDiff(shape, &target, diffMap) == 0);
+
+	SparseDiffData diffData;
+	REQUIRE(nif.CalcShapeDiff(shape, &target, diffData) == 0);
+	REQUIRE(diffData.size() == diffMap.size());
+	REQUIRE(std::is_sorted(diffData.indices.begin(), diffData.indices.end()));
+
+	for (size_t i = 0; i < diffData.size(); i++)
+		REQUIRE(diffMap[diffData.indices[i]] == diffData.GetDiff(i));
+
+	nif.ApplyShapeDiff(shape, diffData, 0.5f);
+
+	auto morphedVerts = nif.GetVertsForShape(shape);
+	bool halfway = true;
+	for (size_t i = 0; i < verts.size(); i++)
+		if (!(*morphedVerts)[i].IsNearlyEqualTo((verts[i] + target[i]) * 0.5f))
+			halfway = false;
+	REQUIRE(halfway);
+}
+
+TEST_CASE("Process files with NifBatch", "[NifFile]") {
+	std::vector<std::filesystem::path> files = {"TestNifFile_Static_SE.nif",
+												"TestNifFile_Skinned_SE.nif",
+												"TestNifFile_NotExisting.nif",
+												"TestNifFile_Skinned_FO4.nif"};
+
+	NifStats loadStats;
+	NifBatchOptions options;
+	options.numThreads = 2;
+	options.maxInFlight = 2;
+	options.loadOptions.stats = &loadStats;
+	options.outputFunc = [](const std::filesystem::path& fileName) {
+		return fileName.stem().string() + nifSuffixOutput;
+	};
+
+	std::atomic<uint32_t> numProcessed{0};
+	auto processFunc = [&](NifFile& nif, const std::filesystem::path&) {
+		numProcessed++;
+		return nif.GetShapes().empty() ? 1 : 0;
+	};
+
+	std::vector<NifBatchResult> results;
+	auto resultFunc = [&](const NifBatchResult& result) { results.push_back(result); };
+
+	NifBatch batch(options);
+	REQUIRE(batch.Run(files, processFunc, resultFunc) == 1);
+	REQUIRE(numProcessed == 3);
+	REQUIRE(results.size() == files.size());
+
+	for (size_t i = 0; i < results.size(); i++) {
+		REQUIRE(results[i].index == i);
+		REQUIRE(results[i].fileName == files[i]);
+	}
+
+	REQUIRE(results[2].status == NBS_LOAD_FAILED);
+	REQUIRE(results[3].status == NBS_OK);
+	REQUIRE(loadStats.prepareData.count == 3);
+
+	NifFile nif;
+	REQUIRE(nif.Load(results[3].outFileName) == 0);
+}
+
+TEST_CASE("Generate synthetic files", "[NifFile]") {
+	const NiVersion versions[] = {NiVersion::getOB(),
+								  NiVersion::getFO3(),
+								  NiVersion::getSK(),
+								  NiVersion::getSSE(),
+								  NiVersion::getFO4()};
+
+	NifGeneratorOptions options;
+	options.nodeCount = 20;
+	options.nodeDepth = 4;
+	options.shapeCount = 6;
+	options.vertsPerShape = 300;
+	options.bonesPerSkin = 5;
+	options.controllerCount = 4;
+	options.collision = true;
+	options.blockCount = 250;
+
+	for (auto& version : versions) {
+		options.version = version;
+
+		NifFile nif;
+		REQUIRE(NifGenerator(options).Generate(nif) == 0);
+		REQUIRE(nif.GetHeader().GetNumBlocks() >= options.blockCount);
+
+		std::stringstream stream;
+		REQUIRE(nif.Save(stream) == 0);
+
+		NifFile loaded;
+		REQUIRE(loaded.Load(stream) == 0);
+		REQUIRE(loaded.GetHeader().GetNumBlocks() == nif.GetHeader().GetNumBlocks());
+		REQUIRE(loaded.GetNodes().size() == options.nodeCount + 1);
+
+		auto shapes = loaded.GetShapes();
+		REQUIRE(shapes.size() == options.shapeCount);
+
+		for (auto& shape : shapes) {
+			std::vector<int> boneIds;
+			REQUIRE(shape->IsSkinned());
+			REQUIRE(shape->GetNumVertices() == options.vertsPerShape);
+			REQUIRE(loaded.GetShapeBoneIDList(shape, boneIds) == options.bonesPerSkin);
+		}
+	}
+
+	options.vertsPerShape = 2;
+
+	NifFile nif;
+	REQUIRE(NifGenerator(options).Generate(nif) == 1);
+}
+
+TEST_CASE("Collect load and save stats", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifStats stats;
+	NifLoadOptions loadOptions;
+	loadOptions.stats = &stats;
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput, loadOptions) == 0);
+
+	REQUIRE(stats.load.count == 1);
+	REQUIRE(stats.readHeader.count == 1);
+	REQUIRE(stats.readBlocks.count == 1);
+	REQUIRE(stats.prepareData.count == 1);
+	REQUIRE(stats.blocksRead == nif.GetHeader().GetNumBlocks());
+	REQUIRE(stats.bytesRead > 0);
+	REQUIRE(stats.bytesRead <= std::filesystem::file_size(fileInput));
+
+	uint64_t blockCount = 0;
+	uint64_t blockBytes = 0;
+	for (auto& [blockType, typeStats] : stats.blockTypes) {
+		blockCount += typeStats.count;
+		blockBytes += typeStats.bytes;
+	}
+
+	REQUIRE(blockCount == stats.blocksRead);
+	REQUIRE(stats.blockTypes["BSTriShape"].count > 0);
+	REQUIRE(stats.headerBytesRead + blockBytes <= stats.bytesRead);
+
+	NifSaveOptions saveOptions;
+	saveOptions.stats = &stats;
+	REQUIRE(nif.Save(fileOutput, saveOptions) == 0);
+	REQUIRE(CompareBinaryFiles(fileOutput, fileExpected));
+
+	REQUIRE(stats.save.count == 1);
+	REQUIRE(stats.finalizeData.count == 1);
+	REQUIRE(stats.optimize.count == 1);
+	REQUIRE(stats.sortBlocks.count == 1);
+	REQUIRE(stats.writeBlocks.count == 1);
+	REQUIRE(stats.blocksWritten == nif.GetHeader().GetNumBlocks());
+	REQUIRE(stats.bytesWritten == std::filesystem::file_size(fileOutput));
+
+	NifStats total;
+	total.Add(stats);
+	total.Add(stats);
+	REQUIRE(total.load.count == 2);
+	REQUIRE(total.blockTypes["BSTriShape"].count == 2 * stats.blockTypes["BSTriShape"].count);
+
+	stats.Reset();
+	REQUIRE(stats.blockTypes.empty());
+	REQUIRE(stats.load.count == 0);
+}
+
+TEST_CASE("Report memory usage", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	NifMemoryUsage usage = nif.GetMemoryUsage();
+	REQUIRE(usage.fileBytes >= sizeof(NifFile));
+	REQUIRE(usage.headerBytes > 0);
+	REQUIRE(usage.objectBytes > 0);
+	REQUIRE(usage.heapBytes > 0);
+	REQUIRE(usage.GetTotal() > std::filesystem::file_size(fileInput));
+
+	uint64_t blockCount = 0;
+	uint64_t objectBytes = 0;
+	uint64_t heapBytes = 0;
+	for (auto& [blockType, typeUsage] : usage.blockTypes) {
+		blockCount += typeUsage.count;
+		objectBytes += typeUsage.objectBytes;
+		heapBytes += typeUsage.heapBytes;
+	}
+
+	REQUIRE(blockCount == nif.GetHeader().GetNumBlocks());
+	REQUIRE(objectBytes == usage.objectBytes);
+	REQUIRE(heapBytes == usage.heapBytes);
+	REQUIRE(usage.blockTypes["NiSkinPartition"].heapBytes > 0);
+
+	auto shape = dynamic_cast<BSTriShape*>(nif.GetShapes().front());
+	REQUIRE(shape);
+	REQUIRE(shape->GetObjectSize() == sizeof(BSTriShape));
+
+	// Raw caches are included once they were filled
+	const size_t shapeHeapBytesNoRaw = shape->GetHeapSize();
+	REQUIRE(shapeHeapBytesNoRaw >= shape->GetVertexData().capacity() * sizeof(BSVertexData));
+
+	const auto& rawVertices = shape->UpdateRawVertices();
+	REQUIRE(!rawVertices.empty());
+	REQUIRE(shape->GetHeapSize() == shapeHeapBytesNoRaw + rawVertices.capacity() * sizeof(Vector3));
+
+	// Short strings are stored in the object itself
+	NiStringRef str("Short");
+	REQUIRE(str.GetHeapSize() == 0);
+	str.get() = std::string(100, 'a');
+	REQUIRE(str.GetHeapSize() > 100);
+
+	std::vector<std::vector<uint16_t>> nested(2, std::vector<uint16_t>(10));
+	REQUIRE(HeapSize(nested) >= 2 * sizeof(std::vector<uint16_t>) + 20 * sizeof(uint16_t));
+}
+
+TEST_CASE("Copy files on write", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	auto countSharedBlocks = [](const NifFile& file) {
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < file.GetHeader().GetNumBlocks(); i++)
+			if (file.GetHeader().IsBlockShared(i))
+				count++;
+		return count;
+	};
+
+	// Bounds and data sizes are updated by the first save
+	REQUIRE(nif.Save(fileOutput) == 0);
+
+	NifFile copy;
+	copy.CopyFrom(nif, true);
+	const uint32_t numBlocks = copy.GetHeader().GetNumBlocks();
+	REQUIRE(countSharedBlocks(copy) == numBlocks);
+
+	// Reading and saving an unchanged copy doesn't copy blocks
+	auto sharedShape = copy.GetShapes().front();
+	REQUIRE(copy.GetRootNode());
+	REQUIRE(copy.Save(fileOutput) == 0);
+	REQUIRE(CompareBinaryFiles(fileOutput, fileExpected));
+	REQUIRE(countSharedBlocks(copy) == numBlocks);
+
+	// Blocks are copied for modification, the source file is unchanged
+	auto shape = copy.GetBlockForWrite(sharedShape);
+	const uint32_t shapeId = copy.GetBlockID(shape);
+	REQUIRE(shape != sharedShape);
+	REQUIRE(copy.GetBlockID(sharedShape) == shapeId);
+	REQUIRE(countSharedBlocks(copy) == numBlocks - 1);
+	REQUIRE_FALSE(copy.GetHeader().IsBlockShared(shapeId));
+	REQUIRE_FALSE(nif.GetHeader().IsBlockShared(shapeId));
+	REQUIRE(nif.GetHeader().GetBlock<NiShape>(shapeId) != shape);
+
+	const std::string shapeName = shape->name.get();
+	shape->name.get() = "CopiedShape";
+	REQUIRE(nif.GetShapeNames().front() == shapeName);
+
+	// Saving doesn't copy blocks that stay the same
+	shape->name.get() = shapeName;
+	REQUIRE(copy.Save(fileOutput) == 0);
+	REQUIRE(CompareBinaryFiles(fileOutput, fileExpected));
+	REQUIRE(countSharedBlocks(copy) > 0);
+
+	REQUIRE(nif.Save(fileOutput) == 0);
+	REQUIRE(CompareBinaryFiles(fileOutput, fileExpected));
+
+	// Geometry data is linked by pointer and always copied
+	NifFile nifOB;
+	REQUIRE(nifOB.Load(std::get<0>(GetNifFileTuple("TestNifFile_Skinned_OB"))) == 0);
+
+	NifFile copyOB;
+	copyOB.CopyFrom(nifOB, true);
+
+	auto shapeOB = copyOB.GetShapes().front();
+	REQUIRE(shapeOB->GetGeomData());
+	REQUIRE_FALSE(copyOB.GetHeader().IsBlockShared(copyOB.GetBlockID(shapeOB->GetGeomData())));
+	REQUIRE(shapeOB->GetGeomData() == copyOB.GetHeader().GetBlock(shapeOB->DataRef()));
+}
+
+TEST_CASE("Sort blocks that are already sorted", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+	nif.PrettySortBlocks();
+
+	// Sorting again keeps all blocks, shared blocks aren't copied
+	NifFile copy;
+	copy.CopyFrom(nif, true);
+	copy.PrettySortBlocks();
+
+	for (uint32_t i = 0; i < copy.GetHeader().GetNumBlocks(); i++)
+		REQUIRE(copy.GetHeader().IsBlockShared(i));
+
+	REQUIRE(copy.Save(fileOutput) == 0);
+	REQUIRE(CompareBinaryFiles(fileOutput, fileExpected));
+}
+
+TEST_CASE("Move files and transplant subtrees", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	// Blocks are moved with the file
+	auto shape = nif.GetShapes().front();
+	NifFile moved(std::move(nif));
+	REQUIRE(nif.GetHeader().GetNumBlocks() == 0);
+	REQUIRE(moved.GetShapes().front() == shape);
+	REQUIRE(moved.Save(fileOutput) == 0);
+	REQUIRE(CompareBinaryFiles(fileOutput, fileExpected));
+
+	NifFile dest;
+	REQUIRE(dest.Load(fileInput) == 0);
+	NifFile src;
+	REQUIRE(src.Load(fileInput) == 0);
+
+	auto srcShapes = src.GetShapes();
+	REQUIRE(srcShapes.size() >= 2);
+	const size_t numDestShapes = dest.GetShapes().size();
+	const uint32_t numSrcBlocks = src.GetHeader().GetNumBlocks();
+
+	// The shader of the first shape is also used by the second shape
+	NiShape* srcShape = srcShapes[0];
+	auto srcShader = src.GetShader(srcShape);
+	REQUIRE(srcShader);
+	srcShapes[1]->ShaderPropertyRef()->index = srcShape->ShaderPropertyRef()->index;
+
+	const std::string shapeName = srcShape->name.get();
+	const uint16_t numVertices = srcShape->GetNumVertices();
+	std::vector<std::string> srcBones;
+	src.GetShapeBoneList(srcShape, srcBones);
+	REQUIRE_FALSE(srcBones.empty());
+
+	const uint32_t destShapeId = dest.TransplantSubtree(src, srcShape);
+	REQUIRE(destShapeId != NIF_NPOS);
+
+	// The shape is moved, not copied
+	auto destShape = dest.GetHeader().GetBlock<NiShape>(destShapeId);
+	REQUIRE(destShape == srcShape);
+	REQUIRE(dest.GetShapes().size() == numDestShapes + 1);
+	REQUIRE(src.GetShapes().size() == srcShapes.size() - 1);
+	REQUIRE(dest.GetParentNode(destShape) == dest.GetRootNode());
+
+	// Bones are resolved by name
+	std::vector<std::string> destBones;
+	REQUIRE(dest.GetShapeBoneList(destShape, destBones) == srcBones.size());
+	REQUIRE(destBones == srcBones);
+
+	// The shared shader stays in the source file
+	auto destShader = dest.GetShader(destShape);
+	REQUIRE(destShader);
+	REQUIRE(src.GetShader(src.GetShapes().front()));
+	REQUIRE(dest.GetHeader().IsBlockShared(destShader->TextureSetRef()->index));
+	REQUIRE(src.GetHeader().GetNumBlocks() < numSrcBlocks);
+
+	REQUIRE(dest.Save(fileOutput) == 0);
+	REQUIRE(src.Save(fileName + std::string("_src") + nifSuffixOutput) == 0);
+
+	NifFile reloaded;
+	REQUIRE(reloaded.Load(fileOutput) == 0);
+	REQUIRE(reloaded.GetShapes().size() == numDestShapes + 1);
+
+	auto reloadedShape = reloaded.FindBlockByName<NiShape>(shapeName);
+	REQUIRE(reloadedShape);
+	REQUIRE(reloadedShape->GetNumVertices() == numVertices);
+}
+
+TEST_CASE("Deduplicate identical blocks", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Static_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	// Cloned shapes come with their own copy of the shader and texture set
+	auto shape = nif.GetShapes().front();
+	auto clonedShape = nif.CloneShape(shape, "ClonedShape");
+	REQUIRE(clonedShape);
+	REQUIRE(shape->ShaderPropertyRef()->index != clonedShape->ShaderPropertyRef()->index);
+
+	const uint32_t numBlocks = nif.GetHeader().GetNumBlocks();
+	const uint32_t deletionCount = nif.DeduplicateBlocks();
+	REQUIRE(deletionCount >= 2);
+	REQUIRE(nif.GetHeader().GetNumBlocks() == numBlocks - deletionCount);
+	REQUIRE(nif.DeduplicateBlocks() == 0);
+
+	// The shader is only merged because its texture set was merged before
+	shape = nif.GetShapes().front();
+	clonedShape = nif.FindBlockByName<NiShape>("ClonedShape");
+	REQUIRE(clonedShape);
+	REQUIRE(shape->ShaderPropertyRef()->index == clonedShape->ShaderPropertyRef()->index);
+
+	auto shader = nif.GetShader(shape);
+	REQUIRE(shader);
+	REQUIRE(nif.GetHeader().GetBlock<BSShaderTextureSet>(shader->TextureSetRef()));
+
+	REQUIRE(nif.Save(fileOutput) == 0);
+
+	NifFile reloaded;
+	REQUIRE(reloaded.Load(fileOutput) == 0);
+	REQUIRE(reloaded.GetHeader().GetNumBlocks() == numBlocks - deletionCount);
+	REQUIRE(reloaded.GetShapes().size() == nif.GetShapes().size());
+}
+
+TEST_CASE("Hash and diff files", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	NifFile reordered;
+	reordered.CopyFrom(nif);
+	REQUIRE(reordered.GetFileHash() == nif.GetFileHash());
+	REQUIRE(reordered.GetFileHash(true) == nif.GetFileHash(true));
+	REQUIRE(nif.Diff(reordered).IsEmpty());
+
+	// Reverse all blocks but the root node
+	const uint32_t numBlocks = reordered.GetHeader().GetNumBlocks();
+	std::vector<uint32_t> newOrder(numBlocks);
+	newOrder[0] = 0;
+	for (uint32_t i = 1; i < numBlocks; i++)
+		newOrder[i] = numBlocks - i;
+
+	reordered.GetHeader().SetBlockOrder(newOrder);
+	REQUIRE(reordered.GetFileHash() != nif.GetFileHash());
+	REQUIRE(!nif.Diff(reordered).IsEmpty());
+
+	REQUIRE(reordered.GetFileHash(true) == nif.GetFileHash(true));
+	REQUIRE(nif.Diff(reordered, true).IsEmpty());
+
+	auto shape = nif.GetShapes().front();
+	const uint32_t shapeId = nif.GetBlockID(shape);
+	REQUIRE(reordered.GetBlockHash(newOrder[shapeId], true) == nif.GetBlockHash(shapeId, true));
+
+	reordered.PrettySortBlocks();
+	REQUIRE(reordered.GetFileHash(true) == nif.GetFileHash(true));
+	REQUIRE(nif.Diff(reordered, true).IsEmpty());
+
+	// Only the modified shape is reported
+	auto reorderedShape = reordered.FindBlockByName<NiShape>(shape->name.get());
+	REQUIRE(reorderedShape);
+	reorderedShape->flags ^= 1;
+
+	REQUIRE(reordered.GetFileHash(true) != nif.GetFileHash(true));
+
+	const NifDiff diff = nif.Diff(reordered, true);
+	REQUIRE(diff.removed.empty());
+	REQUIRE(diff.added.empty());
+	REQUIRE(diff.changed.size() == 1);
+	REQUIRE(diff.changed[0].first == shapeId);
+	REQUIRE(diff.changed[0].second == reordered.GetBlockID(reorderedShape));
+}
+
+TEST_CASE("Hash and diff bone order", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	NifFile swapped;
+	swapped.CopyFrom(nif);
+
+	auto shape = swapped.GetShapes().front();
+	auto skinInst = swapped.GetHeader().GetBlock<NiSkinInstance>(shape->SkinInstanceRef());
+	REQUIRE(skinInst);
+
+	// Bone order defines the skin binding, so it isn't ignored like the order of node children
+	std::vector<uint32_t> boneIndices;
+	skinInst->boneRefs.GetIndices(boneIndices);
+	REQUIRE(boneIndices.size() > 1);
+	REQUIRE(boneIndices[0] != boneIndices[1]);
+
+	std::swap(boneIndices[0], boneIndices[1]);
+	skinInst->boneRefs.SetIndices(boneIndices);
+
+	REQUIRE(swapped.GetFileHash(true) != nif.GetFileHash(true));
+
+	const uint32_t skinInstId = swapped.GetBlockID(skinInst);
+	REQUIRE(swapped.GetBlockHash(skinInstId, true) != nif.GetBlockHash(skinInstId, true));
+
+	const NifDiff diff = nif.Diff(swapped, true);
+	REQUIRE(diff.changed.size() == 1);
+	REQUIRE(diff.changed[0].first == skinInstId);
+	REQUIRE(diff.changed[0].second == skinInstId);
+}
+
+TEST_CASE("Load and save files asynchronously", "[NifFile]") {
+	const std::vector<const char*> fileNames = {"TestNifFile_Static_SE",
+												"TestNifFile_Skinned_SE",
+												"TestNifFile_Skinned_FO4",
+												"TestNifFile_Skinned_OB"};
+
+	std::vector<NifFile> nifs(fileNames.size());
+	std::vector<std::future<int>> results;
+	for (size_t i = 0; i < fileNames.size(); i++)
+		results.push_back(nifs[i].LoadAsync(std::get<0>(GetNifFileTuple(fileNames[i]))));
+
+	for (auto& result : results)
+		REQUIRE(result.get() == 0);
+
+	results.clear();
+	for (size_t i = 0; i < fileNames.size(); i++)
+		results.push_back(nifs[i].SaveAsync(std::get<1>(GetNifFileTuple(fileNames[i]))));
+
+	for (auto& result : results)
+		REQUIRE(result.get() == 0);
+
+	for (auto fileName : fileNames) {
+		const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+		REQUIRE(CompareBinaryFiles(fileOutput, fileExpected));
+	}
+
+	NifFile nif;
+	REQUIRE(nif.LoadAsync("not_existing.nif").get() == 1);
+	REQUIRE(!nif.IsValid());
+}
+
+TEST_CASE("Calculate serialized sizes", "[NifFile]") {
+	for (auto fileName : {"TestNifFile_Skinned_SE", "TestNifFile_Skinned_FO4", "TestNifFile_Skinned_OB"}) {
+		const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+		NifFile nif;
+		REQUIRE(nif.Load(fileInput) == 0);
+
+		const NifSerializedSize size = nif.CalcSerializedSize();
+		REQUIRE(size.blockBytes.size() == nif.GetHeader().GetNumBlocks());
+		REQUIRE(size.GetTotal() == std::filesystem::file_size(fileExpected));
+
+		std::vector<uint8_t> data;
+		REQUIRE(nif.Save(data) == 0);
+		REQUIRE(data.size() == size.GetTotal());
+
+		std::ifstream expected(fileExpected, std::ios::binary);
+		std::vector<uint8_t> expectedData((std::istreambuf_iterator<char>(expected)),
+										  std::istreambuf_iterator<char>());
+		REQUIRE(data == expectedData);
+	}
+}
+
+TEST_CASE("Enumerate block references", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	// Expected references in serialization order, read from the members directly
+	auto getAVObjectRefs = [](NiAVObject* obj) {
+		std::vector<uint32_t> indices;
+		obj->extraDataRefs.GetIndices(indices);
+		indices.push_back(obj->controllerRef.index);
+		obj->propertyRefs.GetIndices(indices);
+		indices.push_back(obj->collisionRef.index);
+		return indices;
+	};
+
+	size_t numChecked = 0;
+	auto& hdr = nif.GetHeader();
+	for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++) {
+		auto block = hdr.GetBlock<NiObject>(i);
+
+		std::vector<uint32_t> visitedIndices;
+		block->ForEachChildRef([&](NiRef& ref) { visitedIndices.push_back(ref.index); });
+
+		std::vector<uint32_t> visitedPtrs;
+		block->ForEachPtr([&](NiRef& ref) { visitedPtrs.push_back(ref.index); });
+
+		bool hasExpected = true;
+		std::vector<uint32_t> expectedIndices;
+		std::vector<uint32_t> expectedPtrs;
+		if (auto node = dynamic_cast<NiNode*>(block)) {
+			expectedIndices = getAVObjectRefs(node);
+			node->childRefs.GetIndices(expectedIndices);
+			node->effectRefs.GetIndices(expectedIndices);
+		}
+		else if (auto shape = dynamic_cast<BSTriShape*>(block)) {
+			expectedIndices = getAVObjectRefs(shape);
+			expectedIndices.push_back(shape->SkinInstanceRef()->index);
+			expectedIndices.push_back(shape->ShaderPropertyRef()->index);
+			expectedIndices.push_back(shape->AlphaPropertyRef()->index);
+		}
+		else if (auto skinInst = dynamic_cast<NiSkinInstance*>(block)) {
+			expectedIndices = {skinInst->dataRef.index, skinInst->skinPartitionRef.index};
+			expectedPtrs.push_back(skinInst->targetRef.index);
+			skinInst->boneRefs.GetIndices(expectedPtrs);
+		}
+		else
+			hasExpected = false;
+
+		if (hasExpected) {
+			REQUIRE(visitedIndices == expectedIndices);
+			REQUIRE(visitedPtrs == expectedPtrs);
+			numChecked++;
+		}
+
+		// Each reference is visited once
+		std::set<NiRef*> refs;
+		size_t numVisited = 0;
+		block->ForEachRef([&](NiRef& ref) {
+			refs.insert(&ref);
+			numVisited++;
+		});
+		REQUIRE(refs.size() == numVisited);
+
+		std::vector<NiStringRef*> stringRefs;
+		block->GetStringRefs(stringRefs);
+
+		size_t numStringRefs = 0;
+		block->ForEachStringRef([&](NiStringRef& str) { REQUIRE(&str == stringRefs[numStringRefs++]); });
+		REQUIRE(numStringRefs == stringRefs.size());
+	}
+
+	// 3 nodes, 2 shapes and 2 skin instances
+	REQUIRE(numChecked == 7);
+
+	auto root = nif.GetRootNode();
+	REQUIRE(hdr.IsBlockReferenced(root->childRefs.GetBlockRef(0), false));
+	REQUIRE(hdr.GetBlockRefCount(0, false) == 0);
+	REQUIRE(hdr.GetBlockRefCount(0) > 0);
+}
+
+TEST_CASE("Look up parent nodes", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	auto& hdr = nif.GetHeader();
+
+	// Parent lookups must match a search of all nodes
+	auto requireParents = [&]() {
+		for (uint32_t i = 0; i < hdr.GetNumBlocks(); i++) {
+			uint32_t expectedId = NIF_NPOS;
+			for (uint32_t j = 0; j < hdr.GetNumBlocks() && expectedId == NIF_NPOS; j++) {
+				auto node = hdr.GetBlock<NiNode>(j);
+				if (node)
+					for (auto& child : node->childRefs)
+						if (child.index == i && expectedId == NIF_NPOS)
+							expectedId = j;
+			}
+
+			REQUIRE(nif.GetParentNodeID(i) == expectedId);
+			REQUIRE(nif.GetBlockID(hdr.GetBlockById(i)) == i);
+		}
+	};
+
+	requireParents();
+
+	auto root = nif.GetRootNode();
+	MatTransform xform;
+	xform.translation.x = 1.0f;
+	xform.translation.y = 2.0f;
+	xform.translation.z = 3.0f;
+
+	NiNode* parent = root;
+	for (int i = 0; i < 8; i++)
+		parent = nif.AddNode("ParentTest" + std::to_string(i), xform, parent);
+
+	REQUIRE(nif.GetParentNode(parent) == nif.FindBlockByName<NiNode>("ParentTest6"));
+	requireParents();
+
+	MatTransform xformChain;
+	xformChain.translation.x = 8.0f;
+	xformChain.translation.y = 16.0f;
+	xformChain.translation.z = 24.0f;
+
+	MatTransform xformGlobal;
+	REQUIRE(nif.GetNodeTransformToGlobal("ParentTest7", xformGlobal));
+	REQUIRE(xformGlobal.IsNearlyEqualTo(root->GetTransformToParent().ComposeTransforms(xformChain)));
+
+	nif.SetParentNode(parent, root);
+	REQUIRE(nif.GetParentNode(parent) == root);
+	requireParents();
+
+	nif.DeleteNode("ParentTest3");
+	REQUIRE(nif.GetParentNode(nif.FindBlockByName<NiNode>("ParentTest4")) == nullptr);
+	requireParents();
+
+	nif.PrettySortBlocks();
+	requireParents();
+
+	// Child refs that were removed or added directly require the index to be invalidated
+	auto node = nif.FindBlockByName<NiNode>("ParentTest1");
+	auto childNode = nif.FindBlockByName<NiNode>("ParentTest2");
+	node->childRefs.Clear();
+	nif.InvalidateParentIndex();
+	REQUIRE(nif.GetParentNode(childNode) == nullptr);
+
+	root->childRefs.AddBlockRef(nif.GetBlockID(childNode));
+	nif.InvalidateParentIndex();
+	REQUIRE(nif.GetParentNode(childNode) == root);
+	requireParents();
+
+	node->childRefs.AddBlockRef(nif.GetBlockID(nif.GetShapes().front()));
+	nif.InvalidateParentIndex();
+	requireParents();
+
+	// Blocks that aren't part of the file aren't found
+	NiNode otherNode;
+	REQUIRE(nif.GetBlockID(&otherNode) == NIF_NPOS);
+	REQUIRE(nif.GetParentNode(&otherNode) == nullptr);
+}
+
+TEST_CASE("Write trace events", "[NifFile]") {
+	constexpr auto fileName = "TestNifFile_Skinned_SE";
+	const auto [fileInput, fileOutput, fileExpected] = GetNifFileTuple(fileName);
+
+	trace::Clear();
+
+	NifFile nif;
+	REQUIRE(nif.Load(fileInput) == 0);
+
+	std::ostringstream out;
+	trace::WriteChromeTrace(out);
+
+	const std::string traceJson = out.str();
+	REQUIRE(traceJson.find("\"traceEvents\":[") != std::string::npos);
+	REQUIRE(traceJson.back() == '\n');
+
+	if (trace::IsEnabled())
+		REQUIRE(traceJson.find("\"name\":\"NifFile::Load\"") != std::string::npos);
+	else
+		REQUIRE(traceJson.find("\"name\"") == std::string::npos);
+
+	trace::Clear();
+	out.str("");
+	trace::WriteChromeTrace(out);
+	REQUIRE(out.str().find("\"name\"") == std::string::npos);
+}